@@ -21,32 +21,37 @@ t_col_name_type::t_col_name_type(const std::string& name, t_dtype type)
     : m_name(name)
     , m_type(type) {}
 
-t_aggspec::t_aggspec() {}
+t_aggspec::t_aggspec()
+    : m_quantile(0.5) {}
 
 t_aggspec::t_aggspec(const std::string& name, t_aggtype agg,
     const std::vector<t_dep>& dependencies)
     : m_name(name)
     , m_disp_name(name)
     , m_agg(agg)
-    , m_dependencies(dependencies) {}
+    , m_dependencies(dependencies)
+    , m_quantile(0.5) {}
 
 t_aggspec::t_aggspec(
     const std::string& aggname, t_aggtype agg, const std::string& dep)
     : m_name(aggname)
     , m_disp_name(aggname)
     , m_agg(agg)
-    , m_dependencies(std::vector<t_dep>{t_dep(dep, DEPTYPE_COLUMN)}) {}
+    , m_dependencies(std::vector<t_dep>{t_dep(dep, DEPTYPE_COLUMN)})
+    , m_quantile(0.5) {}
 
 t_aggspec::t_aggspec(t_aggtype agg, const std::string& dep)
     : m_agg(agg)
-    , m_dependencies(std::vector<t_dep>{t_dep(dep, DEPTYPE_COLUMN)}) {}
+    , m_dependencies(std::vector<t_dep>{t_dep(dep, DEPTYPE_COLUMN)})
+    , m_quantile(0.5) {}
 
 t_aggspec::t_aggspec(const std::string& name, const std::string& disp_name,
     t_aggtype agg, const std::vector<t_dep>& dependencies)
     : m_name(name)
     , m_disp_name(disp_name)
     , m_agg(agg)
-    , m_dependencies(dependencies) {}
+    , m_dependencies(dependencies)
+    , m_quantile(0.5) {}
 
 t_aggspec::t_aggspec(const std::string& name, const std::string& disp_name,
     t_aggtype agg, const std::vector<t_dep>& dependencies, t_sorttype sort_type)
@@ -54,7 +59,8 @@ t_aggspec::t_aggspec(const std::string& name, const std::string& disp_name,
     , m_disp_name(disp_name)
     , m_agg(agg)
     , m_dependencies(dependencies)
-    , m_sort_type(sort_type) {}
+    , m_sort_type(sort_type)
+    , m_quantile(0.5) {}
 
 t_aggspec::t_aggspec(const std::string& aggname,
     const std::string& disp_aggname, t_aggtype agg, t_uindex agg_one_idx,
@@ -65,7 +71,16 @@ t_aggspec::t_aggspec(const std::string& aggname,
     , m_agg_one_idx(agg_one_idx)
     , m_agg_two_idx(agg_two_idx)
     , m_agg_one_weight(agg_one_weight)
-    , m_agg_two_weight(agg_two_weight) {}
+    , m_agg_two_weight(agg_two_weight)
+    , m_quantile(0.5) {}
+
+t_aggspec::t_aggspec(const std::string& aggname, t_aggtype agg,
+    const std::vector<t_dep>& dependencies, double quantile)
+    : m_name(aggname)
+    , m_disp_name(aggname)
+    , m_agg(agg)
+    , m_dependencies(dependencies)
+    , m_quantile(quantile) {}
 
 t_aggspec::~t_aggspec() {}
 
@@ -207,6 +222,12 @@ t_aggspec::agg_str() const {
         case AGGTYPE_STANDARD_DEVIATION: {
             return "stddev";
         }
+        case AGGTYPE_APPROX_DISTINCT: {
+            return "approx_distinct";
+        }
+        case AGGTYPE_APPROX_PERCENTILE: {
+            return "approx_percentile";
+        }
         default: {
             PSP_COMPLAIN_AND_ABORT("Unknown agg type");
             return "unknown";
@@ -272,6 +293,11 @@ t_aggspec::get_agg_two_weight() const {
     return m_agg_two_weight;
 }
 
+double
+t_aggspec::get_quantile() const {
+    return m_quantile;
+}
+
 t_invmode
 t_aggspec::get_inv_mode() const {
     return m_invmode;
@@ -346,7 +372,8 @@ t_aggspec::get_output_specs(const t_schema& schema) const {
         case AGGTYPE_SCALED_ADD:
         case AGGTYPE_SCALED_MUL:
         case AGGTYPE_VARIANCE:
-        case AGGTYPE_STANDARD_DEVIATION: {
+        case AGGTYPE_STANDARD_DEVIATION:
+        case AGGTYPE_APPROX_PERCENTILE: {
             return mk_col_name_type_vec(name(), DTYPE_FLOAT64);
         }
         case AGGTYPE_UDF_COMBINER:
@@ -362,7 +389,8 @@ t_aggspec::get_output_specs(const t_schema& schema) const {
         case AGGTYPE_AND: {
             return mk_col_name_type_vec(name(), DTYPE_BOOL);
         }
-        case AGGTYPE_DISTINCT_COUNT: {
+        case AGGTYPE_DISTINCT_COUNT:
+        case AGGTYPE_APPROX_DISTINCT: {
             return mk_col_name_type_vec(name(), DTYPE_UINT32);
         }
         default: {
@@ -405,6 +433,12 @@ t_aggspec::is_non_delta() const {
     return false;
 }
 
+bool
+t_aggspec::is_sketch_agg() const {
+    return m_agg == AGGTYPE_APPROX_DISTINCT
+        || m_agg == AGGTYPE_APPROX_PERCENTILE;
+}
+
 std::string
 t_aggspec::get_first_depname() const {
     if (m_dependencies.empty())
@@ -11,6 +11,7 @@
 #include <functional>
 #include <perspective/arg_sort.h>
 #include <perspective/multi_sort.h>
+#include <perspective/parallel_sort.h>
 #include <perspective/scalar.h>
 
 namespace perspective {
@@ -22,7 +23,7 @@ argsort(std::vector<t_index>& output, const t_multisorter& sorter) {
     // Output should be the same size is v
     for (t_index i = 0, loop_end = output.size(); i != loop_end; ++i)
         output[i] = i;
-    std::sort(output.begin(), output.end(), sorter);
+    parallel_sort(output, sorter);
 }
 
 t_argsort_comparator::t_argsort_comparator(
@@ -65,7 +66,7 @@ simple_argsort(std::vector<t_tscalar>& v, std::vector<t_index>& output,
         output[i] = i;
     t_argsort_comparator cmp(v, sort_type);
 
-    std::sort(output.begin(), output.end(), cmp);
+    parallel_sort(output, cmp);
 }
 
 } // namespace perspective
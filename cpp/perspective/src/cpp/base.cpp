@@ -503,6 +503,12 @@ str_to_aggtype(const std::string& str) {
         return t_aggtype::AGGTYPE_VARIANCE;
     } else if (str == "stddev" || str == "standard deviation") {
         return t_aggtype::AGGTYPE_STANDARD_DEVIATION;
+    } else if (str == "approx distinct" || str == "approx_distinct") {
+        return t_aggtype::AGGTYPE_APPROX_DISTINCT;
+    } else if (str.rfind("approx percentile", 0) == 0
+        || str.rfind("approx_percentile", 0) == 0) {
+        // matches "approx percentile" as well as "approx percentile(0.95)"
+        return t_aggtype::AGGTYPE_APPROX_PERCENTILE;
     } else {
         std::stringstream ss;
         ss << "Encountered unknown aggregate operation: '" << str << "'"
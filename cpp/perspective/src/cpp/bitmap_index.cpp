@@ -0,0 +1,319 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2017, the Perspective Authors.
+ *
+ * This file is part of the Perspective library, distributed under the terms of
+ * the Apache License 2.0.  The full license can be found in the LICENSE file.
+ *
+ */
+
+#include <perspective/first.h>
+#include <perspective/bitmap_index.h>
+#include <algorithm>
+#include <bitset>
+#include <cstring>
+
+namespace perspective {
+
+static inline t_uindex
+popcount(std::uint64_t word) {
+    return std::bitset<64>(word).count();
+}
+
+const t_uindex t_bitmap_index::MAX_KEYS;
+const std::uint16_t t_bitmap_index::NO_SLOT;
+
+t_bitmap_index::t_bitmap_index()
+    : m_dtype(DTYPE_NONE)
+    , m_nrows(0) {}
+
+bool
+t_bitmap_index::is_indexable(t_dtype dtype) {
+    switch (dtype) {
+        case DTYPE_INT64:
+        case DTYPE_INT32:
+        case DTYPE_INT16:
+        case DTYPE_INT8:
+        case DTYPE_UINT64:
+        case DTYPE_UINT32:
+        case DTYPE_UINT16:
+        case DTYPE_UINT8:
+        case DTYPE_BOOL:
+        case DTYPE_DATE:
+        case DTYPE_STR: {
+            return true;
+        } break;
+        default: {
+            return false;
+        } break;
+    }
+}
+
+t_dtype
+t_bitmap_index::get_dtype() const {
+    return m_dtype;
+}
+
+std::uint64_t
+t_bitmap_index::get_key(const void* data, t_uindex nbytes) {
+    std::uint64_t key = 0;
+    std::memcpy(&key, data, nbytes);
+    return key;
+}
+
+bool
+t_bitmap_index::build(const t_column* column, t_uindex nrows) {
+    clear();
+
+    if (!is_indexable(column->get_dtype())) {
+        return false;
+    }
+
+    m_dtype = column->get_dtype();
+    resize(nrows);
+
+    std::vector<t_uindex> rows(nrows);
+    for (t_uindex ridx = 0; ridx < nrows; ++ridx) {
+        rows[ridx] = ridx;
+    }
+
+    return update(column, rows, nrows);
+}
+
+bool
+t_bitmap_index::update(const t_column* column,
+    const std::vector<t_uindex>& rows, t_uindex nrows) {
+    if (column->get_dtype() != m_dtype) {
+        return build(column, nrows);
+    }
+
+    resize(nrows);
+
+    t_uindex nbytes = get_dtype_size(column->get_dtype());
+    const unsigned char* data = column->get_nth<unsigned char>(0);
+    bool status_enabled = column->is_status_enabled();
+
+    for (t_uindex ridx : rows) {
+        bool valid = !status_enabled
+            || *(column->get_nth_status(ridx)) == STATUS_VALID;
+        std::uint64_t key = get_key(data + ridx * nbytes, nbytes);
+
+        if (!set_row(ridx, valid, key)) {
+            clear();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void
+t_bitmap_index::select(const std::vector<std::uint64_t>& keys,
+    const std::vector<std::uint64_t>* live,
+    std::vector<std::uint64_t>& out) const {
+    std::vector<std::uint64_t> matches((m_nrows + 63) / 64);
+
+    for (std::uint64_t key : keys) {
+        auto iter = m_slots.find(key);
+        if (iter == m_slots.end()) {
+            continue;
+        }
+
+        const std::vector<std::uint64_t>& bitmap = m_bitmaps[iter->second];
+        for (t_uindex widx = 0, loop_end = bitmap.size(); widx < loop_end;
+             ++widx) {
+            matches[widx] |= bitmap[widx];
+        }
+
+        for (t_uindex ridx : m_rows[iter->second]) {
+            matches[ridx / 64] |= std::uint64_t(1) << (ridx % 64);
+        }
+    }
+
+    if (live == nullptr) {
+        out.swap(matches);
+        return;
+    }
+
+    // Row `r` of the compacted table is the `r`th row set in `live`.
+    t_uindex nlive = 0;
+    for (std::uint64_t word : *live) {
+        nlive += popcount(word);
+    }
+
+    out.assign((nlive + 63) / 64, 0);
+    t_uindex offset = 0;
+
+    for (t_uindex widx = 0, loop_end = matches.size(); widx < loop_end;
+         ++widx) {
+        std::uint64_t live_word = widx < live->size() ? (*live)[widx] : 0;
+        std::uint64_t bits = matches[widx] & live_word;
+
+        while (bits != 0) {
+            std::uint64_t below = (bits & (~bits + 1)) - 1;
+            t_uindex ridx = offset + popcount(live_word & below);
+            out[ridx / 64] |= std::uint64_t(1) << (ridx % 64);
+            bits &= bits - 1;
+        }
+
+        offset += popcount(live_word);
+    }
+}
+
+void
+t_bitmap_index::clear() {
+    m_nrows = 0;
+    m_slots.clear();
+    m_keys.clear();
+    m_counts.clear();
+    m_free_slots.clear();
+    m_bitmaps.clear();
+    m_rows.clear();
+    m_row_slots.clear();
+}
+
+void
+t_bitmap_index::resize(t_uindex nrows) {
+    if (nrows <= m_nrows) {
+        return;
+    }
+
+    m_nrows = nrows;
+    m_row_slots.resize(nrows, NO_SLOT);
+
+    for (t_uindex slot = 0, loop_end = m_bitmaps.size(); slot < loop_end;
+         ++slot) {
+        if (m_bitmaps[slot].empty()) {
+            continue;
+        }
+
+        if (m_counts[slot] <= m_nrows / 128) {
+            make_sparse(slot);
+        } else {
+            m_bitmaps[slot].resize((nrows + 63) / 64);
+        }
+    }
+}
+
+bool
+t_bitmap_index::set_row(t_uindex ridx, bool valid, std::uint64_t key) {
+    std::uint16_t old_slot = m_row_slots[ridx];
+
+    if (old_slot != NO_SLOT) {
+        if (valid && m_keys[old_slot] == key) {
+            return true;
+        }
+
+        remove_row(old_slot, ridx);
+        m_row_slots[ridx] = NO_SLOT;
+
+        if (m_counts[old_slot] == 0) {
+            m_slots.erase(m_keys[old_slot]);
+            m_free_slots.push_back(old_slot);
+        }
+    }
+
+    if (!valid) {
+        return true;
+    }
+
+    std::uint16_t slot;
+    auto iter = m_slots.find(key);
+
+    if (iter != m_slots.end()) {
+        slot = iter->second;
+    } else if (!m_free_slots.empty()) {
+        slot = m_free_slots.back();
+        m_free_slots.pop_back();
+        m_keys[slot] = key;
+        m_slots[key] = slot;
+    } else if (m_keys.size() < MAX_KEYS) {
+        slot = m_keys.size();
+        m_keys.push_back(key);
+        m_counts.push_back(0);
+        m_bitmaps.emplace_back();
+        m_rows.emplace_back();
+        m_slots[key] = slot;
+    } else {
+        return false;
+    }
+
+    add_row(slot, ridx);
+    m_row_slots[ridx] = slot;
+    return true;
+}
+
+void
+t_bitmap_index::add_row(std::uint16_t slot, t_uindex ridx) {
+    m_counts[slot] += 1;
+
+    if (!m_bitmaps[slot].empty()) {
+        m_bitmaps[slot][ridx / 64] |= std::uint64_t(1) << (ridx % 64);
+        return;
+    }
+
+    // Rows are mostly indexed in order, so this is usually an append.
+    std::vector<t_uindex>& rows = m_rows[slot];
+    if (rows.empty() || rows.back() < ridx) {
+        rows.push_back(ridx);
+    } else {
+        rows.insert(std::lower_bound(rows.begin(), rows.end(), ridx), ridx);
+    }
+
+    if (m_counts[slot] > m_nrows / 64) {
+        make_dense(slot);
+    }
+}
+
+void
+t_bitmap_index::remove_row(std::uint16_t slot, t_uindex ridx) {
+    m_counts[slot] -= 1;
+
+    if (m_bitmaps[slot].empty()) {
+        std::vector<t_uindex>& rows = m_rows[slot];
+        rows.erase(std::lower_bound(rows.begin(), rows.end(), ridx));
+        return;
+    }
+
+    m_bitmaps[slot][ridx / 64] &= ~(std::uint64_t(1) << (ridx % 64));
+
+    // Half the count a slot was made dense at, so that a value moving
+    // back and forth across it is not converted on every update.
+    if (m_counts[slot] <= m_nrows / 128) {
+        make_sparse(slot);
+    }
+}
+
+void
+t_bitmap_index::make_dense(std::uint16_t slot) {
+    std::vector<std::uint64_t>& bitmap = m_bitmaps[slot];
+    bitmap.assign((m_nrows + 63) / 64, 0);
+
+    for (t_uindex ridx : m_rows[slot]) {
+        bitmap[ridx / 64] |= std::uint64_t(1) << (ridx % 64);
+    }
+
+    std::vector<t_uindex>().swap(m_rows[slot]);
+}
+
+void
+t_bitmap_index::make_sparse(std::uint16_t slot) {
+    std::vector<t_uindex>& rows = m_rows[slot];
+    rows.reserve(m_counts[slot]);
+
+    const std::vector<std::uint64_t>& bitmap = m_bitmaps[slot];
+    for (t_uindex widx = 0, loop_end = bitmap.size(); widx < loop_end;
+         ++widx) {
+        std::uint64_t bits = bitmap[widx];
+
+        while (bits != 0) {
+            std::uint64_t below = (bits & (~bits + 1)) - 1;
+            rows.push_back(widx * 64 + popcount(below));
+            bits &= bits - 1;
+        }
+    }
+
+    std::vector<std::uint64_t>().swap(m_bitmaps[slot]);
+}
+
+} // end namespace perspective
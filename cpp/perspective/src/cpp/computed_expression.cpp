@@ -8,6 +8,11 @@
  */
 
 #include <perspective/computed_expression.h>
+#include <perspective/parallel_for.h>
+#include <cctype>
+#ifdef PSP_PARALLEL_FOR
+#include <thread>
+#endif
 
 namespace perspective {
 
@@ -27,6 +32,8 @@ std::shared_ptr<exprtk::parser<t_tscalar>> t_computed_expression_parser::PARSER
     = std::make_shared<exprtk::parser<t_tscalar>>(
         t_computed_expression_parser::PARSER_COMPILE_OPTIONS);
 
+std::atomic<t_uindex> t_computed_expression_parser::COMPILE_COUNT(0);
+
 computed_function::bucket t_computed_expression_parser::BUCKET_FN
     = computed_function::bucket();
 
@@ -76,6 +83,50 @@ t_tscalar t_computed_expression_parser::TRUE_SCALAR = mktscalar(true);
 
 t_tscalar t_computed_expression_parser::FALSE_SCALAR = mktscalar(false);
 
+// The fewest rows worth compiling another program for, so that a table is
+// only computed in parallel once it is large enough to pay for it.
+static const t_uindex PARALLEL_CHUNK_ROWS = 65536;
+
+// An output slot whose string result is not yet interned.
+static const t_uindex NO_OUTPUT_ID = static_cast<t_uindex>(INVALID_INDEX);
+
+// Whether `parsed_expression_string` calls a function whose result is not
+// determined by its arguments alone, which cannot be computed once and reused.
+static bool
+calls_nondeterministic_function(const std::string& parsed_expression_string) {
+    static const std::vector<std::string> NONDETERMINISTIC_FUNCTIONS
+        = {"random", "now", "today"};
+
+    t_uindex length = parsed_expression_string.size();
+    t_uindex idx = 0;
+
+    while (idx < length) {
+        if (!std::isalpha(parsed_expression_string[idx])
+            && parsed_expression_string[idx] != '_') {
+            ++idx;
+            continue;
+        }
+
+        t_uindex begin = idx;
+        while (idx < length
+            && (std::isalnum(parsed_expression_string[idx])
+                || parsed_expression_string[idx] == '_')) {
+            ++idx;
+        }
+
+        std::string identifier
+            = parsed_expression_string.substr(begin, idx - begin);
+
+        for (const auto& name : NONDETERMINISTIC_FUNCTIONS) {
+            if (identifier == name) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
 /******************************************************************************
  *
  * t_computed_expression
@@ -92,78 +143,293 @@ t_computed_expression::t_computed_expression(
     , m_column_ids(std::move(column_ids))
     , m_dtype(dtype) {}
 
+t_computed_expression::~t_computed_expression() {}
+
 void
 t_computed_expression::compute(std::shared_ptr<t_data_table> source_table,
     std::shared_ptr<t_data_table> destination_table, t_expression_vocab& vocab,
     t_regex_mapping& regex_mapping) const {
-    // TODO: share symtables across pre/re/compute
-    exprtk::symbol_table<t_tscalar> sym_table;
+    auto num_input_columns = m_column_ids.size();
+    std::vector<std::shared_ptr<t_column>> columns(num_input_columns);
+    std::vector<t_dtype> column_dtypes(num_input_columns);
 
-    // pi, infinity, etc.
-    sym_table.add_constants();
+    for (t_uindex cidx = 0; cidx < num_input_columns; ++cidx) {
+        const std::string& column_name = m_column_ids[cidx].second;
+        columns[cidx] = source_table->get_column(column_name);
+        column_dtypes[cidx] = columns[cidx]->get_dtype();
+    }
 
-    // Create a function store, with is_type_validator set to false as we
-    // are calculating values, not type-checking.
-    t_computed_function_store function_store(vocab, regex_mapping, false);
-    function_store.register_computed_functions(sym_table);
+    // The function store holds on to the vocab and regex mapping, so a
+    // program is only reused with the ones it was compiled with.
+    if (m_programs.empty() || m_programs[0]->m_vocab != &vocab
+        || m_programs[0]->m_regex_mapping != &regex_mapping) {
+        m_programs.clear();
+        m_programs.push_back(
+            compile_program(column_dtypes, vocab, regex_mapping));
+        t_computed_program& program = *m_programs[0];
+
+        program.m_plan = t_computed_plan::build(m_parsed_expression_string,
+            m_column_ids, column_dtypes, m_dtype);
+
+        // Column ids are unique per column, so a single id means every
+        // variable in the expression reads the same string.
+        program.m_memoize = program.m_plan == nullptr
+            && num_input_columns == 1 && column_dtypes[0] == DTYPE_STR
+            && !is_nondeterministic();
+    }
 
-    exprtk::expression<t_tscalar> expr_definition;
-    std::vector<std::pair<std::string, t_tscalar>> values;
-    tsl::hopscotch_map<std::string, std::shared_ptr<t_column>> columns;
+    t_computed_program& program = *m_programs[0];
+
+    // create or get output column using m_expression_alias
+    auto output_column
+        = destination_table->add_column_sptr(m_expression_alias, m_dtype, true);
+    auto num_rows = source_table->size();
+    output_column->reserve(num_rows);
+
+    if (program.m_plan != nullptr) {
+        program.m_plan->compute(columns, *output_column, num_rows);
+        return;
+    }
+
+    if (program.m_memoize) {
+        compute_memoized(program, columns[0], *output_column, num_rows);
+        program.m_function_store.clear_computed_function_state();
+        return;
+    }
+
+    t_uindex num_chunks = 1;
+
+#ifdef PSP_PARALLEL_FOR
+    // `random()` draws from a single engine shared by every function store,
+    // so expressions calling it are only ever computed on this thread.
+    if (!is_nondeterministic()) {
+        t_uindex num_threads
+            = std::max(1u, std::thread::hardware_concurrency());
+        t_uindex max_chunks
+            = (num_rows + PARALLEL_CHUNK_ROWS - 1) / PARALLEL_CHUNK_ROWS;
+        num_chunks = std::min(num_threads, max_chunks);
+    }
+#endif
+
+    if (num_chunks <= 1) {
+        compute_rows(program, columns, *output_column, 0, num_rows);
+        program.m_function_store.clear_computed_function_state();
+        return;
+    }
+
+    // Each thread evaluates its rows with its own program, as the values
+    // bound to the symbol table and the function store are written to on
+    // every row. Programs are compiled here, as the parser is shared.
+    while (m_programs.size() < num_chunks) {
+        m_programs.push_back(
+            compile_program(column_dtypes, vocab, regex_mapping));
+    }
+
+    t_uindex chunk_size = (num_rows + num_chunks - 1) / num_chunks;
+
+    // Writing a string interns it into the output column's vocab, which is
+    // not safe across threads, so string results are written afterwards.
+    bool is_string_output = m_dtype == DTYPE_STR;
+    std::vector<t_tscalar> string_values;
+
+    if (is_string_output) {
+        string_values.resize(num_rows);
+    }
 
+    parallel_for(int(num_chunks),
+        [this, &columns, &output_column, &string_values, is_string_output,
+            chunk_size, num_rows](int chunk) {
+            t_computed_program& chunk_program = *m_programs[chunk];
+            t_uindex begin = chunk * chunk_size;
+            t_uindex end = std::min(begin + chunk_size, num_rows);
+
+            if (is_string_output) {
+                for (t_uindex ridx = begin; ridx < end; ++ridx) {
+                    string_values[ridx]
+                        = evaluate_row(chunk_program, columns, ridx);
+                }
+            } else {
+                compute_rows(
+                    chunk_program, columns, *output_column, begin, end);
+            }
+
+            chunk_program.m_function_store.clear_computed_function_state();
+        });
+
+    for (t_uindex ridx = 0; ridx < string_values.size(); ++ridx) {
+        const t_tscalar& value = string_values[ridx];
+
+        if (!value.is_valid() || value.is_none()) {
+            output_column->clear(ridx);
+            continue;
+        }
+
+        output_column->set_scalar(ridx, value);
+    }
+};
+
+std::unique_ptr<t_computed_program>
+t_computed_expression::compile_program(
+    const std::vector<t_dtype>& column_dtypes, t_expression_vocab& vocab,
+    t_regex_mapping& regex_mapping) const {
     auto num_input_columns = m_column_ids.size();
-    values.resize(num_input_columns);
-    columns.reserve(num_input_columns);
+    std::unique_ptr<t_computed_program> program(
+        new t_computed_program(vocab, regex_mapping));
+
+    // pi, infinity, etc.
+    program->m_sym_table.add_constants();
+    program->m_function_store.register_computed_functions(
+        program->m_sym_table);
+
+    // Sized once, as the symbol table refers to each value by address.
+    program->m_values.resize(num_input_columns);
 
     for (t_uindex cidx = 0; cidx < num_input_columns; ++cidx) {
         const std::string& column_id = m_column_ids[cidx].first;
-        const std::string& column_name = m_column_ids[cidx].second;
-        columns[column_id] = source_table->get_column(column_name);
 
-        t_tscalar rval;
+        t_tscalar& rval = program->m_values[cidx];
         rval.clear();
-        rval.m_type = columns[column_id]->get_dtype();
-
-        values[cidx] = std::pair<std::string, t_tscalar>(column_id, rval);
-        sym_table.add_variable(column_id, values[cidx].second);
+        rval.m_type = column_dtypes[cidx];
+        program->m_sym_table.add_variable(column_id, rval);
     }
 
-    expr_definition.register_symbol_table(sym_table);
+    program->m_expression.register_symbol_table(program->m_sym_table);
 
-    if (!t_computed_expression_parser::PARSER->compile(
-            m_parsed_expression_string, expr_definition)) {
+    if (!t_computed_expression_parser::compile(
+            m_parsed_expression_string, program->m_expression)) {
         std::stringstream ss;
-        ss << "[t_computed_expression::compute] Failed to parse expression: `"
+        ss << "[t_computed_expression::compute] Failed to parse "
+              "expression: `"
            << m_parsed_expression_string << "`, failed with error: "
            << t_computed_expression_parser::PARSER->error() << std::endl;
-
         PSP_COMPLAIN_AND_ABORT(ss.str());
     }
 
-    // create or get output column using m_expression_alias
-    auto output_column
-        = destination_table->add_column_sptr(m_expression_alias, m_dtype, true);
-    auto num_rows = source_table->size();
-    output_column->reserve(num_rows);
+    return program;
+}
 
-    for (t_uindex ridx = 0; ridx < num_rows; ++ridx) {
-        for (t_uindex cidx = 0; cidx < num_input_columns; ++cidx) {
-            const std::string& column_id = m_column_ids[cidx].first;
-            values[cidx].second.set(columns[column_id]->get_scalar(ridx));
-        }
+t_tscalar
+t_computed_expression::evaluate_row(t_computed_program& program,
+    const std::vector<std::shared_ptr<t_column>>& columns,
+    t_uindex ridx) const {
+    for (t_uindex cidx = 0, loop_end = columns.size(); cidx < loop_end;
+         ++cidx) {
+        program.m_values[cidx].set(columns[cidx]->get_scalar(ridx));
+    }
 
-        t_tscalar value = expr_definition.value();
+    return program.m_expression.value();
+}
+
+void
+t_computed_expression::compute_rows(t_computed_program& program,
+    const std::vector<std::shared_ptr<t_column>>& columns,
+    t_column& output_column, t_uindex begin, t_uindex end) const {
+    for (t_uindex ridx = begin; ridx < end; ++ridx) {
+        t_tscalar value = evaluate_row(program, columns, ridx);
 
         if (!value.is_valid() || value.is_none()) {
-            output_column->clear(ridx);
+            output_column.clear(ridx);
             continue;
         }
 
-        output_column->set_scalar(ridx, value);
+        output_column.set_scalar(ridx, value);
     }
+}
 
-    function_store.clear_computed_function_state();
-};
+void
+t_computed_expression::compute_memoized(t_computed_program& program,
+    std::shared_ptr<t_column> column, t_column& output_column,
+    t_uindex num_rows) const {
+    const t_uindex NUM_STATUSES = t_computed_memo::NUM_STATUSES;
+    t_expression_vocab& vocab = *(program.m_vocab);
+    t_computed_memo* memo = nullptr;
+
+    // Drop the results for columns that no longer exist.
+    auto& memos = program.m_memos;
+    memos.erase(std::remove_if(memos.begin(), memos.end(),
+                    [](const t_computed_memo& m) {
+                        return m.m_column.expired();
+                    }),
+        memos.end());
+
+    for (auto& m : memos) {
+        if (m.m_column.lock() == column) {
+            memo = &m;
+            break;
+        }
+    }
+
+    if (memo == nullptr) {
+        memos.emplace_back();
+        memo = &memos.back();
+        memo->m_column = column;
+    }
+
+    // A column that borrowed another vocab has its strings renumbered, and
+    // a cleared expression vocab has freed the string results.
+    t_uindex num_slots = column->get_vlenidx() * NUM_STATUSES;
+    if (memo->m_vocab != column->_get_vocab()
+        || memo->m_generation != vocab.get_generation()
+        || memo->m_results.size() > num_slots) {
+        memo->m_vocab = column->_get_vocab();
+        memo->m_generation = vocab.get_generation();
+        memo->m_results.clear();
+        memo->m_computed.clear();
+    }
+
+    memo->m_results.resize(num_slots);
+    memo->m_computed.resize(num_slots, false);
+
+    // A string output column interns each result once, and rows with the
+    // same result then share its id.
+    bool is_string_output = output_column.get_dtype() == DTYPE_STR;
+    std::vector<t_uindex> output_ids;
+    if (is_string_output) {
+        output_ids.resize(num_slots, NO_OUTPUT_ID);
+    }
+
+    bool status_enabled = column->is_status_enabled();
+    t_tscalar& input = program.m_values[0];
+
+    for (t_uindex ridx = 0; ridx < num_rows; ++ridx) {
+        t_uindex sidx = *(column->get_nth<t_uindex>(ridx));
+        t_status status
+            = status_enabled ? *(column->get_nth_status(ridx)) : STATUS_VALID;
+        t_uindex slot = sidx * NUM_STATUSES + status;
+        t_tscalar& value = memo->m_results[slot];
+
+        if (!memo->m_computed[slot]) {
+            input.set(column->get_scalar(ridx));
+            value = program.m_expression.value();
+
+            // Strings read straight from the input column would not survive
+            // its vocab growing, so keep a copy in the expression vocab.
+            if (value.get_dtype() == DTYPE_STR && value.is_valid()) {
+                value.set(vocab.intern(value.get_char_ptr()));
+            }
+
+            memo->m_computed[slot] = true;
+        }
+
+        if (!value.is_valid() || value.is_none()) {
+            output_column.clear(ridx);
+            continue;
+        }
+
+        if (!is_string_output) {
+            output_column.set_scalar(ridx, value);
+            continue;
+        }
+
+        if (output_ids[slot] == NO_OUTPUT_ID) {
+            output_column.set_scalar(ridx, value);
+            output_ids[slot] = *(output_column.get_nth<t_uindex>(ridx));
+        } else {
+            output_column.set_nth<t_uindex>(
+                ridx, output_ids[slot], STATUS_VALID);
+        }
+    }
+}
 
 const std::string&
 t_computed_expression::get_expression_alias() const {
@@ -190,6 +456,11 @@ t_computed_expression::get_dtype() const {
     return m_dtype;
 }
 
+bool
+t_computed_expression::is_nondeterministic() const {
+    return calls_nondeterministic_function(m_parsed_expression_string);
+}
+
 /******************************************************************************
  *
  * t_computed_expression_parser
@@ -208,6 +479,18 @@ t_computed_expression_parser::init() {
             exprtk::parser<t_tscalar>::settings_store::e_bf_max);
 }
 
+bool
+t_computed_expression_parser::compile(const std::string& expression_string,
+    exprtk::expression<t_tscalar>& expression) {
+    ++COMPILE_COUNT;
+    return PARSER->compile(expression_string, expression);
+}
+
+t_uindex
+t_computed_expression_parser::get_compile_count() {
+    return COMPILE_COUNT;
+}
+
 std::shared_ptr<t_computed_expression>
 t_computed_expression_parser::precompute(const std::string& expression_alias,
     const std::string& expression_string,
@@ -254,7 +537,7 @@ t_computed_expression_parser::precompute(const std::string& expression_alias,
     exprtk::expression<t_tscalar> expr_definition;
     expr_definition.register_symbol_table(sym_table);
 
-    if (!t_computed_expression_parser::PARSER->compile(
+    if (!t_computed_expression_parser::compile(
             parsed_expression_string, expr_definition)) {
         std::stringstream ss;
         ss << "[t_computed_expression_parser::precompute] Failed to parse "
@@ -329,7 +612,7 @@ t_computed_expression_parser::get_dtype(const std::string& expression_alias,
     exprtk::expression<t_tscalar> expr_definition;
     expr_definition.register_symbol_table(sym_table);
 
-    if (!t_computed_expression_parser::PARSER->compile(
+    if (!t_computed_expression_parser::compile(
             parsed_expression_string, expr_definition)) {
         // Error count should always be above 0 if there is a compile error -
         // We simply take the first error and return it.
@@ -510,4 +793,20 @@ t_computed_function_store::clear_computed_function_state() {
     m_order_fn.clear_order_map();
 }
 
+t_computed_program::t_computed_program(
+    t_expression_vocab& vocab, t_regex_mapping& regex_mapping)
+    : m_vocab(&vocab)
+    , m_regex_mapping(&regex_mapping)
+    , m_function_store(vocab, regex_mapping, false)
+    , m_memoize(false) {}
+
+/******************************************************************************
+ *
+ * t_computed_memo
+ */
+
+t_computed_memo::t_computed_memo()
+    : m_vocab(nullptr)
+    , m_generation(0) {}
+
 } // end namespace perspective
\ No newline at end of file
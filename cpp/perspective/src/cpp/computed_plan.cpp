@@ -0,0 +1,1001 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2019, the Perspective Authors.
+ *
+ * This file is part of the Perspective library, distributed under the terms of
+ * the Apache License 2.0.  The full license can be found in the LICENSE file.
+ *
+ */
+
+#include <perspective/first.h>
+#include <perspective/computed_plan.h>
+#include <perspective/exprtk.h>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <functional>
+
+namespace perspective {
+
+const t_uindex t_computed_plan::BATCH_SIZE;
+
+static const t_uindex NO_INDEX = static_cast<t_uindex>(INVALID_INDEX);
+
+static bool
+is_plain_dtype(t_dtype dtype) {
+    return is_numeric_type(dtype) || dtype == DTYPE_BOOL;
+}
+
+// Whether a double holds every value of `dtype`, so that comparing rows as
+// doubles orders them as `t_tscalar` does.
+static bool
+is_exact_dtype(t_dtype dtype) {
+    return is_plain_dtype(dtype) && dtype != DTYPE_INT64
+        && dtype != DTYPE_UINT64;
+}
+
+static bool
+is_float_dtype(t_dtype dtype) {
+    return dtype == DTYPE_FLOAT64 || dtype == DTYPE_FLOAT32;
+}
+
+static bool
+is_digit_char(char c) {
+    return std::isdigit(static_cast<unsigned char>(c));
+}
+
+static bool
+is_symbol_char(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+static bool
+iequals(const std::string& lhs, const std::string& rhs) {
+    if (lhs.size() != rhs.size()) {
+        return false;
+    }
+
+    for (t_uindex idx = 0, loop_end = lhs.size(); idx < loop_end; ++idx) {
+        if (std::tolower(static_cast<unsigned char>(lhs[idx]))
+            != std::tolower(static_cast<unsigned char>(rhs[idx]))) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Recursive descent over a parsed expression string, following
+ * ExprTk's precedence: the ternary, then `or`, `and`, comparisons, `+ -`,
+ * `* / %` and unary minus. Anything else fails the parse.
+ */
+class t_plan_parser {
+public:
+    t_plan_parser(const std::string& expression,
+        const std::vector<std::pair<std::string, std::string>>& column_ids,
+        const std::vector<t_dtype>& column_dtypes,
+        std::vector<t_plan_node>& nodes)
+        : m_expression(expression)
+        , m_pos(0)
+        , m_column_ids(column_ids)
+        , m_column_dtypes(column_dtypes)
+        , m_column_nodes(column_ids.size(), NO_INDEX)
+        , m_nodes(nodes) {}
+
+    bool
+    parse(t_uindex& root) {
+        if (!parse_expression(root)) {
+            return false;
+        }
+
+        while (accept(";")) {
+        }
+
+        skip_space();
+        return m_pos == m_expression.size();
+    }
+
+private:
+    bool
+    parse_expression(t_uindex& out) {
+        t_uindex condition;
+
+        if (!parse_or(condition)) {
+            return false;
+        }
+
+        if (!accept("?")) {
+            out = condition;
+            return true;
+        }
+
+        t_uindex consequent;
+        t_uindex alternative;
+
+        // `:=` is an assignment, not the ternary's separator.
+        if (!parse_expression(consequent) || peek(":=") || !accept(":")
+            || !parse_expression(alternative)) {
+            return false;
+        }
+
+        return push_if(condition, consequent, alternative, out);
+    }
+
+    bool
+    parse_or(t_uindex& out) {
+        if (!parse_and(out)) {
+            return false;
+        }
+
+        while (accept_word("or")) {
+            t_uindex rhs;
+            if (!parse_and(rhs) || !push_logical(PLAN_OP_OR, out, rhs, out)) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool
+    parse_and(t_uindex& out) {
+        if (!parse_comparison(out)) {
+            return false;
+        }
+
+        while (accept_word("and")) {
+            t_uindex rhs;
+            if (!parse_comparison(rhs)
+                || !push_logical(PLAN_OP_AND, out, rhs, out)) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool
+    parse_comparison(t_uindex& out) {
+        if (!parse_sum(out)) {
+            return false;
+        }
+
+        while (true) {
+            t_plan_op op;
+
+            if (accept("<=")) {
+                op = PLAN_OP_LTE;
+            } else if (accept("<>") || accept("!=")) {
+                op = PLAN_OP_NE;
+            } else if (accept("<")) {
+                op = PLAN_OP_LT;
+            } else if (accept(">=")) {
+                op = PLAN_OP_GTE;
+            } else if (accept(">")) {
+                op = PLAN_OP_GT;
+            } else if (accept("==") || accept("=")) {
+                op = PLAN_OP_EQ;
+            } else {
+                return true;
+            }
+
+            t_uindex rhs;
+            if (!parse_sum(rhs) || !push_comparison(op, out, rhs, out)) {
+                return false;
+            }
+        }
+    }
+
+    bool
+    parse_sum(t_uindex& out) {
+        if (!parse_product(out)) {
+            return false;
+        }
+
+        while (true) {
+            t_plan_op op;
+
+            if (accept("+")) {
+                op = PLAN_OP_ADD;
+            } else if (accept("-")) {
+                op = PLAN_OP_SUB;
+            } else {
+                return true;
+            }
+
+            t_uindex rhs;
+            if (!parse_product(rhs) || !push_arithmetic(op, out, rhs, out)) {
+                return false;
+            }
+        }
+    }
+
+    bool
+    parse_product(t_uindex& out) {
+        if (!parse_unary(out)) {
+            return false;
+        }
+
+        while (true) {
+            t_plan_op op;
+
+            if (accept("*")) {
+                op = PLAN_OP_MUL;
+            } else if (accept("/")) {
+                op = PLAN_OP_DIV;
+            } else if (accept("%")) {
+                op = PLAN_OP_MOD;
+            } else {
+                return true;
+            }
+
+            t_uindex rhs;
+            if (!parse_unary(rhs) || !push_arithmetic(op, out, rhs, out)) {
+                return false;
+            }
+        }
+    }
+
+    bool
+    parse_unary(t_uindex& out) {
+        if (!accept("-")) {
+            return parse_primary(out);
+        }
+
+        t_uindex arg;
+        if (!parse_unary(arg)) {
+            return false;
+        }
+
+        // Negation keeps the type of its argument, and integer negation
+        // wraps in ways a double would not.
+        t_dtype dtype = m_nodes[arg].m_dtype;
+        if (!is_float_dtype(dtype)) {
+            return false;
+        }
+
+        if (m_nodes[arg].m_op == PLAN_OP_LITERAL) {
+            out = push_literal(DTYPE_FLOAT64, -m_nodes[arg].m_value);
+            return true;
+        }
+
+        out = push(PLAN_OP_NEG, dtype, {arg});
+        return true;
+    }
+
+    bool
+    parse_primary(t_uindex& out) {
+        skip_space();
+
+        if (accept("(")) {
+            return parse_expression(out) && accept(")");
+        }
+
+        double number;
+        if (read_number(number)) {
+            out = push_literal(DTYPE_FLOAT64, number);
+            return true;
+        }
+
+        std::string symbol;
+        if (!read_symbol(symbol)) {
+            return false;
+        }
+
+        if (accept("(")) {
+            return parse_call(symbol, out);
+        }
+
+        for (t_uindex cidx = 0, loop_end = m_column_ids.size();
+             cidx < loop_end; ++cidx) {
+            if (!iequals(symbol, m_column_ids[cidx].first)) {
+                continue;
+            }
+
+            if (m_column_nodes[cidx] == NO_INDEX) {
+                m_column_nodes[cidx]
+                    = push(PLAN_OP_COLUMN, m_column_dtypes[cidx], {});
+                m_nodes.back().m_cidx = cidx;
+            }
+
+            out = m_column_nodes[cidx];
+            return true;
+        }
+
+        return false;
+    }
+
+    // Called after the opening parenthesis of `name(...)`.
+    bool
+    parse_call(const std::string& name, t_uindex& out) {
+        std::vector<t_uindex> args;
+
+        if (!accept(")")) {
+            do {
+                t_uindex arg;
+                if (!parse_expression(arg)) {
+                    return false;
+                }
+
+                args.push_back(arg);
+            } while (accept(","));
+
+            if (!accept(")")) {
+                return false;
+            }
+        }
+
+        if (iequals(name, "if")) {
+            return args.size() == 3 && push_if(args[0], args[1], args[2], out);
+        }
+
+        if (iequals(name, "min") || iequals(name, "max")) {
+            if (args.empty() || !all_numeric(args)) {
+                return false;
+            }
+
+            t_plan_op op = iequals(name, "min") ? PLAN_OP_MIN : PLAN_OP_MAX;
+            out = push(op, DTYPE_FLOAT64, args);
+            return true;
+        }
+
+        if (iequals(name, "bucket")) {
+            if (args.size() != 2 || !all_numeric(args)) {
+                return false;
+            }
+
+            out = push(PLAN_OP_BUCKET, DTYPE_FLOAT64, args);
+            return true;
+        }
+
+        if (args.size() != 1) {
+            return false;
+        }
+
+        if (iequals(name, "is_null") || iequals(name, "is_not_null")) {
+            t_plan_op op = iequals(name, "is_null") ? PLAN_OP_IS_NULL
+                                                    : PLAN_OP_IS_NOT_NULL;
+            out = push(op, DTYPE_BOOL, args);
+            return true;
+        }
+
+        // `abs` only has a value for floats, and is null for integers.
+        if (iequals(name, "abs") && is_float_dtype(m_nodes[args[0]].m_dtype)) {
+            out = push(PLAN_OP_ABS, DTYPE_FLOAT64, args);
+            return true;
+        }
+
+        if (iequals(name, "float") && all_numeric(args)) {
+            out = push(PLAN_OP_TO_FLOAT, DTYPE_FLOAT64, args);
+            return true;
+        }
+
+        return false;
+    }
+
+    bool
+    push_arithmetic(t_plan_op op, t_uindex lhs, t_uindex rhs, t_uindex& out) {
+        if (!all_numeric({lhs, rhs})) {
+            return false;
+        }
+
+        out = push(op, DTYPE_FLOAT64, {lhs, rhs});
+        return true;
+    }
+
+    bool
+    push_comparison(t_plan_op op, t_uindex lhs, t_uindex rhs, t_uindex& out) {
+        t_dtype lhs_dtype = m_nodes[lhs].m_dtype;
+        t_dtype rhs_dtype = m_nodes[rhs].m_dtype;
+
+        if (!is_plain_dtype(lhs_dtype) || !is_plain_dtype(rhs_dtype)) {
+            return false;
+        }
+
+        // Scalars of different types are ordered by their type alone.
+        if (lhs_dtype != rhs_dtype) {
+            unsigned char lhs_type = lhs_dtype;
+            unsigned char rhs_type = rhs_dtype;
+            bool value;
+
+            switch (op) {
+                case PLAN_OP_LT: {
+                    value = lhs_type < rhs_type;
+                } break;
+                case PLAN_OP_LTE: {
+                    value = lhs_type <= rhs_type;
+                } break;
+                case PLAN_OP_GT: {
+                    value = lhs_type > rhs_type;
+                } break;
+                case PLAN_OP_GTE: {
+                    value = lhs_type >= rhs_type;
+                } break;
+                case PLAN_OP_EQ: {
+                    value = false;
+                } break;
+                default: {
+                    value = true;
+                } break;
+            }
+
+            out = push_literal(DTYPE_BOOL, value);
+            return true;
+        }
+
+        if (!is_exact_dtype(lhs_dtype)) {
+            return false;
+        }
+
+        out = push(op, DTYPE_BOOL, {lhs, rhs});
+        return true;
+    }
+
+    bool
+    push_logical(t_plan_op op, t_uindex lhs, t_uindex rhs, t_uindex& out) {
+        if (!is_plain_dtype(m_nodes[lhs].m_dtype)
+            || !is_plain_dtype(m_nodes[rhs].m_dtype)) {
+            return false;
+        }
+
+        out = push(op, DTYPE_BOOL, {lhs, rhs});
+        return true;
+    }
+
+    bool
+    push_if(t_uindex condition, t_uindex consequent, t_uindex alternative,
+        t_uindex& out) {
+        t_dtype condition_dtype = m_nodes[condition].m_dtype;
+        t_dtype dtype = m_nodes[consequent].m_dtype;
+
+        if (!is_plain_dtype(condition_dtype) || !is_plain_dtype(dtype)
+            || m_nodes[alternative].m_dtype != dtype) {
+            return false;
+        }
+
+        // Only a boolean can equal `false`, so any other condition always
+        // takes the consequent.
+        if (condition_dtype != DTYPE_BOOL) {
+            out = consequent;
+            return true;
+        }
+
+        out = push(PLAN_OP_IF, dtype, {condition, consequent, alternative});
+        return true;
+    }
+
+    bool
+    all_numeric(const std::vector<t_uindex>& args) const {
+        for (auto arg : args) {
+            if (!is_numeric_type(m_nodes[arg].m_dtype)) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    t_uindex
+    push(t_plan_op op, t_dtype dtype, const std::vector<t_uindex>& args) {
+        t_plan_node node;
+        node.m_op = op;
+        node.m_dtype = dtype;
+        node.m_args = args;
+        node.m_cidx = NO_INDEX;
+        node.m_value = 0;
+        m_nodes.push_back(node);
+        return m_nodes.size() - 1;
+    }
+
+    t_uindex
+    push_literal(t_dtype dtype, double value) {
+        t_uindex nidx = push(PLAN_OP_LITERAL, dtype, {});
+        m_nodes[nidx].m_value = value;
+        return nidx;
+    }
+
+    void
+    skip_space() {
+        while (m_pos < m_expression.size()
+            && std::isspace(static_cast<unsigned char>(m_expression[m_pos]))) {
+            ++m_pos;
+        }
+    }
+
+    bool
+    peek(const char* token) {
+        skip_space();
+        return m_expression.compare(m_pos, std::strlen(token), token) == 0;
+    }
+
+    bool
+    accept(const char* token) {
+        if (!peek(token)) {
+            return false;
+        }
+
+        m_pos += std::strlen(token);
+        return true;
+    }
+
+    bool
+    accept_word(const char* word) {
+        skip_space();
+        t_uindex end = m_pos;
+
+        while (end < m_expression.size() && is_symbol_char(m_expression[end])) {
+            ++end;
+        }
+
+        if (!iequals(m_expression.substr(m_pos, end - m_pos), word)) {
+            return false;
+        }
+
+        m_pos = end;
+        return true;
+    }
+
+    bool
+    read_symbol(std::string& out) {
+        t_uindex end = m_pos;
+
+        if (end == m_expression.size()
+            || !(std::isalpha(static_cast<unsigned char>(m_expression[end]))
+                || m_expression[end] == '_')) {
+            return false;
+        }
+
+        while (end < m_expression.size() && is_symbol_char(m_expression[end])) {
+            ++end;
+        }
+
+        out = m_expression.substr(m_pos, end - m_pos);
+        m_pos = end;
+        return true;
+    }
+
+    // Reads with ExprTk's own conversion, so literals round the same way.
+    bool
+    read_number(double& out) {
+        t_uindex end = m_pos;
+        bool digits = false;
+
+        while (end < m_expression.size()
+            && (is_digit_char(m_expression[end])
+                || m_expression[end] == '.')) {
+            digits = digits || m_expression[end] != '.';
+            ++end;
+        }
+
+        if (!digits) {
+            return false;
+        }
+
+        if (end < m_expression.size()
+            && (m_expression[end] == 'e' || m_expression[end] == 'E')) {
+            ++end;
+
+            if (end < m_expression.size()
+                && (m_expression[end] == '+' || m_expression[end] == '-')) {
+                ++end;
+            }
+
+            while (end < m_expression.size()
+                && is_digit_char(m_expression[end])) {
+                ++end;
+            }
+        }
+
+        std::string token = m_expression.substr(m_pos, end - m_pos);
+        if (!exprtk::details::string_to_real(token, out)) {
+            return false;
+        }
+
+        m_pos = end;
+        return true;
+    }
+
+    const std::string& m_expression;
+    t_uindex m_pos;
+    const std::vector<std::pair<std::string, std::string>>& m_column_ids;
+    const std::vector<t_dtype>& m_column_dtypes;
+    std::vector<t_uindex> m_column_nodes;
+    std::vector<t_plan_node>& m_nodes;
+};
+
+/******************************************************************************
+ *
+ * Kernels
+ *
+ * Each kernel writes `size` values and statuses from its arguments' batches,
+ * without branching on a row so the loops vectorize.
+ */
+
+template <typename DATA_T>
+static void
+load_values(const t_column& column, t_uindex begin, t_uindex size,
+    double* out) {
+    const DATA_T* data = column.get_nth<DATA_T>(begin);
+
+    for (t_uindex idx = 0; idx < size; ++idx) {
+        out[idx] = static_cast<double>(data[idx]);
+    }
+}
+
+static void
+load_column(const t_column& column, t_uindex begin, t_uindex size,
+    double* out, std::uint8_t* out_status) {
+    switch (column.get_dtype()) {
+        case DTYPE_INT64: {
+            load_values<std::int64_t>(column, begin, size, out);
+        } break;
+        case DTYPE_INT32: {
+            load_values<std::int32_t>(column, begin, size, out);
+        } break;
+        case DTYPE_INT16: {
+            load_values<std::int16_t>(column, begin, size, out);
+        } break;
+        case DTYPE_INT8: {
+            load_values<std::int8_t>(column, begin, size, out);
+        } break;
+        case DTYPE_UINT64: {
+            load_values<std::uint64_t>(column, begin, size, out);
+        } break;
+        case DTYPE_UINT32: {
+            load_values<std::uint32_t>(column, begin, size, out);
+        } break;
+        case DTYPE_UINT16: {
+            load_values<std::uint16_t>(column, begin, size, out);
+        } break;
+        case DTYPE_UINT8: {
+            load_values<std::uint8_t>(column, begin, size, out);
+        } break;
+        case DTYPE_FLOAT64: {
+            load_values<double>(column, begin, size, out);
+        } break;
+        case DTYPE_FLOAT32: {
+            load_values<float>(column, begin, size, out);
+        } break;
+        case DTYPE_BOOL: {
+            load_values<bool>(column, begin, size, out);
+        } break;
+        default: {
+            // Only the status of other columns is read.
+        } break;
+    }
+
+    if (!column.is_status_enabled()) {
+        std::fill(out_status, out_status + size, STATUS_VALID);
+        return;
+    }
+
+    const t_status* status = column.get_nth_status(begin);
+
+    for (t_uindex idx = 0; idx < size; ++idx) {
+        out_status[idx] = status[idx];
+    }
+}
+
+struct t_fmod {
+    double
+    operator()(double lhs, double rhs) const {
+        return std::fmod(lhs, rhs);
+    }
+};
+
+// `t_tscalar` arithmetic: invalid if either side is, or when dividing by 0.
+template <typename OP_T, bool CHECK_ZERO>
+static void
+arithmetic_kernel(const double* lhs, const std::uint8_t* lhs_status,
+    const double* rhs, const std::uint8_t* rhs_status, t_uindex size,
+    double* out, std::uint8_t* out_status) {
+    OP_T op;
+
+    for (t_uindex idx = 0; idx < size; ++idx) {
+        bool valid = lhs_status[idx] == STATUS_VALID
+            && rhs_status[idx] == STATUS_VALID
+            && !(CHECK_ZERO && rhs[idx] == 0);
+        double value = op(lhs[idx], rhs[idx]);
+        out[idx] = valid ? value : 0;
+        out_status[idx] = valid ? STATUS_VALID : STATUS_INVALID;
+    }
+}
+
+// `t_tscalar::compare_common` for operands of the same type: rows of
+// different status are ordered by their status.
+template <template <typename> class COMPARER_T>
+static void
+compare_kernel(const double* lhs, const std::uint8_t* lhs_status,
+    const double* rhs, const std::uint8_t* rhs_status, t_uindex size,
+    double* out, std::uint8_t* out_status) {
+    COMPARER_T<double> cmp;
+    COMPARER_T<std::uint8_t> cmp_status;
+
+    for (t_uindex idx = 0; idx < size; ++idx) {
+        bool value = lhs_status[idx] == rhs_status[idx]
+            ? cmp(lhs[idx], rhs[idx])
+            : cmp_status(lhs_status[idx], rhs_status[idx]);
+        out[idx] = value;
+        out_status[idx] = STATUS_VALID;
+    }
+}
+
+// `t_tscalar::operator==` compares the bits of the value, so `NaN` equals
+// itself and `-0` does not equal `0`.
+static void
+equal_kernel(const double* lhs, const std::uint8_t* lhs_status,
+    const double* rhs, const std::uint8_t* rhs_status, t_uindex size,
+    bool negate, double* out, std::uint8_t* out_status) {
+    for (t_uindex idx = 0; idx < size; ++idx) {
+        std::uint64_t lhs_bits;
+        std::uint64_t rhs_bits;
+        std::memcpy(&lhs_bits, lhs + idx, sizeof(lhs_bits));
+        std::memcpy(&rhs_bits, rhs + idx, sizeof(rhs_bits));
+        bool value
+            = lhs_status[idx] == rhs_status[idx] && lhs_bits == rhs_bits;
+        out[idx] = value != negate;
+        out_status[idx] = STATUS_VALID;
+    }
+}
+
+// `t_tscalar::as_bool`, applied to both sides.
+static void
+logical_kernel(const double* lhs, const std::uint8_t* lhs_status,
+    const double* rhs, const std::uint8_t* rhs_status, t_uindex size,
+    bool is_and, double* out, std::uint8_t* out_status) {
+    for (t_uindex idx = 0; idx < size; ++idx) {
+        bool lhs_true = lhs_status[idx] == STATUS_VALID && lhs[idx] != 0;
+        bool rhs_true = rhs_status[idx] == STATUS_VALID && rhs[idx] != 0;
+        out[idx] = is_and ? (lhs_true && rhs_true) : (lhs_true || rhs_true);
+        out_status[idx] = STATUS_VALID;
+    }
+}
+
+/******************************************************************************
+ *
+ * t_computed_plan
+ */
+
+t_computed_plan::t_computed_plan()
+    : m_dtype(DTYPE_NONE) {}
+
+std::unique_ptr<t_computed_plan>
+t_computed_plan::build(const std::string& parsed_expression_string,
+    const std::vector<std::pair<std::string, std::string>>& column_ids,
+    const std::vector<t_dtype>& column_dtypes, t_dtype dtype) {
+    if (dtype != DTYPE_FLOAT64 && dtype != DTYPE_BOOL) {
+        return nullptr;
+    }
+
+    std::unique_ptr<t_computed_plan> plan(new t_computed_plan());
+    plan->m_dtype = dtype;
+
+    t_plan_parser parser(
+        parsed_expression_string, column_ids, column_dtypes, plan->m_nodes);
+    t_uindex root;
+
+    if (!parser.parse(root) || plan->m_nodes[root].m_dtype != dtype) {
+        return nullptr;
+    }
+
+    // Steps only ever read earlier steps, so the root is made the last one
+    // and the rest of the steps run in order before it.
+    if (root != plan->m_nodes.size() - 1) {
+        plan->m_nodes.push_back(plan->m_nodes[root]);
+    }
+
+    return plan;
+}
+
+void
+t_computed_plan::compute(const std::vector<std::shared_ptr<t_column>>& columns,
+    t_column& output_column, t_uindex num_rows) const {
+    t_uindex num_nodes = m_nodes.size();
+    std::vector<double> values(num_nodes * BATCH_SIZE);
+    std::vector<std::uint8_t> statuses(num_nodes * BATCH_SIZE);
+
+    // Each step reads the batches of its arguments from the same place for
+    // every batch.
+    std::vector<std::vector<const double*>> node_args(num_nodes);
+    std::vector<std::vector<const std::uint8_t*>> node_arg_status(num_nodes);
+
+    for (t_uindex nidx = 0; nidx < num_nodes; ++nidx) {
+        for (auto arg : m_nodes[nidx].m_args) {
+            node_args[nidx].push_back(values.data() + arg * BATCH_SIZE);
+            node_arg_status[nidx].push_back(
+                statuses.data() + arg * BATCH_SIZE);
+        }
+    }
+
+    for (t_uindex begin = 0; begin < num_rows; begin += BATCH_SIZE) {
+        t_uindex size = std::min(BATCH_SIZE, num_rows - begin);
+
+        for (t_uindex nidx = 0; nidx < num_nodes; ++nidx) {
+            const t_plan_node& node = m_nodes[nidx];
+            double* out = values.data() + nidx * BATCH_SIZE;
+            std::uint8_t* out_status = statuses.data() + nidx * BATCH_SIZE;
+            const std::vector<const double*>& args = node_args[nidx];
+            const std::vector<const std::uint8_t*>& arg_status
+                = node_arg_status[nidx];
+
+            switch (node.m_op) {
+                case PLAN_OP_COLUMN: {
+                    load_column(
+                        *columns[node.m_cidx], begin, size, out, out_status);
+                } break;
+                case PLAN_OP_LITERAL: {
+                    std::fill(out, out + size, node.m_value);
+                    std::fill(out_status, out_status + size, STATUS_VALID);
+                } break;
+                case PLAN_OP_ADD: {
+                    arithmetic_kernel<std::plus<double>, false>(args[0],
+                        arg_status[0], args[1], arg_status[1], size, out,
+                        out_status);
+                } break;
+                case PLAN_OP_SUB: {
+                    arithmetic_kernel<std::minus<double>, false>(args[0],
+                        arg_status[0], args[1], arg_status[1], size, out,
+                        out_status);
+                } break;
+                case PLAN_OP_MUL: {
+                    arithmetic_kernel<std::multiplies<double>, false>(args[0],
+                        arg_status[0], args[1], arg_status[1], size, out,
+                        out_status);
+                } break;
+                case PLAN_OP_DIV: {
+                    arithmetic_kernel<std::divides<double>, true>(args[0],
+                        arg_status[0], args[1], arg_status[1], size, out,
+                        out_status);
+                } break;
+                case PLAN_OP_MOD: {
+                    arithmetic_kernel<t_fmod, true>(args[0], arg_status[0],
+                        args[1], arg_status[1], size, out, out_status);
+                } break;
+                case PLAN_OP_NEG: {
+                    for (t_uindex idx = 0; idx < size; ++idx) {
+                        bool valid = arg_status[0][idx] == STATUS_VALID;
+                        out[idx] = valid ? -args[0][idx] : 0;
+                        out_status[idx]
+                            = valid ? STATUS_VALID : STATUS_INVALID;
+                    }
+                } break;
+                case PLAN_OP_LT: {
+                    compare_kernel<std::less>(args[0], arg_status[0],
+                        args[1], arg_status[1], size, out, out_status);
+                } break;
+                case PLAN_OP_LTE: {
+                    compare_kernel<std::less_equal>(args[0], arg_status[0],
+                        args[1], arg_status[1], size, out, out_status);
+                } break;
+                case PLAN_OP_GT: {
+                    compare_kernel<std::greater>(args[0], arg_status[0],
+                        args[1], arg_status[1], size, out, out_status);
+                } break;
+                case PLAN_OP_GTE: {
+                    compare_kernel<std::greater_equal>(args[0],
+                        arg_status[0], args[1], arg_status[1], size, out,
+                        out_status);
+                } break;
+                case PLAN_OP_EQ:
+                case PLAN_OP_NE: {
+                    equal_kernel(args[0], arg_status[0], args[1],
+                        arg_status[1], size, node.m_op == PLAN_OP_NE, out,
+                        out_status);
+                } break;
+                case PLAN_OP_AND:
+                case PLAN_OP_OR: {
+                    logical_kernel(args[0], arg_status[0], args[1],
+                        arg_status[1], size, node.m_op == PLAN_OP_AND, out,
+                        out_status);
+                } break;
+                case PLAN_OP_IF: {
+                    // ExprTk takes the consequent unless the condition is a
+                    // valid `false`.
+                    for (t_uindex idx = 0; idx < size; ++idx) {
+                        bool taken = arg_status[0][idx] != STATUS_VALID
+                            || args[0][idx] != 0;
+                        out[idx] = taken ? args[1][idx] : args[2][idx];
+                        out_status[idx]
+                            = taken ? arg_status[1][idx] : arg_status[2][idx];
+                    }
+                } break;
+                case PLAN_OP_MIN:
+                case PLAN_OP_MAX: {
+                    // As `min_fn`/`max_fn`: the first extreme value, invalid
+                    // if any argument is.
+                    bool is_min = node.m_op == PLAN_OP_MIN;
+
+                    for (t_uindex idx = 0; idx < size; ++idx) {
+                        out[idx] = args[0][idx];
+                        out_status[idx] = arg_status[0][idx] == STATUS_VALID
+                            ? STATUS_VALID
+                            : STATUS_INVALID;
+                    }
+
+                    for (t_uindex aidx = 1; aidx < args.size(); ++aidx) {
+                        for (t_uindex idx = 0; idx < size; ++idx) {
+                            double value = args[aidx][idx];
+                            bool replace
+                                = is_min ? value < out[idx] : value > out[idx];
+                            bool valid = out_status[idx] == STATUS_VALID
+                                && arg_status[aidx][idx] == STATUS_VALID;
+                            out[idx] = replace ? value : out[idx];
+                            out_status[idx]
+                                = valid ? STATUS_VALID : STATUS_INVALID;
+                        }
+                    }
+
+                    for (t_uindex idx = 0; idx < size; ++idx) {
+                        out[idx] = out_status[idx] == STATUS_VALID ? out[idx]
+                                                                   : 0;
+                    }
+                } break;
+                case PLAN_OP_ABS: {
+                    for (t_uindex idx = 0; idx < size; ++idx) {
+                        bool valid = arg_status[0][idx] == STATUS_VALID;
+                        out[idx] = valid ? std::fabs(args[0][idx]) : 0;
+                        out_status[idx]
+                            = valid ? STATUS_VALID : STATUS_INVALID;
+                    }
+                } break;
+                case PLAN_OP_BUCKET: {
+                    for (t_uindex idx = 0; idx < size; ++idx) {
+                        std::uint8_t status = STATUS_VALID;
+
+                        if (arg_status[0][idx] == STATUS_CLEAR
+                            || arg_status[1][idx] == STATUS_CLEAR) {
+                            status = STATUS_CLEAR;
+                        } else if (arg_status[0][idx] != STATUS_VALID
+                            || arg_status[1][idx] != STATUS_VALID) {
+                            status = STATUS_INVALID;
+                        }
+
+                        double unit = args[1][idx];
+                        out[idx] = status == STATUS_VALID
+                            ? std::floor(args[0][idx] / unit) * unit
+                            : 0;
+                        out_status[idx] = status;
+                    }
+                } break;
+                case PLAN_OP_TO_FLOAT: {
+                    for (t_uindex idx = 0; idx < size; ++idx) {
+                        bool valid = arg_status[0][idx] == STATUS_VALID
+                            && !std::isnan(args[0][idx]);
+                        out[idx] = valid ? args[0][idx] : 0;
+                        out_status[idx]
+                            = valid ? STATUS_VALID : STATUS_INVALID;
+                    }
+                } break;
+                case PLAN_OP_IS_NULL:
+                case PLAN_OP_IS_NOT_NULL: {
+                    bool is_null = node.m_op == PLAN_OP_IS_NULL;
+                    for (t_uindex idx = 0; idx < size; ++idx) {
+                        bool valid = arg_status[0][idx] == STATUS_VALID;
+                        out[idx] = valid != is_null;
+                        out_status[idx] = STATUS_VALID;
+                    }
+                } break;
+            }
+        }
+
+        const double* root = values.data() + (num_nodes - 1) * BATCH_SIZE;
+        const std::uint8_t* root_status
+            = statuses.data() + (num_nodes - 1) * BATCH_SIZE;
+
+        for (t_uindex idx = 0; idx < size; ++idx) {
+            t_uindex ridx = begin + idx;
+
+            if (root_status[idx] != STATUS_VALID) {
+                output_column.clear(ridx);
+            } else if (m_dtype == DTYPE_BOOL) {
+                output_column.set_nth<bool>(ridx, root[idx] != 0, STATUS_VALID);
+            } else {
+                output_column.set_nth<double>(ridx, root[idx], STATUS_VALID);
+            }
+        }
+    }
+}
+
+} // end namespace perspective
@@ -12,6 +12,12 @@
 
 namespace perspective {
 
+// Length-prefixed so that no two distinct field lists share a signature.
+static inline void
+write_signature_field(std::stringstream& ss, const std::string& field) {
+    ss << field.size() << ':' << field;
+}
+
 // t_ctxunit
 t_config::t_config(const std::vector<std::string>& detail_columns)
     : t_config(detail_columns, {}, FILTER_OP_AND, {}) {}
@@ -80,6 +86,28 @@ t_config::t_config(const std::vector<std::string>& row_pivots,
         std::vector<std::string>{});
 }
 
+// t_ctx_grouped_pkey
+t_config::t_config(const std::vector<std::string>& detail_columns,
+    const std::string& child_pkey_column,
+    const std::string& parent_pkey_column, const std::string& sort_column)
+    : m_detail_columns(detail_columns)
+    , m_combiner(FILTER_OP_AND)
+    , m_column_only(false)
+    , m_is_trivial_config(false)
+    , m_totals(TOTALS_BEFORE)
+    , m_parent_pkey_column(parent_pkey_column)
+    , m_child_pkey_column(child_pkey_column)
+    , m_fmode(FMODE_SIMPLE_CLAUSES) {
+    m_row_pivots.push_back(t_pivot(child_pkey_column));
+
+    for (const auto& column : detail_columns) {
+        m_aggregates.push_back(t_aggspec(column, AGGTYPE_IDENTITY, column));
+    }
+
+    setup(m_detail_columns, std::vector<std::string>{child_pkey_column},
+        std::vector<std::string>{sort_column});
+}
+
 // Constructors used for C++ tests
 t_config::t_config(const std::vector<std::string>& row_pivots,
     const std::vector<std::string>& col_pivots,
@@ -199,6 +227,8 @@ t_config::setup(const std::vector<std::string>& detail_columns,
             case AGGTYPE_DISTINCT_LEAF:
             case AGGTYPE_VARIANCE:
             case AGGTYPE_STANDARD_DEVIATION:
+            case AGGTYPE_APPROX_DISTINCT:
+            case AGGTYPE_APPROX_PERCENTILE:
                 m_has_pkey_agg = true;
                 break;
             default:
@@ -457,4 +487,59 @@ t_config::get_fmode() const {
     return m_fmode;
 }
 
+std::string
+t_config::get_aggregate_signature(const t_aggspec& spec) {
+    std::stringstream ss;
+    write_signature_field(ss, spec.name());
+    write_signature_field(ss, spec.agg_str());
+    ss << ',' << spec.get_sort_type() << ',' << spec.get_agg_one_idx() << ','
+       << spec.get_agg_two_idx() << ',' << spec.get_agg_one_weight() << ','
+       << spec.get_agg_two_weight();
+
+    if (spec.agg() == AGGTYPE_APPROX_PERCENTILE) {
+        ss << ',' << spec.get_quantile();
+    }
+
+    const auto& deps = spec.get_dependencies();
+    ss << 'd' << deps.size();
+    for (const auto& dep : deps) {
+        write_signature_field(ss, dep.name());
+    }
+
+    return ss.str();
+}
+
+std::string
+t_config::get_tree_signature() const {
+    std::stringstream ss;
+
+    ss << "p" << m_row_pivots.size();
+    for (const auto& pivot : m_row_pivots) {
+        write_signature_field(ss, pivot.colname());
+        ss << ',' << pivot.mode();
+    }
+
+    ss << "s" << m_sortby.size();
+    for (const auto& kv : m_sortby) {
+        write_signature_field(ss, kv.first);
+        write_signature_field(ss, kv.second);
+    }
+
+    ss << "f" << m_fterms.size() << ',' << m_combiner;
+    for (const auto& fterm : m_fterms) {
+        write_signature_field(ss, fterm.get_expr());
+    }
+
+    ss << "e" << m_expressions.size();
+    for (const auto& expr : m_expressions) {
+        write_signature_field(ss, expr->get_expression_alias());
+        write_signature_field(ss, expr->get_expression_string());
+    }
+
+    ss << "t" << m_totals;
+    write_signature_field(ss, m_grand_agg_str);
+
+    return ss.str();
+}
+
 } // end namespace perspective
@@ -24,15 +24,20 @@
 
 namespace perspective {
 
+const t_uindex t_gpkey_row::NO_NODE;
+
+static const t_uindex NO_NODE = t_gpkey_row::NO_NODE;
+
 t_ctx_grouped_pkey::t_ctx_grouped_pkey()
-    : m_depth(0)
+    : m_has_label(false)
+    , m_depth(0)
     , m_depth_set(false) {}
 
 t_ctx_grouped_pkey::t_ctx_grouped_pkey(t_schema schema, t_config config)
-    : m_depth(0)
-    , m_depth_set(false) {
-    PSP_COMPLAIN_AND_ABORT("Not Implemented");
-}
+    : t_ctxbase<t_ctx_grouped_pkey>(schema, config)
+    , m_has_label(!config.get_grouping_label_column().empty())
+    , m_depth(0)
+    , m_depth_set(false) {}
 
 t_ctx_grouped_pkey::~t_ctx_grouped_pkey() {}
 
@@ -164,9 +169,11 @@ t_ctx_grouped_pkey::get_data(t_index start_row, t_index end_row,
 
         if (m_has_label && ridx > 0) {
             // Get pkey
-            auto iters = m_tree->get_pkeys_for_leaf(nidx);
-            tree_value.set(
-                get_value_from_gstate(grouping_label_col, iters.first->m_pkey));
+            const auto& pkeys = m_tree->get_pkeys_for_leaf(nidx);
+            if (!pkeys.empty()) {
+                tree_value.set(
+                    get_value_from_gstate(grouping_label_col, pkeys.front()));
+            }
         }
 
         tmpvalues[(ridx - ext.m_srow) * ncols] = tree_value;
@@ -197,7 +204,50 @@ t_ctx_grouped_pkey::notify(const t_data_table& flattened,
     const t_data_table& existed) {
     PSP_TRACE_SENTINEL();
     PSP_VERBOSE_ASSERT(m_init, "touching uninited object");
-    rebuild();
+
+    t_uindex nrecs = flattened.size();
+    std::shared_ptr<const t_column> pkey_sptr
+        = flattened.get_const_column("psp_pkey");
+    std::shared_ptr<const t_column> op_sptr
+        = flattened.get_const_column("psp_op");
+    const t_column* pkey_col = pkey_sptr.get();
+    const t_column* op_col = op_sptr.get();
+
+    bool has_filters = m_config.has_filters();
+    t_mask msk_curr;
+
+    if (has_filters) {
+        msk_curr = filter_table_for_config(current, m_config);
+    }
+
+    // Rows leaving the filter are removed like deleted rows.
+    std::vector<t_tscalar> upserted;
+    std::vector<t_tscalar> removed;
+
+    for (t_uindex idx = 0; idx < nrecs; ++idx) {
+        t_tscalar pkey
+            = m_symtable.get_interned_tscalar(pkey_col->get_scalar(idx));
+        std::uint8_t op_ = *(op_col->get_nth<std::uint8_t>(idx));
+        t_op op = static_cast<t_op>(op_);
+
+        switch (op) {
+            case OP_INSERT: {
+                if (!has_filters || msk_curr.get(idx)) {
+                    upserted.push_back(pkey);
+                } else {
+                    removed.push_back(pkey);
+                }
+            } break;
+            case OP_DELETE: {
+                removed.push_back(pkey);
+            } break;
+            default: {
+                PSP_COMPLAIN_AND_ABORT("Unexpected OP");
+            } break;
+        }
+    }
+
+    update_rows(upserted, removed, true);
 }
 
 void
@@ -211,7 +261,17 @@ void
 t_ctx_grouped_pkey::step_end() {
     PSP_TRACE_SENTINEL();
     PSP_VERBOSE_ASSERT(m_init, "touching uninited object");
-    sort_by(m_sortby);
+
+    // Inserted and moved rows already went in at their sorted positions,
+    // so only siblings of rows updated in place are sorted again.
+    if (!m_sortby.empty() && !m_sort_parents.empty()) {
+        m_traversal->sort_children(m_sortby, *this,
+            std::vector<t_uindex>(
+                m_sort_parents.begin(), m_sort_parents.end()));
+    }
+
+    m_sort_parents.clear();
+
     if (m_depth_set) {
         set_depth(m_depth);
     }
@@ -335,10 +395,8 @@ t_ctx_grouped_pkey::get_pkeys(
             continue;
 
         if (seen.find(ptidx) == seen.end()) {
-            auto iters = m_tree->get_pkeys_for_leaf(ptidx);
-            for (auto iter = iters.first; iter != iters.second; ++iter) {
-                rval.push_back(iter->m_pkey);
-            }
+            const auto& pkeys = m_tree->get_pkeys_for_leaf(ptidx);
+            rval.insert(rval.end(), pkeys.begin(), pkeys.end());
             seen.insert(ptidx);
         }
 
@@ -348,10 +406,8 @@ t_ctx_grouped_pkey::get_pkeys(
             if (seen.find(d) != seen.end())
                 continue;
 
-            auto iters = m_tree->get_pkeys_for_leaf(d);
-            for (auto iter = iters.first; iter != iters.second; ++iter) {
-                rval.push_back(iter->m_pkey);
-            }
+            const auto& pkeys = m_tree->get_pkeys_for_leaf(d);
+            rval.insert(rval.end(), pkeys.begin(), pkeys.end());
             seen.insert(d);
         }
     }
@@ -414,6 +470,10 @@ t_ctx_grouped_pkey::reset(bool reset_expressions) {
     m_tree->init();
     m_tree->set_deltas_enabled(get_feature_state(CTX_FEAT_DELTA));
     m_traversal = std::shared_ptr<t_traversal>(new t_traversal(m_tree));
+    m_rows.clear();
+    m_child_pkeys.clear();
+    m_parent_pkeys.clear();
+    m_sort_parents.clear();
 
     if (reset_expressions)
         m_expression_tables->reset();
@@ -458,12 +518,6 @@ t_ctx_grouped_pkey::rebuild() {
         tbl = tbl->clone(mask);
     }
 
-    std::string child_col_name = m_config.get_child_pkey_column();
-
-    std::shared_ptr<const t_column> child_col_sptr
-        = tbl->get_const_column(child_col_name);
-
-    const t_column* child_col = child_col_sptr.get();
     auto expansion_state = get_expansion_state();
 
     std::sort(expansion_state.begin(), expansion_state.end(),
@@ -477,164 +531,353 @@ t_ctx_grouped_pkey::rebuild() {
 
     reset();
 
-    t_uindex nrows = child_col->size();
+    t_uindex nrows = tbl->size();
 
     if (nrows == 0) {
         return;
     }
 
-    struct t_datum {
-        t_uindex m_pidx;
-        t_tscalar m_parent;
-        t_tscalar m_child;
-        t_tscalar m_pkey;
-        bool m_is_rchild;
-        t_uindex m_idx;
-    };
+    auto pkey_col = tbl->get_const_column("psp_pkey").get();
+    std::vector<t_tscalar> upserted(nrows);
 
-    auto sortby_col
-        = tbl->get_const_column(m_config.get_sort_by(child_col_name)).get();
+    for (t_uindex idx = 0; idx < nrows; ++idx) {
+        upserted[idx]
+            = m_symtable.get_interned_tscalar(pkey_col->get_scalar(idx));
+    }
 
-    auto parent_col
-        = tbl->get_const_column(m_config.get_parent_pkey_column()).get();
+    update_rows(upserted, std::vector<t_tscalar>(), false);
 
-    auto pkey_col = tbl->get_const_column("psp_pkey").get();
+    m_traversal = std::shared_ptr<t_traversal>(new t_traversal(m_tree));
 
-    std::vector<t_datum> data(nrows);
-    tsl::hopscotch_map<t_tscalar, t_uindex> child_ridx_map;
-    std::vector<bool> self_pkey_eq(nrows);
+    set_expansion_state(expansion_state);
 
-    for (t_uindex idx = 0; idx < nrows; ++idx) {
-        data[idx].m_child.set(child_col->get_scalar(idx));
-        data[idx].m_pkey.set(pkey_col->get_scalar(idx));
-        child_ridx_map[data[idx].m_child] = idx;
+    if (!m_sortby.empty()) {
+        m_traversal->sort_by(m_config, m_sortby, *this);
     }
+}
 
-    for (t_uindex idx = 0; idx < nrows; ++idx) {
-        auto ppkey = parent_col->get_scalar(idx);
-        data[idx].m_parent.set(ppkey);
+void
+t_ctx_grouped_pkey::update_rows(const std::vector<t_tscalar>& upserted,
+    const std::vector<t_tscalar>& removed, bool process_traversal) {
+    std::shared_ptr<t_data_table> master = m_gstate->get_table();
+    const std::string& child_col_name = m_config.get_child_pkey_column();
 
-        auto p_iter = child_ridx_map.find(ppkey);
-        bool missing_parent = p_iter == child_ridx_map.end();
+    const t_column* child_col
+        = master->get_const_column(child_col_name).get();
 
-        data[idx].m_is_rchild
-            = !ppkey.is_valid() || data[idx].m_child == ppkey || missing_parent;
-        data[idx].m_pidx
-            = data[idx].m_is_rchild ? 0 : child_ridx_map.at(data[idx].m_parent);
-        data[idx].m_idx = idx;
-    }
+    const t_column* parent_col
+        = master->get_const_column(m_config.get_parent_pkey_column()).get();
+
+    const t_column* sortby_col
+        = master->get_const_column(m_config.get_sort_by(child_col_name))
+              .get();
+
+    // Rows to place once every change is applied, and the rows that were
+    // expanded when their node was detached.
+    std::vector<t_tscalar> dirty;
+    tsl::hopscotch_set<t_tscalar> expanded;
+
+    // Aggregate rows to fill, paired with their rows in the master table.
+    std::vector<std::pair<t_uindex, t_uindex>> writes;
+
+    // Take the subtree of `row` out of the tree and the traversal.
+    auto detach = [&](t_gpkey_row& row) {
+        if (row.m_nidx == NO_NODE) {
+            return;
+        }
+
+        t_uindex root = row.m_nidx;
+        std::vector<t_uindex> nidxs = m_tree->get_descendents(root);
+        nidxs.push_back(root);
+
+        for (auto nidx : nidxs) {
+            // Every node holds the primary key of its row.
+            t_tscalar pkey = m_tree->get_pkeys_for_leaf(nidx).front();
+
+            if (process_traversal
+                && m_traversal->get_node_expanded(
+                    m_traversal->tree_index_lookup(nidx, 0))) {
+                expanded.insert(pkey);
+            }
+
+            m_rows[pkey].m_nidx = NO_NODE;
+            dirty.push_back(pkey);
+        }
+
+        if (process_traversal) {
+            m_traversal->drop_tree_indices(std::vector<t_uindex>(1, root));
+        }
 
-    struct t_datumcmp {
-        bool
-        operator()(const t_datum& a, const t_datum& b) const {
-            typedef std::tuple<bool, t_tscalar, t_tscalar> t_tuple;
-            return t_tuple(!a.m_is_rchild, a.m_parent, a.m_child)
-                < t_tuple(!b.m_is_rchild, b.m_parent, b.m_child);
+        m_tree->remove_nodes(nidxs);
+    };
+
+    // Detach every row naming `child` as its parent.
+    auto detach_children = [&](const t_tscalar& child) {
+        auto iter = m_parent_pkeys.find(child);
+        if (iter == m_parent_pkeys.end()) {
+            return;
+        }
+
+        for (const auto& pkey : iter->second) {
+            detach(m_rows[pkey]);
+            dirty.push_back(pkey);
+        }
+    };
+
+    auto unlink = [&](const t_tscalar& pkey, const t_gpkey_row& row) {
+        auto citer = m_child_pkeys.find(row.m_child);
+        if (citer != m_child_pkeys.end() && citer->second == pkey) {
+            m_child_pkeys.erase(citer);
+            detach_children(row.m_child);
+        }
+
+        auto piter = m_parent_pkeys.find(row.m_parent);
+        if (piter != m_parent_pkeys.end()) {
+            auto& pkeys = m_parent_pkeys[row.m_parent];
+            pkeys.erase(pkey);
+            if (pkeys.empty()) {
+                m_parent_pkeys.erase(row.m_parent);
+            }
         }
     };
 
-    t_datumcmp cmp;
+    auto insert = [&](const t_tscalar& pkey, t_gpkey_row& row,
+                      t_uindex pidx) {
+        // Like values under one parent collapse into the first node.
+        if (m_tree->resolve_child(pidx, row.m_child) != NO_NODE) {
+            return false;
+        }
 
-    std::sort(data.begin(), data.end(), cmp);
+        t_uindex ridx = m_gstate->lookup(pkey).m_idx;
+        t_uindex nidx = m_tree->genidx();
+        t_uindex aggidx = m_tree->gen_aggidx();
 
-    std::vector<t_uindex> root_children;
+        auto sortby_value
+            = m_symtable.get_interned_tscalar(sortby_col->get_scalar(ridx));
 
-    std::queue<t_uindex> queue;
-    t_uindex nroot_children = 0;
-    while (nroot_children < nrows && data[nroot_children].m_is_rchild) {
-        queue.push(nroot_children);
-        ++nroot_children;
-    }
+        t_stnode node(nidx, pidx, row.m_child, m_tree->get_depth(pidx) + 1,
+            sortby_value, 1, aggidx);
 
-    tsl::hopscotch_map<t_tscalar, std::pair<t_uindex, t_uindex>> p_range_map;
+        m_tree->insert_node(node);
+        m_tree->add_pkey(nidx, pkey, ridx);
+        writes.push_back(std::pair<t_uindex, t_uindex>(aggidx, ridx));
+        row.m_nidx = nidx;
+        return true;
+    };
 
-    t_uindex brange = nroot_children;
-    for (t_uindex idx = nroot_children; idx < nrows; ++idx) {
-        if (data[idx].m_parent != data[idx - 1].m_parent
-            && idx > nroot_children) {
-            p_range_map[data[idx - 1].m_parent]
-                = std::pair<t_uindex, t_uindex>(brange, idx);
-            brange = idx;
+    for (const auto& pkey : removed) {
+        auto iter = m_rows.find(pkey);
+        if (iter == m_rows.end()) {
+            continue;
         }
+
+        detach(m_rows[pkey]);
+        t_gpkey_row row = m_rows[pkey];
+        unlink(pkey, row);
+        m_rows.erase(pkey);
     }
 
-    p_range_map[data.back().m_parent]
-        = std::pair<t_uindex, t_uindex>(brange, nrows);
+    for (const auto& pkey : upserted) {
+        t_uindex ridx = m_gstate->lookup(pkey).m_idx;
 
-    // map from unsorted space to sorted space
-    tsl::hopscotch_map<t_uindex, t_uindex> sortidx_map;
+        t_tscalar child
+            = m_symtable.get_interned_tscalar(child_col->get_scalar(ridx));
+        t_tscalar parent
+            = m_symtable.get_interned_tscalar(parent_col->get_scalar(ridx));
 
-    for (t_uindex idx = 0; idx < nrows; ++idx) {
-        sortidx_map[data[idx].m_idx] = idx;
+        auto iter = m_rows.find(pkey);
+
+        if (iter != m_rows.end()) {
+            t_gpkey_row& row = m_rows[pkey];
+
+            if (row.m_child == child && row.m_parent == parent) {
+                // An attached row keeps its node unless it moves among its
+                // siblings; a waiting row is read again once placed.
+                if (row.m_nidx == NO_NODE) {
+                    continue;
+                }
+
+                auto sortby_value = m_symtable.get_interned_tscalar(
+                    sortby_col->get_scalar(ridx));
+
+                if (sortby_value == m_tree->get_sortby_value(row.m_nidx)) {
+                    writes.push_back(std::pair<t_uindex, t_uindex>(
+                        m_tree->get_aggidx(row.m_nidx), ridx));
+                    m_sort_parents.insert(m_tree->get_parent_idx(row.m_nidx));
+                } else {
+                    detach(row);
+                }
+
+                continue;
+            }
+
+            detach(row);
+            t_gpkey_row old_row = row;
+            unlink(pkey, old_row);
+        }
+
+        t_gpkey_row& row = m_rows[pkey];
+        row.m_child = child;
+        row.m_parent = parent;
+        row.m_nidx = NO_NODE;
+
+        // This row now owns `child`, so rows naming it as their parent move
+        // under this row.
+        m_child_pkeys[child] = pkey;
+        detach_children(child);
+
+        if (parent.is_valid()) {
+            m_parent_pkeys[parent].insert(pkey);
+        }
+
+        dirty.push_back(pkey);
     }
 
-    while (!queue.empty()) {
-        // ridx is in sorted space
-        t_uindex ridx = queue.front();
-        queue.pop();
+    // Place every dirty row whose parent is in the tree, then the rows
+    // waiting under it, breadth first. Rows under a parent that never
+    // reaches the root stay detached.
+    std::vector<t_uindex> added;
+    std::vector<t_tscalar> queue;
 
-        const t_datum& rec = data[ridx];
-        t_uindex pridx = rec.m_is_rchild ? 0 : sortidx_map.at(rec.m_pidx);
+    for (const auto& pkey : dirty) {
+        auto iter = m_rows.find(pkey);
+        if (iter == m_rows.end() || iter->second.m_nidx != NO_NODE) {
+            continue;
+        }
 
-        auto sortby_value = m_symtable.get_interned_tscalar(
-            sortby_col->get_scalar(rec.m_idx));
+        t_gpkey_row& row = m_rows[pkey];
+        t_uindex pidx = 0;
 
-        t_uindex nidx = ridx + 1;
-        t_uindex pidx = rec.m_is_rchild ? 0 : pridx + 1;
+        if (row.m_parent.is_valid() && row.m_parent != row.m_child) {
+            auto piter = m_child_pkeys.find(row.m_parent);
+            if (piter != m_child_pkeys.end()) {
+                pidx = m_rows.find(piter->second)->second.m_nidx;
+            }
+        }
+
+        if (pidx == NO_NODE || !insert(pkey, row, pidx)) {
+            continue;
+        }
 
-        auto pnode = m_tree->get_node(pidx);
+        added.push_back(row.m_nidx);
+        queue.push_back(pkey);
 
-        auto value = m_symtable.get_interned_tscalar(rec.m_child);
+        while (!queue.empty()) {
+            t_tscalar ppkey = queue.back();
+            queue.pop_back();
 
-        t_stnode node(
-            nidx, pidx, value, pnode.m_depth + 1, sortby_value, 1, nidx);
+            const t_gpkey_row& prow = m_rows.find(ppkey)->second;
+            auto citer = m_child_pkeys.find(prow.m_child);
+            auto piter = m_parent_pkeys.find(prow.m_child);
 
-        m_tree->insert_node(node);
-        m_tree->add_pkey(nidx, m_symtable.get_interned_tscalar(rec.m_pkey));
+            if (citer == m_child_pkeys.end() || citer->second != ppkey
+                || piter == m_parent_pkeys.end()) {
+                continue;
+            }
 
-        auto riter = p_range_map.find(rec.m_child);
+            for (const auto& cpkey : piter->second) {
+                t_gpkey_row& crow = m_rows[cpkey];
 
-        if (riter != p_range_map.end()) {
-            auto range = riter->second;
-            t_uindex bidx = range.first;
-            t_uindex eidx = range.second;
+                if (crow.m_nidx != NO_NODE
+                    || crow.m_child == crow.m_parent) {
+                    continue;
+                }
 
-            for (t_uindex cidx = bidx; cidx < eidx; ++cidx) {
-                queue.push(cidx);
+                if (insert(cpkey, crow, prow.m_nidx)) {
+                    queue.push_back(cpkey);
+                }
             }
         }
     }
 
-    auto aggtable = m_tree->_get_aggtable();
-    aggtable->extend(nrows + 1);
+    if (!writes.empty()) {
+        auto aggtable = m_tree->_get_aggtable();
+        t_uindex naggrows = 0;
 
-    auto aggspecs = m_config.get_aggregates();
-    t_uindex naggs = aggspecs.size();
+        for (const auto& w : writes) {
+            naggrows = std::max(naggrows, w.first + 1);
+        }
 
-    std::vector<t_uindex> aggindices(nrows);
+        if (naggrows > aggtable->size()) {
+            aggtable->extend(naggrows);
+        }
 
-    for (t_uindex idx = 0; idx < nrows; ++idx) {
-        aggindices[idx] = data[idx].m_idx;
+        for (const auto& spec : m_config.get_aggregates()) {
+            if (spec.agg() != AGGTYPE_IDENTITY) {
+                continue;
+            }
+
+            auto dst = aggtable->get_column(spec.get_first_depname()).get();
+            auto src
+                = master->get_const_column(spec.get_first_depname()).get();
+
+            for (const auto& w : writes) {
+                dst->set_scalar(w.first, src->get_scalar(w.second));
+            }
+        }
+    }
+
+    if (!process_traversal) {
+        return;
     }
 
-    parallel_for(
-        int(naggs), [&aggtable, &aggindices, &aggspecs, &tbl](int aggnum) {
-            const t_aggspec& spec = aggspecs[aggnum];
-            if (spec.agg() == AGGTYPE_IDENTITY) {
-                auto scol
-                    = aggtable->get_column(spec.get_first_depname()).get();
-                scol->copy(
-                    tbl->get_const_column(spec.get_first_depname()).get(),
-                    aggindices, 1);
+    if (!added.empty()) {
+        if (m_traversal->size() == 1 && m_traversal->get_node_expanded(0)) {
+            m_traversal->populate_root_children(m_tree);
+            m_traversal->sort_children(
+                m_sortby, *this, std::vector<t_uindex>(1, 0));
+        } else {
+            // Parents must enter the traversal before their children, and
+            // without a sort siblings go in tree order, so new nodes go in
+            // ordered by their `(sort value, value)` paths.
+            typedef std::vector<std::pair<t_tscalar, t_tscalar>> t_sortpath;
+            std::vector<std::pair<t_sortpath, t_uindex>> paths(added.size());
+
+            for (t_uindex idx = 0, loop_end = added.size(); idx < loop_end;
+                 ++idx) {
+                std::vector<t_tscalar> sort_values;
+                std::vector<t_tscalar> values;
+                m_tree->get_sortby_path(added[idx], sort_values);
+                m_tree->get_path(added[idx], values);
+
+                t_sortpath& path = paths[idx].first;
+                for (t_uindex didx = values.size(); didx > 0; --didx) {
+                    path.push_back(std::pair<t_tscalar, t_tscalar>(
+                        sort_values[didx - 1], values[didx - 1]));
+                }
+
+                paths[idx].second = added[idx];
             }
-        });
 
-    m_traversal = std::shared_ptr<t_traversal>(new t_traversal(m_tree));
+            std::sort(paths.begin(), paths.end());
 
-    set_expansion_state(expansion_state);
+            for (const auto& path : paths) {
+                auto ancestry = m_tree->get_ancestry(path.second);
+                m_traversal->add_sorted_node(
+                    m_sortby, ancestry, ancestry.size() - 1, *this);
+            }
+        }
+    }
 
-    if (!m_sortby.empty()) {
-        m_traversal->sort_by(m_config, m_sortby, *this);
+    // Open the rows that were expanded before they moved, parents first.
+    std::vector<std::pair<t_depth, t_uindex>> reopen;
+
+    for (const auto& pkey : expanded) {
+        auto iter = m_rows.find(pkey);
+        if (iter != m_rows.end() && iter->second.m_nidx != NO_NODE) {
+            t_uindex nidx = iter->second.m_nidx;
+            reopen.push_back(std::pair<t_depth, t_uindex>(
+                m_tree->get_depth(nidx), nidx));
+        }
+    }
+
+    std::sort(reopen.begin(), reopen.end());
+
+    for (const auto& r : reopen) {
+        t_index tvidx = m_traversal->tree_index_lookup(r.second, 0);
+        if (tvidx != INVALID_INDEX) {
+            m_traversal->expand_node(m_sortby, tvidx);
+        }
     }
 }
 
@@ -679,75 +922,8 @@ t_ctx_grouped_pkey::get_column_dtype(t_uindex idx) const {
 }
 
 void
-t_ctx_grouped_pkey::compute_expressions(
-    std::shared_ptr<t_data_table> flattened_masked,
-    t_expression_vocab& expression_vocab, t_regex_mapping& regex_mapping) {
-    // Clear the transitional expression tables on the context so they are
-    // ready for the next update.
-    m_expression_tables->clear_transitional_tables();
-
-    std::shared_ptr<t_data_table> master_expression_table
-        = m_expression_tables->m_master;
-
-    // Set the master table to the right size.
-    master_expression_table->reserve(flattened_masked->size());
-    master_expression_table->set_size(flattened_masked->size());
-
-    const auto& expressions = m_config.get_expressions();
-    for (const auto& expr : expressions) {
-        // Compute the expressions on the master table.
-        expr->compute(flattened_masked, master_expression_table,
-            expression_vocab, regex_mapping);
-    }
-}
-
-void
-t_ctx_grouped_pkey::compute_expressions(std::shared_ptr<t_data_table> master,
-    std::shared_ptr<t_data_table> flattened,
-    std::shared_ptr<t_data_table> delta, std::shared_ptr<t_data_table> prev,
-    std::shared_ptr<t_data_table> current,
-    std::shared_ptr<t_data_table> transitions,
-    std::shared_ptr<t_data_table> existed, t_expression_vocab& expression_vocab,
-    t_regex_mapping& regex_mapping) {
-    // Clear the tables so they are ready for this round of updates
-    m_expression_tables->clear_transitional_tables();
-
-    // All tables are the same size
-    t_uindex flattened_num_rows = flattened->size();
-    m_expression_tables->reserve_transitional_table_size(flattened_num_rows);
-    m_expression_tables->set_transitional_table_size(flattened_num_rows);
-
-    // Update the master expression table's size
-    t_uindex master_num_rows = master->size();
-    m_expression_tables->m_master->reserve(master_num_rows);
-    m_expression_tables->m_master->set_size(master_num_rows);
-
-    const auto& expressions = m_config.get_expressions();
-    for (const auto& expr : expressions) {
-        // master: compute based on latest state of the gnode state table
-        expr->compute(master, m_expression_tables->m_master, expression_vocab,
-            regex_mapping);
-
-        // flattened: compute based on the latest update dataset
-        expr->compute(flattened, m_expression_tables->m_flattened,
-            expression_vocab, regex_mapping);
-
-        // delta: for each numerical column, the numerical delta between the
-        // previous value and the current value in the row.
-        expr->compute(delta, m_expression_tables->m_delta, expression_vocab,
-            regex_mapping);
-
-        // prev: the values of the updated rows before this update was applied
-        expr->compute(
-            prev, m_expression_tables->m_prev, expression_vocab, regex_mapping);
-
-        // current: the current values of the updated rows
-        expr->compute(current, m_expression_tables->m_current, expression_vocab,
-            regex_mapping);
-    }
-
-    // Calculate the transitions now that the intermediate tables are computed
-    m_expression_tables->calculate_transitions(existed);
+t_ctx_grouped_pkey::compute_expressions(t_expression_cache& cache) {
+    m_expression_tables->compute(m_config.get_expressions(), cache);
 }
 
 t_uindex
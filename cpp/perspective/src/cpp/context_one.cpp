@@ -18,22 +18,31 @@
 
 #include <perspective/env_vars.h>
 #include <perspective/traversal.h>
+#include <perspective/flat_traversal.h>
+#include <algorithm>
 
 namespace perspective {
 
 t_ctx1::t_ctx1(const t_schema& schema, const t_config& pivot_config)
     : t_ctxbase<t_ctx1>(schema, pivot_config)
     , m_depth(0)
-    , m_depth_set(false) {}
+    , m_depth_set(false)
+    , m_top_n(-1) {}
 
-t_ctx1::~t_ctx1() {}
+t_ctx1::~t_ctx1() {
+    if (m_tree) {
+        m_tree->remove_context();
+    }
+}
 
 void
 t_ctx1::init() {
     auto pivots = m_config.get_row_pivots();
+    set_tree_aggregates(m_config.get_aggregates());
     m_tree = std::make_shared<t_stree>(
-        pivots, m_config.get_aggregates(), m_schema, m_config);
+        pivots, m_tree_aggregates, m_schema, m_config);
     m_tree->init();
+    m_tree->add_context();
     m_traversal = std::shared_ptr<t_traversal>(new t_traversal(m_tree));
 
     // Each context stores its own expression columns in separate
@@ -84,7 +93,23 @@ t_ctx1::open(t_index idx) {
     if (idx >= t_index(m_traversal->size()))
         return 0;
 
-    t_index retval = m_traversal->expand_node(m_sortby, idx);
+    t_index retval = 0;
+
+    if (m_top_n >= 0) {
+        if (m_traversal->get_node_expanded(idx)) {
+            return 0;
+        }
+
+        t_uindex nidx = m_traversal->get_tree_index(idx);
+        std::vector<t_uindex> changed;
+        build_top_n_pool(nidx);
+        retval = show_top_n(nidx, changed);
+        mark_minmax_nodes(changed);
+    } else {
+        retval = m_traversal->expand_node(m_tree_sortby, idx);
+        mark_minmax_rows(idx + 1, idx + 1 + retval);
+    }
+
     m_rows_changed = (retval > 0);
     return retval;
 }
@@ -100,6 +125,15 @@ t_ctx1::close(t_index idx) {
     if (idx >= t_index(m_traversal->size()))
         return 0;
 
+    t_index eidx = idx + 1 + m_traversal->get_node(idx).m_ndesc;
+    mark_minmax_rows(idx + 1, eidx);
+
+    if (!m_top_n_pools.empty()) {
+        for (t_index ridx = idx; ridx < eidx; ++ridx) {
+            m_top_n_pools.erase(m_traversal->get_tree_index(ridx));
+        }
+    }
+
     t_index retval = m_traversal->collapse_node(idx);
     m_rows_changed = (retval > 0);
     return retval;
@@ -107,47 +141,62 @@ t_ctx1::close(t_index idx) {
 
 std::pair<t_tscalar, t_tscalar>
 t_ctx1::get_min_max(const std::string& colname) const {
-    auto rval = std::make_pair(mknone(), mknone());
-    auto aggtable = m_tree->get_aggtable();
-    t_schema aggschema = aggtable->get_schema();
-    auto col = aggtable->get_const_column(colname).get();
-    auto colidx = aggschema.get_colidx(colname);
-    auto depth = m_config.get_num_rpivots();
-    const std::vector<t_aggspec>& aggspecs = m_config.get_aggregates();
-    bool is_finished = false;
-    while (!is_finished && depth > 0) {
-        for (std::size_t i = 0; i < m_traversal->size(); i++) {
-            t_index nidx = m_traversal->get_tree_index(i);
-            t_index pnidx = m_tree->get_parent_idx(nidx);
-            if (m_tree->get_depth(nidx) != depth) {
-                continue;
-            }
+    t_depth max_depth = m_config.get_num_rpivots();
 
-            t_uindex agg_ridx = m_tree->get_aggidx(nidx);
-            t_index agg_pridx = pnidx == INVALID_INDEX
-                ? INVALID_INDEX
-                : m_tree->get_aggidx(pnidx);
-            t_tscalar val
-                = extract_aggregate(aggspecs[colidx], col, agg_ridx, agg_pridx);
+    if (m_minmax.empty()) {
+        m_minmax.resize(max_depth + 1);
+    }
 
-            if (!val.is_valid()) {
+    // Re-read the nodes marked since the last call, and drop the ones that
+    // are no longer shown. A percentage also changes with nodes that were
+    // not marked, so its column is read again in full.
+    if (!m_minmax_marked.empty()) {
+        auto aggtable = m_tree->get_aggtable();
+        t_schema aggschema = aggtable->get_schema();
+        const std::vector<t_aggspec>& aggspecs = m_tree_aggregates;
+
+        for (const std::string& tracked : m_minmax[0].get_columns()) {
+            const t_aggspec& aggspec = aggspecs[aggschema.get_colidx(tracked)];
+            if (aggspec.agg() == AGGTYPE_PCT_SUM_PARENT
+                || aggspec.agg() == AGGTYPE_PCT_SUM_GRAND_TOTAL) {
+                add_minmax_column(tracked);
                 continue;
             }
 
-            is_finished = true;
-            if (rval.first.is_none() || (!val.is_none() && val < rval.first)) {
-                rval.first = val;
-            }
+            auto col = aggtable->get_const_column(tracked).get();
 
-            if (val > rval.second) {
-                rval.second = val;
+            for (auto nidx : m_minmax_marked) {
+                t_tscalar key = mktscalar(nidx);
+
+                if (m_traversal->tree_index_lookup(nidx, 0) != INVALID_INDEX) {
+                    m_minmax[m_tree->get_depth(nidx)].set_value(
+                        tracked, key, get_minmax_value(aggspec, col, nidx));
+                    continue;
+                }
+
+                // The depth of a dropped node is gone with it.
+                for (t_depth depth = 1; depth <= max_depth; ++depth) {
+                    m_minmax[depth].set_value(tracked, key, mknone());
+                }
             }
         }
 
-        depth--;
+        m_minmax_marked.clear();
     }
 
-    return rval;
+    if (!m_minmax[0].has_column(colname)) {
+        add_minmax_column(colname);
+    }
+
+    // The min and max of the deepest depth with any value.
+    for (t_depth depth = max_depth; depth > 0; --depth) {
+        auto rval = m_minmax[depth].get_min_max(colname);
+        if (!rval.first.is_none()) {
+            return rval;
+        }
+    }
+
+    return std::make_pair(mknone(), mknone());
 }
 
 std::vector<t_tscalar>
@@ -174,7 +223,8 @@ t_ctx1::get_data(t_index start_row, t_index end_row, t_index start_col,
 
     for (t_uindex aggidx = 0, loop_end = aggcols.size(); aggidx < loop_end;
          ++aggidx) {
-        const std::string& aggname = aggschema.m_columns[aggidx];
+        const std::string& aggname
+            = aggschema.m_columns[m_tree_agg_indices[aggidx]];
         aggcols[aggidx] = aggtable->get_const_column(aggname).get();
     }
 
@@ -229,7 +279,8 @@ t_ctx1::get_data(const std::vector<t_uindex>& rows) const {
 
     for (t_uindex aggidx = 0, loop_end = aggcols.size(); aggidx < loop_end;
          ++aggidx) {
-        const std::string& aggname = aggschema.m_columns[aggidx];
+        const std::string& aggname
+            = aggschema.m_columns[m_tree_agg_indices[aggidx]];
         aggcols[aggidx] = aggtable->get_const_column(aggname).get();
     }
 
@@ -273,10 +324,18 @@ void
 t_ctx1::notify(const t_data_table& flattened) {
     PSP_TRACE_SENTINEL();
     PSP_VERBOSE_ASSERT(m_init, "touching uninited object");
+    notify_sparse_tree(m_tree, m_traversal, true, m_tree_aggregates,
+        m_config.get_sortby_pairs(), m_tree_sortby, flattened, m_config,
+        *m_gstate, *(m_expression_tables->m_master));
+    mark_minmax_nodes(m_tree->get_last_step().m_updated_ids);
+}
 
-    notify_sparse_tree(m_tree, m_traversal, true, m_config.get_aggregates(),
-        m_config.get_sortby_pairs(), m_sortby, flattened, m_config, *m_gstate,
-        *(m_expression_tables->m_master));
+void
+t_ctx1::notify_traversal() {
+    PSP_TRACE_SENTINEL();
+    PSP_VERBOSE_ASSERT(m_init, "touching uninited object");
+    notify_sparse_traversal(m_tree, m_traversal, true, m_tree_sortby);
+    mark_minmax_nodes(m_tree->get_last_step().m_updated_ids);
 }
 
 void
@@ -285,11 +344,11 @@ t_ctx1::notify(const t_data_table& flattened, const t_data_table& delta,
     const t_data_table& transitions, const t_data_table& existed) {
     PSP_TRACE_SENTINEL();
     PSP_VERBOSE_ASSERT(m_init, "touching uninited object");
-
-    notify_sparse_tree(m_tree, m_traversal, true, m_config.get_aggregates(),
-        m_config.get_sortby_pairs(), m_sortby, flattened, delta, prev, current,
-        transitions, existed, m_config, *m_gstate,
+    notify_sparse_tree(m_tree, m_traversal, true, m_tree_aggregates,
+        m_config.get_sortby_pairs(), m_tree_sortby, flattened, delta, prev,
+        current, transitions, existed, m_config, *m_gstate,
         *(m_expression_tables->m_master));
+    mark_minmax_nodes(m_tree->get_last_step().m_updated_ids);
 }
 
 void
@@ -303,6 +362,12 @@ void
 t_ctx1::step_end() {
     PSP_TRACE_SENTINEL();
     PSP_VERBOSE_ASSERT(m_init, "touching uninited object");
+
+    if (m_top_n >= 0) {
+        update_top_n();
+        return;
+    }
+
     sort_by(m_sortby);
     if (m_depth_set) {
         set_depth(m_depth);
@@ -350,6 +415,7 @@ t_ctx1::reset_sortby() {
     PSP_TRACE_SENTINEL();
     PSP_VERBOSE_ASSERT(m_init, "touching uninited object");
     m_sortby = std::vector<t_sortspec>();
+    update_tree_sortby();
 }
 
 void
@@ -357,10 +423,325 @@ t_ctx1::sort_by(const std::vector<t_sortspec>& sortby) {
     PSP_TRACE_SENTINEL();
     PSP_VERBOSE_ASSERT(m_init, "touching uninited object");
     m_sortby = sortby;
+    update_tree_sortby();
+
+    // The kept children were ranked under the previous sort.
+    if (m_top_n >= 0) {
+        apply_top_n();
+        return;
+    }
+
     if (m_sortby.empty()) {
         return;
     }
-    m_traversal->sort_by(m_config, sortby, *(m_tree.get()));
+    m_traversal->sort_by(m_config, m_tree_sortby, *(m_tree.get()));
+}
+
+void
+t_ctx1::update_tree_sortby() {
+    m_tree_sortby = m_sortby;
+    for (auto& sortspec : m_tree_sortby) {
+        sortspec.m_agg_index = m_tree_agg_indices[sortspec.m_agg_index];
+    }
+}
+
+void
+t_ctx1::set_top_n(t_index top_n) {
+    PSP_TRACE_SENTINEL();
+    PSP_VERBOSE_ASSERT(m_init, "touching uninited object");
+    m_top_n = top_n;
+
+    if (m_top_n >= 0) {
+        apply_top_n();
+    }
+}
+
+void
+t_ctx1::apply_top_n() {
+    std::vector<t_path> paths;
+    reset_minmax();
+
+    if (!m_depth_set) {
+        paths = get_expansion_state();
+    }
+
+    m_top_n_agg_indices.clear();
+    for (const auto& sortspec : m_tree_sortby) {
+        m_top_n_agg_indices.push_back(sortspec.m_agg_index);
+    }
+
+    m_top_n_sort_orders = get_sort_orders(m_tree_sortby);
+    m_top_n_sort_orders.push_back(SORTTYPE_ASCENDING);
+    m_top_n_sort_orders.push_back(SORTTYPE_ASCENDING);
+    m_top_n_pools.clear();
+
+    // Start from the root alone, so the root's children are ranked once.
+    m_traversal = std::shared_ptr<t_traversal>(new t_traversal(m_tree));
+    m_traversal->populate_root_children(t_stnode_vec());
+
+    std::vector<t_uindex> changed;
+    build_top_n_pool(0);
+    show_top_n(0, changed);
+
+    if (m_depth_set) {
+        expand_top_n(changed, changed);
+    } else {
+        ctx_set_expansion_state(
+            *this, HEADER_ROW, m_tree, m_traversal, paths);
+    }
+
+    m_rows_changed = true;
+}
+
+void
+t_ctx1::update_top_n() {
+    const std::vector<t_uindex>& updated
+        = m_tree->get_last_step().m_updated_ids;
+
+    // Changed children of each parent with a pool.
+    tsl::hopscotch_map<t_uindex, std::vector<t_uindex>> cnidxs;
+    std::vector<t_uindex> pending;
+    for (auto nidx : updated) {
+        if (!m_tree->node_exists(nidx)) {
+            m_top_n_pools.erase(nidx);
+            continue;
+        }
+
+        pending.push_back(nidx);
+        if (nidx == 0) {
+            continue;
+        }
+
+        t_uindex pidx = m_tree->get_parent_idx(nidx);
+        if (m_top_n_pools.find(pidx) != m_top_n_pools.end()) {
+            cnidxs[pidx].push_back(nidx);
+        }
+    }
+
+    std::vector<t_uindex> changed;
+    for (const auto& parent : cnidxs) {
+        update_top_n_pool(parent.first, parent.second);
+        show_top_n(parent.first, changed);
+    }
+
+    // Rows shown by this step, and rows notify added, may need expanding.
+    if (m_depth_set) {
+        pending.insert(pending.end(), changed.begin(), changed.end());
+        expand_top_n(pending, changed);
+    }
+
+    for (auto nidx : changed) {
+        if (m_traversal->tree_index_lookup(nidx, 0) == INVALID_INDEX) {
+            m_top_n_pools.erase(nidx);
+        }
+    }
+
+    mark_minmax_nodes(changed);
+    if (!changed.empty()) {
+        m_rows_changed = true;
+    }
+}
+
+void
+t_ctx1::fill_top_n_elem(t_uindex nidx, t_mselem& elem) const {
+    std::vector<t_tscalar> row(m_top_n_agg_indices.size());
+    m_tree->get_aggregates_for_sorting(
+        nidx, m_top_n_agg_indices, row, nullptr);
+    row.push_back(m_tree->get_sortby_value(nidx));
+    row.push_back(m_tree->get_value(nidx));
+    elem.m_order = nidx;
+    elem.set_row(row, m_top_n_sort_orders);
+}
+
+void
+t_ctx1::build_top_n_pool(t_uindex nidx) {
+    t_stnode_vec children;
+    m_tree->get_child_nodes(nidx, children);
+
+    std::vector<t_mselem> pool(children.size());
+    for (t_uindex idx = 0, loop_end = children.size(); idx < loop_end;
+         ++idx) {
+        fill_top_n_elem(children[idx].m_idx, pool[idx]);
+    }
+
+    t_multisorter sorter(m_top_n_sort_orders);
+    t_uindex pool_size = m_top_n * t_ftrav::TOP_N_POOL_FACTOR;
+    if (pool_size < pool.size()) {
+        std::nth_element(
+            pool.begin(), pool.begin() + pool_size, pool.end(), sorter);
+        pool.resize(pool_size);
+    }
+
+    std::sort(pool.begin(), pool.end(), sorter);
+    m_top_n_pools[nidx] = std::move(pool);
+}
+
+void
+t_ctx1::update_top_n_pool(
+    t_uindex nidx, const std::vector<t_uindex>& cnidxs) {
+    std::vector<t_mselem>& pool = m_top_n_pools[nidx];
+    tsl::hopscotch_set<t_uindex> changed(cnidxs.begin(), cnidxs.end());
+
+    pool.erase(std::remove_if(pool.begin(), pool.end(),
+                   [&](const t_mselem& elem) {
+                       return changed.find(elem.m_order) != changed.end()
+                           || !m_tree->node_exists(elem.m_order);
+                   }),
+        pool.end());
+
+    // The pool holds the best children, so a changed child may only join
+    // ahead of its last entry - unless no other child is outside it.
+    t_uindex nchild = m_tree->get_num_children(nidx);
+    bool complete = pool.size() + cnidxs.size() >= nchild;
+    t_multisorter sorter(m_top_n_sort_orders);
+
+    for (auto cnidx : cnidxs) {
+        t_mselem elem;
+        fill_top_n_elem(cnidx, elem);
+
+        if (complete || (!pool.empty() && sorter(elem, pool.back()))) {
+            pool.insert(
+                std::upper_bound(pool.begin(), pool.end(), elem, sorter),
+                std::move(elem));
+        }
+    }
+
+    t_uindex pool_size = m_top_n * t_ftrav::TOP_N_POOL_FACTOR;
+    if (pool.size() > pool_size) {
+        pool.resize(pool_size);
+    }
+
+    // A pool that lost children to updates or removes is refilled from
+    // every child.
+    if (pool.size() < std::min<t_uindex>(m_top_n, nchild)) {
+        build_top_n_pool(nidx);
+    }
+}
+
+t_index
+t_ctx1::show_top_n(t_uindex nidx, std::vector<t_uindex>& changed) {
+    const std::vector<t_mselem>& pool = m_top_n_pools[nidx];
+    t_uindex nshown = std::min<t_uindex>(m_top_n, pool.size());
+    std::vector<t_uindex> cnidxs(nshown);
+    for (t_uindex idx = 0; idx < nshown; ++idx) {
+        cnidxs[idx] = pool[idx].m_order;
+    }
+
+    return m_traversal->set_children(nidx, cnidxs, changed);
+}
+
+t_index
+t_ctx1::expand_top_n(
+    std::vector<t_uindex> pending, std::vector<t_uindex>& changed) {
+    t_index n_changed = 0;
+
+    while (!pending.empty()) {
+        t_uindex nidx = pending.back();
+        pending.pop_back();
+
+        t_index tvidx = m_traversal->tree_index_lookup(nidx, 0);
+        if (tvidx == INVALID_INDEX
+            || m_traversal->get_node_expanded(tvidx)
+            || m_traversal->get_depth(tvidx) > m_depth
+            || m_tree->get_num_children(nidx) == 0) {
+            continue;
+        }
+
+        build_top_n_pool(nidx);
+        n_changed += show_top_n(nidx, changed);
+
+        const std::vector<t_mselem>& pool = m_top_n_pools[nidx];
+        t_uindex nshown = std::min<t_uindex>(m_top_n, pool.size());
+        for (t_uindex idx = 0; idx < nshown; ++idx) {
+            pending.push_back(pool[idx].m_order);
+        }
+    }
+
+    return n_changed;
+}
+
+void
+t_ctx1::mark_minmax_nodes(const std::vector<t_uindex>& nidxs) {
+    if (m_minmax.empty() || m_minmax[0].empty()) {
+        return;
+    }
+
+    m_minmax_marked.insert(nidxs.begin(), nidxs.end());
+}
+
+void
+t_ctx1::mark_minmax_rows(t_index bidx, t_index eidx) {
+    if (m_minmax.empty() || m_minmax[0].empty()) {
+        return;
+    }
+
+    for (t_index idx = bidx; idx < eidx; ++idx) {
+        m_minmax_marked.insert(m_traversal->get_tree_index(idx));
+    }
+}
+
+void
+t_ctx1::reset_minmax() {
+    m_minmax.clear();
+    m_minmax_marked.clear();
+}
+
+void
+t_ctx1::add_minmax_column(const std::string& colname) const {
+    auto aggtable = m_tree->get_aggtable();
+    auto col = aggtable->get_const_column(colname).get();
+    t_uindex colidx = aggtable->get_schema().get_colidx(colname);
+    const t_aggspec& aggspec = m_tree_aggregates[colidx];
+    t_depth max_depth = m_config.get_num_rpivots();
+
+    std::vector<std::vector<t_tscalar>> nidxs(max_depth + 1);
+    std::vector<std::vector<t_tscalar>> values(max_depth + 1);
+
+    for (t_uindex idx = 0, loop_end = m_traversal->size(); idx < loop_end;
+         ++idx) {
+        t_index nidx = m_traversal->get_tree_index(idx);
+        t_depth depth = m_tree->get_depth(nidx);
+        if (depth == 0 || depth > max_depth) {
+            continue;
+        }
+
+        nidxs[depth].push_back(mktscalar<t_uindex>(nidx));
+        values[depth].push_back(get_minmax_value(aggspec, col, nidx));
+    }
+
+    for (t_depth depth = 0; depth <= max_depth; ++depth) {
+        m_minmax[depth].add_column(colname, nidxs[depth], values[depth]);
+    }
+}
+
+t_tscalar
+t_ctx1::get_minmax_value(
+    const t_aggspec& aggspec, const t_column* col, t_uindex nidx) const {
+    t_index pnidx = m_tree->get_parent_idx(nidx);
+    t_index agg_pridx
+        = pnidx == INVALID_INDEX ? INVALID_INDEX : m_tree->get_aggidx(pnidx);
+    return extract_aggregate(aggspec, col, m_tree->get_aggidx(nidx), agg_pridx);
+}
+
+std::vector<t_path>
+t_ctx1::get_expansion_state() const {
+    PSP_TRACE_SENTINEL();
+    PSP_VERBOSE_ASSERT(m_init, "touching uninited object");
+    return ctx_get_expansion_state(m_tree, m_traversal);
+}
+
+void
+t_ctx1::set_expansion_state(const std::vector<t_path>& paths) {
+    PSP_TRACE_SENTINEL();
+    PSP_VERBOSE_ASSERT(m_init, "touching uninited object");
+
+    // `step_end` re-expands to a set depth, and opening a path would unset
+    // it.
+    if (m_depth_set) {
+        return;
+    }
+
+    ctx_set_expansion_state(*this, HEADER_ROW, m_tree, m_traversal, paths);
 }
 
 void
@@ -370,11 +751,24 @@ t_ctx1::set_depth(t_depth depth) {
     if (m_config.get_num_rpivots() == 0)
         return;
     depth = std::min<t_depth>(m_config.get_num_rpivots() - 1, depth);
-    t_index retval = 0;
-    retval = m_traversal->set_depth(m_sortby, depth);
-    m_rows_changed = (retval > 0);
+
+    // Expanding to the same depth again, as `step_end` does, only shows
+    // nodes new to the tree, which are already marked.
+    if (!m_depth_set || depth != m_depth) {
+        reset_minmax();
+    }
     m_depth = depth;
     m_depth_set = true;
+
+    // Every row down to the new depth is ranked top N at a time.
+    if (m_top_n >= 0) {
+        apply_top_n();
+        return;
+    }
+
+    t_index retval = 0;
+    retval = m_traversal->set_depth(m_tree_sortby, depth);
+    m_rows_changed = (retval > 0);
 }
 
 std::vector<t_tscalar>
@@ -409,16 +803,126 @@ t_ctx1::set_feature_state(t_ctx_feature feature, bool state) {
     m_features[feature] = state;
 }
 
+// A shared tree keeps alerts and deltas off; `t_gnode` moves a context
+// that enables either onto a tree of its own before the next update, and
+// `reset` applies the feature state to that tree.
 void
 t_ctx1::set_alerts_enabled(bool enabled_state) {
     m_features[CTX_FEAT_ALERT] = enabled_state;
-    m_tree->set_alerts_enabled(enabled_state);
+    if (m_tree->get_num_contexts() <= 1) {
+        m_tree->set_alerts_enabled(enabled_state);
+    }
 }
 
 void
 t_ctx1::set_deltas_enabled(bool enabled_state) {
     m_features[CTX_FEAT_DELTA] = enabled_state;
-    m_tree->set_deltas_enabled(enabled_state);
+    if (m_tree->get_num_contexts() <= 1) {
+        m_tree->set_deltas_enabled(enabled_state);
+    }
+}
+
+bool
+t_ctx1::can_share_tree() const {
+    return !get_feature_state(CTX_FEAT_ALERT)
+        && !get_feature_state(CTX_FEAT_DELTA);
+}
+
+bool
+t_ctx1::needs_own_tree() const {
+    if (can_share_tree()) {
+        return false;
+    }
+
+    if (m_tree->get_num_contexts() > 1
+        || m_tree_aggregates.size() != m_tree_agg_indices.size()) {
+        return true;
+    }
+
+    // Deltas are reported by tree aggregate, so they need a tree of
+    // exactly this context's aggregates, in order.
+    for (t_uindex idx = 0, loop_end = m_tree_agg_indices.size();
+         idx < loop_end; ++idx) {
+        if (m_tree_agg_indices[idx] != t_index(idx)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void
+t_ctx1::share_tree(const t_ctx1& other) {
+    PSP_TRACE_SENTINEL();
+    PSP_VERBOSE_ASSERT(m_init, "touching uninited object");
+    reset_minmax();
+    PSP_VERBOSE_ASSERT(
+        m_config.get_tree_signature() == other.m_config.get_tree_signature(),
+        "Cannot share a tree between different tree signatures");
+
+    m_tree->remove_context();
+    m_tree = other.m_tree;
+    m_tree->add_context();
+    set_tree_aggregates(other.m_tree_aggregates);
+
+    // A new traversal starts with the root's children under an expanded
+    // root, as `notify_sparse_traversal` would build it on a first update.
+    m_traversal = std::shared_ptr<t_traversal>(new t_traversal(m_tree));
+    m_rows_changed = true;
+
+    if (m_top_n >= 0) {
+        apply_top_n();
+    }
+}
+
+const std::vector<t_aggspec>&
+t_ctx1::get_tree_aggregates() const {
+    return m_tree_aggregates;
+}
+
+void
+t_ctx1::set_tree_aggregates(const std::vector<t_aggspec>& aggregates) {
+    m_tree_aggregates = aggregates;
+
+    const std::vector<t_aggspec>& aggspecs = m_config.get_aggregates();
+    m_tree_agg_indices.resize(aggspecs.size());
+
+    for (t_uindex aggidx = 0, loop_end = aggspecs.size(); aggidx < loop_end;
+         ++aggidx) {
+        auto iter = std::find_if(m_tree_aggregates.begin(),
+            m_tree_aggregates.end(), [&](const t_aggspec& spec) {
+                return spec.name() == aggspecs[aggidx].name();
+            });
+
+        PSP_VERBOSE_ASSERT(iter != m_tree_aggregates.end(),
+            "Tree is missing an aggregate of this context");
+        m_tree_agg_indices[aggidx] = iter - m_tree_aggregates.begin();
+    }
+
+    update_tree_sortby();
+}
+
+bool
+t_ctx1::merge_tree_aggregates(const std::vector<t_aggspec>& aggregates,
+    std::vector<t_aggspec>& out_aggregates) const {
+    std::map<std::string, std::string> signatures;
+    for (const auto& spec : aggregates) {
+        signatures[spec.name()] = t_config::get_aggregate_signature(spec);
+    }
+
+    std::vector<t_aggspec> merged = aggregates;
+    for (const auto& spec : m_config.get_aggregates()) {
+        auto iter = signatures.find(spec.name());
+
+        if (iter == signatures.end()) {
+            merged.push_back(spec);
+        } else if (iter->second != t_config::get_aggregate_signature(spec)) {
+            return false;
+        }
+    }
+
+    std::swap(merged, out_aggregates);
+    return true;
 }
 
 /**
@@ -500,14 +1004,26 @@ t_ctx1::get_cell_delta(t_index bidx, t_index eidx) const {
 void
 t_ctx1::reset(bool reset_expressions) {
     auto pivots = m_config.get_row_pivots();
+
+    if (m_tree) {
+        m_tree->remove_context();
+    }
+
     m_tree = std::make_shared<t_stree>(
-        pivots, m_config.get_aggregates(), m_schema, m_config);
+        pivots, m_tree_aggregates, m_schema, m_config);
     m_tree->init();
+    m_tree->add_context();
+    m_tree->set_alerts_enabled(get_feature_state(CTX_FEAT_ALERT));
     m_tree->set_deltas_enabled(get_feature_state(CTX_FEAT_DELTA));
     m_traversal = std::shared_ptr<t_traversal>(new t_traversal(m_tree));
 
     if (reset_expressions)
         m_expression_tables->reset();
+
+    reset_minmax();
+    if (m_top_n >= 0) {
+        apply_top_n();
+    }
 }
 
 void
@@ -554,7 +1070,8 @@ t_ctx1::pprint() const {
 
     for (t_uindex aggidx = 0, loop_end = aggcols.size(); aggidx < loop_end;
          ++aggidx) {
-        const std::string& aggname = aggschema.m_columns[aggidx];
+        const std::string& aggname
+            = aggschema.m_columns[m_tree_agg_indices[aggidx]];
         aggcols[aggidx] = aggtable->get_const_column(aggname).get();
     }
 
@@ -599,7 +1116,9 @@ t_dtype
 t_ctx1::get_column_dtype(t_uindex idx) const {
     if (idx == 0 || idx >= static_cast<t_uindex>(get_column_count()))
         return DTYPE_NONE;
-    return m_tree->get_aggtable()->get_const_column(idx - 1)->get_dtype();
+    return m_tree->get_aggtable()
+        ->get_const_column(m_tree_agg_indices[idx - 1])
+        ->get_dtype();
 }
 
 t_depth
@@ -608,75 +1127,8 @@ t_ctx1::get_trav_depth(t_index idx) const {
 }
 
 void
-t_ctx1::compute_expressions(std::shared_ptr<t_data_table> flattened_masked,
-    t_expression_vocab& expression_vocab, t_regex_mapping& regex_mapping) {
-    // Clear the transitional expression tables on the context so they are
-    // ready for the next update.
-    m_expression_tables->clear_transitional_tables();
-
-    std::shared_ptr<t_data_table> master_expression_table
-        = m_expression_tables->m_master;
-
-    // Set the master table to the right size.
-    t_uindex num_rows = flattened_masked->size();
-    master_expression_table->reserve(num_rows);
-    master_expression_table->set_size(num_rows);
-
-    const auto& expressions = m_config.get_expressions();
-    for (const auto& expr : expressions) {
-        // Compute the expressions on the master table.
-        expr->compute(flattened_masked, master_expression_table,
-            expression_vocab, regex_mapping);
-    }
-}
-
-void
-t_ctx1::compute_expressions(std::shared_ptr<t_data_table> master,
-    std::shared_ptr<t_data_table> flattened,
-    std::shared_ptr<t_data_table> delta, std::shared_ptr<t_data_table> prev,
-    std::shared_ptr<t_data_table> current,
-    std::shared_ptr<t_data_table> transitions,
-    std::shared_ptr<t_data_table> existed, t_expression_vocab& expression_vocab,
-    t_regex_mapping& regex_mapping) {
-    // Clear the tables so they are ready for this round of updates
-    m_expression_tables->clear_transitional_tables();
-
-    // All tables are the same size
-    t_uindex flattened_num_rows = flattened->size();
-    m_expression_tables->reserve_transitional_table_size(flattened_num_rows);
-    m_expression_tables->set_transitional_table_size(flattened_num_rows);
-
-    // Update the master expression table's size
-    t_uindex master_num_rows = master->size();
-    m_expression_tables->m_master->reserve(master_num_rows);
-    m_expression_tables->m_master->set_size(master_num_rows);
-
-    const auto& expressions = m_config.get_expressions();
-    for (const auto& expr : expressions) {
-        // master: compute based on latest state of the gnode state table
-        expr->compute(master, m_expression_tables->m_master, expression_vocab,
-            regex_mapping);
-
-        // flattened: compute based on the latest update dataset
-        expr->compute(flattened, m_expression_tables->m_flattened,
-            expression_vocab, regex_mapping);
-
-        // delta: for each numerical column, the numerical delta between the
-        // previous value and the current value in the row.
-        expr->compute(delta, m_expression_tables->m_delta, expression_vocab,
-            regex_mapping);
-
-        // prev: the values of the updated rows before this update was applied
-        expr->compute(
-            prev, m_expression_tables->m_prev, expression_vocab, regex_mapping);
-
-        // current: the current values of the updated rows
-        expr->compute(current, m_expression_tables->m_current, expression_vocab,
-            regex_mapping);
-    }
-
-    // Calculate the transitions now that the intermediate tables are computed
-    m_expression_tables->calculate_transitions(existed);
+t_ctx1::compute_expressions(t_expression_cache& cache) {
+    m_expression_tables->compute(m_config.get_expressions(), cache);
 }
 
 bool
@@ -793,7 +1245,16 @@ t_ctx1::unity_init_load_step_end() {}
 
 std::shared_ptr<t_data_table>
 t_ctx1::get_table() const {
-    auto schema = m_tree->get_aggtable()->get_schema();
+    // Only this context's aggregates, of a tree that may hold more.
+    auto aggschema = m_tree->get_aggtable()->get_schema();
+    std::vector<std::string> columns;
+    std::vector<t_dtype> dtypes;
+    for (auto aggidx : m_tree_agg_indices) {
+        columns.push_back(aggschema.m_columns[aggidx]);
+        dtypes.push_back(aggschema.m_types[aggidx]);
+    }
+
+    t_schema schema(columns, dtypes);
     auto pivots = m_config.get_row_pivots();
     auto tbl = std::make_shared<t_data_table>(schema, m_tree->size());
     tbl->init();
@@ -816,7 +1277,8 @@ t_ctx1::get_table() const {
             pivcols[depth - 1]->set_scalar(idx, m_tree->get_value(nidx));
         }
         for (t_uindex aggnum = 0; aggnum < n_aggs; ++aggnum) {
-            auto aggscalar = m_tree->get_aggregate(nidx, aggnum);
+            auto aggscalar
+                = m_tree->get_aggregate(nidx, m_tree_agg_indices[aggnum]);
             aggcols[aggnum]->set_scalar(idx, aggscalar);
         }
         ++idx;
@@ -129,10 +129,12 @@ t_ctx2::open(t_header header, t_index idx) {
         } else {
             retval = m_rtraversal->expand_node(m_sortby, idx);
         }
+        mark_minmax_rows(idx + 1, idx + 1 + retval);
         m_rows_changed = (retval > 0);
     } else {
         if (!m_ctraversal->is_valid_idx(idx))
             return 0;
+        reset_minmax();
         retval = m_ctraversal->expand_node(idx);
         m_column_depth_set = false;
         m_column_depth = 0;
@@ -152,6 +154,8 @@ t_ctx2::close(t_header header, t_index idx) {
                 return 0;
             m_row_depth_set = false;
             m_row_depth = 0;
+            mark_minmax_rows(
+                idx + 1, idx + 1 + m_rtraversal->get_node(idx).m_ndesc);
             retval = m_rtraversal->collapse_node(idx);
             m_rows_changed = (retval > 0);
         } break;
@@ -213,85 +217,219 @@ t_ctx2::get_ctraversal_indices() const {
 
 std::pair<t_tscalar, t_tscalar>
 t_ctx2::get_min_max(const std::string& colname) const {
-    t_uindex ctx_nrows = get_row_count();
-    t_uindex ctx_ncols = get_column_count();
-    auto rval = std::make_pair(mknone(), mknone());
+    t_uindex max_depth = m_row_depth + 1;
+
+    // Rows deeper than `max_depth` are not counted, so tracking starts over
+    // when it changes.
+    if (m_row_mins.size() != max_depth + 1) {
+        m_row_mins.clear();
+        m_row_maxes.clear();
+        m_minmax_marked.clear();
+        m_row_mins.resize(max_depth + 1);
+        m_row_maxes.resize(max_depth + 1);
+    }
+
+    // Re-read the rows marked since the last call, and drop the ones that
+    // are no longer shown. A percentage also changes with rows that were
+    // not marked, so its column is read again in full.
+    if (!m_minmax_marked.empty()) {
+        std::vector<t_index> ridxs;
+        std::vector<t_uindex> nidxs;
+        std::vector<t_tscalar> hidden;
+
+        for (auto nidx : m_minmax_marked) {
+            t_index ridx = m_rtraversal->tree_index_lookup(nidx, 0);
+            t_uindex row_depth
+                = ridx == INVALID_INDEX ? 0 : rtree()->get_depth(nidx);
+
+            if (row_depth == 0 || row_depth > max_depth) {
+                hidden.push_back(mktscalar(nidx));
+            } else {
+                ridxs.push_back(ridx);
+                nidxs.push_back(nidx);
+            }
+        }
+
+        t_schema aggschema = m_trees[0]->get_aggtable()->get_schema();
+        const std::vector<t_aggspec>& aggspecs = m_config.get_aggregates();
+
+        for (const std::string& tracked : m_row_mins[0].get_columns()) {
+            t_uindex scol = aggschema.get_colidx(tracked);
+            if (aggspecs[scol].agg() == AGGTYPE_PCT_SUM_PARENT
+                || aggspecs[scol].agg() == AGGTYPE_PCT_SUM_GRAND_TOTAL) {
+                add_minmax_column(tracked);
+                continue;
+            }
+
+            auto row_rvals = get_row_min_max(ridxs, scol);
+
+            for (t_uindex idx = 0, loop_end = nidxs.size(); idx < loop_end;
+                 ++idx) {
+                t_uindex row_depth = rtree()->get_depth(nidxs[idx]);
+                t_tscalar key = mktscalar(nidxs[idx]);
+                m_row_mins[row_depth].set_value(
+                    tracked, key, row_rvals[idx].first);
+                m_row_maxes[row_depth].set_value(
+                    tracked, key, row_rvals[idx].second);
+            }
+
+            // The depth of a dropped row is gone with it.
+            for (const t_tscalar& key : hidden) {
+                for (t_uindex row_depth = 1; row_depth <= max_depth;
+                     ++row_depth) {
+                    m_row_mins[row_depth].set_value(tracked, key, mknone());
+                    m_row_maxes[row_depth].set_value(tracked, key, mknone());
+                }
+            }
+        }
+
+        m_minmax_marked.clear();
+    }
+
+    if (!m_row_mins[0].has_column(colname)) {
+        add_minmax_column(colname);
+    }
+
+    // The min and max of the deepest row depth with any value.
+    for (t_uindex row_depth = max_depth; row_depth > 0; --row_depth) {
+        auto mins = m_row_mins[row_depth].get_min_max(colname);
+        if (!mins.first.is_none()) {
+            auto maxes = m_row_maxes[row_depth].get_min_max(colname);
+            return std::make_pair(mins.first, maxes.second);
+        }
+    }
+
+    return std::make_pair(mknone(), mknone());
+}
+
+void
+t_ctx2::mark_minmax_nodes(const std::vector<t_uindex>& nidxs) {
+    if (m_row_mins.empty() || m_row_mins[0].empty()) {
+        return;
+    }
+
+    m_minmax_marked.insert(nidxs.begin(), nidxs.end());
+}
+
+void
+t_ctx2::mark_minmax_rows(t_index bidx, t_index eidx) {
+    if (m_row_mins.empty() || m_row_mins[0].empty()) {
+        return;
+    }
+
+    for (t_index idx = bidx; idx < eidx; ++idx) {
+        m_minmax_marked.insert(m_rtraversal->get_tree_index(idx));
+    }
+}
+
+void
+t_ctx2::reset_minmax() {
+    m_row_mins.clear();
+    m_row_maxes.clear();
+    m_minmax_marked.clear();
+}
+
+void
+t_ctx2::add_minmax_column(const std::string& colname) const {
     t_uindex scol
         = m_trees[0]->get_aggtable()->get_schema().get_colidx(colname);
+    t_uindex max_depth = m_row_depth + 1;
+    std::vector<t_index> ridxs;
+
+    for (t_index ridx = 0, loop_end = get_row_count(); ridx < loop_end;
+         ++ridx) {
+        t_uindex row_depth = m_rtraversal->get_depth(ridx);
+        if (row_depth > 0 && row_depth <= max_depth) {
+            ridxs.push_back(ridx);
+        }
+    }
+
+    auto row_rvals = get_row_min_max(ridxs, scol);
+    std::vector<std::vector<t_tscalar>> nidxs(max_depth + 1);
+    std::vector<std::vector<t_tscalar>> mins(max_depth + 1);
+    std::vector<std::vector<t_tscalar>> maxes(max_depth + 1);
+
+    for (t_uindex idx = 0, loop_end = ridxs.size(); idx < loop_end; ++idx) {
+        t_uindex row_depth = m_rtraversal->get_depth(ridxs[idx]);
+        t_uindex nidx = m_rtraversal->get_tree_index(ridxs[idx]);
+        nidxs[row_depth].push_back(mktscalar(nidx));
+        mins[row_depth].push_back(row_rvals[idx].first);
+        maxes[row_depth].push_back(row_rvals[idx].second);
+    }
+
+    for (t_uindex row_depth = 0; row_depth <= max_depth; ++row_depth) {
+        m_row_mins[row_depth].add_column(
+            colname, nidxs[row_depth], mins[row_depth]);
+        m_row_maxes[row_depth].add_column(
+            colname, nidxs[row_depth], maxes[row_depth]);
+    }
+}
+
+std::vector<std::pair<t_tscalar, t_tscalar>>
+t_ctx2::get_row_min_max(
+    const std::vector<t_index>& ridxs, t_uindex scol) const {
+    t_uindex ctx_ncols = get_column_count();
+    t_uindex n_aggs = m_config.get_num_aggregates();
+
+    // Only the view columns of aggregate `scol`.
     std::vector<std::pair<t_uindex, t_uindex>> cells;
-    for (t_index ridx = 0; ridx < ctx_nrows; ++ridx) {
-        for (t_index cidx = 0; cidx < ctx_ncols; ++cidx) {
-            cells.push_back(std::pair<t_index, t_index>(ridx, cidx));
+    std::vector<t_uindex> cell_rows;
+
+    for (t_uindex idx = 0, loop_end = ridxs.size(); idx < loop_end; ++idx) {
+        for (t_uindex cidx = scol + 1; cidx < ctx_ncols; cidx += n_aggs) {
+            cells.push_back(std::pair<t_uindex, t_uindex>(ridxs[idx], cidx));
+            cell_rows.push_back(idx);
         }
     }
 
     auto cells_info = resolve_cells(cells);
-    typedef std::pair<t_uindex, t_uindex> t_aggpair;
-    std::map<t_aggpair, const t_column*> aggmap;
-    auto n_aggs = m_config.get_num_aggregates();
+    std::vector<const t_column*> aggcols(m_trees.size());
+
     for (t_uindex treeidx = 0, tree_loop_end = m_trees.size();
          treeidx < tree_loop_end; ++treeidx) {
         auto aggtable = m_trees[treeidx]->get_aggtable();
-        t_schema aggschema = aggtable->get_schema();
-        for (t_uindex aggidx = 0, agg_loop_end = n_aggs; aggidx < agg_loop_end;
-             ++aggidx) {
-            const std::string& aggname = aggschema.m_columns[aggidx];
-            aggmap[t_aggpair(treeidx, aggidx)]
-                = aggtable->get_const_column(aggname).get();
-        }
+        const std::string& aggname = aggtable->get_schema().m_columns[scol];
+        aggcols[treeidx] = aggtable->get_const_column(aggname).get();
     }
 
-    const std::vector<t_aggspec>& aggspecs = m_config.get_aggregates();
-    bool is_finished = false;
-    t_uindex row_depth = m_row_depth + 1;
-    while (!is_finished && row_depth > 0) {
-        for (std::size_t i = 0; i < cells_info.size(); ++i) {
-            const t_cellinfo& cinfo = cells_info[i];
-            if (cinfo.m_idx < 0 || cinfo.m_agg_index != scol) {
-                continue;
-            } else {
-                t_index nidx = m_rtraversal->get_tree_index(cinfo.m_ridx);
-                if (rtree()->get_depth(nidx) != row_depth) {
-                    continue;
-                }
+    const t_aggspec& aggspec = m_config.get_aggregates()[scol];
+    std::vector<std::pair<t_tscalar, t_tscalar>> rval(
+        ridxs.size(), std::make_pair(mknone(), mknone()));
 
-                auto col_depth
-                    = ctree()->get_depth(m_ctraversal->get_tree_index(
-                        calc_translated_colidx(n_aggs, cinfo.m_cidx)));
-                if (m_config.get_num_cpivots() != col_depth) {
-                    continue;
-                }
+    for (t_uindex idx = 0, loop_end = cells_info.size(); idx < loop_end;
+         ++idx) {
+        const t_cellinfo& cinfo = cells_info[idx];
+        if (cinfo.m_idx < 0) {
+            continue;
+        }
 
-                auto aggcol
-                    = aggmap[t_aggpair(cinfo.m_treenum, cinfo.m_agg_index)];
-                t_index p_idx
-                    = m_trees[cinfo.m_treenum]->get_parent_idx(cinfo.m_idx);
-                t_uindex agg_ridx
-                    = m_trees[cinfo.m_treenum]->get_aggidx(cinfo.m_idx);
-                t_uindex agg_pridx = p_idx == INVALID_INDEX
-                    ? INVALID_INDEX
-                    : m_trees[cinfo.m_treenum]->get_aggidx(p_idx);
+        auto col_depth = ctree()->get_depth(m_ctraversal->get_tree_index(
+            calc_translated_colidx(n_aggs, cinfo.m_cidx)));
+        if (m_config.get_num_cpivots() != col_depth) {
+            continue;
+        }
 
-                auto val = extract_aggregate(
-                    aggspecs[cinfo.m_agg_index], aggcol, agg_ridx, agg_pridx);
+        const auto& tree = m_trees[cinfo.m_treenum];
+        t_index p_idx = tree->get_parent_idx(cinfo.m_idx);
+        t_uindex agg_ridx = tree->get_aggidx(cinfo.m_idx);
+        t_index agg_pridx
+            = p_idx == INVALID_INDEX ? INVALID_INDEX : tree->get_aggidx(p_idx);
 
-                if (!val.is_valid()) {
-                    continue;
-                }
+        auto val = extract_aggregate(
+            aggspec, aggcols[cinfo.m_treenum], agg_ridx, agg_pridx);
 
-                is_finished = true;
-                if (rval.first.is_none()
-                    || (!val.is_none() && val < rval.first)) {
-                    rval.first = val;
-                }
+        if (!val.is_valid() || val.is_none() || val.is_nan()) {
+            continue;
+        }
 
-                if (val > rval.second) {
-                    rval.second = val;
-                }
-            }
+        auto& row_rval = rval[cell_rows[idx]];
+        if (row_rval.first.is_none() || val < row_rval.first) {
+            row_rval.first = val;
         }
 
-        row_depth--;
+        if (row_rval.second.is_none() || val > row_rval.second) {
+            row_rval.second = val;
+        }
     }
 
     return rval;
@@ -525,6 +663,11 @@ t_ctx2::notify(const t_data_table& flattened) {
                 *(m_expression_tables->m_master));
         }
     }
+
+    // A cell only changes with its row, so marking the row tree's nodes
+    // covers every tree.
+    mark_minmax_nodes(rtree()->get_last_step().m_updated_ids);
+
     if (!m_sortby.empty()) {
         sort_by(m_sortby);
     }
@@ -534,7 +677,6 @@ void
 t_ctx2::notify(const t_data_table& flattened, const t_data_table& delta,
     const t_data_table& prev, const t_data_table& current,
     const t_data_table& transitions, const t_data_table& existed) {
-
     for (t_uindex tree_idx = 0, loop_end = m_trees.size(); tree_idx < loop_end;
          ++tree_idx) {
         if (is_rtree_idx(tree_idx)) {
@@ -557,6 +699,8 @@ t_ctx2::notify(const t_data_table& flattened, const t_data_table& delta,
         }
     }
 
+    mark_minmax_nodes(rtree()->get_last_step().m_updated_ids);
+
     if (!m_sortby.empty()) {
         sort_by(m_sortby);
     }
@@ -811,6 +955,13 @@ t_ctx2::set_depth(t_header header, t_depth depth) {
                 return;
             new_depth
                 = std::min<t_depth>(m_config.get_num_rpivots() - 1, depth);
+
+            // Expanding to the same depth again, as `step_end` does, only
+            // shows rows new to the tree, which are already marked.
+            if (!m_row_depth_set || new_depth != m_row_depth) {
+                reset_minmax();
+            }
+
             m_rtraversal->set_depth(m_sortby, new_depth);
             m_row_depth = new_depth;
             m_row_depth_set = true;
@@ -820,6 +971,11 @@ t_ctx2::set_depth(t_header header, t_depth depth) {
                 return;
             new_depth
                 = std::min<t_depth>(m_config.get_num_cpivots() - 1, depth);
+
+            if (!m_column_depth_set || new_depth != m_column_depth) {
+                reset_minmax();
+            }
+
             m_ctraversal->set_depth(m_column_sortby, new_depth);
             m_column_depth = new_depth;
             m_column_depth_set = true;
@@ -950,6 +1106,7 @@ t_ctx2::get_rows_changed() {
 
 void
 t_ctx2::reset(bool reset_expressions) {
+    reset_minmax();
     for (t_uindex treeidx = 0, tree_loop_end = m_trees.size();
          treeidx < tree_loop_end; ++treeidx) {
         std::vector<t_pivot> pivots;
@@ -1050,75 +1207,8 @@ t_ctx2::get_column_dtype(t_uindex idx) const {
 }
 
 void
-t_ctx2::compute_expressions(std::shared_ptr<t_data_table> flattened_masked,
-    t_expression_vocab& expression_vocab, t_regex_mapping& regex_mapping) {
-    // Clear the transitional expression tables on the context so they are
-    // ready for the next update.
-    m_expression_tables->clear_transitional_tables();
-
-    std::shared_ptr<t_data_table> master_expression_table
-        = m_expression_tables->m_master;
-
-    // Set the master table to the right size.
-    t_uindex num_rows = flattened_masked->size();
-    master_expression_table->reserve(num_rows);
-    master_expression_table->set_size(num_rows);
-
-    const auto& expressions = m_config.get_expressions();
-    for (const auto& expr : expressions) {
-        // Compute the expressions on the master table.
-        expr->compute(flattened_masked, master_expression_table,
-            expression_vocab, regex_mapping);
-    }
-}
-
-void
-t_ctx2::compute_expressions(std::shared_ptr<t_data_table> master,
-    std::shared_ptr<t_data_table> flattened,
-    std::shared_ptr<t_data_table> delta, std::shared_ptr<t_data_table> prev,
-    std::shared_ptr<t_data_table> current,
-    std::shared_ptr<t_data_table> transitions,
-    std::shared_ptr<t_data_table> existed, t_expression_vocab& expression_vocab,
-    t_regex_mapping& regex_mapping) {
-    // Clear the tables so they are ready for this round of updates
-    m_expression_tables->clear_transitional_tables();
-
-    // All tables are the same size
-    t_uindex flattened_num_rows = flattened->size();
-    m_expression_tables->reserve_transitional_table_size(flattened_num_rows);
-    m_expression_tables->set_transitional_table_size(flattened_num_rows);
-
-    // Update the master expression table's size
-    t_uindex master_num_rows = master->size();
-    m_expression_tables->m_master->reserve(master_num_rows);
-    m_expression_tables->m_master->set_size(master_num_rows);
-
-    const auto& expressions = m_config.get_expressions();
-    for (const auto& expr : expressions) {
-        // master: compute based on latest state of the gnode state table
-        expr->compute(master, m_expression_tables->m_master, expression_vocab,
-            regex_mapping);
-
-        // flattened: compute based on the latest update dataset
-        expr->compute(flattened, m_expression_tables->m_flattened,
-            expression_vocab, regex_mapping);
-
-        // delta: for each numerical column, the numerical delta between the
-        // previous value and the current value in the row.
-        expr->compute(delta, m_expression_tables->m_delta, expression_vocab,
-            regex_mapping);
-
-        // prev: the values of the updated rows before this update was applied
-        expr->compute(
-            prev, m_expression_tables->m_prev, expression_vocab, regex_mapping);
-
-        // current: the current values of the updated rows
-        expr->compute(current, m_expression_tables->m_current, expression_vocab,
-            regex_mapping);
-    }
-
-    // Calculate the transitions now that the intermediate tables are computed
-    m_expression_tables->calculate_transitions(existed);
+t_ctx2::compute_expressions(t_expression_cache& cache) {
+    m_expression_tables->compute(m_config.get_expressions(), cache);
 }
 
 bool
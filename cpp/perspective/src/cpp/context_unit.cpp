@@ -125,24 +125,44 @@ t_ctxunit::notify(const t_data_table& flattened) {
 
 std::pair<t_tscalar, t_tscalar>
 t_ctxunit::get_min_max(const std::string& colname) const {
-    auto col = m_gstate->get_table()->get_const_column(colname);
-    auto rval = std::make_pair(mknone(), mknone());
-    for (std::size_t i = 0; i < col->size(); i++) {
-        t_tscalar val = col->get_scalar(i);
-        if (!val.is_valid()) {
-            continue;
+    std::shared_ptr<const t_data_table> master = m_gstate->get_table();
+
+    // Re-read the rows changed since the last call; removed rows are
+    // cleared in the master table, so they read as invalid.
+    const tsl::hopscotch_set<t_tscalar>& marked = m_minmax.get_marked_rows();
+
+    if (!marked.empty()) {
+        for (const std::string& tracked : m_minmax.get_columns()) {
+            auto col = master->get_const_column(tracked);
+
+            for (const t_tscalar& pkey : marked) {
+                t_rlookup lookup = m_gstate->lookup(pkey);
+                t_tscalar val = lookup.m_exists
+                    ? col->get_scalar(lookup.m_idx)
+                    : mknone();
+                m_minmax.set_value(tracked, pkey, val);
+            }
         }
 
-        if (rval.first.is_none() || (!val.is_none() && val < rval.first)) {
-            rval.first = val;
-        }
+        m_minmax.clear_marked_rows();
+    }
+
+    if (!m_minmax.has_column(colname)) {
+        auto col = master->get_const_column(colname);
+        auto pkey_col = master->get_const_column("psp_pkey");
+        t_uindex nrows = col->size();
+        std::vector<t_tscalar> pkeys(nrows);
+        std::vector<t_tscalar> values(nrows);
 
-        if (val > rval.second) {
-            rval.second = val;
+        for (t_uindex ridx = 0; ridx < nrows; ++ridx) {
+            pkeys[ridx] = pkey_col->get_scalar(ridx);
+            values[ridx] = col->get_scalar(ridx);
         }
+
+        m_minmax.add_column(colname, pkeys, values);
     }
 
-    return rval;
+    return m_minmax.get_min_max(colname);
 }
 
 /**
@@ -349,6 +369,7 @@ t_ctxunit::get_column_names() const {
 void
 t_ctxunit::reset() {
     m_has_delta = false;
+    m_minmax.clear();
 }
 
 bool
@@ -432,6 +453,7 @@ t_ctxunit::unity_get_column_expanded(t_uindex idx) const {
 void
 t_ctxunit::add_delta_pkey(t_tscalar pkey) {
     m_delta_pkeys.insert(pkey);
+    m_minmax.mark_row(pkey);
 }
 
 bool
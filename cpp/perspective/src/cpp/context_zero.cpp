@@ -18,10 +18,14 @@
 
 namespace perspective {
 
-t_ctx0::t_ctx0() {}
+t_ctx0::t_ctx0()
+    : m_expression_vocab(nullptr)
+    , m_regex_mapping(nullptr) {}
 
 t_ctx0::t_ctx0(const t_schema& schema, const t_config& config)
     : t_ctxbase<t_ctx0>(schema, config)
+    , m_expression_vocab(nullptr)
+    , m_regex_mapping(nullptr)
     , m_has_delta(false) {}
 
 t_ctx0::~t_ctx0() { m_traversal.reset(); }
@@ -33,9 +37,30 @@ t_ctx0::init() {
 
     // Each context stores its own expression columns in separate
     // `t_data_table`s so that each context's expressions are isolated
-    // and do not affect other contexts when they are calculated.
-    const auto& expressions = m_config.get_expressions();
-    m_expression_tables = std::make_shared<t_expression_tables>(expressions);
+    // and do not affect other contexts when they are calculated. Only the
+    // filtered expressions are needed for every row up front - sorting is
+    // set after `init`, and moves the sorted expressions over then.
+    // Nondeterministic expressions are never cached, so that they are
+    // recomputed on every update like any other eager expression.
+    std::set<std::string> filtered;
+    for (const auto& fterm : m_config.get_fterms()) {
+        filtered.insert(fterm.m_colname);
+    }
+
+    std::vector<std::shared_ptr<t_computed_expression>> lazy_expressions;
+    for (const auto& expr : m_config.get_expressions()) {
+        if (filtered.count(expr->get_expression_alias()) != 0
+            || expr->is_nondeterministic()) {
+            m_eager_expressions.push_back(expr);
+        } else {
+            lazy_expressions.push_back(expr);
+        }
+    }
+
+    m_expression_tables
+        = std::make_shared<t_expression_tables>(m_eager_expressions);
+    m_lazy_expressions
+        = std::make_shared<t_lazy_expressions>(lazy_expressions);
 
     m_init = true;
 }
@@ -66,7 +91,8 @@ t_ctx0::step_end() {
         return;
     }
 
-    m_traversal->step_end();
+    m_traversal->step_end(
+        *m_gstate, *(m_expression_tables->m_master), m_config);
 }
 
 /**
@@ -99,6 +125,17 @@ t_ctx0::notify(const t_data_table& flattened, const t_data_table& delta,
 
     bool delete_encountered = false;
 
+    if (m_lazy_expressions->size() > 0) {
+        std::vector<t_uindex> rows(nrecs);
+        for (t_uindex idx = 0; idx < nrecs; ++idx) {
+            t_rlookup lookup = m_gstate->lookup(pkey_col->get_scalar(idx));
+            rows[idx] = lookup.m_exists ? lookup.m_idx
+                                     : static_cast<t_uindex>(INVALID_INDEX);
+        }
+
+        m_lazy_expressions->invalidate(rows, transitions, *existed_col);
+    }
+
     if (m_config.has_filters()) {
         t_mask msk_prev = filter_table_for_config(prev, m_config);
         t_mask msk_curr = filter_table_for_config(curr, m_config);
@@ -202,6 +239,7 @@ t_ctx0::notify(const t_data_table& flattened) {
     const t_column* op_col = op_sptr.get();
 
     m_has_delta = true;
+    m_lazy_expressions->invalidate_all();
 
     if (m_config.has_filters()) {
         t_mask msk = filter_table_for_config(flattened, m_config);
@@ -261,28 +299,76 @@ std::pair<t_tscalar, t_tscalar>
 t_ctx0::get_min_max(const std::string& colname) const {
     std::pair<t_tscalar, t_tscalar> rval(mknone(), mknone());
     t_uindex ctx_nrows = get_row_count();
-    std::vector<t_tscalar> values(ctx_nrows);
-    std::vector<t_tscalar> pkeys = m_traversal->get_pkeys(0, ctx_nrows);
-    std::vector<t_tscalar> out_data(pkeys.size());
 
-    read_column_from_gstate(colname, pkeys, out_data);
+    // A top-N view is at most N rows, which are cheaper to scan than to
+    // track through rows entering and leaving the top N.
+    if (m_traversal->get_top_n() >= 0) {
+        std::vector<t_tscalar> pkeys = m_traversal->get_pkeys(0, ctx_nrows);
+        std::vector<t_tscalar> out_data(pkeys.size());
+
+        read_column_from_gstate(colname, pkeys, out_data);
+
+        for (t_index ridx = 0; ridx < m_traversal->size(); ++ridx) {
+            auto val = out_data[ridx];
+            if (!val.is_valid()) {
+                continue;
+            }
 
-    for (t_index ridx = 0; ridx < m_traversal->size(); ++ridx) {
-        auto val = out_data[ridx];
-        if (!val.is_valid()) {
-            continue;
+            if (rval.first.is_none() || (!val.is_none() && val < rval.first)) {
+                rval.first = val;
+            }
+
+            if (val > rval.second) {
+                rval.second = val;
+            }
         }
 
-        if (rval.first.is_none() || (!val.is_none() && val < rval.first)) {
-            rval.first = val;
+        return rval;
+    }
+
+    // Re-read the rows changed since the last call, and drop the ones that
+    // are no longer in the view.
+    const tsl::hopscotch_set<t_tscalar>& marked = m_minmax.get_marked_rows();
+
+    if (!marked.empty()) {
+        std::vector<t_tscalar> pkeys;
+        std::vector<t_tscalar> removed;
+        pkeys.reserve(marked.size());
+
+        for (const t_tscalar& pkey : marked) {
+            if (m_traversal->get_row_idx(pkey) >= 0) {
+                pkeys.push_back(pkey);
+            } else {
+                removed.push_back(pkey);
+            }
         }
 
-        if (val > rval.second) {
-            rval.second = val;
+        for (const std::string& tracked : m_minmax.get_columns()) {
+            std::vector<t_tscalar> out_data(pkeys.size());
+            read_column_from_gstate(tracked, pkeys, out_data);
+
+            for (t_uindex idx = 0, loop_end = pkeys.size(); idx < loop_end;
+                 ++idx) {
+                m_minmax.set_value(tracked, pkeys[idx], out_data[idx]);
+            }
+
+            for (const t_tscalar& pkey : removed) {
+                m_minmax.set_value(tracked, pkey, mknone());
+            }
         }
+
+        m_minmax.clear_marked_rows();
     }
 
-    return rval;
+    if (!m_minmax.has_column(colname)) {
+        std::vector<t_tscalar> pkeys = m_traversal->get_pkeys(0, ctx_nrows);
+        std::vector<t_tscalar> out_data(pkeys.size());
+
+        read_column_from_gstate(colname, pkeys, out_data);
+        m_minmax.add_column(colname, pkeys, out_data);
+    }
+
+    return m_minmax.get_min_max(colname);
 }
 
 /**
@@ -307,24 +393,21 @@ t_ctx0::get_data(t_index start_row, t_index end_row, t_index start_col,
     t_index stride = ext.m_ecol - ext.m_scol;
     std::vector<t_tscalar> values(nrows * stride);
 
+    if (nrows <= 0 || stride <= 0) {
+        return values;
+    }
+
+    // Resolve the viewport's primary keys once, then gather each column
+    // by row straight into its slot of the row-major result.
     std::vector<t_tscalar> pkeys
         = m_traversal->get_pkeys(ext.m_srow, ext.m_erow);
-    auto none = mknone();
+    std::vector<t_uindex> rows;
+    m_gstate->lookup(pkeys, rows);
 
     for (t_index cidx = ext.m_scol; cidx < ext.m_ecol; ++cidx) {
-        std::vector<t_tscalar> out_data(pkeys.size());
         const std::string& colname = m_config.col_at(cidx);
-        read_column_from_gstate(colname, pkeys, out_data);
-
-        for (t_index ridx = ext.m_srow; ridx < ext.m_erow; ++ridx) {
-            auto v = out_data[ridx - ext.m_srow];
-
-            // todo: fix null handling
-            if (!v.is_valid())
-                v.set(none);
-
-            values[(ridx - ext.m_srow) * stride + (cidx - ext.m_scol)] = v;
-        }
+        read_column_from_gstate(
+            colname, rows, values.data() + (cidx - ext.m_scol), stride);
     }
 
     return values;
@@ -341,22 +424,18 @@ std::vector<t_tscalar>
 t_ctx0::get_data(const std::vector<t_uindex>& rows) const {
     t_uindex stride = get_column_count();
     std::vector<t_tscalar> values(rows.size() * stride);
+    if (values.empty()) {
+        return values;
+    }
+
     std::vector<t_tscalar> pkeys = m_traversal->get_pkeys(rows);
+    std::vector<t_uindex> master_rows;
+    m_gstate->lookup(pkeys, master_rows);
 
-    auto none = mknone();
     for (t_uindex cidx = 0; cidx < stride; ++cidx) {
-        std::vector<t_tscalar> out_data(rows.size());
         const std::string& colname = m_config.col_at(cidx);
-        read_column_from_gstate(colname, pkeys, out_data);
-
-        for (t_uindex ridx = 0; ridx < rows.size(); ++ridx) {
-            auto v = out_data[ridx];
-
-            if (!v.is_valid())
-                v.set(none);
-
-            values[(ridx)*stride + (cidx)] = v;
-        }
+        read_column_from_gstate(
+            colname, master_rows, values.data() + cidx, stride);
     }
 
     return values;
@@ -371,10 +450,21 @@ void
 t_ctx0::sort_by(const std::vector<t_sortspec>& sortby) {
     if (sortby.empty())
         return;
+
+    for (const auto& spec : sortby) {
+        make_expression_eager(spec.m_colname);
+    }
+
     m_traversal->sort_by(
         *m_gstate, *(m_expression_tables->m_master), m_config, sortby);
 }
 
+void
+t_ctx0::set_top_n(t_index top_n) {
+    m_traversal->set_top_n(top_n);
+    m_minmax.clear();
+}
+
 void
 t_ctx0::reset_sortby() {
     m_traversal->sort_by(*m_gstate, *(m_expression_tables->m_master), m_config,
@@ -448,9 +538,12 @@ t_ctx0::reset(bool reset_expressions) {
     m_traversal->reset();
     m_deltas = std::make_shared<t_zcdeltas>();
     m_has_delta = false;
+    m_minmax.clear();
 
     if (reset_expressions)
         m_expression_tables->reset();
+
+    m_lazy_expressions->invalidate_all();
 }
 
 t_index
@@ -616,76 +709,10 @@ t_ctx0::get_step_delta(t_index bidx, t_index eidx) {
 }
 
 void
-t_ctx0::compute_expressions(std::shared_ptr<t_data_table> flattened_masked,
-    t_expression_vocab& expression_vocab, t_regex_mapping& regex_mapping) {
-    // Clear the transitional expression tables on the context so they are
-    // ready for the next update.
-    m_expression_tables->clear_transitional_tables();
-
-    std::shared_ptr<t_data_table> master_expression_table
-        = m_expression_tables->m_master;
-
-    // Set the master table to the right size.
-    t_uindex num_rows = flattened_masked->size();
-    master_expression_table->reserve(num_rows);
-    master_expression_table->set_size(num_rows);
-
-    const auto& expressions = m_config.get_expressions();
-    for (const auto& expr : expressions) {
-        // Compute the expressions on the master table.
-        expr->compute(flattened_masked, master_expression_table,
-            expression_vocab, regex_mapping);
-    }
-}
-
-// TODO rewrite const&
-void
-t_ctx0::compute_expressions(std::shared_ptr<t_data_table> master,
-    std::shared_ptr<t_data_table> flattened,
-    std::shared_ptr<t_data_table> delta, std::shared_ptr<t_data_table> prev,
-    std::shared_ptr<t_data_table> current,
-    std::shared_ptr<t_data_table> transitions,
-    std::shared_ptr<t_data_table> existed, t_expression_vocab& expression_vocab,
-    t_regex_mapping& regex_mapping) {
-    // Clear the tables so they are ready for this round of updates
-    m_expression_tables->clear_transitional_tables();
-
-    // All tables are the same size
-    t_uindex flattened_num_rows = flattened->size();
-    m_expression_tables->reserve_transitional_table_size(flattened_num_rows);
-    m_expression_tables->set_transitional_table_size(flattened_num_rows);
-
-    // Update the master expression table's size
-    t_uindex master_num_rows = master->size();
-    m_expression_tables->m_master->reserve(master_num_rows);
-    m_expression_tables->m_master->set_size(master_num_rows);
-
-    const auto& expressions = m_config.get_expressions();
-    for (const auto& expr : expressions) {
-        // master: compute based on latest state of the gnode state table
-        expr->compute(master, m_expression_tables->m_master, expression_vocab,
-            regex_mapping);
-
-        // flattened: compute based on the latest update dataset
-        expr->compute(flattened, m_expression_tables->m_flattened,
-            expression_vocab, regex_mapping);
-
-        // delta: for each numerical column, the numerical delta between the
-        // previous value and the current value in the row.
-        expr->compute(delta, m_expression_tables->m_delta, expression_vocab,
-            regex_mapping);
-
-        // prev: the values of the updated rows before this update was applied
-        expr->compute(
-            prev, m_expression_tables->m_prev, expression_vocab, regex_mapping);
-
-        // current: the current values of the updated rows
-        expr->compute(current, m_expression_tables->m_current, expression_vocab,
-            regex_mapping);
-    }
-
-    // Calculate the transitions now that the intermediate tables are computed
-    m_expression_tables->calculate_transitions(existed);
+t_ctx0::compute_expressions(t_expression_cache& cache) {
+    m_expression_vocab = &(cache.get_expression_vocab());
+    m_regex_mapping = &(cache.get_regex_mapping());
+    m_expression_tables->compute(m_eager_expressions, cache);
 }
 
 bool
@@ -694,10 +721,13 @@ t_ctx0::is_expression_column(const std::string& colname) const {
     return schema.has_column(colname);
 }
 
+/**
+ * @brief The number of expressions in `m_expression_tables` - lazy
+ * expressions are not joined with the gnode's tables.
+ */
 t_uindex
 t_ctx0::num_expressions() const {
-    const auto& expressions = m_config.get_expressions();
-    return expressions.size();
+    return m_eager_expressions.size();
 }
 
 std::shared_ptr<t_expression_tables>
@@ -710,7 +740,13 @@ t_ctx0::read_column_from_gstate(const std::string& colname,
     const std::vector<t_tscalar>& pkeys,
     std::vector<t_tscalar>& out_data) const {
 
-    if (is_expression_column(colname)) {
+    if (m_lazy_expressions->has_column(colname)) {
+        std::vector<t_uindex> rows;
+        m_gstate->lookup(pkeys, rows);
+        materialize_expression(colname, rows);
+        m_gstate->read_column(*(m_lazy_expressions->get_table(colname)),
+            colname, pkeys, out_data);
+    } else if (is_expression_column(colname)) {
         m_gstate->read_column(
             *(m_expression_tables->m_master), colname, pkeys, out_data);
     } else {
@@ -719,6 +755,73 @@ t_ctx0::read_column_from_gstate(const std::string& colname,
     }
 }
 
+void
+t_ctx0::read_column_from_gstate(const std::string& colname,
+    const std::vector<t_uindex>& rows, t_tscalar* out_data,
+    t_uindex stride) const {
+
+    if (m_lazy_expressions->has_column(colname)) {
+        materialize_expression(colname, rows);
+        m_gstate->read_column(*(m_lazy_expressions->get_table(colname)),
+            colname, rows, out_data, stride);
+    } else if (is_expression_column(colname)) {
+        m_gstate->read_column(
+            *(m_expression_tables->m_master), colname, rows, out_data, stride);
+    } else {
+        std::shared_ptr<t_data_table> master_table = m_gstate->get_table();
+        m_gstate->read_column(*master_table, colname, rows, out_data, stride);
+    }
+}
+
+void
+t_ctx0::materialize_expression(
+    const std::string& colname, const std::vector<t_uindex>& rows) const {
+    PSP_VERBOSE_ASSERT(m_expression_vocab != nullptr,
+        "Expressions read before the context was computed");
+    m_lazy_expressions->materialize(colname, *(m_gstate->get_table()), rows,
+        *m_expression_vocab, *m_regex_mapping);
+}
+
+void
+t_ctx0::make_expression_eager(const std::string& colname) {
+    if (!m_lazy_expressions->has_column(colname)) {
+        return;
+    }
+
+    std::shared_ptr<t_computed_expression> expression
+        = m_lazy_expressions->remove(colname);
+    std::shared_ptr<t_expression_tables> previous = m_expression_tables;
+
+    m_eager_expressions.push_back(expression);
+    m_expression_tables
+        = std::make_shared<t_expression_tables>(m_eager_expressions);
+
+    // Before the context is registered there is nothing computed yet, and
+    // the gnode computes every eager expression from here on.
+    if (m_gstate == nullptr || m_expression_vocab == nullptr) {
+        return;
+    }
+
+    // Otherwise keep the master columns already computed, and compute the
+    // new one over the whole master table now.
+    std::shared_ptr<t_data_table> master = m_gstate->get_table();
+    std::shared_ptr<t_data_table> expression_master
+        = m_expression_tables->m_master;
+
+    for (const auto& expr : m_eager_expressions) {
+        const std::string& alias = expr->get_expression_alias();
+        if (expr != expression) {
+            expression_master->set_column(
+                alias, previous->m_master->get_column(alias));
+        }
+    }
+
+    expression->compute(
+        master, expression_master, *m_expression_vocab, *m_regex_mapping);
+    expression_master->set_capacity(master->size());
+    expression_master->set_table_size(master->size());
+}
+
 t_index
 t_ctx0::get_row_count() const {
     return m_traversal->size();
@@ -737,6 +840,7 @@ t_ctx0::get_column_count() const {
 void
 t_ctx0::add_delta_pkey(t_tscalar pkey) {
     m_delta_pkeys.insert(pkey);
+    m_minmax.mark_row(pkey);
 }
 
 void
@@ -15,6 +15,9 @@
 #include <perspective/storage.h>
 #include <perspective/scalar.h>
 #include <perspective/tracing.h>
+#include <perspective/bitmap_index.h>
+#include <perspective/filter_kernel.h>
+#include <perspective/parallel_for.h>
 #include <perspective/utils.h>
 
 #include <sstream>
@@ -464,79 +467,83 @@ t_data_table::clear() {
 t_mask
 t_data_table::filter_cpp(
     t_filter_op combiner, const std::vector<t_fterm>& fterms_) const {
-    auto self = const_cast<t_data_table*>(this);
     auto fterms = fterms_;
-
-    t_mask mask(size());
+    t_uindex nrows = size();
     t_uindex fterm_size = fterms.size();
-    std::vector<t_uindex> indices(fterm_size);
-    std::vector<const t_column*> columns(fterm_size);
+    std::vector<std::shared_ptr<t_filter_kernel>> kernels(fterm_size);
 
     for (t_uindex idx = 0; idx < fterm_size; ++idx) {
-        indices[idx] = m_schema.get_colidx(fterms[idx].m_colname);
-        columns[idx] = get_const_column(fterms[idx].m_colname).get();
-        fterms[idx].coerce_numeric(columns[idx]->get_dtype());
-        if (fterms[idx].m_use_interned) {
-            t_tscalar& thr = fterms[idx].m_threshold;
-            auto col = self->get_column(fterms[idx].m_colname);
-            auto interned = col->get_interned(thr.get_char_ptr());
-            thr.set(interned);
+        const t_column* column
+            = get_const_column(fterms[idx].m_colname).get();
+        fterms[idx].coerce_numeric(column->get_dtype());
+
+        if (m_bitmap_indexes) {
+            auto iter = m_bitmap_indexes->m_indexes.find(fterms[idx].m_colname);
+            if (iter != m_bitmap_indexes->m_indexes.end()) {
+                kernels[idx] = make_index_filter_kernel(column, *(iter->second),
+                    m_bitmap_indexes->m_has_live ? &m_bitmap_indexes->m_live
+                                                 : nullptr,
+                    fterms[idx], nrows);
+            }
         }
-    }
 
-    switch (combiner) {
-        case FILTER_OP_AND: {
-            t_tscalar cell_val;
+        if (!kernels[idx]) {
+            kernels[idx] = make_filter_kernel(column, fterms[idx], nrows);
+        }
+    }
 
-            for (t_uindex ridx = 0, rloop_end = size(); ridx < rloop_end;
-                 ++ridx) {
-                bool pass = true;
+    if (combiner != FILTER_OP_AND && combiner != FILTER_OP_OR) {
+        PSP_COMPLAIN_AND_ABORT("Unknown filter op");
+    }
 
-                for (t_uindex cidx = 0; cidx < fterm_size; ++cidx) {
-                    if (!pass)
-                        break;
+    // Each term is evaluated 64 rows at a time, and a term is skipped for
+    // words the terms before it already decided.
+    bool is_and = combiner == FILTER_OP_AND;
+    t_uindex nwords = (nrows + FILTER_WORD_BITS - 1) / FILTER_WORD_BITS;
+    std::vector<std::uint64_t> words(nwords);
+    const t_uindex chunk_words = 1024;
+    t_uindex nchunks = (nwords + chunk_words - 1) / chunk_words;
 
-                    const auto& ft = fterms[cidx];
-                    bool tval;
+    parallel_for(int(nchunks), [&](int cidx) {
+        t_uindex bidx = cidx * chunk_words;
+        t_uindex eidx = std::min(bidx + chunk_words, nwords);
 
-                    if (ft.m_use_interned) {
-                        cell_val.set(*(columns[cidx]->get_nth<t_uindex>(ridx)));
-                        cell_val.set_status(
-                            *(columns[cidx]->get_nth_status(ridx)));
-                    } else {
-                        cell_val = columns[cidx]->get_scalar(ridx);
-                    }
+        for (t_uindex widx = bidx; widx < eidx; ++widx) {
+            t_uindex nbits
+                = std::min(FILTER_WORD_BITS, nrows - widx * FILTER_WORD_BITS);
+            std::uint64_t all = nbits == FILTER_WORD_BITS
+                ? ~std::uint64_t(0)
+                : (std::uint64_t(1) << nbits) - 1;
+            std::uint64_t word = is_and ? all : 0;
 
-                    tval = ft(cell_val);
-                    if (!tval) {
-                        pass = false;
-                        break;
-                    }
+            for (const auto& kernel : kernels) {
+                if (word == (is_and ? 0 : all)) {
+                    break;
                 }
 
-                mask.set(ridx, pass);
-            }
-        } break;
-        case FILTER_OP_OR: {
-            for (t_uindex ridx = 0, rloop_end = size(); ridx < rloop_end;
-                 ++ridx) {
-                bool pass = false;
-                for (t_uindex cidx = 0; cidx < fterm_size; ++cidx) {
-                    t_tscalar cell_val = columns[cidx]->get_scalar(ridx);
-                    if (fterms[cidx](cell_val)) {
-                        pass = true;
-                        break;
-                    }
+                if (is_and) {
+                    word &= kernel->word(widx);
+                } else {
+                    word |= kernel->word(widx);
                 }
-                mask.set(ridx, pass);
             }
-        } break;
-        default: {
-            PSP_COMPLAIN_AND_ABORT("Unknown filter op");
-        } break;
-    }
 
-    return mask;
+            words[widx] = word;
+        }
+    });
+
+    return t_mask(words, nrows);
+}
+
+void
+t_data_table::set_bitmap_indexes(
+    std::shared_ptr<const t_bitmap_index_set> indexes) {
+    m_bitmap_indexes = indexes;
+}
+
+std::shared_ptr<const t_bitmap_index_set>
+t_data_table::get_bitmap_indexes() const {
+    return m_bitmap_indexes;
 }
 
 t_uindex
@@ -660,6 +667,9 @@ t_data_table::join(std::shared_ptr<t_data_table> other_table) const {
     rval->set_table_size(size());
     rval->set_capacity(std::max(get_capacity(), other_table->get_capacity()));
 
+    // Columns of the current table are shared, and so are their indexes.
+    rval->set_bitmap_indexes(m_bitmap_indexes);
+
     return rval;
 }
 
@@ -10,6 +10,7 @@
 #include <perspective/emscripten.h>
 #include <perspective/arrow_loader.h>
 #include <perspective/arrow_writer.h>
+#include <perspective/context_grouped_pkey.h>
 #include <arrow/csv/api.h>
 
 using namespace emscripten;
@@ -1587,6 +1588,10 @@ namespace binding {
                 config["split_by_depth"].as<std::int32_t>());
         }
 
+        if (has_value(config["top_n"])) {
+            view_config->set_top_n(config["top_n"].as<std::int32_t>());
+        }
+
         return view_config;
     }
 
@@ -1651,6 +1656,11 @@ namespace binding {
         auto cfg = t_config(columns, fterm, filter_op, expressions);
         auto ctx0 = std::make_shared<t_ctx0>(*(schema.get()), cfg);
         ctx0->init();
+
+        if (view_config->get_top_n() > -1) {
+            ctx0->set_top_n(view_config->get_top_n());
+        }
+
         ctx0->sort_by(sortspec);
 
         auto pool = table->get_pool();
@@ -1680,6 +1690,10 @@ namespace binding {
         ctx1->init();
         ctx1->sort_by(sortspec);
 
+        if (view_config->get_top_n() > -1) {
+            ctx1->set_top_n(view_config->get_top_n());
+        }
+
         auto pool = table->get_pool();
         auto gnode = table->get_gnode();
         pool->register_context(gnode->get_id(), name, ONE_SIDED_CONTEXT,
@@ -1838,6 +1852,77 @@ namespace binding {
         return arr;
     }
 
+    /******************************************************************************
+     *
+     * Grouped primary key contexts, which are not exposed through `View` and
+     * are only used by the internal tests.
+     */
+
+    /**
+     * @brief Register a `t_ctx_grouped_pkey` named `name` on `table`, with
+     * its rows nested by `child_pkey` and `parent_pkey` and every row
+     * expanded. `sort` is `undefined` or an `[aggregate index, descending]`
+     * pair, where aggregate index -1 sorts by `sort_column`.
+     */
+    std::shared_ptr<t_ctx_grouped_pkey>
+    make_grouped_pkey_context(std::shared_ptr<Table> table,
+        const std::string& name, t_val j_columns,
+        const std::string& child_pkey, const std::string& parent_pkey,
+        const std::string& sort_column, t_val sort) {
+        auto columns = vecFromArray<t_val, std::string>(j_columns);
+        t_config cfg(columns, child_pkey, parent_pkey, sort_column);
+        auto ctx = std::make_shared<t_ctx_grouped_pkey>(
+            table->get_schema(), cfg);
+        ctx->init();
+
+        if (!sort.isUndefined()) {
+            t_sorttype sort_type
+                = sort[1].as<bool>() ? SORTTYPE_DESCENDING : SORTTYPE_ASCENDING;
+            ctx->sort_by(std::vector<t_sortspec>{
+                t_sortspec(sort[0].as<std::int32_t>(), sort_type)});
+        }
+
+        auto pool = table->get_pool();
+        auto gnode = table->get_gnode();
+        pool->register_context(gnode->get_id(), name, GROUPED_PKEY_CONTEXT,
+            reinterpret_cast<std::uintptr_t>(ctx.get()));
+
+        // `t_ctx_grouped_pkey` has a single pivot, so expand row by row.
+        for (t_index ridx = 0; ridx < ctx->get_row_count(); ++ridx) {
+            ctx->open(ridx);
+        }
+
+        return ctx;
+    }
+
+    /**
+     * @brief The rows of a `t_ctx_grouped_pkey` below its root, in order, as
+     * `[depth, child pkey]` pairs.
+     */
+    t_val
+    get_grouped_pkey_rows(std::shared_ptr<t_ctx_grouped_pkey> ctx) {
+        t_val arr = t_val::array();
+        auto traversal = ctx->get_traversal();
+
+        for (t_index ridx = 1; ridx < ctx->get_row_count(); ++ridx) {
+            t_val row = t_val::array();
+            row.set(0, t_val(std::int32_t(traversal->get_depth(ridx))));
+            row.set(1,
+                scalar_to_val(
+                    ctx->get_tree_value(traversal->get_tree_index(ridx))));
+            arr.set(ridx - 1, row);
+        }
+
+        return arr;
+    }
+
+    void
+    delete_grouped_pkey_context(
+        std::shared_ptr<Table> table, const std::string& name) {
+        table->get_pool()->unregister_context(
+            table->get_gnode()->get_id(), name);
+    }
+
 } // end namespace binding
 } // end namespace perspective
 
@@ -2094,6 +2179,14 @@ EMSCRIPTEN_BINDINGS(perspective) {
     class_<t_ctx2>("t_ctx2").smart_ptr<std::shared_ptr<t_ctx2>>(
         "shared_ptr<t_ctx2>");
 
+    /******************************************************************************
+     *
+     * t_ctx_grouped_pkey
+     */
+    class_<t_ctx_grouped_pkey>("t_ctx_grouped_pkey")
+        .smart_ptr<std::shared_ptr<t_ctx_grouped_pkey>>(
+            "shared_ptr<t_ctx_grouped_pkey>");
+
     /******************************************************************************
      *
      * t_pool
@@ -2282,4 +2375,9 @@ EMSCRIPTEN_BINDINGS(perspective) {
     function("validate_expressions", &validate_expressions<t_val>);
     function("is_valid_datetime", &is_valid_datetime);
     function("init", &t_computed_expression_parser::init);
+    function("get_expression_compile_count",
+        &t_computed_expression_parser::get_compile_count);
+    function("make_grouped_pkey_context", &make_grouped_pkey_context);
+    function("get_grouped_pkey_rows", &get_grouped_pkey_rows);
+    function("delete_grouped_pkey_context", &delete_grouped_pkey_context);
 }
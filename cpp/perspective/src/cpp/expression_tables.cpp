@@ -8,137 +8,436 @@
  */
 
 #include <perspective/expression_tables.h>
+#include <sstream>
 
 namespace perspective {
 
+static std::shared_ptr<t_data_table>
+make_table(const t_schema& schema) {
+    auto table = std::make_shared<t_data_table>(
+        "", "", schema, DEFAULT_EMPTY_CAPACITY, BACKING_STORE_MEMORY);
+    table->init();
+    return table;
+}
+
+// A table of one column with `num_rows` rows.
+static std::shared_ptr<t_data_table>
+make_table(const std::string& name, t_dtype dtype, t_uindex num_rows) {
+    std::shared_ptr<t_data_table> table = make_table(t_schema({name}, {dtype}));
+    table->reserve(num_rows);
+    table->set_size(num_rows);
+    return table;
+}
+
+/******************************************************************************
+ *
+ * t_expression_cache
+ */
+
+t_expression_cache::t_expression_cache(std::shared_ptr<t_data_table> master,
+    t_expression_vocab& expression_vocab, t_regex_mapping& regex_mapping)
+    : m_master(master)
+    , m_expression_vocab(expression_vocab)
+    , m_regex_mapping(regex_mapping) {}
+
+t_expression_cache::t_expression_cache(std::shared_ptr<t_data_table> master,
+    std::shared_ptr<t_data_table> flattened,
+    std::shared_ptr<t_data_table> delta, std::shared_ptr<t_data_table> prev,
+    std::shared_ptr<t_data_table> current,
+    std::shared_ptr<t_data_table> existed,
+    t_expression_vocab& expression_vocab, t_regex_mapping& regex_mapping)
+    : m_master(master)
+    , m_flattened(flattened)
+    , m_delta(delta)
+    , m_prev(prev)
+    , m_current(current)
+    , m_existed(existed)
+    , m_expression_vocab(expression_vocab)
+    , m_regex_mapping(regex_mapping) {}
+
+std::string
+t_expression_cache::get_key(const t_computed_expression& expression) {
+    // Column ids are assigned in order of appearance, so two expressions
+    // that read the same columns the same way have the same parsed string
+    // and the same ids.
+    std::stringstream ss;
+    ss << expression.get_parsed_expression_string();
+
+    for (const auto& column_id : expression.get_column_ids()) {
+        ss << '\0' << column_id.first << '\0' << column_id.second;
+    }
+
+    return ss.str();
+}
+
+void
+t_expression_cache::compute(
+    const std::vector<std::shared_ptr<t_computed_expression>>& expressions) {
+    std::vector<t_expression_columns*> computed;
+
+    for (const auto& expr : expressions) {
+        std::string key = get_key(*expr);
+
+        if (m_columns.count(key) != 0) {
+            continue;
+        }
+
+        t_expression_columns& columns = m_columns[key];
+
+        // master: compute based on latest state of the gnode state table
+        columns.m_master = compute_column(*expr, m_master);
+
+        if (!has_transitional_tables()) {
+            continue;
+        }
+
+        // flattened: compute based on the latest update dataset
+        columns.m_flattened = compute_column(*expr, m_flattened);
+
+        // delta: for each numerical column, the numerical delta between the
+        // previous value and the current value in the row.
+        columns.m_delta = compute_column(*expr, m_delta);
+
+        // prev: the values of the updated rows before this update was applied
+        columns.m_prev = compute_column(*expr, m_prev);
+
+        // current: the current values of the updated rows
+        columns.m_current = compute_column(*expr, m_current);
+
+        const std::string& alias = expr->get_expression_alias();
+        columns.m_transitions
+            = make_table(alias, DTYPE_UINT8, m_flattened->size())
+                  ->get_column(alias);
+        computed.push_back(&columns);
+    }
+
+    if (computed.empty()) {
+        return;
+    }
+
+    // Calculate the transitions now that the intermediate columns are
+    // computed.
+    const t_column& existed_column
+        = *(m_existed->get_const_column("psp_existed"));
+
+    parallel_for(int(computed.size()), [&computed, &existed_column](int idx) {
+        const t_expression_columns& columns = *(computed[idx]);
+        t_expression_tables::calculate_transitions(existed_column,
+            *(columns.m_prev), *(columns.m_current), *(columns.m_transitions));
+    });
+}
+
+const t_expression_columns&
+t_expression_cache::get_columns(const t_computed_expression& expression) const {
+    auto iter = m_columns.find(get_key(expression));
+    PSP_VERBOSE_ASSERT(
+        iter != m_columns.end(), "Expression was not computed in this pass");
+    return iter->second;
+}
+
+bool
+t_expression_cache::has_transitional_tables() const {
+    return m_flattened != nullptr;
+}
+
+t_uindex
+t_expression_cache::get_master_size() const {
+    return m_master->size();
+}
+
+t_uindex
+t_expression_cache::get_transitional_size() const {
+    return m_flattened->size();
+}
+
+t_expression_vocab&
+t_expression_cache::get_expression_vocab() const {
+    return m_expression_vocab;
+}
+
+t_regex_mapping&
+t_expression_cache::get_regex_mapping() const {
+    return m_regex_mapping;
+}
+
+std::shared_ptr<t_column>
+t_expression_cache::compute_column(const t_computed_expression& expression,
+    std::shared_ptr<t_data_table> source) const {
+    const std::string& alias = expression.get_expression_alias();
+    std::shared_ptr<t_data_table> table
+        = make_table(alias, expression.get_dtype(), source->size());
+    expression.compute(source, table, m_expression_vocab, m_regex_mapping);
+    return table->get_column(alias);
+}
+
+/******************************************************************************
+ *
+ * t_expression_tables
+ */
+
 t_expression_tables::t_expression_tables(
     const std::vector<std::shared_ptr<t_computed_expression>>& expressions) {
-    t_schema schema;
-    t_schema transitions_schema;
+    for (const auto& expr : expressions) {
+        const std::string& alias = expr->get_expression_alias();
+        m_schema.add_column(alias, expr->get_dtype());
+        m_transitions_schema.add_column(alias, DTYPE_UINT8);
+    }
+
+    reset();
+}
+
+void
+t_expression_tables::compute(
+    const std::vector<std::shared_ptr<t_computed_expression>>& expressions,
+    t_expression_cache& cache) {
+    cache.compute(expressions);
+
+    if (!cache.has_transitional_tables()) {
+        clear_transitional_tables();
+    }
 
     for (const auto& expr : expressions) {
         const std::string& alias = expr->get_expression_alias();
-        schema.add_column(alias, expr->get_dtype());
-        transitions_schema.add_column(alias, DTYPE_UINT8);
+        const t_expression_columns& columns = cache.get_columns(*expr);
+        m_master->set_column(alias, columns.m_master);
+
+        if (cache.has_transitional_tables()) {
+            m_flattened->set_column(alias, columns.m_flattened);
+            m_prev->set_column(alias, columns.m_prev);
+            m_current->set_column(alias, columns.m_current);
+            m_delta->set_column(alias, columns.m_delta);
+            m_transitions->set_column(alias, columns.m_transitions);
+        }
     }
 
-    m_master = std::make_shared<t_data_table>(
-        "", "", schema, DEFAULT_EMPTY_CAPACITY, BACKING_STORE_MEMORY);
-    m_flattened = std::make_shared<t_data_table>(
-        "", "", schema, DEFAULT_EMPTY_CAPACITY, BACKING_STORE_MEMORY);
-    m_prev = std::make_shared<t_data_table>(
-        "", "", schema, DEFAULT_EMPTY_CAPACITY, BACKING_STORE_MEMORY);
-    m_current = std::make_shared<t_data_table>(
-        "", "", schema, DEFAULT_EMPTY_CAPACITY, BACKING_STORE_MEMORY);
-    m_delta = std::make_shared<t_data_table>(
-        "", "", schema, DEFAULT_EMPTY_CAPACITY, BACKING_STORE_MEMORY);
-    m_transitions = std::make_shared<t_data_table>("", "", transitions_schema,
-        DEFAULT_EMPTY_CAPACITY, BACKING_STORE_MEMORY);
+    t_uindex master_num_rows = cache.get_master_size();
+    m_master->set_capacity(master_num_rows);
+    m_master->set_table_size(master_num_rows);
+
+    if (cache.has_transitional_tables()) {
+        // All tables are the same size
+        t_uindex num_rows = cache.get_transitional_size();
 
-    m_master->init();
-    m_flattened->init();
-    m_prev->init();
-    m_current->init();
-    m_delta->init();
-    m_transitions->init();
+        for (auto table :
+            {m_flattened, m_prev, m_current, m_delta, m_transitions}) {
+            table->set_capacity(num_rows);
+            table->set_table_size(num_rows);
+        }
+    }
 }
 
 void
-t_expression_tables::calculate_transitions(
-    std::shared_ptr<t_data_table> existed) {
-    const t_schema& schema = m_transitions->get_schema();
-    const std::vector<std::string>& column_names = schema.m_columns;
-    const t_column& existed_column
-        = *(existed->get_const_column("psp_existed"));
-
-    auto num_cols = column_names.size();
-
-    parallel_for(
-        int(num_cols), [&column_names, &existed_column, this](int cidx) {
-            const std::string& cname = column_names[cidx];
-            const t_column& prev_column = *(m_prev->get_const_column(cname));
-            const t_column& current_column
-                = *(m_current->get_const_column(cname));
-            std::shared_ptr<t_column> transition_column
-                = m_transitions->get_column(cname);
-
-            for (t_uindex ridx = 0; ridx < transition_column->size(); ++ridx) {
-                bool row_existed = existed_column.get_nth<bool>(ridx);
-
-                t_tscalar prev_value = prev_column.get_scalar(ridx);
-                t_tscalar curr_value = current_column.get_scalar(ridx);
-
-                bool prev_valid = prev_column.is_valid(ridx);
-                bool curr_valid = current_column.is_valid(ridx);
-                bool prev_curr_eq
-                    = prev_valid && curr_valid && (prev_value == curr_value);
-
-                t_value_transition transition;
-
-                // Use a small subset of `t_value_transitions` that are
-                // relevant - I have not implemented the code paths in
-                // `calc_transitions` that are not referenced elsewhere, i.e.
-                // by a context or by a tree implementation.
-                if (row_existed) {
-                    if (prev_curr_eq) {
-                        // Row existed before, and the current value is
-                        // the same as the previous value.
-                        transition = VALUE_TRANSITION_EQ_TT;
-                    } else {
-                        if (!prev_valid && curr_valid) {
-                            // Previous value was a null, new value is valid.
-                            transition = VALUE_TRANSITION_NEQ_FT;
-                        } else {
-                            // Previous value was not null, new value is
-                            // not null, and previous value != new value
-                            transition = VALUE_TRANSITION_NEQ_TT;
-                        }
-                    }
-                } else {
-                    // Row did not exist before and was added
+t_expression_tables::calculate_transitions(const t_column& existed,
+    const t_column& prev, const t_column& current, t_column& transitions) {
+    for (t_uindex ridx = 0; ridx < transitions.size(); ++ridx) {
+        bool row_existed = existed.get_nth<bool>(ridx);
+
+        t_tscalar prev_value = prev.get_scalar(ridx);
+        t_tscalar curr_value = current.get_scalar(ridx);
+
+        bool prev_valid = prev.is_valid(ridx);
+        bool curr_valid = current.is_valid(ridx);
+        bool prev_curr_eq
+            = prev_valid && curr_valid && (prev_value == curr_value);
+
+        t_value_transition transition;
+
+        // Use a small subset of `t_value_transitions` that are
+        // relevant - I have not implemented the code paths in
+        // `calc_transitions` that are not referenced elsewhere, i.e.
+        // by a context or by a tree implementation.
+        if (row_existed) {
+            if (prev_curr_eq) {
+                // Row existed before, and the current value is
+                // the same as the previous value.
+                transition = VALUE_TRANSITION_EQ_TT;
+            } else {
+                if (!prev_valid && curr_valid) {
+                    // Previous value was a null, new value is valid.
                     transition = VALUE_TRANSITION_NEQ_FT;
+                } else {
+                    // Previous value was not null, new value is
+                    // not null, and previous value != new value
+                    transition = VALUE_TRANSITION_NEQ_TT;
                 }
-
-                transition_column->set_nth<std::uint8_t>(ridx, transition);
             }
-        });
+        } else {
+            // Row did not exist before and was added
+            transition = VALUE_TRANSITION_NEQ_FT;
+        }
+
+        transitions.set_nth<std::uint8_t>(ridx, transition);
+    }
 }
 
 void
-t_expression_tables::reserve_transitional_table_size(t_uindex size) {
-    m_flattened->reserve(size);
-    m_prev->reserve(size);
-    m_current->reserve(size);
-    m_delta->reserve(size);
-    m_transitions->reserve(size);
+t_expression_tables::clear_transitional_tables() {
+    m_flattened = make_table(m_schema);
+    m_prev = make_table(m_schema);
+    m_current = make_table(m_schema);
+    m_delta = make_table(m_schema);
+    m_transitions = make_table(m_transitions_schema);
 }
 
 void
-t_expression_tables::set_transitional_table_size(t_uindex size) {
-    m_flattened->set_size(size);
-    m_prev->set_size(size);
-    m_current->set_size(size);
-    m_delta->set_size(size);
-    m_transitions->set_size(size);
+t_expression_tables::reset() {
+    m_master = make_table(m_schema);
+    clear_transitional_tables();
+}
+
+/******************************************************************************
+ *
+ * t_lazy_expressions
+ */
+
+t_lazy_expressions::t_lazy_expressions(
+    const std::vector<std::shared_ptr<t_computed_expression>>& expressions) {
+    for (const auto& expr : expressions) {
+        const std::string& alias = expr->get_expression_alias();
+        t_lazy_expression_column& column = m_columns[alias];
+        column.m_expression = expr;
+        column.m_table = make_table(alias, expr->get_dtype(), 0);
+    }
+}
+
+bool
+t_lazy_expressions::has_column(const std::string& colname) const {
+    return m_columns.count(colname) != 0;
+}
+
+t_uindex
+t_lazy_expressions::size() const {
+    return m_columns.size();
 }
 
 void
-t_expression_tables::clear_transitional_tables() {
-    m_flattened->clear();
-    m_prev->clear();
-    m_current->clear();
-    m_delta->clear();
-    m_transitions->clear();
+t_lazy_expressions::materialize(const std::string& colname,
+    const t_data_table& master, const std::vector<t_uindex>& rows,
+    t_expression_vocab& vocab, t_regex_mapping& regex_mapping) {
+    auto iter = m_columns.find(colname);
+    PSP_VERBOSE_ASSERT(iter != m_columns.end(), "Not a lazy expression");
+    t_lazy_expression_column& column = iter->second;
+    t_uindex num_master_rows = master.size();
+
+    if (column.m_computed.size() < num_master_rows) {
+        column.m_computed.resize(num_master_rows, false);
+        column.m_table->reserve(num_master_rows);
+        column.m_table->set_size(num_master_rows);
+    }
+
+    // Marking rows as they are collected also skips repeated rows.
+    std::vector<t_uindex> missing;
+    for (auto ridx : rows) {
+        if (ridx >= num_master_rows || column.m_computed[ridx]) {
+            continue;
+        }
+
+        column.m_computed[ridx] = true;
+        missing.push_back(ridx);
+    }
+
+    if (missing.empty()) {
+        return;
+    }
+
+    // Gather the inputs of the missing rows into a table of their own, and
+    // compute the expression over just that.
+    const t_computed_expression& expression = *(column.m_expression);
+    t_uindex num_rows = missing.size();
+    std::vector<std::string> names;
+    std::vector<t_dtype> dtypes;
+
+    for (const auto& column_id : expression.get_column_ids()) {
+        const std::string& name = column_id.second;
+        names.push_back(name);
+        dtypes.push_back(master.get_const_column(name)->get_dtype());
+    }
+
+    std::shared_ptr<t_data_table> source = make_table(t_schema(names, dtypes));
+    source->reserve(num_rows);
+    source->set_size(num_rows);
+
+    for (const auto& name : names) {
+        std::shared_ptr<const t_column> from = master.get_const_column(name);
+        std::shared_ptr<t_column> to = source->get_column(name);
+
+        for (t_uindex idx = 0; idx < num_rows; ++idx) {
+            to->set_scalar(idx, from->get_scalar(missing[idx]));
+        }
+    }
+
+    std::shared_ptr<t_data_table> results
+        = make_table(colname, expression.get_dtype(), num_rows);
+    expression.compute(source, results, vocab, regex_mapping);
+
+    std::shared_ptr<const t_column> result = results->get_const_column(colname);
+    std::shared_ptr<t_column> output = column.m_table->get_column(colname);
+
+    for (t_uindex idx = 0; idx < num_rows; ++idx) {
+        output->set_scalar(missing[idx], result->get_scalar(idx));
+    }
+}
+
+std::shared_ptr<t_data_table>
+t_lazy_expressions::get_table(const std::string& colname) const {
+    auto iter = m_columns.find(colname);
+    PSP_VERBOSE_ASSERT(iter != m_columns.end(), "Not a lazy expression");
+    return iter->second.m_table;
 }
 
 void
-t_expression_tables::reset() {
-    m_master->reset();
-    m_flattened->reset();
-    m_prev->reset();
-    m_current->reset();
-    m_delta->reset();
-    m_transitions->reset();
+t_lazy_expressions::invalidate(const std::vector<t_uindex>& rows,
+    const t_data_table& transitions, const t_column& existed) {
+    for (auto& iter : m_columns) {
+        t_lazy_expression_column& column = iter.second;
+        std::vector<std::shared_ptr<const t_column>> inputs;
+
+        for (const auto& column_id : column.m_expression->get_column_ids()) {
+            inputs.push_back(transitions.get_const_column(column_id.second));
+        }
+
+        for (t_uindex idx = 0, loop_end = rows.size(); idx < loop_end; ++idx) {
+            t_uindex ridx = rows[idx];
+
+            // Deleted rows are not looked up, and rows with no result yet
+            // have nothing to drop.
+            if (ridx >= column.m_computed.size() || !column.m_computed[ridx]) {
+                continue;
+            }
+
+            // A row that did not exist may reuse the master table row of a
+            // deleted one, and its result along with it.
+            bool changed = !*(existed.get_nth<bool>(idx));
+
+            for (t_uindex cidx = 0; !changed && cidx < inputs.size(); ++cidx) {
+                std::uint8_t transition
+                    = *(inputs[cidx]->get_nth<std::uint8_t>(idx));
+                changed = transition != VALUE_TRANSITION_EQ_FF
+                    && transition != VALUE_TRANSITION_EQ_TT;
+            }
+
+            if (changed) {
+                column.m_computed[ridx] = false;
+            }
+        }
+    }
+}
+
+void
+t_lazy_expressions::invalidate_all() {
+    for (auto& iter : m_columns) {
+        iter.second.m_computed.clear();
+    }
+}
+
+std::shared_ptr<t_computed_expression>
+t_lazy_expressions::remove(const std::string& colname) {
+    auto iter = m_columns.find(colname);
+    PSP_VERBOSE_ASSERT(iter != m_columns.end(), "Not a lazy expression");
+    std::shared_ptr<t_computed_expression> expression
+        = iter->second.m_expression;
+    m_columns.erase(iter);
+    return expression;
 }
 
 } // end namespace perspective
@@ -12,7 +12,8 @@
 namespace perspective {
 
 t_expression_vocab::t_expression_vocab()
-    : m_empty_string("") {
+    : m_generation(0)
+    , m_empty_string("") {
     // Allocate 4096 bytes per page
     m_max_vocab_size = 64 * 64;
 
@@ -23,6 +24,7 @@ t_expression_vocab::t_expression_vocab()
 const char*
 t_expression_vocab::intern(const char* str) {
     std::size_t bytelength = strlen(str);
+    std::lock_guard<std::mutex> guard(m_mutex);
 
     if (m_current_vocab_size + bytelength + 1 > m_max_vocab_size) {
         allocate_new_vocab();
@@ -41,8 +43,15 @@ t_expression_vocab::intern(const std::string& str) {
 
 void
 t_expression_vocab::clear() {
+    std::lock_guard<std::mutex> guard(m_mutex);
     m_vocabs.clear();
     allocate_new_vocab();
+    ++m_generation;
+}
+
+t_uindex
+t_expression_vocab::get_generation() const {
+    return m_generation;
 }
 
 const char*
@@ -72,7 +72,9 @@ extract_aggregate(const t_aggspec& aggspec, const t_column* aggcol,
         case AGGTYPE_DISTINCT_COUNT:
         case AGGTYPE_DISTINCT_LEAF:
         case AGGTYPE_VARIANCE:
-        case AGGTYPE_STANDARD_DEVIATION: {
+        case AGGTYPE_STANDARD_DEVIATION:
+        case AGGTYPE_APPROX_DISTINCT:
+        case AGGTYPE_APPROX_PERCENTILE: {
             t_tscalar rval = aggcol->get_scalar(ridx);
             return rval;
         } break;
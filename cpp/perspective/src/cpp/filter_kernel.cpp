@@ -0,0 +1,408 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2017, the Perspective Authors.
+ *
+ * This file is part of the Perspective library, distributed under the terms of
+ * the Apache License 2.0.  The full license can be found in the LICENSE file.
+ *
+ */
+
+#include <perspective/first.h>
+#include <perspective/filter_kernel.h>
+
+namespace perspective {
+
+t_filter_kernel::t_filter_kernel(t_uindex nrows)
+    : m_nrows(nrows) {}
+
+t_filter_kernel::~t_filter_kernel() {}
+
+t_uindex
+t_filter_kernel::word_rows(t_uindex widx) const {
+    t_uindex bidx = widx * FILTER_WORD_BITS;
+    return std::min(FILTER_WORD_BITS, m_nrows - bidx);
+}
+
+std::uint64_t
+t_filter_kernel::word_mask(t_uindex widx) const {
+    t_uindex nbits = word_rows(widx);
+    return nbits == FILTER_WORD_BITS ? ~std::uint64_t(0)
+                                     : (std::uint64_t(1) << nbits) - 1;
+}
+
+/**
+ * @brief IS_NULL and IS_NOT_NULL only read the status of each row.
+ */
+class t_filter_null_kernel : public t_filter_kernel {
+public:
+    t_filter_null_kernel(const t_column* column, t_uindex nrows, bool is_null)
+        : t_filter_kernel(nrows)
+        , m_status(
+              column->is_status_enabled() ? column->get_nth_status(0) : nullptr)
+        , m_is_null(is_null) {}
+
+    std::uint64_t
+    word(t_uindex widx) const override {
+        t_uindex nbits = word_rows(widx);
+        std::uint64_t valid = ~std::uint64_t(0);
+
+        if (m_status != nullptr) {
+            const t_status* status = m_status + widx * FILTER_WORD_BITS;
+            valid = 0;
+
+            for (t_uindex bit = 0; bit < nbits; ++bit) {
+                valid |= std::uint64_t(status[bit] == STATUS_VALID) << bit;
+            }
+        }
+
+        return (m_is_null ? ~valid : valid) & word_mask(widx);
+    }
+
+private:
+    const t_status* m_status;
+    bool m_is_null;
+};
+
+/**
+ * @brief Evaluates `t_fterm` on the scalar of each row.
+ */
+class t_filter_scalar_kernel : public t_filter_kernel {
+public:
+    t_filter_scalar_kernel(
+        const t_column* column, const t_fterm& fterm, t_uindex nrows)
+        : t_filter_kernel(nrows)
+        , m_column(column)
+        , m_fterm(fterm) {}
+
+    std::uint64_t
+    word(t_uindex widx) const override {
+        t_uindex bidx = widx * FILTER_WORD_BITS;
+        t_uindex nbits = word_rows(widx);
+        std::uint64_t bits = 0;
+
+        for (t_uindex bit = 0; bit < nbits; ++bit) {
+            bits |= std::uint64_t(m_fterm(m_column->get_scalar(bidx + bit)))
+                << bit;
+        }
+
+        return bits;
+    }
+
+private:
+    const t_column* m_column;
+    t_fterm m_fterm;
+};
+
+/**
+ * @brief Reads precomputed words, inverted for NE, NOT_IN and negation.
+ */
+class t_filter_words_kernel : public t_filter_kernel {
+public:
+    t_filter_words_kernel(
+        std::vector<std::uint64_t>& words, t_uindex nrows, bool invert)
+        : t_filter_kernel(nrows)
+        , m_invert(invert ? ~std::uint64_t(0) : 0) {
+        m_words.swap(words);
+    }
+
+    std::uint64_t
+    word(t_uindex widx) const override {
+        std::uint64_t bits = widx < m_words.size() ? m_words[widx] : 0;
+        return (bits ^ m_invert) & word_mask(widx);
+    }
+
+private:
+    std::vector<std::uint64_t> m_words;
+    std::uint64_t m_invert;
+};
+
+/**
+ * @brief Read the value of `scalar` as the raw column type `DATA_T`.
+ *
+ * Every member of the scalar union starts at its first byte, so this is
+ * the value the scalar itself compares.
+ */
+template <typename DATA_T>
+static inline DATA_T
+get_raw_value(const t_tscalar& scalar) {
+    DATA_T rval;
+    std::memcpy(&rval, &scalar.m_data, sizeof(DATA_T));
+    return rval;
+}
+
+/**
+ * @brief Whether `fterm` on a column of `dtype` can be evaluated on raw
+ * values: the threshold (or every bag member of the column's type) must
+ * be a valid scalar of that type.
+ */
+static inline bool
+is_typed_term(const t_fterm& fterm, t_dtype dtype) {
+    switch (fterm.m_op) {
+        case FILTER_OP_LT:
+        case FILTER_OP_LTEQ:
+        case FILTER_OP_GT:
+        case FILTER_OP_GTEQ:
+        case FILTER_OP_EQ:
+        case FILTER_OP_NE: {
+            return fterm.m_threshold.m_type == dtype
+                && fterm.m_threshold.m_status == STATUS_VALID;
+        } break;
+        case FILTER_OP_IN:
+        case FILTER_OP_NOT_IN: {
+            for (const t_tscalar& member : fterm.m_bag) {
+                if (member.m_type == dtype && member.m_status != STATUS_VALID) {
+                    return false;
+                }
+            }
+            return true;
+        } break;
+        default: {
+            return false;
+        } break;
+    }
+}
+
+// Result of the term, before negation, for a row that is not valid.
+static inline bool
+get_null_result(const t_fterm& fterm) {
+    return fterm.m_op == FILTER_OP_NE;
+}
+
+template <typename DATA_T, typename PRED_T>
+static inline std::shared_ptr<t_filter_kernel>
+make_value_kernel(const t_column* column, const t_fterm& fterm,
+    t_uindex nrows, const PRED_T& pred) {
+    return std::make_shared<t_filter_value_kernel<DATA_T, PRED_T>>(
+        column, nrows, pred, get_null_result(fterm), fterm.m_negated);
+}
+
+template <typename DATA_T>
+static inline std::shared_ptr<t_filter_kernel>
+make_typed_kernel(
+    const t_column* column, const t_fterm& fterm, t_uindex nrows) {
+    t_dtype dtype = column->get_dtype();
+    DATA_T threshold = get_raw_value<DATA_T>(fterm.m_threshold);
+
+    switch (fterm.m_op) {
+        case FILTER_OP_LT: {
+            t_filter_pred_lt<DATA_T> pred{threshold};
+            return make_value_kernel<DATA_T>(column, fterm, nrows, pred);
+        } break;
+        case FILTER_OP_LTEQ: {
+            t_filter_pred_lteq<DATA_T> pred{threshold};
+            return make_value_kernel<DATA_T>(column, fterm, nrows, pred);
+        } break;
+        case FILTER_OP_GT: {
+            t_filter_pred_gt<DATA_T> pred{threshold};
+            return make_value_kernel<DATA_T>(column, fterm, nrows, pred);
+        } break;
+        case FILTER_OP_GTEQ: {
+            t_filter_pred_gteq<DATA_T> pred{threshold};
+            return make_value_kernel<DATA_T>(column, fterm, nrows, pred);
+        } break;
+        case FILTER_OP_EQ: {
+            t_filter_pred_eq<DATA_T> pred{threshold};
+            return make_value_kernel<DATA_T>(column, fterm, nrows, pred);
+        } break;
+        case FILTER_OP_NE: {
+            t_filter_pred_ne<DATA_T> pred{threshold};
+            return make_value_kernel<DATA_T>(column, fterm, nrows, pred);
+        } break;
+        case FILTER_OP_IN:
+        case FILTER_OP_NOT_IN: {
+            t_filter_pred_in<DATA_T> pred;
+            for (const t_tscalar& member : fterm.m_bag) {
+                if (member.m_type == dtype) {
+                    pred.m_values.push_back(get_raw_value<DATA_T>(member));
+                }
+            }
+
+            if (fterm.m_op == FILTER_OP_IN) {
+                return make_value_kernel<DATA_T>(column, fterm, nrows, pred);
+            }
+
+            // NOT_IN is IN inverted, so rows that are not valid pass.
+            return std::make_shared<
+                t_filter_value_kernel<DATA_T, t_filter_pred_in<DATA_T>>>(
+                column, nrows, pred, false, !fterm.m_negated);
+        } break;
+        default: {
+            PSP_COMPLAIN_AND_ABORT("Unexpected filter op");
+        } break;
+    }
+
+    return std::shared_ptr<t_filter_kernel>();
+}
+
+/**
+ * @brief String terms compare interned ids: the term is evaluated once per
+ * vocabulary entry into a table, then every row is a table lookup.
+ */
+static inline std::shared_ptr<t_filter_kernel>
+make_string_kernel(
+    const t_column* column, const t_fterm& fterm, t_uindex nrows) {
+    const t_vocab* vocab = const_cast<t_column*>(column)->_get_vocab();
+    t_uindex nvocab = vocab->get_vlenidx();
+    t_filter_pred_table pred;
+    pred.m_table.resize(nvocab);
+
+    switch (fterm.m_op) {
+        case FILTER_OP_EQ:
+        case FILTER_OP_NE: {
+            t_uindex interned;
+            if (vocab->string_exists(
+                    fterm.m_threshold.get_char_ptr(), interned)) {
+                pred.m_table[interned] = 1;
+            }
+        } break;
+        case FILTER_OP_IN:
+        case FILTER_OP_NOT_IN: {
+            for (const t_tscalar& member : fterm.m_bag) {
+                t_uindex interned;
+                if (member.m_type == DTYPE_STR
+                    && vocab->string_exists(member.get_char_ptr(), interned)) {
+                    pred.m_table[interned] = 1;
+                }
+            }
+        } break;
+        default: {
+            t_tscalar value;
+            value.clear();
+
+            for (t_uindex idx = 0; idx < nvocab; ++idx) {
+                value.set(vocab->unintern_c(idx));
+                pred.m_table[idx] = value.cmp(fterm.m_op, fterm.m_threshold);
+            }
+        } break;
+    }
+
+    // NE and NOT_IN are EQ and IN inverted, so rows that are not valid pass.
+    bool inverse
+        = fterm.m_op == FILTER_OP_NE || fterm.m_op == FILTER_OP_NOT_IN;
+
+    return std::make_shared<
+        t_filter_value_kernel<t_uindex, t_filter_pred_table>>(
+        column, nrows, pred, false, inverse != fterm.m_negated);
+}
+
+std::shared_ptr<t_filter_kernel>
+make_index_filter_kernel(const t_column* column, const t_bitmap_index& index,
+    const std::vector<std::uint64_t>* live, const t_fterm& fterm,
+    t_uindex nrows) {
+    t_dtype dtype = column->get_dtype();
+
+    if (fterm.m_op != FILTER_OP_EQ && fterm.m_op != FILTER_OP_NE
+        && fterm.m_op != FILTER_OP_IN && fterm.m_op != FILTER_OP_NOT_IN) {
+        return std::shared_ptr<t_filter_kernel>();
+    }
+
+    if (index.get_dtype() != dtype || !is_typed_term(fterm, dtype)) {
+        return std::shared_ptr<t_filter_kernel>();
+    }
+
+    std::vector<t_tscalar> values;
+    if (fterm.m_op == FILTER_OP_EQ || fterm.m_op == FILTER_OP_NE) {
+        values.push_back(fterm.m_threshold);
+    } else {
+        values = fterm.m_bag;
+    }
+
+    // Keys are the raw column bits, as `t_bitmap_index` stores them.
+    const t_vocab* vocab = dtype == DTYPE_STR
+        ? const_cast<t_column*>(column)->_get_vocab()
+        : nullptr;
+    t_uindex nbytes = get_dtype_size(dtype);
+    std::vector<std::uint64_t> keys;
+
+    for (const t_tscalar& value : values) {
+        if (value.m_type != dtype) {
+            continue;
+        }
+
+        if (vocab != nullptr) {
+            t_uindex interned;
+            if (vocab->string_exists(value.get_char_ptr(), interned)) {
+                keys.push_back(interned);
+            }
+        } else {
+            keys.push_back(t_bitmap_index::get_key(&value.m_data, nbytes));
+        }
+    }
+
+    std::vector<std::uint64_t> words;
+    index.select(keys, live, words);
+
+    // Rows that are not valid are in no bitmap, so inverting EQ and IN
+    // passes them for NE and NOT_IN as `t_fterm` does.
+    bool inverse = fterm.m_op == FILTER_OP_NE || fterm.m_op == FILTER_OP_NOT_IN;
+
+    return std::make_shared<t_filter_words_kernel>(
+        words, nrows, inverse != fterm.m_negated);
+}
+
+std::shared_ptr<t_filter_kernel>
+make_filter_kernel(
+    const t_column* column, const t_fterm& fterm, t_uindex nrows) {
+    if (fterm.m_op == FILTER_OP_IS_NULL
+        || fterm.m_op == FILTER_OP_IS_NOT_NULL) {
+        bool is_null = (fterm.m_op == FILTER_OP_IS_NULL) != fterm.m_negated;
+        return std::make_shared<t_filter_null_kernel>(column, nrows, is_null);
+    }
+
+    t_dtype dtype = column->get_dtype();
+
+    if (!is_typed_term(fterm, dtype)) {
+        return std::make_shared<t_filter_scalar_kernel>(column, fterm, nrows);
+    }
+
+    switch (dtype) {
+        case DTYPE_INT64: {
+            return make_typed_kernel<std::int64_t>(column, fterm, nrows);
+        } break;
+        case DTYPE_INT32: {
+            return make_typed_kernel<std::int32_t>(column, fterm, nrows);
+        } break;
+        case DTYPE_INT16: {
+            return make_typed_kernel<std::int16_t>(column, fterm, nrows);
+        } break;
+        case DTYPE_INT8: {
+            return make_typed_kernel<std::int8_t>(column, fterm, nrows);
+        } break;
+        case DTYPE_UINT64: {
+            return make_typed_kernel<std::uint64_t>(column, fterm, nrows);
+        } break;
+        case DTYPE_UINT32: {
+            return make_typed_kernel<std::uint32_t>(column, fterm, nrows);
+        } break;
+        case DTYPE_UINT16: {
+            return make_typed_kernel<std::uint16_t>(column, fterm, nrows);
+        } break;
+        case DTYPE_UINT8: {
+            return make_typed_kernel<std::uint8_t>(column, fterm, nrows);
+        } break;
+        case DTYPE_FLOAT64: {
+            return make_typed_kernel<double>(column, fterm, nrows);
+        } break;
+        case DTYPE_FLOAT32: {
+            return make_typed_kernel<float>(column, fterm, nrows);
+        } break;
+        case DTYPE_BOOL: {
+            return make_typed_kernel<bool>(column, fterm, nrows);
+        } break;
+        case DTYPE_DATE: {
+            return make_typed_kernel<t_date::t_rawtype>(column, fterm, nrows);
+        } break;
+        case DTYPE_TIME: {
+            return make_typed_kernel<t_time::t_rawtype>(column, fterm, nrows);
+        } break;
+        case DTYPE_STR: {
+            return make_string_kernel(column, fterm, nrows);
+        } break;
+        default: {
+            return std::make_shared<t_filter_scalar_kernel>(
+                column, fterm, nrows);
+        } break;
+    }
+}
+
+} // end namespace perspective
@@ -11,20 +11,26 @@
 #include <perspective/base.h>
 #include <perspective/config.h>
 #include <perspective/flat_traversal.h>
+#include <perspective/parallel_sort.h>
 #include <perspective/scalar.h>
 #include <perspective/schema.h>
 
 namespace perspective {
 
+const t_index t_ftrav::TOP_N_POOL_FACTOR;
+
 t_ftrav::t_ftrav()
-    : m_step_deletes(0)
-    , m_step_inserts(0) {
-    m_index = std::make_shared<std::vector<t_mselem>>();
-}
+    : m_lazy(false)
+    , m_top_n(-1) {}
 
 void
 t_ftrav::init() {
-    m_index = std::make_shared<std::vector<t_mselem>>();
+    m_index.clear();
+    m_pkeyidx.clear();
+    m_members.clear();
+    m_lazy = false;
+    m_lazy_elems.clear();
+    m_lazy_segments.clear();
 }
 
 std::vector<t_tscalar>
@@ -34,9 +40,8 @@ t_ftrav::get_all_pkeys(
     // cells
     std::vector<t_tscalar> rval;
     rval.reserve(cells.size());
-    std::vector<t_mselem>* index = m_index.get();
     for (auto iter = cells.begin(); iter != cells.end(); ++iter) {
-        rval.push_back((*index)[iter->first].m_pkey);
+        rval.push_back(get_pkey(iter->first));
     }
     return rval;
 }
@@ -56,7 +61,7 @@ t_ftrav::get_pkeys(
     std::set<t_index>::iterator it;
     t_index count = 0;
     for (it = all_rows.begin(); it != all_rows.end(); ++it) {
-        rval[count] = (*m_index)[*it].m_pkey;
+        rval[count] = get_pkey(*it);
         ++count;
     }
     return rval;
@@ -64,12 +69,31 @@ t_ftrav::get_pkeys(
 
 std::vector<t_tscalar>
 t_ftrav::get_pkeys(t_index begin_row, t_index end_row) const {
-    t_index index_size = m_index->size();
+    t_index index_size = size();
     end_row = std::min(end_row, index_size);
-    std::vector<t_tscalar> rval(end_row - begin_row);
+    std::vector<t_tscalar> rval;
+
+    if (begin_row >= end_row) {
+        return rval;
+    }
+
+    rval.reserve(end_row - begin_row);
+
+    if (m_lazy) {
+        sort_window(begin_row, end_row);
+        for (t_index ridx = begin_row; ridx < end_row; ++ridx) {
+            rval.push_back(m_lazy_elems[ridx].m_pkey);
+        }
+        return rval;
+    }
+
+    t_uindex nidx = m_index.at(begin_row);
+
     for (t_index ridx = begin_row; ridx < end_row; ++ridx) {
-        rval[ridx - begin_row] = (*m_index)[ridx].m_pkey;
+        rval.push_back(m_index.get(nidx).m_pkey);
+        nidx = m_index.next(nidx);
     }
+
     return rval;
 }
 
@@ -78,28 +102,41 @@ t_ftrav::get_pkeys(const std::vector<t_uindex>& rows) const {
     std::vector<t_tscalar> rval;
     rval.reserve(rows.size());
     for (auto it = rows.begin(); it != rows.end(); ++it) {
-        t_uindex ridx = *it;
-        rval.push_back((*m_index)[ridx].m_pkey);
+        rval.push_back(get_pkey(*it));
     }
     return rval;
 }
 
 std::vector<t_tscalar>
 t_ftrav::get_pkeys() const {
+    materialize();
     return get_pkeys(0, size());
 }
 
 t_tscalar
 t_ftrav::get_pkey(t_index idx) const {
-    return (*m_index)[idx].m_pkey;
+    if (m_lazy) {
+        sort_window(idx, idx + 1);
+        return m_lazy_elems[idx].m_pkey;
+    }
+
+    return m_index.get(m_index.at(idx)).m_pkey;
 }
 
 void
 t_ftrav::fill_sort_elem(const t_gstate& gstate,
     const t_data_table& expression_master_table, const t_config& config,
     t_tscalar pkey, t_mselem& out_elem) {
-    t_index sortby_size = m_sortby.size();
-    out_elem.m_row.reserve(sortby_size);
+    fill_sort_row(gstate, expression_master_table, config, pkey, out_elem);
+    intern_sort_row(out_elem);
+}
+
+void
+t_ftrav::fill_sort_row(const t_gstate& gstate,
+    const t_data_table& expression_master_table, const t_config& config,
+    t_tscalar pkey, t_mselem& out_elem) const {
+    std::vector<t_tscalar> row;
+    row.reserve(m_sortby.size());
     out_elem.m_pkey = pkey;
 
     for (const t_sortspec& sort : m_sortby) {
@@ -114,17 +151,31 @@ t_ftrav::fill_sort_elem(const t_gstate& gstate,
 
         const std::string& sortby_colname = config.get_sort_by(colname);
 
-        out_elem.m_row.push_back(
-            m_symtable.get_interned_tscalar(get_from_gstate(
-                gstate, expression_master_table, sortby_colname, pkey)));
+        row.push_back(get_from_gstate(
+            gstate, expression_master_table, sortby_colname, pkey));
+    }
+
+    out_elem.set_row(row, m_sort_orders);
+}
+
+void
+t_ftrav::intern_sort_row(t_mselem& elem) {
+    // Only rows the sort key could not fully encode are kept, and they
+    // must outlive the column vocabularies their strings point into.
+    if (!elem.m_row) {
+        return;
+    }
+
+    for (t_tscalar& value : *(elem.m_row)) {
+        value = m_symtable.get_interned_tscalar(value);
     }
 }
 
 void
 t_ftrav::fill_sort_elem(const t_gstate& gstate, const t_config& config,
     const std::vector<t_tscalar>& row, t_mselem& out_elem) const {
-    t_index sortby_size = m_sortby.size();
-    out_elem.m_row.reserve(sortby_size);
+    std::vector<t_tscalar> sort_row;
+    sort_row.reserve(m_sortby.size());
     out_elem.m_pkey = mknone();
 
     for (const t_sortspec& sort : m_sortby) {
@@ -138,9 +189,11 @@ t_ftrav::fill_sort_elem(const t_gstate& gstate, const t_config& config,
 
         const std::string& sortby_colname = config.get_sort_by(colname);
 
-        out_elem.m_row.push_back(
+        sort_row.push_back(
             get_interned_tscalar(row.at(config.get_colidx(sortby_colname))));
     }
+
+    out_elem.set_row(sort_row, m_sort_orders);
 }
 
 void
@@ -149,37 +202,133 @@ t_ftrav::sort_by(const t_gstate& gstate,
     const std::vector<t_sortspec>& sortby) {
     if (sortby.empty())
         return;
-    t_multisorter sorter(get_sort_orders(sortby));
-    t_index size = m_index->size();
-    auto sort_elems
-        = std::make_shared<std::vector<t_mselem>>(static_cast<size_t>(size));
     m_sortby = sortby;
+    m_sort_orders = get_sort_orders(sortby);
+    m_index.set_sort_orders(m_sort_orders);
+
+    if (m_lazy) {
+        // Re-sorting does not need the previous order.
+        std::vector<t_tscalar> pkeys;
+        pkeys.reserve(m_lazy_elems.size());
+        for (const t_mselem& elem : m_lazy_elems) {
+            pkeys.push_back(elem.m_pkey);
+        }
+
+        rebuild(gstate, expression_master_table, config, pkeys);
+    } else if (m_top_n < 0) {
+        rebuild(gstate, expression_master_table, config, get_pkeys());
+    } else {
+        rebuild(gstate, expression_master_table, config,
+            std::vector<t_tscalar>(m_members.begin(), m_members.end()));
+    }
+}
+
+void
+t_ftrav::rebuild(const t_gstate& gstate,
+    const t_data_table& expression_master_table, const t_config& config,
+    const std::vector<t_tscalar>& pkeys) {
+    t_multisorter sorter(m_sort_orders);
+    t_index size = pkeys.size();
+    std::vector<t_mselem> sort_elems(static_cast<size_t>(size));
+
+    // Reading rows from the gnode state is thread-safe; interning into
+    // `m_symtable` is not, so it runs afterwards on the rows that kept
+    // their scalars.
+    t_index nchunks = (size + PARALLEL_SORT_CHUNK - 1) / PARALLEL_SORT_CHUNK;
+
+    parallel_for(int(nchunks), [&](int cidx) {
+        t_index bidx = cidx * PARALLEL_SORT_CHUNK;
+        t_index eidx = std::min(bidx + t_index(PARALLEL_SORT_CHUNK), size);
+
+        for (t_index idx = bidx; idx < eidx; ++idx) {
+            fill_sort_row(gstate, expression_master_table, config,
+                pkeys[idx], sort_elems[idx]);
+        }
+    });
+
+    // Top-N views only keep a pool of the best `get_pool_size()` rows.
+    t_index pool_size = get_pool_size();
+    if (pool_size < size) {
+        std::nth_element(sort_elems.begin(), sort_elems.begin() + pool_size,
+            sort_elems.end(), sorter);
+        sort_elems.resize(pool_size);
+    }
 
-    for (t_index idx = 0; idx < size; ++idx) {
-        t_mselem& elem = (*sort_elems)[idx];
-        t_tscalar pkey = (*m_index)[idx].m_pkey;
-        fill_sort_elem(gstate, expression_master_table, config, pkey, elem);
+    for (t_mselem& elem : sort_elems) {
+        intern_sort_row(elem);
     }
 
-    std::swap(m_index, sort_elems);
-    std::sort(m_index->begin(), m_index->end(), sorter);
+    m_lazy_elems.clear();
+    m_lazy_segments.clear();
+
+    // Large views are only sorted as far as they are read; the first
+    // window costs a linear selection instead of a full sort.
+    m_lazy = m_top_n < 0 && t_uindex(sort_elems.size()) > PARALLEL_SORT_CHUNK;
+
+    if (m_lazy) {
+        m_index.clear();
+        m_pkeyidx.clear();
+        m_lazy_elems.swap(sort_elems);
+        m_lazy_segments[0] = false;
+        return;
+    }
+
+    parallel_sort(sort_elems, sorter);
+    m_index.build(sort_elems);
+
+    // `build` assigns node ids in row order.
     m_pkeyidx.clear();
-    for (t_index idx = 0, loop_end = m_index->size(); idx < loop_end; ++idx) {
-        m_pkeyidx[(*m_index)[idx].m_pkey] = idx;
+    for (t_index idx = 0, loop_end = m_index.size(); idx < loop_end; ++idx) {
+        m_pkeyidx[m_index.get(idx).m_pkey] = idx;
     }
 }
 
 t_index
 t_ftrav::size() const {
-    return m_index->size();
+    if (m_lazy) {
+        return m_lazy_elems.size();
+    }
+
+    t_index size = m_index.size();
+    return m_top_n < 0 ? size : std::min<t_index>(size, m_top_n);
+}
+
+void
+t_ftrav::set_top_n(t_index top_n) {
+    materialize();
+    m_top_n = top_n;
+    m_members.clear();
+
+    if (m_top_n >= 0) {
+        for (const auto& pkidx : m_pkeyidx) {
+            m_members.insert(pkidx.first);
+        }
+    }
+}
+
+t_index
+t_ftrav::get_top_n() const {
+    return m_top_n;
+}
+
+t_index
+t_ftrav::get_pool_size() const {
+    return m_top_n < 0 ? std::numeric_limits<t_index>::max()
+                       : m_top_n * TOP_N_POOL_FACTOR;
 }
 
 void
 t_ftrav::get_row_indices(const tsl::hopscotch_set<t_tscalar>& pkeys,
     tsl::hopscotch_map<t_tscalar, t_index>& out_map) const {
-    for (t_index idx = 0, loop_end = size(); idx < loop_end; ++idx) {
-        const t_tscalar& pkey = (*m_index)[idx].m_pkey;
-        if (pkeys.find(pkey) != pkeys.end()) {
+    materialize();
+    for (const t_tscalar& pkey : pkeys) {
+        auto pkiter = m_pkeyidx.find(pkey);
+        if (pkiter == m_pkeyidx.end()) {
+            continue;
+        }
+
+        t_index idx = m_index.rank(pkiter->second);
+        if (idx < size()) {
             out_map[pkey] = idx;
         }
     }
@@ -189,9 +338,15 @@ void
 t_ftrav::get_row_indices(t_index bidx, t_index eidx,
     const tsl::hopscotch_set<t_tscalar>& pkeys,
     tsl::hopscotch_map<t_tscalar, t_index>& out_map) const {
-    for (t_index idx = bidx; idx < eidx; ++idx) {
-        const t_tscalar& pkey = (*m_index)[idx].m_pkey;
-        if (pkeys.find(pkey) != pkeys.end()) {
+    materialize();
+    for (const t_tscalar& pkey : pkeys) {
+        auto pkiter = m_pkeyidx.find(pkey);
+        if (pkiter == m_pkeyidx.end()) {
+            continue;
+        }
+
+        t_index idx = m_index.rank(pkiter->second);
+        if (bidx <= idx && idx < eidx && idx < size()) {
             out_map[pkey] = idx;
         }
     }
@@ -205,33 +360,45 @@ t_ftrav::get_row_indices(t_index bidx, t_index eidx,
  */
 std::vector<t_uindex>
 t_ftrav::get_row_indices(const tsl::hopscotch_set<t_tscalar>& pkeys) const {
+    materialize();
     std::vector<t_uindex> rows;
-    for (t_uindex idx = 0, loop_end = size(); idx < loop_end; ++idx) {
-        const t_tscalar& pkey = (*m_index)[idx].m_pkey;
-        if (pkeys.find(pkey) != pkeys.end()) {
+    rows.reserve(pkeys.size());
+    t_uindex nrows = size();
+    for (const t_tscalar& pkey : pkeys) {
+        auto pkiter = m_pkeyidx.find(pkey);
+        if (pkiter == m_pkeyidx.end()) {
+            continue;
+        }
+
+        t_uindex idx = m_index.rank(pkiter->second);
+        if (idx < nrows) {
             rows.push_back(idx);
         }
     }
+    std::sort(rows.begin(), rows.end());
     return rows;
 }
 
 void
 t_ftrav::reset() {
-    if (m_index.get())
-        m_index->clear();
+    m_index.clear();
+    m_pkeyidx.clear();
+    m_members.clear();
+    m_lazy = false;
+    m_lazy_elems.clear();
+    m_lazy_segments.clear();
 }
 
 void
 t_ftrav::check_size() {
     tsl::hopscotch_set<t_tscalar> pkey_set;
-    for (t_index idx = 0, loop_end = m_index->size(); idx < loop_end; ++idx) {
-        if (pkey_set.find((*m_index)[idx].m_pkey) != pkey_set.end()) {
-            std::cout << "Duplicate entry for " << (*m_index)[idx].m_pkey
-                      << std::endl;
+    for (const t_tscalar& pkey : get_pkeys()) {
+        if (pkey_set.find(pkey) != pkey_set.end()) {
+            std::cout << "Duplicate entry for " << pkey << std::endl;
             PSP_COMPLAIN_AND_ABORT("Exiting");
         }
 
-        pkey_set.insert((*m_index)[idx].m_pkey);
+        pkey_set.insert(pkey);
     }
 }
 
@@ -249,87 +416,37 @@ t_ftrav::validate_cells(
 }
 
 void
-t_ftrav::step_begin() {
-    m_step_deletes = 0;
-    m_step_inserts = 0;
-    m_new_elems.clear();
-}
+t_ftrav::step_begin() {}
 
 void
-t_ftrav::step_end() {
-    // The new number of rows in this traversal
-    t_index new_size = m_index->size() + m_step_inserts - m_step_deletes;
-
-    auto new_index = std::make_shared<std::vector<t_mselem>>();
-    new_index->reserve(new_size);
-
-    t_uindex i = 0;
-    t_multisorter sorter(get_sort_orders(m_sortby));
-
-    std::vector<t_mselem> new_rows;
-    new_rows.reserve(m_new_elems.size());
-
-    for (tsl::hopscotch_map<t_tscalar, t_mselem>::const_iterator pkelem_iter
-         = m_new_elems.begin();
-         pkelem_iter != m_new_elems.end(); ++pkelem_iter) {
-        new_rows.push_back(pkelem_iter->second);
-    }
-
-    // TODO: int/float/date/datetime pkeys are already sorted here, so if
-    // there was a way to assert that `psp_pkey` is a string typed column,
-    // we can conditional the sort on whether m_sortby.size() > 0 or if
-    // psp_pkey is a string column.
-    std::sort(new_rows.begin(), new_rows.end(), sorter);
-
-    for (auto it = new_rows.begin(); it != new_rows.end(); ++it) {
-        const t_mselem& new_elem = *it;
-
-        while (i < m_index->size()) {
-            const t_mselem& old_elem = (*m_index)[i];
-
-            if (old_elem.m_deleted) {
-                i++;
-                m_pkeyidx.erase(old_elem.m_pkey);
-            } else if (old_elem.m_updated) {
-                i++;
-            } else if (sorter(old_elem, new_elem)) {
-                m_pkeyidx[old_elem.m_pkey] = new_index->size();
-                new_index->push_back(old_elem);
-                i++;
-            } else {
-                break;
-            }
-        }
-
-        m_pkeyidx[new_elem.m_pkey] = new_index->size();
-        new_index->push_back(new_elem);
+t_ftrav::step_end(const t_gstate& gstate,
+    const t_data_table& expression_master_table, const t_config& config) {
+    materialize();
+
+    // A top-N pool that lost rows to deletes or updates is refilled from
+    // every member once it can no longer fill the view.
+    t_index pool_size = m_index.size();
+    if (m_top_n >= 0 && pool_size < m_top_n
+        && pool_size < t_index(m_members.size())) {
+        rebuild(gstate, expression_master_table, config,
+            std::vector<t_tscalar>(m_members.begin(), m_members.end()));
     }
-
-    // reconcile old rows that are marked as removed or updated.
-    while (i < m_index->size()) {
-        const t_mselem& old_elem = (*m_index)[i++];
-
-        if (old_elem.m_deleted) {
-            m_pkeyidx.erase(old_elem.m_pkey);
-        } else if (!old_elem.m_updated) {
-            // Add back cells that have not changed during this step.
-            m_pkeyidx[old_elem.m_pkey] = new_index->size();
-            new_index->push_back(old_elem);
-        }
-    }
-
-    std::swap(new_index, m_index);
-    m_new_elems.clear();
 }
 
 void
 t_ftrav::add_row(const t_gstate& gstate,
     const t_data_table& expression_master_table, const t_config& config,
     t_tscalar pkey) {
+    materialize();
     t_mselem mselem;
     fill_sort_elem(gstate, expression_master_table, config, pkey, mselem);
-    m_new_elems[pkey] = mselem;
-    ++m_step_inserts;
+    erase_pkey(pkey);
+
+    if (m_top_n >= 0) {
+        m_members.insert(pkey);
+    }
+
+    insert_elem(mselem);
 }
 
 void
@@ -338,25 +455,40 @@ t_ftrav::update_row(const t_gstate& gstate,
     t_tscalar pkey) {
     if (m_sortby.empty())
         return;
+    materialize();
     auto pkiter = m_pkeyidx.find(pkey);
     if (pkiter == m_pkeyidx.end()) {
-        add_row(gstate, expression_master_table, config, pkey);
+        if (m_top_n < 0 || m_members.find(pkey) == m_members.end()) {
+            add_row(gstate, expression_master_table, config, pkey);
+            return;
+        }
+
+        // A top-N member outside the pool may move into it.
+        t_mselem mselem;
+        fill_sort_elem(gstate, expression_master_table, config, pkey, mselem);
+        insert_elem(mselem);
         return;
     }
     t_mselem mselem;
     fill_sort_elem(gstate, expression_master_table, config, pkey, mselem);
-    (*m_index)[pkiter->second].m_updated = true;
-    m_new_elems[pkey] = mselem;
+
+    // Rows whose sort key did not change keep their node.
+    const t_mselem& old_elem = m_index.get(pkiter->second);
+    if (!m_index.less(old_elem, mselem) && !m_index.less(mselem, old_elem))
+        return;
+
+    erase_pkey(pkey);
+    insert_elem(mselem);
 }
 
 void
 t_ftrav::delete_row(t_tscalar pkey) {
-    auto pkiter = m_pkeyidx.find(pkey);
-    if (pkiter == m_pkeyidx.end())
-        return;
-    (*m_index)[pkiter->second].m_deleted = true;
-    m_new_elems.erase(pkey);
-    ++m_step_deletes;
+    materialize();
+    erase_pkey(pkey);
+
+    if (m_top_n >= 0) {
+        m_members.erase(pkey);
+    }
 }
 
 std::vector<t_sortspec>
@@ -370,32 +502,162 @@ t_ftrav::empty_sort_by() const {
 }
 
 void
-t_ftrav::reset_step_state() {
-    m_step_deletes = 0;
-    m_step_inserts = 0;
-    m_new_elems.clear();
-}
+t_ftrav::reset_step_state() {}
 
 t_uindex
 t_ftrav::lower_bound_row_idx(const t_gstate& gstate, const t_config& config,
     const std::vector<t_tscalar>& row) const {
-    t_multisorter sorter(get_sort_orders(m_sortby));
+    materialize();
     t_mselem target_val;
 
     fill_sort_elem(gstate, config, row, target_val);
 
-    auto iter = std::lower_bound(
-        m_index->begin(), m_index->end(), target_val, sorter);
-
-    return std::distance(m_index->begin(), iter);
+    return std::min<t_uindex>(m_index.lower_bound(target_val), size());
 }
 
 t_index
 t_ftrav::get_row_idx(t_tscalar pkey) const {
+    materialize();
     auto pkiter = m_pkeyidx.find(pkey);
     if (pkiter == m_pkeyidx.end())
         return -1;
-    return pkiter->second;
+    t_index idx = m_index.rank(pkiter->second);
+    return idx < size() ? idx : -1;
+}
+
+void
+t_ftrav::insert_elem(const t_mselem& elem) {
+    if (m_top_n >= 0) {
+        // The pool always holds the best rows, so a row from outside may
+        // only join ahead of the pool's last row - unless the pool
+        // already holds every other member.
+        t_index pool_size = m_index.size();
+        bool complete = pool_size + 1 >= t_index(m_members.size());
+
+        if (!complete
+            && (pool_size == 0
+                || !m_index.less(
+                    elem, m_index.get(m_index.at(pool_size - 1))))) {
+            return;
+        }
+    }
+
+    m_pkeyidx[elem.m_pkey] = m_index.insert(elem);
+
+    if (t_index(m_index.size()) > get_pool_size()) {
+        erase_pkey(m_index.get(m_index.at(m_index.size() - 1)).m_pkey);
+    }
+}
+
+void
+t_ftrav::erase_pkey(t_tscalar pkey) {
+    auto pkiter = m_pkeyidx.find(pkey);
+    if (pkiter == m_pkeyidx.end())
+        return;
+    m_index.erase(pkiter->second);
+    m_pkeyidx.erase(pkiter);
+}
+
+void
+t_ftrav::sort_window(t_uindex bidx, t_uindex eidx) const {
+    split_lazy_segment(bidx);
+    split_lazy_segment(eidx);
+
+    t_multisorter sorter(m_sort_orders);
+    auto iter = m_lazy_segments.find(bidx);
+
+    while (iter != m_lazy_segments.end() && iter->first < eidx) {
+        auto next = std::next(iter);
+        t_uindex send
+            = next == m_lazy_segments.end() ? m_lazy_elems.size() : next->first;
+
+        if (!iter->second) {
+            std::sort(m_lazy_elems.begin() + iter->first,
+                m_lazy_elems.begin() + send, sorter);
+            iter->second = true;
+        }
+
+        iter = next;
+    }
+}
+
+void
+t_ftrav::split_lazy_segment(t_uindex pos) const {
+    if (pos >= m_lazy_elems.size()) {
+        return;
+    }
+
+    auto iter = std::prev(m_lazy_segments.upper_bound(pos));
+    t_uindex sbegin = iter->first;
+
+    if (sbegin == pos) {
+        return;
+    }
+
+    if (iter->second) {
+        m_lazy_segments[pos] = true;
+        return;
+    }
+
+    auto next = std::next(iter);
+    t_uindex send
+        = next == m_lazy_segments.end() ? m_lazy_elems.size() : next->first;
+
+    // Selection leaves `pos` in its final place, between two unsorted
+    // segments.
+    t_multisorter sorter(m_sort_orders);
+    std::nth_element(m_lazy_elems.begin() + sbegin,
+        m_lazy_elems.begin() + pos, m_lazy_elems.begin() + send, sorter);
+
+    m_lazy_segments[pos] = true;
+
+    if (pos + 1 < send) {
+        m_lazy_segments[pos + 1] = false;
+    }
+}
+
+void
+t_ftrav::materialize() const {
+    if (!m_lazy) {
+        return;
+    }
+
+    std::vector<std::pair<t_uindex, t_uindex>> unsorted;
+
+    for (auto iter = m_lazy_segments.begin(); iter != m_lazy_segments.end();
+         ++iter) {
+        auto next = std::next(iter);
+        t_uindex send
+            = next == m_lazy_segments.end() ? m_lazy_elems.size() : next->first;
+
+        if (!iter->second) {
+            unsorted.push_back(std::make_pair(iter->first, send));
+        }
+    }
+
+    t_multisorter sorter(m_sort_orders);
+
+    // Segments are independent; the single segment left by a sort that
+    // was never read is sorted in parallel instead.
+    if (unsorted.size() == 1 && unsorted[0].first == 0
+        && unsorted[0].second == m_lazy_elems.size()) {
+        parallel_sort(m_lazy_elems, sorter);
+    } else {
+        parallel_for(int(unsorted.size()), [&](int sidx) {
+            std::sort(m_lazy_elems.begin() + unsorted[sidx].first,
+                m_lazy_elems.begin() + unsorted[sidx].second, sorter);
+        });
+    }
+
+    m_index.build(m_lazy_elems);
+
+    m_pkeyidx.clear();
+    for (t_index idx = 0, loop_end = m_index.size(); idx < loop_end; ++idx) {
+        m_pkeyidx[m_index.get(idx).m_pkey] = idx;
+    }
+
+    m_lazy = false;
+    m_lazy_segments.clear();
 }
 
 t_tscalar
@@ -593,6 +593,8 @@ t_gnode::process(t_uindex port_id) {
     PerspectiveScopedGILRelease acquire(m_event_loop_thread_id);
 #endif
 
+    _unshare_context_trees();
+
     t_process_table_result result = _process_table(port_id);
 
     if (result.m_flattened_data_table) {
@@ -686,6 +688,21 @@ t_gnode::set_ctx_state(void* ptr) {
     ctx->set_state(m_gstate);
 }
 
+template <typename CTX_T>
+void
+t_gnode::index_filtered_columns(void* ptr) {
+    PSP_TRACE_SENTINEL();
+    PSP_VERBOSE_ASSERT(m_init, "touching uninited object");
+    CTX_T* ctx = static_cast<CTX_T*>(ptr);
+    std::vector<std::string> colnames;
+
+    for (const auto& fterm : ctx->get_config().get_fterms()) {
+        colnames.push_back(fterm.m_colname);
+    }
+
+    m_gstate->index_columns(colnames);
+}
+
 template <>
 void
 t_gnode::update_context_from_state(t_ctxunit* ctx, const std::string& name,
@@ -727,11 +744,20 @@ t_gnode::_update_contexts_from_state(std::shared_ptr<t_data_table> tbl) {
         count++;
     }
 
+    // Read before the contexts are reset onto new trees.
+    std::vector<t_index> owners = _get_tree_owners(context_handles);
+
     auto update_contexts_helper = [this, &context_names, &context_handles,
-                                      &tbl](t_index ctx_idx) {
+                                      &owners, &tbl, num_contexts](
+                                      t_index ctx_idx) {
         const std::string& name = context_names[ctx_idx];
         const t_ctx_handle& ctxh = context_handles[ctx_idx];
 
+        // Updated along with the context that owns its tree.
+        if (owners[ctx_idx] != ctx_idx) {
+            return;
+        }
+
         switch (ctxh.get_type()) {
             case TWO_SIDED_CONTEXT: {
                 auto ctx = static_cast<t_ctx2*>(ctxh.m_ctx);
@@ -744,6 +770,18 @@ t_gnode::_update_contexts_from_state(std::shared_ptr<t_data_table> tbl) {
                 auto ctx = static_cast<t_ctx1*>(ctxh.m_ctx);
                 ctx->reset(false);
                 update_context_from_state<t_ctx1>(ctx, name, tbl);
+
+                for (t_index idx = ctx_idx + 1; idx < num_contexts; ++idx) {
+                    if (owners[idx] != ctx_idx) {
+                        continue;
+                    }
+
+                    auto shared_ctx
+                        = static_cast<t_ctx1*>(context_handles[idx].m_ctx);
+                    shared_ctx->share_tree(*ctx);
+                    shared_ctx->step_begin();
+                    shared_ctx->step_end();
+                }
             } break;
             case ZERO_SIDED_CONTEXT: {
                 auto ctx = static_cast<t_ctx0*>(ctxh.m_ctx);
@@ -857,6 +895,28 @@ t_gnode::_register_context(
     t_ctx_handle ch(ptr_, type);
     m_contexts[name] = ch;
 
+    // Before the pkeyed table is cloned, as it shares the master indexes.
+    switch (type) {
+        case TWO_SIDED_CONTEXT: {
+            index_filtered_columns<t_ctx2>(ptr_);
+        } break;
+        case ONE_SIDED_CONTEXT: {
+            index_filtered_columns<t_ctx1>(ptr_);
+        } break;
+        case ZERO_SIDED_CONTEXT: {
+            index_filtered_columns<t_ctx0>(ptr_);
+        } break;
+        case UNIT_CONTEXT: {
+            index_filtered_columns<t_ctxunit>(ptr_);
+        } break;
+        case GROUPED_PKEY_CONTEXT: {
+            index_filtered_columns<t_ctx_grouped_pkey>(ptr_);
+        } break;
+        default: {
+            PSP_COMPLAIN_AND_ABORT("Unexpected context type");
+        } break;
+    }
+
     bool should_update = m_gstate->mapping_size() > 0;
     std::shared_ptr<t_data_table> pkeyed_table;
 
@@ -867,6 +927,11 @@ t_gnode::_register_context(
     t_expression_vocab& expression_vocab = *(m_expression_vocab);
     t_regex_mapping& expression_regex_mapping = *(m_expression_regex_mapping);
 
+    // Computed over the pkeyed table, which no other context's expression
+    // columns are aligned with, so nothing is shared until the next update.
+    t_expression_cache expression_cache(
+        pkeyed_table, expression_vocab, expression_regex_mapping);
+
     switch (type) {
         case TWO_SIDED_CONTEXT: {
             set_ctx_state<t_ctx2>(ptr_);
@@ -874,8 +939,7 @@ t_gnode::_register_context(
             ctx->reset();
 
             if (should_update) {
-                ctx->compute_expressions(
-                    pkeyed_table, expression_vocab, expression_regex_mapping);
+                ctx->compute_expressions(expression_cache);
                 update_context_from_state<t_ctx2>(ctx, name, pkeyed_table);
             }
         } break;
@@ -885,8 +949,30 @@ t_gnode::_register_context(
             ctx->reset();
 
             if (should_update) {
-                ctx->compute_expressions(
-                    pkeyed_table, expression_vocab, expression_regex_mapping);
+                ctx->compute_expressions(expression_cache);
+            }
+
+            std::vector<t_aggspec> aggregates;
+            t_ctx1* owner = _find_tree_owner(ctx, aggregates);
+
+            if (owner != nullptr
+                && aggregates.size() == owner->get_tree_aggregates().size()) {
+                ctx->share_tree(*owner);
+                ctx->step_begin();
+                ctx->step_end();
+            } else if (owner != nullptr) {
+                // A tree for the union of the aggregates replaces the tree
+                // of the contexts `ctx` shares with.
+                ctx->set_tree_aggregates(aggregates);
+                ctx->reset(false);
+
+                if (should_update) {
+                    update_context_from_state<t_ctx1>(
+                        ctx, name, pkeyed_table);
+                }
+
+                _move_tree_contexts(owner->get_trees()[0], *ctx);
+            } else if (should_update) {
                 update_context_from_state<t_ctx1>(ctx, name, pkeyed_table);
             }
         } break;
@@ -896,8 +982,7 @@ t_gnode::_register_context(
             ctx->reset();
 
             if (should_update) {
-                ctx->compute_expressions(
-                    pkeyed_table, expression_vocab, expression_regex_mapping);
+                ctx->compute_expressions(expression_cache);
                 update_context_from_state<t_ctx0>(ctx, name, pkeyed_table);
             }
         } break;
@@ -917,8 +1002,7 @@ t_gnode::_register_context(
             ctx->reset();
 
             if (should_update) {
-                ctx->compute_expressions(
-                    pkeyed_table, expression_vocab, expression_regex_mapping);
+                ctx->compute_expressions(expression_cache);
                 update_context_from_state<t_ctx_grouped_pkey>(
                     ctx, name, pkeyed_table);
             }
@@ -955,79 +1039,67 @@ t_gnode::notify_contexts(std::shared_ptr<t_data_table> flattened) {
         ctxh_count++;
     }
 
-    auto notify_context_helper
-        = [this, &context_names, &ctxhvec, &flattened](t_index ctx_idx) {
-              const std::string& name = context_names[ctx_idx];
-              const t_ctx_handle& ctxh = ctxhvec[ctx_idx];
-
-              switch (ctxh.get_type()) {
-                  case TWO_SIDED_CONTEXT: {
-                      notify_context<t_ctx2>(flattened, ctxh, name);
-                  } break;
-                  case ONE_SIDED_CONTEXT: {
-                      notify_context<t_ctx1>(flattened, ctxh, name);
-                  } break;
-                  case ZERO_SIDED_CONTEXT: {
-                      notify_context<t_ctx0>(flattened, ctxh, name);
-                  } break;
-                  case UNIT_CONTEXT: {
-                      notify_context<t_ctxunit>(flattened, ctxh, name);
-                  } break;
-                  case GROUPED_PKEY_CONTEXT: {
-                      notify_context<t_ctx_grouped_pkey>(flattened, ctxh, name);
-                  } break;
-                  default: {
-                      PSP_COMPLAIN_AND_ABORT("Unexpected context type");
-                  } break;
-              }
-          };
-
-    parallel_for(int(num_contexts), [&notify_context_helper](int ctx_idx) {
-        notify_context_helper(ctx_idx);
-    });
-}
+    std::vector<t_index> owners = _get_tree_owners(ctxhvec);
 
-/******************************************************************************
- *
- * Expressions
- */
+    auto notify_context_helper = [this, &context_names, &ctxhvec, &owners,
+                                     &flattened, num_contexts](
+                                     t_index ctx_idx) {
+        const std::string& name = context_names[ctx_idx];
+        const t_ctx_handle& ctxh = ctxhvec[ctx_idx];
 
-void
-t_gnode::_compute_expressions(std::shared_ptr<t_data_table> flattened_masked) {
-    t_expression_vocab& expression_vocab = *(m_expression_vocab);
-    t_regex_mapping& expression_regex_mapping = *(m_expression_regex_mapping);
+        // Notified after the context that owns its tree.
+        if (owners[ctx_idx] != ctx_idx) {
+            return;
+        }
 
-    for (const auto& iter : m_contexts) {
-        const t_ctx_handle& ctxh = iter.second;
         switch (ctxh.get_type()) {
             case TWO_SIDED_CONTEXT: {
-                t_ctx2* ctx = static_cast<t_ctx2*>(ctxh.m_ctx);
-                ctx->compute_expressions(flattened_masked, expression_vocab,
-                    expression_regex_mapping);
+                notify_context<t_ctx2>(flattened, ctxh, name);
             } break;
             case ONE_SIDED_CONTEXT: {
-                t_ctx1* ctx = static_cast<t_ctx1*>(ctxh.m_ctx);
-                ctx->compute_expressions(flattened_masked, expression_vocab,
-                    expression_regex_mapping);
+                notify_context<t_ctx1>(flattened, ctxh, name);
+
+                for (t_index idx = ctx_idx + 1; idx < num_contexts; ++idx) {
+                    if (owners[idx] != ctx_idx) {
+                        continue;
+                    }
+
+                    t_ctx1* shared_ctx = ctxhvec[idx].get<t_ctx1>();
+                    shared_ctx->step_begin();
+                    shared_ctx->notify_traversal();
+                    shared_ctx->step_end();
+                }
             } break;
             case ZERO_SIDED_CONTEXT: {
-                t_ctx0* ctx = static_cast<t_ctx0*>(ctxh.m_ctx);
-                ctx->compute_expressions(flattened_masked, expression_vocab,
-                    expression_regex_mapping);
+                notify_context<t_ctx0>(flattened, ctxh, name);
+            } break;
+            case UNIT_CONTEXT: {
+                notify_context<t_ctxunit>(flattened, ctxh, name);
             } break;
             case GROUPED_PKEY_CONTEXT: {
-                t_ctx_grouped_pkey* ctx
-                    = static_cast<t_ctx_grouped_pkey*>(ctxh.m_ctx);
-                ctx->compute_expressions(flattened_masked, expression_vocab,
-                    expression_regex_mapping);
+                notify_context<t_ctx_grouped_pkey>(flattened, ctxh, name);
             } break;
-            case UNIT_CONTEXT:
-                break;
             default: {
                 PSP_COMPLAIN_AND_ABORT("Unexpected context type");
             } break;
         }
-    }
+    };
+
+    parallel_for(int(num_contexts), [&notify_context_helper](int ctx_idx) {
+        notify_context_helper(ctx_idx);
+    });
+}
+
+/******************************************************************************
+ *
+ * Expressions
+ */
+
+void
+t_gnode::_compute_expressions(std::shared_ptr<t_data_table> flattened_masked) {
+    t_expression_cache expression_cache(flattened_masked,
+        *m_expression_vocab, *m_expression_regex_mapping);
+    _compute_expressions(expression_cache);
 }
 
 void
@@ -1037,42 +1109,36 @@ t_gnode::_compute_expressions(std::shared_ptr<t_data_table> master,
     std::shared_ptr<t_data_table> prev = m_oports[PSP_PORT_PREV]->get_table();
     std::shared_ptr<t_data_table> current
         = m_oports[PSP_PORT_CURRENT]->get_table();
-    std::shared_ptr<t_data_table> transitions
-        = m_oports[PSP_PORT_TRANSITIONS]->get_table();
     std::shared_ptr<t_data_table> existed
         = m_oports[PSP_PORT_EXISTED]->get_table();
 
-    t_expression_vocab& expression_vocab = *(m_expression_vocab);
-    t_regex_mapping& expression_regex_mapping = *(m_expression_regex_mapping);
+    t_expression_cache expression_cache(master, flattened, delta, prev,
+        current, existed, *m_expression_vocab, *m_expression_regex_mapping);
+    _compute_expressions(expression_cache);
+}
 
+void
+t_gnode::_compute_expressions(t_expression_cache& expression_cache) {
     for (const auto& iter : m_contexts) {
         const t_ctx_handle& ctxh = iter.second;
 
         switch (ctxh.get_type()) {
             case TWO_SIDED_CONTEXT: {
                 t_ctx2* ctx = static_cast<t_ctx2*>(ctxh.m_ctx);
-                ctx->compute_expressions(master, flattened, delta, prev,
-                    current, transitions, existed, expression_vocab,
-                    expression_regex_mapping);
+                ctx->compute_expressions(expression_cache);
             } break;
             case ONE_SIDED_CONTEXT: {
                 t_ctx1* ctx = static_cast<t_ctx1*>(ctxh.m_ctx);
-                ctx->compute_expressions(master, flattened, delta, prev,
-                    current, transitions, existed, expression_vocab,
-                    expression_regex_mapping);
+                ctx->compute_expressions(expression_cache);
             } break;
             case ZERO_SIDED_CONTEXT: {
                 t_ctx0* ctx = static_cast<t_ctx0*>(ctxh.m_ctx);
-                ctx->compute_expressions(master, flattened, delta, prev,
-                    current, transitions, existed, expression_vocab,
-                    expression_regex_mapping);
+                ctx->compute_expressions(expression_cache);
             } break;
             case GROUPED_PKEY_CONTEXT: {
                 t_ctx_grouped_pkey* ctx
                     = static_cast<t_ctx_grouped_pkey*>(ctxh.m_ctx);
-                ctx->compute_expressions(master, flattened, delta, prev,
-                    current, transitions, existed, expression_vocab,
-                    expression_regex_mapping);
+                ctx->compute_expressions(expression_cache);
             } break;
             case UNIT_CONTEXT:
                 break;
@@ -1083,6 +1149,132 @@ t_gnode::_compute_expressions(std::shared_ptr<t_data_table> master,
     }
 }
 
+/******************************************************************************
+ *
+ * Shared Trees
+ */
+
+t_ctx1*
+t_gnode::_find_tree_owner(
+    const t_ctx1* ctx, std::vector<t_aggspec>& out_aggregates) const {
+    if (!ctx->can_share_tree()) {
+        return nullptr;
+    }
+
+    std::string signature = ctx->get_config().get_tree_signature();
+
+    for (const auto& iter : m_contexts) {
+        const t_ctx_handle& ctxh = iter.second;
+
+        if (ctxh.get_type() != ONE_SIDED_CONTEXT || ctxh.m_ctx == ctx) {
+            continue;
+        }
+
+        t_ctx1* other = static_cast<t_ctx1*>(ctxh.m_ctx);
+
+        if (other->can_share_tree()
+            && other->get_config().get_tree_signature() == signature
+            && ctx->merge_tree_aggregates(
+                other->get_tree_aggregates(), out_aggregates)) {
+            return other;
+        }
+    }
+
+    return nullptr;
+}
+
+std::vector<t_index>
+t_gnode::_get_tree_owners(const std::vector<t_ctx_handle>& ctxhvec) const {
+    t_index num_contexts = ctxhvec.size();
+    std::vector<t_index> owners(num_contexts);
+    std::map<t_stree*, t_index> tree_owners;
+
+    for (t_index idx = 0; idx < num_contexts; ++idx) {
+        owners[idx] = idx;
+
+        if (ctxhvec[idx].get_type() != ONE_SIDED_CONTEXT) {
+            continue;
+        }
+
+        t_ctx1* ctx = static_cast<t_ctx1*>(ctxhvec[idx].m_ctx);
+        t_stree* tree = ctx->get_trees()[0];
+        auto inserted = tree_owners.insert(std::make_pair(tree, idx));
+        owners[idx] = inserted.first->second;
+    }
+
+    return owners;
+}
+
+void
+t_gnode::_move_tree_contexts(t_stree* tree, t_ctx1& ctx) {
+    std::vector<t_ctx1*> readers;
+
+    for (const auto& iter : m_contexts) {
+        const t_ctx_handle& ctxh = iter.second;
+
+        if (ctxh.get_type() != ONE_SIDED_CONTEXT || ctxh.m_ctx == &ctx) {
+            continue;
+        }
+
+        t_ctx1* other = static_cast<t_ctx1*>(ctxh.m_ctx);
+
+        if (other->get_trees()[0] == tree) {
+            readers.push_back(other);
+        }
+    }
+
+    for (t_ctx1* other : readers) {
+        std::vector<t_path> expansion_state = other->get_expansion_state();
+        other->share_tree(ctx);
+        other->step_begin();
+        other->step_end();
+        other->set_expansion_state(expansion_state);
+    }
+}
+
+void
+t_gnode::_unshare_context_trees() {
+    bool should_update = m_gstate->mapping_size() > 0;
+    std::shared_ptr<t_data_table> pkeyed_table;
+
+    t_expression_vocab& expression_vocab = *(m_expression_vocab);
+    t_regex_mapping& expression_regex_mapping = *(m_expression_regex_mapping);
+
+    for (const auto& iter : m_contexts) {
+        const t_ctx_handle& ctxh = iter.second;
+
+        if (ctxh.get_type() != ONE_SIDED_CONTEXT) {
+            continue;
+        }
+
+        t_ctx1* ctx = static_cast<t_ctx1*>(ctxh.m_ctx);
+
+        if (!ctx->needs_own_tree()) {
+            continue;
+        }
+
+        std::vector<t_path> expansion_state = ctx->get_expansion_state();
+
+        // Rebuilt the same way as in `_register_context`, for this
+        // context's aggregates only.
+        ctx->set_tree_aggregates(ctx->get_aggregates());
+        ctx->reset();
+
+        if (should_update) {
+            if (!pkeyed_table) {
+                pkeyed_table = m_gstate->get_pkeyed_table();
+            }
+
+            t_expression_cache expression_cache(
+                pkeyed_table, expression_vocab, expression_regex_mapping);
+            ctx->compute_expressions(expression_cache);
+            update_context_from_state<t_ctx1>(ctx, iter.first, pkeyed_table);
+        }
+
+        ctx->set_expansion_state(expansion_state);
+    }
+}
+
 /******************************************************************************
  *
  * Getters
@@ -35,6 +35,7 @@ t_gstate::init() {
     m_table->init();
     m_pkcol = m_table->get_column("psp_pkey");
     m_opcol = m_table->get_column("psp_op");
+    build_bitmap_indexes();
     m_init = true;
 }
 
@@ -52,6 +53,20 @@ t_gstate::lookup(t_tscalar pkey) const {
     return rval;
 }
 
+void
+t_gstate::lookup(const std::vector<t_tscalar>& pkeys,
+    std::vector<t_uindex>& out_rows) const {
+    t_uindex num_rows = pkeys.size();
+    std::vector<t_uindex> rval(num_rows);
+
+    for (t_uindex idx = 0; idx < num_rows; ++idx) {
+        t_mapping::const_iterator iter = m_mapping.find(pkeys[idx]);
+        rval[idx] = iter == m_mapping.end() ? INVALID_INDEX : iter->second;
+    }
+
+    std::swap(rval, out_rows);
+}
+
 void
 t_gstate::_mark_deleted(t_uindex idx) {
     m_free.insert(idx);
@@ -171,7 +186,7 @@ t_gstate::fill_master_table(const t_data_table* flattened) {
     master_table->verify();
 #endif
 
-    return;
+    build_bitmap_indexes();
 }
 
 void
@@ -189,6 +204,8 @@ t_gstate::update_master_table(const t_data_table* flattened) {
 
     t_data_table* master_table = m_table.get();
     std::vector<t_uindex> master_table_indexes(flattened->num_rows());
+    std::vector<t_uindex> updated_rows;
+    updated_rows.reserve(flattened->num_rows());
 
     for (t_uindex idx = 0, loop_end = flattened->num_rows(); idx < loop_end;
          ++idx) {
@@ -206,8 +223,14 @@ t_gstate::update_master_table(const t_data_table* flattened) {
                 m_opcol->set_nth<std::uint8_t>(
                     master_table_indexes[idx], OP_INSERT);
                 m_pkcol->set_scalar(master_table_indexes[idx], pkey);
+                updated_rows.push_back(master_table_indexes[idx]);
             } break;
             case OP_DELETE: {
+                t_rlookup lookup_ = lookup(pkey);
+                if (lookup_.m_exists) {
+                    updated_rows.push_back(lookup_.m_idx);
+                }
+
                 // Erase the pkey from the master table, but this does not
                 // change the size as the row isn't removed, just cleared out.
                 erase(pkey);
@@ -235,6 +258,71 @@ t_gstate::update_master_table(const t_data_table* flattened) {
             update_master_column(master_column, flattened_column.get(),
                 flattened_op_col, master_table_indexes, flattened->num_rows());
         });
+
+    update_bitmap_indexes(&updated_rows);
+}
+
+void
+t_gstate::build_bitmap_indexes() {
+    m_bitmap_indexes = std::make_shared<t_bitmap_index_set>();
+    m_bitmap_indexes->m_has_live = false;
+
+    for (const std::string& colname : m_indexed_columns) {
+        m_bitmap_indexes->m_indexes[colname]
+            = std::make_shared<t_bitmap_index>();
+    }
+
+    update_bitmap_indexes(nullptr);
+    m_table->set_bitmap_indexes(m_bitmap_indexes);
+}
+
+void
+t_gstate::index_columns(const std::vector<std::string>& colnames) {
+    const t_schema& schema = m_table->get_schema();
+    auto& indexes = m_bitmap_indexes->m_indexes;
+    t_uindex nrows = m_table->size();
+
+    for (const std::string& colname : colnames) {
+        if (colname == "psp_pkey" || colname == "psp_op"
+            || indexes.count(colname) != 0 || !schema.has_column(colname)
+            || !t_bitmap_index::is_indexable(schema.get_dtype(colname))) {
+            continue;
+        }
+
+        m_indexed_columns.insert(colname);
+
+        auto index = std::make_shared<t_bitmap_index>();
+        if (index->build(m_table->get_const_column(colname).get(), nrows)) {
+            indexes[colname] = index;
+        }
+    }
+}
+
+void
+t_gstate::update_bitmap_indexes(const std::vector<t_uindex>* rows) {
+    auto& indexes = m_bitmap_indexes->m_indexes;
+    t_uindex nrows = m_table->size();
+    std::vector<std::string> colnames;
+
+    for (const auto& kv : indexes) {
+        colnames.push_back(kv.first);
+    }
+
+    std::vector<std::uint8_t> indexed(colnames.size());
+
+    parallel_for(int(colnames.size()), [&](int idx) {
+        t_bitmap_index& index = *(indexes.find(colnames[idx])->second);
+        const t_column* column
+            = m_table->get_const_column(colnames[idx]).get();
+        indexed[idx] = rows == nullptr ? index.build(column, nrows)
+                                       : index.update(column, *rows, nrows);
+    });
+
+    for (t_uindex idx = 0, loop_end = colnames.size(); idx < loop_end; ++idx) {
+        if (!indexed[idx]) {
+            indexes.erase(colnames[idx]);
+        }
+    }
 }
 
 void
@@ -463,6 +551,185 @@ t_gstate::read_column(const t_data_table& table, const std::string& colname,
     std::swap(rval, out_data);
 }
 
+template <typename DATA_T>
+static void
+gather_column(const t_column* col, const std::vector<t_uindex>& row_indices,
+    std::vector<double>& out_data, bool include_nones) {
+    const DATA_T* base = col->get_nth<DATA_T>(0);
+    const t_status* status
+        = col->is_status_enabled() ? col->get_nth_status(0) : nullptr;
+
+    for (auto idx : row_indices) {
+        if (include_nones || status == nullptr || status[idx] == STATUS_VALID) {
+            out_data.push_back(static_cast<double>(base[idx]));
+        }
+    }
+}
+
+void
+t_gstate::read_column(const t_data_table& table, const std::string& colname,
+    const std::vector<t_uindex>& row_indices, std::vector<double>& out_data,
+    bool include_nones) const {
+    std::shared_ptr<const t_column> col = table.get_const_column(colname);
+    const t_column* col_ = col.get();
+
+    std::vector<double> rval;
+    rval.reserve(row_indices.size());
+
+    if (row_indices.empty()) {
+        std::swap(rval, out_data);
+        return;
+    }
+
+    switch (col_->get_dtype()) {
+        case DTYPE_INT64: {
+            gather_column<std::int64_t>(col_, row_indices, rval, include_nones);
+        } break;
+        case DTYPE_INT32: {
+            gather_column<std::int32_t>(col_, row_indices, rval, include_nones);
+        } break;
+        case DTYPE_INT16: {
+            gather_column<std::int16_t>(col_, row_indices, rval, include_nones);
+        } break;
+        case DTYPE_INT8: {
+            gather_column<std::int8_t>(col_, row_indices, rval, include_nones);
+        } break;
+        case DTYPE_UINT64: {
+            gather_column<std::uint64_t>(
+                col_, row_indices, rval, include_nones);
+        } break;
+        case DTYPE_UINT32: {
+            gather_column<std::uint32_t>(
+                col_, row_indices, rval, include_nones);
+        } break;
+        case DTYPE_UINT16: {
+            gather_column<std::uint16_t>(
+                col_, row_indices, rval, include_nones);
+        } break;
+        case DTYPE_UINT8: {
+            gather_column<std::uint8_t>(col_, row_indices, rval, include_nones);
+        } break;
+        case DTYPE_FLOAT64: {
+            gather_column<double>(col_, row_indices, rval, include_nones);
+        } break;
+        case DTYPE_FLOAT32: {
+            gather_column<float>(col_, row_indices, rval, include_nones);
+        } break;
+        default: {
+            for (auto idx : row_indices) {
+                auto tscalar = col_->get_scalar(idx);
+                if (include_nones || tscalar.is_valid()) {
+                    rval.push_back(tscalar.to_double());
+                }
+            }
+        }
+    }
+
+    std::swap(rval, out_data);
+}
+
+template <typename DATA_T, typename VALUE_T>
+static void
+gather_scalars(const t_column* col, const std::vector<t_uindex>& row_indices,
+    t_tscalar* out_data, t_uindex stride) {
+    const DATA_T* base = col->get_nth<DATA_T>(0);
+    const t_status* status
+        = col->is_status_enabled() ? col->get_nth_status(0) : nullptr;
+    t_tscalar none = mknone();
+
+    for (auto idx : row_indices) {
+        if (idx != static_cast<t_uindex>(INVALID_INDEX)
+            && (status == nullptr || status[idx] == STATUS_VALID)) {
+            out_data->set(VALUE_T(base[idx]));
+        } else {
+            out_data->set(none);
+        }
+
+        out_data += stride;
+    }
+}
+
+void
+t_gstate::read_column(const t_data_table& table, const std::string& colname,
+    const std::vector<t_uindex>& row_indices, t_tscalar* out_data,
+    t_uindex stride) const {
+    std::shared_ptr<const t_column> col = table.get_const_column(colname);
+    const t_column* col_ = col.get();
+
+    if (row_indices.empty()) {
+        return;
+    }
+
+    switch (col_->get_dtype()) {
+        case DTYPE_INT64: {
+            gather_scalars<std::int64_t, std::int64_t>(
+                col_, row_indices, out_data, stride);
+        } break;
+        case DTYPE_INT32: {
+            gather_scalars<std::int32_t, std::int32_t>(
+                col_, row_indices, out_data, stride);
+        } break;
+        case DTYPE_INT16: {
+            gather_scalars<std::int16_t, std::int16_t>(
+                col_, row_indices, out_data, stride);
+        } break;
+        case DTYPE_INT8: {
+            gather_scalars<std::int8_t, std::int8_t>(
+                col_, row_indices, out_data, stride);
+        } break;
+        case DTYPE_UINT64: {
+            gather_scalars<std::uint64_t, std::uint64_t>(
+                col_, row_indices, out_data, stride);
+        } break;
+        case DTYPE_UINT32: {
+            gather_scalars<std::uint32_t, std::uint32_t>(
+                col_, row_indices, out_data, stride);
+        } break;
+        case DTYPE_UINT16: {
+            gather_scalars<std::uint16_t, std::uint16_t>(
+                col_, row_indices, out_data, stride);
+        } break;
+        case DTYPE_UINT8: {
+            gather_scalars<std::uint8_t, std::uint8_t>(
+                col_, row_indices, out_data, stride);
+        } break;
+        case DTYPE_FLOAT64: {
+            gather_scalars<double, double>(
+                col_, row_indices, out_data, stride);
+        } break;
+        case DTYPE_FLOAT32: {
+            gather_scalars<float, float>(col_, row_indices, out_data, stride);
+        } break;
+        case DTYPE_BOOL: {
+            gather_scalars<bool, bool>(col_, row_indices, out_data, stride);
+        } break;
+        case DTYPE_TIME: {
+            gather_scalars<t_time::t_rawtype, t_time>(
+                col_, row_indices, out_data, stride);
+        } break;
+        case DTYPE_DATE: {
+            gather_scalars<t_date::t_rawtype, t_date>(
+                col_, row_indices, out_data, stride);
+        } break;
+        default: {
+            t_tscalar none = mknone();
+
+            for (auto idx : row_indices) {
+                if (idx != static_cast<t_uindex>(INVALID_INDEX)) {
+                    out_data->set(col_->get_scalar(idx));
+                }
+
+                if (idx == static_cast<t_uindex>(INVALID_INDEX)
+                    || !out_data->is_valid()) {
+                    out_data->set(none);
+                }
+
+                out_data += stride;
+            }
+        }
+    }
+}
+
 t_tscalar
 t_gstate::get(const t_data_table& table, const std::string& colname,
     t_tscalar pkey) const {
@@ -534,6 +801,44 @@ t_gstate::apply(const t_data_table& table, const std::string& colname,
     return false;
 }
 
+bool
+t_gstate::is_unique(const t_data_table& table, const std::string& colname,
+    const std::vector<t_uindex>& row_indices, t_tscalar& value) const {
+    std::shared_ptr<const t_column> col = table.get_const_column(colname);
+    const t_column* col_ = col.get();
+    value = mknone();
+
+    for (auto idx : row_indices) {
+        auto tmp = col_->get_scalar(idx);
+        if (!value.is_none() && value != tmp)
+            return false;
+        value = tmp;
+    }
+
+    return true;
+}
+
+bool
+t_gstate::apply(const t_data_table& table, const std::string& colname,
+    const std::vector<t_uindex>& row_indices, t_tscalar& value,
+    std::function<bool(const t_tscalar&, t_tscalar&)> fn) const {
+    std::shared_ptr<const t_column> col = table.get_const_column(colname);
+    const t_column* col_ = col.get();
+
+    value = mknone();
+
+    for (auto idx : row_indices) {
+        auto tmp = col_->get_scalar(idx);
+        bool done = fn(tmp, value);
+        if (done) {
+            value = tmp;
+            return done;
+        }
+    }
+
+    return false;
+}
+
 const t_schema&
 t_gstate::get_output_schema() const {
     return m_output_schema;
@@ -580,6 +885,19 @@ t_gstate::get_pkeyed_table() const {
 
     );
 
+    // The clone shares the master indexes, compacted through the mask of
+    // live rows when read.
+    auto indexes = std::make_shared<t_bitmap_index_set>();
+    indexes->m_indexes = m_bitmap_indexes->m_indexes;
+    indexes->m_live.assign((mask.size() + 63) / 64, 0);
+    indexes->m_has_live = true;
+
+    for (const auto& kv : m_mapping) {
+        indexes->m_live[kv.second / 64] |= std::uint64_t(1) << (kv.second % 64);
+    }
+
+    rval->set_bitmap_indexes(indexes);
+
     return rval;
 }
 
@@ -690,6 +1008,7 @@ t_gstate::reset() {
     m_table->reset();
     m_mapping.clear();
     m_free.clear();
+    build_bitmap_indexes();
 }
 
 const t_schema&
@@ -28,6 +28,23 @@ t_mask::t_mask(const t_simple_bitmask& m) {
     }
 }
 
+t_mask::t_mask(const std::vector<std::uint64_t>& words, t_uindex size) {
+    typedef boost::dynamic_bitset<>::block_type t_block;
+    const t_uindex block_bits = boost::dynamic_bitset<>::bits_per_block;
+
+    std::vector<t_block> blocks;
+    blocks.reserve(words.size() * (64 / block_bits));
+
+    for (std::uint64_t word : words) {
+        for (t_uindex shift = 0; shift < 64; shift += block_bits) {
+            blocks.push_back(static_cast<t_block>(word >> shift));
+        }
+    }
+
+    m_bitmap.append(blocks.begin(), blocks.end());
+    m_bitmap.resize(t_msize(size));
+}
+
 t_mask::~t_mask() { LOG_DESTRUCTOR("t_mask"); }
 
 void
@@ -0,0 +1,150 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2017, the Perspective Authors.
+ *
+ * This file is part of the Perspective library, distributed under the terms of
+ * the Apache License 2.0.  The full license can be found in the LICENSE file.
+ *
+ */
+
+#include <perspective/first.h>
+#include <perspective/min_max.h>
+
+namespace perspective {
+
+static inline bool
+is_tracked_value(const t_tscalar& value) {
+    return value.is_valid() && !value.is_none() && !value.is_nan();
+}
+
+t_minmax_index::t_minmax_index() {}
+
+void
+t_minmax_index::clear() {
+    m_columns.clear();
+    m_marked.clear();
+}
+
+bool
+t_minmax_index::empty() const {
+    return m_columns.empty();
+}
+
+bool
+t_minmax_index::has_column(const std::string& colname) const {
+    return m_columns.find(colname) != m_columns.end();
+}
+
+std::vector<std::string>
+t_minmax_index::get_columns() const {
+    std::vector<std::string> rval;
+    rval.reserve(m_columns.size());
+
+    for (const auto& column : m_columns) {
+        rval.push_back(column.first);
+    }
+
+    return rval;
+}
+
+void
+t_minmax_index::add_column(const std::string& colname,
+    const std::vector<t_tscalar>& pkeys,
+    const std::vector<t_tscalar>& values) {
+    t_column_minmax& column = m_columns[colname];
+    column.m_counts.clear();
+    column.m_values.clear();
+    column.m_values.reserve(pkeys.size());
+
+    for (t_uindex idx = 0, loop_end = pkeys.size(); idx < loop_end; ++idx) {
+        if (!is_tracked_value(values[idx])) {
+            continue;
+        }
+
+        t_tscalar value = m_symtable.get_interned_tscalar(values[idx]);
+        column.m_values[pkeys[idx]] = value;
+        insert_value(column, value);
+    }
+}
+
+void
+t_minmax_index::mark_row(t_tscalar pkey) {
+    if (m_columns.empty()) {
+        return;
+    }
+
+    m_marked.insert(pkey);
+}
+
+const tsl::hopscotch_set<t_tscalar>&
+t_minmax_index::get_marked_rows() const {
+    return m_marked;
+}
+
+void
+t_minmax_index::clear_marked_rows() {
+    m_marked.clear();
+}
+
+void
+t_minmax_index::set_value(
+    const std::string& colname, t_tscalar pkey, t_tscalar value) {
+    auto citer = m_columns.find(colname);
+    if (citer == m_columns.end()) {
+        return;
+    }
+
+    t_column_minmax& column = citer->second;
+    auto viter = column.m_values.find(pkey);
+
+    if (viter != column.m_values.end()) {
+        if (is_tracked_value(value) && viter->second == value) {
+            return;
+        }
+
+        erase_value(column, viter->second);
+        column.m_values.erase(viter);
+    }
+
+    if (!is_tracked_value(value)) {
+        return;
+    }
+
+    value = m_symtable.get_interned_tscalar(value);
+    column.m_values[pkey] = value;
+    insert_value(column, value);
+}
+
+std::pair<t_tscalar, t_tscalar>
+t_minmax_index::get_min_max(const std::string& colname) const {
+    auto rval = std::make_pair(mknone(), mknone());
+    auto citer = m_columns.find(colname);
+
+    if (citer == m_columns.end() || citer->second.m_counts.empty()) {
+        return rval;
+    }
+
+    const std::map<t_tscalar, t_uindex>& counts = citer->second.m_counts;
+    rval.first = counts.begin()->first;
+    rval.second = counts.rbegin()->first;
+    return rval;
+}
+
+void
+t_minmax_index::insert_value(t_column_minmax& column, t_tscalar value) {
+    column.m_counts[value] += 1;
+}
+
+void
+t_minmax_index::erase_value(t_column_minmax& column, const t_tscalar& value) {
+    auto iter = column.m_counts.find(value);
+    if (iter == column.m_counts.end()) {
+        return;
+    }
+
+    if (--iter->second == 0) {
+        column.m_counts.erase(iter);
+    }
+}
+
+} // end namespace perspective
@@ -12,73 +12,203 @@
 #include <perspective/base.h>
 #include <perspective/multi_sort.h>
 #include <perspective/scalar.h>
+#include <cstring>
 #include <vector>
 
 namespace perspective {
 
+const t_uindex t_sortkey::CAPACITY;
+
+t_sortkey::t_sortkey()
+    : m_size(0)
+    , m_partial(0)
+    , m_keyed(false) {}
+
+static inline std::uint64_t
+encode_sort_int(std::int64_t value) {
+    return static_cast<std::uint64_t>(value) ^ (std::uint64_t(1) << 63);
+}
+
+static inline std::uint64_t
+encode_sort_double(double value) {
+    // -0.0 and 0.0 compare equal, so they must encode equal.
+    if (value == 0) {
+        value = 0;
+    }
+
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return (bits >> 63) ? ~bits : bits | (std::uint64_t(1) << 63);
+}
+
+// Big-endian string prefix, so unsigned word order is `strcmp` order on
+// the first 8 bytes.
+static inline std::uint64_t
+encode_sort_prefix(const char* str, bool& partial) {
+    std::uint64_t word = 0;
+    t_uindex len = 0;
+
+    for (; str != nullptr && len < 8 && str[len] != '\0'; ++len) {
+        word |= std::uint64_t(static_cast<unsigned char>(str[len]))
+            << (56 - 8 * len);
+    }
+
+    partial = len == 8;
+    return word;
+}
+
+bool
+encode_sort_key(const std::vector<t_tscalar>& row,
+    const std::vector<t_sorttype>& sort_order, t_sortkey& out_key) {
+    out_key.m_keyed = false;
+    out_key.m_size = 0;
+    out_key.m_partial = 0;
+
+    if (row.size() != sort_order.size()
+        || sort_order.size() > t_sortkey::CAPACITY) {
+        return false;
+    }
+
+    for (t_uindex idx = 0, loop_end = row.size(); idx < loop_end; ++idx) {
+        const t_tscalar& value = row[idx];
+        t_sorttype order = sort_order[idx];
+
+        if (order != SORTTYPE_ASCENDING && order != SORTTYPE_DESCENDING) {
+            return false;
+        }
+
+        // NaN sorts below every other value of its dtype, then status
+        // and value as in `t_tscalar::operator<`.
+        bool is_nan
+            = value.is_floating_point() && std::isnan(value.to_double());
+        std::uint8_t tag = (value.m_type << 3)
+            | (is_nan ? 0 : 1 + static_cast<std::uint8_t>(value.m_status));
+        std::uint64_t word = 0;
+        bool partial = false;
+
+        switch (value.m_type) {
+            case DTYPE_INT64:
+            case DTYPE_TIME: {
+                word = encode_sort_int(value.m_data.m_int64);
+            } break;
+            case DTYPE_INT32: {
+                word = encode_sort_int(value.m_data.m_int32);
+            } break;
+            case DTYPE_INT16: {
+                word = encode_sort_int(value.m_data.m_int16);
+            } break;
+            case DTYPE_INT8: {
+                word = encode_sort_int(value.m_data.m_int8);
+            } break;
+            case DTYPE_UINT32:
+            case DTYPE_DATE: {
+                word = value.m_data.m_uint32;
+            } break;
+            case DTYPE_UINT16: {
+                word = value.m_data.m_uint16;
+            } break;
+            case DTYPE_UINT8: {
+                word = value.m_data.m_uint8;
+            } break;
+            case DTYPE_BOOL: {
+                word = value.m_data.m_bool ? 1 : 0;
+            } break;
+            case DTYPE_FLOAT64: {
+                word = is_nan ? 0 : encode_sort_double(value.m_data.m_float64);
+            } break;
+            case DTYPE_FLOAT32: {
+                word = is_nan ? 0 : encode_sort_double(value.m_data.m_float32);
+            } break;
+            case DTYPE_NONE: {
+                word = 0;
+            } break;
+            case DTYPE_STR: {
+                word = encode_sort_prefix(value.get_char_ptr(), partial);
+            } break;
+            default: {
+                word = value.m_data.m_uint64;
+            } break;
+        }
+
+        if (order == SORTTYPE_DESCENDING) {
+            tag = ~tag;
+            word = ~word;
+        }
+
+        out_key.m_tags[idx] = tag;
+        out_key.m_words[idx] = word;
+
+        if (partial) {
+            out_key.m_partial |= 1 << idx;
+        }
+    }
+
+    out_key.m_size = row.size();
+    out_key.m_keyed = true;
+    return true;
+}
+
 t_mselem::t_mselem()
     : m_pkey(mknone())
-    , m_order(0)
-    , m_deleted(false)
-    , m_updated(false) {}
+    , m_order(0) {}
 
 t_mselem::t_mselem(const std::vector<t_tscalar>& row)
-    : m_row(row)
-    , m_pkey(mknone())
+    : m_pkey(mknone())
     , m_order(0)
-    , m_deleted(false)
-    , m_updated(false) {}
+    , m_row(new std::vector<t_tscalar>(row)) {}
 
 t_mselem::t_mselem(const std::vector<t_tscalar>& row, t_uindex order)
-    : m_row(row)
-    , m_pkey(mknone())
+    : m_pkey(mknone())
     , m_order(order)
-    , m_deleted(false)
-    , m_updated(false) {}
+    , m_row(new std::vector<t_tscalar>(row)) {}
 
 t_mselem::t_mselem(const t_tscalar& pkey, const std::vector<t_tscalar>& row)
-    : m_row(row)
-    , m_pkey(pkey)
+    : m_pkey(pkey)
     , m_order(0)
-    , m_deleted(false)
-    , m_updated(false) {}
+    , m_row(new std::vector<t_tscalar>(row)) {}
 
-t_mselem::t_mselem(const t_mselem& other) {
-    m_pkey = other.m_pkey;
-    m_row = other.m_row;
-    m_deleted = other.m_deleted;
-    m_updated = other.m_updated;
-    m_order = other.m_order;
-}
+t_mselem::t_mselem(const t_mselem& other)
+    : m_key(other.m_key)
+    , m_pkey(other.m_pkey)
+    , m_order(other.m_order)
+    , m_row(other.m_row ? new std::vector<t_tscalar>(*other.m_row)
+                        : nullptr) {}
 
-t_mselem::t_mselem(t_mselem&& other) {
-    m_pkey = other.m_pkey;
-    m_row = std::move(other.m_row);
-    m_deleted = other.m_deleted;
-    m_updated = other.m_updated;
-    m_order = other.m_order;
-}
+t_mselem::t_mselem(t_mselem&& other)
+    : m_key(other.m_key)
+    , m_pkey(other.m_pkey)
+    , m_order(other.m_order)
+    , m_row(std::move(other.m_row)) {}
 
 t_mselem&
 t_mselem::operator=(const t_mselem& other) {
+    m_key = other.m_key;
     m_pkey = other.m_pkey;
-    m_row = other.m_row;
-    m_deleted = other.m_deleted;
     m_order = other.m_order;
-    m_updated = other.m_updated;
+    m_row.reset(
+        other.m_row ? new std::vector<t_tscalar>(*other.m_row) : nullptr);
     return *this;
 }
 
 t_mselem&
 t_mselem::operator=(t_mselem&& other) {
+    m_key = other.m_key;
     m_pkey = other.m_pkey;
-    m_row = std::move(other.m_row);
-    m_deleted = other.m_deleted;
-    m_updated = other.m_updated;
     m_order = other.m_order;
+    m_row = std::move(other.m_row);
     return *this;
 }
 
+void
+t_mselem::set_row(const std::vector<t_tscalar>& row,
+    const std::vector<t_sorttype>& sort_order) {
+    if (encode_sort_key(row, sort_order, m_key) && m_key.m_partial == 0) {
+        m_row.reset();
+    } else {
+        m_row.reset(new std::vector<t_tscalar>(row));
+    }
+}
+
 t_minmax_idx::t_minmax_idx(t_index mn, t_index mx)
     : m_min(mn)
     , m_max(mx) {}
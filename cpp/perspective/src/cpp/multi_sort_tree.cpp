@@ -0,0 +1,136 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2017, the Perspective Authors.
+ *
+ * This file is part of the Perspective library, distributed under the terms of
+ * the Apache License 2.0.  The full license can be found in the LICENSE file.
+ *
+ */
+
+#include <perspective/first.h>
+#include <perspective/multi_sort_tree.h>
+
+namespace perspective {
+
+static const t_uindex NO_NODE = static_cast<t_uindex>(INVALID_INDEX);
+
+t_mstree::t_mstree()
+    : m_sorter(std::vector<t_sorttype>()) {}
+
+void
+t_mstree::set_sort_orders(const std::vector<t_sorttype>& sort_orders) {
+    m_sorter = t_multisorter(sort_orders);
+}
+
+void
+t_mstree::clear() {
+    m_treap.clear();
+    m_elems.clear();
+}
+
+t_uindex
+t_mstree::size() const {
+    return m_treap.size();
+}
+
+void
+t_mstree::build(std::vector<t_mselem>& elems) {
+    clear();
+
+    t_uindex nelems = elems.size();
+    std::vector<t_uindex> nidxs(nelems);
+    m_elems.reserve(nelems);
+
+    for (t_uindex idx = 0; idx < nelems; ++idx) {
+        nidxs[idx] = m_treap.alloc();
+        m_elems.push_back(std::move(elems[idx]));
+    }
+
+    m_treap.build(nidxs);
+    elems.clear();
+}
+
+t_uindex
+t_mstree::insert(const t_mselem& elem) {
+    // Rank of the first row ordered after `elem`, so equal rows keep their
+    // insertion order.
+    t_uindex rank = 0;
+    t_uindex cur = m_treap.root();
+
+    while (cur != NO_NODE) {
+        if (m_sorter(elem, m_elems[cur])) {
+            cur = m_treap.left(cur);
+        } else {
+            rank += m_treap.subtree_size(m_treap.left(cur)) + 1;
+            cur = m_treap.right(cur);
+        }
+    }
+
+    t_uindex nidx = alloc(elem);
+    m_treap.insert(rank, std::vector<t_uindex>{nidx});
+    return nidx;
+}
+
+void
+t_mstree::erase(t_uindex nidx) {
+    std::vector<t_uindex> erased;
+    t_uindex rank = m_treap.rank(nidx);
+    m_treap.erase(rank, rank + 1, erased);
+    m_elems[nidx] = t_mselem();
+}
+
+const t_mselem&
+t_mstree::get(t_uindex nidx) const {
+    return m_elems[nidx];
+}
+
+t_uindex
+t_mstree::at(t_uindex rank) const {
+    return m_treap.at(rank);
+}
+
+t_uindex
+t_mstree::rank(t_uindex nidx) const {
+    return m_treap.rank(nidx);
+}
+
+t_uindex
+t_mstree::next(t_uindex nidx) const {
+    return m_treap.next(nidx);
+}
+
+t_uindex
+t_mstree::lower_bound(const t_mselem& elem) const {
+    t_uindex rval = 0;
+    t_uindex cur = m_treap.root();
+
+    while (cur != NO_NODE) {
+        if (m_sorter(m_elems[cur], elem)) {
+            rval += m_treap.subtree_size(m_treap.left(cur)) + 1;
+            cur = m_treap.right(cur);
+        } else {
+            cur = m_treap.left(cur);
+        }
+    }
+
+    return rval;
+}
+
+bool
+t_mstree::less(const t_mselem& a, const t_mselem& b) const {
+    return m_sorter(a, b);
+}
+
+t_uindex
+t_mstree::alloc(const t_mselem& elem) {
+    t_uindex nidx = m_treap.alloc();
+
+    if (nidx >= m_elems.size()) {
+        m_elems.resize(nidx + 1);
+    }
+
+    m_elems[nidx] = elem;
+    return nidx;
+}
+
+} // end namespace perspective
@@ -13,8 +13,11 @@ namespace perspective {
 
 RE2*
 t_regex_mapping::intern(const std::string& pattern) {
-    if (m_regex_map.count(pattern) == 1) {
-        return m_regex_map[pattern].get();
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    auto iter = m_regex_map.find(pattern);
+    if (iter != m_regex_map.end()) {
+        return iter->second.get();
     }
 
     std::shared_ptr<RE2> compiled_pattern
@@ -31,6 +34,7 @@ t_regex_mapping::intern(const std::string& pattern) {
 
 void
 t_regex_mapping::clear() {
+    std::lock_guard<std::mutex> guard(m_mutex);
     m_regex_map.clear();
 }
 
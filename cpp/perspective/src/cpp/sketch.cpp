@@ -0,0 +1,381 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2017, the Perspective Authors.
+ *
+ * This file is part of the Perspective library, distributed under the terms of
+ * the Apache License 2.0.  The full license can be found in the LICENSE file.
+ *
+ */
+
+#include <perspective/first.h>
+#include <perspective/sketch.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace perspective {
+
+namespace {
+    // `hash_value` is tuned for hash tables, not for HyperLogLog, which
+    // needs every bit of the hash to be uniformly distributed - run it
+    // through the splitmix64 finalizer first.
+    inline std::uint64_t
+    mix_hash(std::uint64_t h) {
+        h ^= h >> 30;
+        h *= 0xbf58476d1ce4e5b9ULL;
+        h ^= h >> 27;
+        h *= 0x94d049bb133111ebULL;
+        h ^= h >> 31;
+        return h;
+    }
+
+    const double TDIGEST_PI = 3.14159265358979323846;
+
+    // The k1 scale function and its inverse, which bound how much weight a
+    // single centroid may hold at a given quantile.
+    inline double
+    tdigest_k(double q) {
+        return (double(t_tdigest::TDIGEST_COMPRESSION) / (2 * TDIGEST_PI))
+            * std::asin(2 * q - 1);
+    }
+
+    inline double
+    tdigest_k_inverse(double k) {
+        return (std::sin(
+                    k * (2 * TDIGEST_PI)
+                    / double(t_tdigest::TDIGEST_COMPRESSION))
+                   + 1)
+            / 2;
+    }
+} // namespace
+
+const std::uint32_t t_hll_sketch::HLL_PRECISION;
+const std::uint32_t t_hll_sketch::HLL_NUM_REGISTERS;
+const std::uint32_t t_hll_sketch::HLL_SPARSE_MAX;
+const t_uindex t_tdigest::TDIGEST_COMPRESSION;
+
+t_hll_sketch::t_hll_sketch() {}
+
+void
+t_hll_sketch::add(const t_tscalar& value) {
+    add_hash(mix_hash(hash_value(value)));
+}
+
+void
+t_hll_sketch::add_hash(std::uint64_t hash) {
+    std::uint32_t ridx = hash >> (64 - HLL_PRECISION);
+
+    // rank = position of the first set bit in the remaining bits, bounded
+    // by the number of bits left after taking the register index.
+    std::uint64_t rest = hash << HLL_PRECISION;
+    std::uint8_t rank = 1;
+    std::uint8_t max_rank = 64 - HLL_PRECISION + 1;
+
+    while (rank < max_rank && !(rest & 0x8000000000000000ULL)) {
+        ++rank;
+        rest <<= 1;
+    }
+
+    set_register(ridx, rank);
+}
+
+void
+t_hll_sketch::merge(const t_hll_sketch& other) {
+    if (!other.m_registers.empty()) {
+        make_dense();
+
+        for (t_uindex idx = 0; idx < HLL_NUM_REGISTERS; ++idx) {
+            m_registers[idx]
+                = std::max(m_registers[idx], other.m_registers[idx]);
+        }
+
+        return;
+    }
+
+    if (other.m_sparse.empty()) {
+        return;
+    }
+
+    if (m_registers.empty() && m_sparse.empty()) {
+        m_sparse = other.m_sparse;
+        return;
+    }
+
+    if (!m_registers.empty()) {
+        for (std::uint32_t entry : other.m_sparse) {
+            set_register(entry >> 8, entry & 0xFF);
+        }
+
+        return;
+    }
+
+    // Both lists are sorted by register index, so they merge in one pass,
+    // keeping the larger rank of a register set in both.
+    std::vector<std::uint32_t> merged;
+    merged.reserve(m_sparse.size() + other.m_sparse.size());
+    auto left = m_sparse.begin();
+    auto right = other.m_sparse.begin();
+
+    while (left != m_sparse.end() || right != other.m_sparse.end()) {
+        if (right == other.m_sparse.end()
+            || (left != m_sparse.end() && (*left >> 8) < (*right >> 8))) {
+            merged.push_back(*left++);
+        } else if (left == m_sparse.end() || (*right >> 8) < (*left >> 8)) {
+            merged.push_back(*right++);
+        } else {
+            merged.push_back(std::max(*left++, *right++));
+        }
+    }
+
+    m_sparse.swap(merged);
+
+    if (m_sparse.size() > HLL_SPARSE_MAX) {
+        make_dense();
+    }
+}
+
+void
+t_hll_sketch::clear() {
+    std::vector<std::uint32_t>().swap(m_sparse);
+    std::vector<std::uint8_t>().swap(m_registers);
+}
+
+bool
+t_hll_sketch::empty() const {
+    return m_sparse.empty() && m_registers.empty();
+}
+
+double
+t_hll_sketch::estimate() const {
+    if (empty()) {
+        return 0;
+    }
+
+    double m = HLL_NUM_REGISTERS;
+    double alpha = 0.7213 / (1 + 1.079 / m);
+    double sum = 0;
+    t_uindex zeros = 0;
+
+    if (m_registers.empty()) {
+        // Every register missing from the list is zero.
+        zeros = HLL_NUM_REGISTERS - m_sparse.size();
+        sum = double(zeros);
+
+        for (std::uint32_t entry : m_sparse) {
+            sum += std::ldexp(1.0, -static_cast<int>(entry & 0xFF));
+        }
+    } else {
+        for (auto reg : m_registers) {
+            sum += std::ldexp(1.0, -static_cast<int>(reg));
+            if (reg == 0) {
+                ++zeros;
+            }
+        }
+    }
+
+    double estimate = alpha * m * m / sum;
+
+    // Linear counting is far more accurate for small cardinalities.
+    if (estimate <= 2.5 * m && zeros > 0) {
+        estimate = m * std::log(m / double(zeros));
+    }
+
+    return estimate;
+}
+
+void
+t_hll_sketch::set_register(std::uint32_t ridx, std::uint8_t rank) {
+    if (!m_registers.empty()) {
+        if (rank > m_registers[ridx]) {
+            m_registers[ridx] = rank;
+        }
+
+        return;
+    }
+
+    std::uint32_t entry = (ridx << 8) | rank;
+    auto iter = std::lower_bound(m_sparse.begin(), m_sparse.end(), ridx << 8);
+
+    if (iter != m_sparse.end() && (*iter >> 8) == ridx) {
+        *iter = std::max(*iter, entry);
+        return;
+    }
+
+    m_sparse.insert(iter, entry);
+
+    if (m_sparse.size() > HLL_SPARSE_MAX) {
+        make_dense();
+    }
+}
+
+void
+t_hll_sketch::make_dense() {
+    if (!m_registers.empty()) {
+        return;
+    }
+
+    m_registers.resize(HLL_NUM_REGISTERS, 0);
+
+    for (std::uint32_t entry : m_sparse) {
+        m_registers[entry >> 8] = entry & 0xFF;
+    }
+
+    std::vector<std::uint32_t>().swap(m_sparse);
+}
+
+t_tdigest::t_tdigest()
+    : m_total_weight(0)
+    , m_min(std::numeric_limits<double>::infinity())
+    , m_max(-std::numeric_limits<double>::infinity()) {}
+
+void
+t_tdigest::add(double value) {
+    if (std::isnan(value)) {
+        return;
+    }
+
+    m_unmerged.push_back(t_centroid{value, 1});
+    m_total_weight += 1;
+    m_min = std::min(m_min, value);
+    m_max = std::max(m_max, value);
+
+    if (m_unmerged.size() >= 5 * TDIGEST_COMPRESSION) {
+        compress();
+    }
+}
+
+void
+t_tdigest::merge(const t_tdigest& other) {
+    if (other.empty()) {
+        return;
+    }
+
+    m_unmerged.insert(m_unmerged.end(), other.m_centroids.begin(),
+        other.m_centroids.end());
+    m_unmerged.insert(
+        m_unmerged.end(), other.m_unmerged.begin(), other.m_unmerged.end());
+    m_total_weight += other.m_total_weight;
+    m_min = std::min(m_min, other.m_min);
+    m_max = std::max(m_max, other.m_max);
+
+    if (m_unmerged.size() >= 5 * TDIGEST_COMPRESSION) {
+        compress();
+    }
+}
+
+void
+t_tdigest::clear() {
+    std::vector<t_centroid>().swap(m_centroids);
+    std::vector<t_centroid>().swap(m_unmerged);
+    m_total_weight = 0;
+    m_min = std::numeric_limits<double>::infinity();
+    m_max = -std::numeric_limits<double>::infinity();
+}
+
+bool
+t_tdigest::empty() const {
+    return m_total_weight == 0;
+}
+
+void
+t_tdigest::compress() {
+    if (m_unmerged.empty()) {
+        return;
+    }
+
+    std::vector<t_centroid> all;
+    all.reserve(m_centroids.size() + m_unmerged.size());
+    all.insert(all.end(), m_centroids.begin(), m_centroids.end());
+    all.insert(all.end(), m_unmerged.begin(), m_unmerged.end());
+    m_unmerged.clear();
+
+    std::sort(all.begin(), all.end(),
+        [](const t_centroid& a, const t_centroid& b) {
+            return a.m_mean < b.m_mean;
+        });
+
+    std::vector<t_centroid> merged;
+    merged.reserve(2 * TDIGEST_COMPRESSION);
+
+    double total = m_total_weight;
+    double weight_so_far = 0;
+    double q_limit = tdigest_k_inverse(tdigest_k(0) + 1);
+    t_centroid current = all[0];
+
+    for (t_uindex idx = 1, loop_end = all.size(); idx < loop_end; ++idx) {
+        const t_centroid& next = all[idx];
+        double q = (weight_so_far + current.m_weight + next.m_weight) / total;
+
+        if (q <= q_limit) {
+            current.m_weight += next.m_weight;
+            current.m_mean += (next.m_mean - current.m_mean) * next.m_weight
+                / current.m_weight;
+        } else {
+            weight_so_far += current.m_weight;
+            merged.push_back(current);
+            q_limit = tdigest_k_inverse(tdigest_k(weight_so_far / total) + 1);
+            current = next;
+        }
+    }
+
+    merged.push_back(current);
+    std::swap(m_centroids, merged);
+}
+
+double
+t_tdigest::quantile(double q) {
+    compress();
+
+    if (m_centroids.empty()) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+
+    q = std::max(0.0, std::min(1.0, q));
+
+    if (m_centroids.size() == 1 || q == 0) {
+        return q == 1 ? m_max : (q == 0 ? m_min : m_centroids[0].m_mean);
+    }
+
+    if (q == 1) {
+        return m_max;
+    }
+
+    double index = q * m_total_weight;
+
+    // Each centroid is treated as being centered on its cumulative weight;
+    // interpolate between neighbouring centers, and between the outermost
+    // centers and the exact min/max.
+    const t_centroid& first = m_centroids.front();
+    if (index < first.m_weight / 2) {
+        return m_min
+            + (first.m_mean - m_min) * (index / (first.m_weight / 2));
+    }
+
+    double weight_so_far = first.m_weight / 2;
+
+    for (t_uindex idx = 0, loop_end = m_centroids.size() - 1; idx < loop_end;
+         ++idx) {
+        const t_centroid& left = m_centroids[idx];
+        const t_centroid& right = m_centroids[idx + 1];
+        double gap = (left.m_weight + right.m_weight) / 2;
+
+        if (index < weight_so_far + gap) {
+            double t = (index - weight_so_far) / gap;
+            return left.m_mean + (right.m_mean - left.m_mean) * t;
+        }
+
+        weight_so_far += gap;
+    }
+
+    const t_centroid& last = m_centroids.back();
+    double tail = m_total_weight - weight_so_far;
+
+    if (tail <= 0) {
+        return m_max;
+    }
+
+    return last.m_mean
+        + (m_max - last.m_mean) * std::min(1.0, (index - weight_so_far) / tail);
+}
+
+} // end namespace perspective
@@ -10,6 +10,7 @@
 #include <perspective/first.h>
 #include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <fstream>
 #include <perspective/base.h>
 #include <perspective/compat.h>
@@ -27,7 +28,9 @@
 #include <perspective/data_table.h>
 #include <perspective/filter_utils.h>
 #include <perspective/context_two.h>
+#include <perspective/parallel_for.h>
 #include <set>
+#include <type_traits>
 
 namespace perspective {
 
@@ -73,6 +76,15 @@ t_tree_unify_rec::t_tree_unify_rec(
     , m_saggidx(saggidx)
     , m_nstrands(nstrands) {}
 
+const t_uindex t_stree::AGG_UPDATE_CHUNK_SIZE;
+const t_uindex t_stree::AGG_UPDATE_PARALLEL_MIN_RECORDS;
+
+t_agg_update_deltas::t_agg_update_deltas()
+    : m_has_delta(false) {}
+
+t_sketch_inserts::t_sketch_inserts()
+    : m_fold(false) {}
+
 t_stree::t_stree(const std::vector<t_pivot>& pivots,
     const std::vector<t_aggspec>& aggspecs, const t_schema& schema,
     const t_config& cfg)
@@ -82,7 +94,8 @@ t_stree::t_stree(const std::vector<t_pivot>& pivots,
     , m_aggspecs(aggspecs)
     , m_schema(schema)
     , m_cur_aggidx(1)
-    , m_has_delta(false) {
+    , m_has_delta(false)
+    , m_num_contexts(0) {
     auto g_agg_str = cfg.get_grand_agg_str();
     m_grand_agg_str = g_agg_str.empty() ? "Grand Aggregate" : g_agg_str;
 }
@@ -108,9 +121,11 @@ t_stree::repr() const {
 
 void
 t_stree::init() {
-    m_nodes = std::make_shared<t_treenodes>();
-    m_idxpkey = std::make_shared<t_idxpkey>();
-    m_idxleaf = std::make_shared<t_idxleaf>();
+    m_nodes = std::make_shared<t_stnodes>();
+    m_pkeys.clear();
+    m_rows.clear();
+    m_leaves.clear();
+    m_last_step = t_stree_step();
 
     t_tscalar value = m_symtable.get_interned_tscalar(m_grand_agg_str.c_str());
     t_tnode node(0, root_pidx(), value, 0, value, 1, 0);
@@ -148,18 +163,12 @@ t_stree::init() {
 
 t_tscalar
 t_stree::get_value(t_index idx) const {
-    iter_by_idx iter = m_nodes->get<by_idx>().find(idx);
-    PSP_VERBOSE_ASSERT(
-        iter != m_nodes->get<by_idx>().end(), "Reached end iterator");
-    return iter->m_value;
+    return m_nodes->get_value(idx);
 }
 
 t_tscalar
 t_stree::get_sortby_value(t_index idx) const {
-    iter_by_idx iter = m_nodes->get<by_idx>().find(idx);
-    PSP_VERBOSE_ASSERT(
-        iter != m_nodes->get<by_idx>().end(), "Reached end iterator");
-    return iter->m_sort_value;
+    return m_nodes->get_sort_value(idx);
 }
 
 void
@@ -641,8 +650,8 @@ t_stree::pivots_changed(t_value_transition t) const {
 
 void
 t_stree::populate_pkey_idx(const t_dtree_ctx& ctx, const t_dtree& dtree,
-    t_uindex dptidx, t_uindex sptidx, t_uindex ndepth,
-    t_idxpkey& new_idx_pkey) {
+    const t_gstate& gstate, t_uindex dptidx, t_uindex sptidx,
+    t_uindex ndepth, std::vector<t_stpkey>& new_pkeys) {
     if (ndepth == dtree.last_level()) {
         auto pkey_col = ctx.get_pkey_col();
         auto strand_count_col = ctx.get_strand_count_col();
@@ -659,8 +668,10 @@ t_stree::populate_pkey_idx(const t_dtree_ctx& ctx, const t_dtree& dtree,
             // Checks the strand count and adds a new primary key if it's
             // increased.
             if (strand_count > 0) {
-                t_stpkey s(sptidx, pkey);
-                new_idx_pkey.insert(s);
+                t_rlookup lookup = gstate.lookup(pkey);
+                PSP_VERBOSE_ASSERT(
+                    lookup.m_exists, "Primary key missing from gstate");
+                new_pkeys.push_back(t_stpkey(sptidx, pkey, lookup.m_idx));
             }
 
             if (strand_count < 0) {
@@ -671,7 +682,8 @@ t_stree::populate_pkey_idx(const t_dtree_ctx& ctx, const t_dtree& dtree,
 }
 
 void
-t_stree::update_shape_from_static(const t_dtree_ctx& ctx) {
+t_stree::update_shape_from_static(
+    const t_dtree_ctx& ctx, const t_gstate& gstate) {
 
     m_newids.clear();
     m_newleaves.clear();
@@ -689,26 +701,23 @@ t_stree::update_shape_from_static(const t_dtree_ctx& ctx) {
     t_filter filter;
 
     // update root
-    auto root_iter = m_nodes->get<by_idx>().find(0);
-    auto root_node = *root_iter;
-
     // scount = summed strand count
     t_index root_nstrands
-        = *(scount->get_nth<t_index>(0)) + root_node.m_nstrands;
-    root_node.set_nstrands(std::max(root_nstrands, (t_index)1));
-    m_nodes->get<by_idx>().replace(root_iter, root_node);
+        = *(scount->get_nth<t_index>(0)) + m_nodes->get_nstrands(0);
+    m_nodes->set_nstrands(0, std::max(root_nstrands, (t_index)1));
 
     t_tree_unify_rec unif_rec(0, 0, 0, root_nstrands);
     m_tree_unification_records.push_back(unif_rec);
 
-    t_idxpkey new_idx_pkey;
+    std::vector<t_stpkey> new_pkeys;
 
     for (auto dptidx : dtree.dfs()) {
         t_uindex sptidx = 0;
         t_depth ndepth = dtree.get_depth(dptidx);
 
         if (dptidx == 0) {
-            populate_pkey_idx(ctx, dtree, dptidx, sptidx, ndepth, new_idx_pkey);
+            populate_pkey_idx(
+                ctx, dtree, gstate, dptidx, sptidx, ndepth, new_pkeys);
             continue;
         }
 
@@ -723,16 +732,15 @@ t_stree::update_shape_from_static(const t_dtree_ctx& ctx) {
 
         t_uindex src_ridx = dptidx;
 
-        auto iter = m_nodes->get<by_pidx_hash>().find(
-            std::make_tuple(p_sptidx, value));
+        t_uindex existing = m_nodes->find_child(p_sptidx, value);
 
         auto nstrands = *(scount->get_nth<std::int64_t>(dptidx));
 
-        if (iter == m_nodes->get<by_pidx_hash>().end() && nstrands < 0) {
+        if (existing == t_stnodes::NO_CHILD && nstrands < 0) {
             continue;
         }
 
-        if (iter == m_nodes->get<by_pidx_hash>().end()) {
+        if (existing == t_stnodes::NO_CHILD) {
             // create node and enqueue
             sptidx = genidx();
             t_uindex aggsize = m_aggregates->size();
@@ -753,47 +761,39 @@ t_stree::update_shape_from_static(const t_dtree_ctx& ctx) {
                 m_newleaves.insert(sptidx);
             }
 
-            auto insert_pair = m_nodes->insert(node);
-            if (!insert_pair.second) {
-                auto failed_because = *(insert_pair.first);
-                std::cout << "failed because of " << failed_because
-                          << std::endl;
+            bool inserted = m_nodes->insert(node);
+            if (!inserted) {
+                std::cout << "failed to insert " << node << std::endl;
             }
-            PSP_VERBOSE_ASSERT(insert_pair.second, "Failed to insert node");
+            PSP_VERBOSE_ASSERT(inserted, "Failed to insert node");
             t_tree_unify_rec unif_rec(sptidx, src_ridx, dst_ridx, nstrands);
             m_tree_unification_records.push_back(unif_rec);
         } else {
-            sptidx = iter->m_idx;
+            sptidx = existing;
 
             // update node
-            t_tnode node = *iter;
-            node.set_sort_value(sortby_value);
+            m_nodes->set_sort_value(sptidx, sortby_value);
 
-            t_uindex dst_ridx = node.m_aggidx;
+            t_uindex dst_ridx = m_nodes->get_aggidx(sptidx);
 
-            nstrands = node.m_nstrands + nstrands;
+            nstrands = m_nodes->get_nstrands(sptidx) + nstrands;
 
             t_tree_unify_rec unif_rec(sptidx, src_ridx, dst_ridx, nstrands);
             m_tree_unification_records.push_back(unif_rec);
 
-            sptidx = iter->m_idx;
-            node.set_nstrands(nstrands);
-            PSP_VERBOSE_ASSERT(m_nodes->get<by_pidx_hash>().replace(iter, node),
-                ,
-                "Failed to replace"); // middle argument ignored
+            m_nodes->set_nstrands(sptidx, nstrands);
         }
 
-        populate_pkey_idx(ctx, dtree, dptidx, sptidx, ndepth, new_idx_pkey);
+        populate_pkey_idx(
+            ctx, dtree, gstate, dptidx, sptidx, ndepth, new_pkeys);
         nmap[dptidx] = sptidx;
     }
 
-    auto biter = new_idx_pkey.get<by_idx_pkey>().begin();
-    auto eiter = new_idx_pkey.get<by_idx_pkey>().end();
+    // New nodes and sort value changes only mark their parent's child range
+    // as unsorted; sort each touched range once here.
+    m_nodes->sort_children();
 
-    for (auto iter = biter; iter != eiter; ++iter) {
-        t_stpkey s(iter->m_idx, iter->m_pkey);
-        m_idxpkey->insert(s);
-    }
+    add_pkeys(new_pkeys);
 
     mark_zero_desc();
 }
@@ -809,16 +809,13 @@ t_stree::mark_zero_desc() {
     }
 
     for (auto n : z_desc) {
-        auto iter = m_nodes->get<by_idx>().find(n);
-        auto node = *iter;
-        node.set_nstrands(0);
-        m_nodes->get<by_idx>().replace(iter, node);
+        m_nodes->set_nstrands(n, 0);
     }
 }
 
 void
 t_stree::update_aggs_from_static(const t_dtree_ctx& ctx, const t_gstate& gstate,
-    const t_data_table& expression_master_table) {
+    const t_data_table& expression_master_table, bool inserts_only) {
     const t_data_table& src_aggtable = ctx.get_aggtable();
 
     t_agg_update_info agg_update_info;
@@ -880,13 +877,524 @@ t_stree::update_aggs_from_static(const t_dtree_ctx& ctx, const t_gstate& gstate,
         }
     }
 
+    std::vector<t_uindex> plain_cols;
+    std::vector<t_uindex> scaled_cols;
+    std::vector<t_uindex> sketch_cols;
+
+    for (auto idx : cols_topo_sorted) {
+        if (agg_update_info.m_aggspecs[idx].is_sketch_agg()) {
+            sketch_cols.push_back(idx);
+        } else if (is_col_scaled_aggregate(idx)) {
+            scaled_cols.push_back(idx);
+        } else {
+            plain_cols.push_back(idx);
+        }
+    }
+
+    // Order the records that still exist by depth, deepest first, keeping
+    // DFS order within a depth. `level_ends[depth]` is one past the last
+    // record at `depth`.
+    std::vector<std::vector<const t_tree_unify_rec*>> levels;
+
     for (const auto& r : m_tree_unification_records) {
         if (!node_exists(r.m_sptidx)) {
             continue;
         }
 
-        update_agg_table(r.m_sptidx, agg_update_info, r.m_daggidx, r.m_saggidx,
-            r.m_nstrands, gstate, expression_master_table);
+        t_depth depth = m_nodes->get_depth(r.m_sptidx);
+        if (depth >= levels.size()) {
+            levels.resize(depth + 1);
+        }
+
+        levels[depth].push_back(&r);
+    }
+
+    std::vector<const t_tree_unify_rec*> records;
+    std::vector<t_uindex> level_ends(levels.size());
+
+    for (t_uindex depth = levels.size(); depth-- > 0;) {
+        records.insert(records.end(), levels[depth].begin(), levels[depth].end());
+        level_ends[depth] = records.size();
+    }
+
+    // Every record writes its own aggregate row, so different records
+    // never write the same cell and columns of a stage never read each
+    // other: scaled aggregates read the plain columns of the same row, so
+    // they run as a second stage.
+    std::vector<t_agg_update_task> tasks;
+    make_agg_update_tasks(
+        agg_update_info, plain_cols, 0, records.size(), tasks);
+    run_agg_update_tasks(agg_update_info, records, tasks, nullptr, gstate,
+        expression_master_table);
+
+    tasks.clear();
+    make_agg_update_tasks(
+        agg_update_info, scaled_cols, 0, records.size(), tasks);
+    run_agg_update_tasks(agg_update_info, records, tasks, nullptr, gstate,
+        expression_master_table);
+
+    if (sketch_cols.empty()) {
+        return;
+    }
+
+    // Sketches are sized up front so tasks can index them concurrently.
+    for (auto idx : sketch_cols) {
+        switch (agg_update_info.m_aggspecs[idx].agg()) {
+            case AGGTYPE_APPROX_DISTINCT: {
+                auto& sketches = m_hll_sketches[idx];
+                if (sketches.size() < m_cur_aggidx) {
+                    sketches.resize(m_cur_aggidx);
+                }
+            } break;
+            case AGGTYPE_APPROX_PERCENTILE: {
+                auto& digests = m_tdigests[idx];
+                if (digests.size() < m_cur_aggidx) {
+                    digests.resize(m_cur_aggidx);
+                }
+            } break;
+            default: {
+                PSP_COMPLAIN_AND_ABORT("Not a sketch aggregate");
+            }
+        }
+    }
+
+    // Every row a node held before is unchanged, so its sketches only need
+    // the rows this update added under it. New nodes are built as before.
+    std::vector<t_sketch_inserts> sketch_inserts(records.size());
+
+    if (inserts_only) {
+        auto pkey_col = ctx.get_pkey_col();
+
+        for (t_uindex ridx = 0, loop_end = records.size(); ridx < loop_end;
+             ++ridx) {
+            const t_tree_unify_rec& r = *records[ridx];
+            if (m_newids.count(r.m_sptidx) != 0) {
+                continue;
+            }
+
+            t_sketch_inserts& inserts = sketch_inserts[ridx];
+            inserts.m_fold = true;
+            auto liters = ctx.get_leaf_iterators(r.m_daggidx);
+
+            for (auto lfiter = liters.first; lfiter != liters.second;
+                 ++lfiter) {
+                t_rlookup lookup = gstate.lookup(pkey_col->get_scalar(*lfiter));
+                if (lookup.m_exists) {
+                    inserts.m_rows.push_back(lookup.m_idx);
+                }
+            }
+        }
+    }
+
+    // A parent's sketch merges its children's, so sketches are built one
+    // depth at a time, bottom-up.
+    t_uindex level_begin = 0;
+    for (t_uindex depth = levels.size(); depth-- > 0;) {
+        tasks.clear();
+        make_agg_update_tasks(agg_update_info, sketch_cols, level_begin,
+            level_ends[depth], tasks);
+        run_agg_update_tasks(agg_update_info, records, tasks, &sketch_inserts,
+            gstate, expression_master_table);
+        level_begin = level_ends[depth];
+    }
+}
+
+void
+t_stree::make_agg_update_tasks(const t_agg_update_info& info,
+    const std::vector<t_uindex>& cols, t_uindex begin, t_uindex end,
+    std::vector<t_agg_update_task>& tasks) const {
+    for (auto colidx : cols) {
+        // String columns intern into their vocab on write, which is not
+        // thread safe, so they are never split across tasks.
+        bool split = info.m_dst[colidx]->get_dtype() != DTYPE_STR;
+        t_uindex chunk_size = split ? AGG_UPDATE_CHUNK_SIZE : end - begin;
+
+        for (t_uindex bidx = begin; bidx < end; bidx += chunk_size) {
+            t_agg_update_task task;
+            task.m_colidx = colidx;
+            task.m_begin = bidx;
+            task.m_end = std::min(bidx + chunk_size, end);
+            tasks.push_back(task);
+        }
+    }
+}
+
+void
+t_stree::run_agg_update_tasks(t_agg_update_info& info,
+    const std::vector<const t_tree_unify_rec*>& records,
+    const std::vector<t_agg_update_task>& tasks,
+    const std::vector<t_sketch_inserts>* sketch_inserts,
+    const t_gstate& gstate, const t_data_table& expression_master_table) {
+    std::vector<t_agg_update_deltas> deltas(tasks.size());
+    bool sketch = sketch_inserts != nullptr;
+
+    auto run_task = [&](int tidx) {
+        const t_agg_update_task& task = tasks[tidx];
+        if (!sketch
+            && update_agg_column(info, records, task, gstate,
+                expression_master_table, deltas[tidx])) {
+            return;
+        }
+
+        for (t_uindex ridx = task.m_begin; ridx < task.m_end; ++ridx) {
+            const t_tree_unify_rec& r = *records[ridx];
+            if (sketch) {
+                update_sketch_aggs(r.m_sptidx, task.m_colidx, info,
+                    r.m_saggidx, (*sketch_inserts)[ridx], gstate,
+                    expression_master_table, deltas[tidx]);
+            } else {
+                update_agg_table(r.m_sptidx, task.m_colidx, info, r.m_daggidx,
+                    r.m_saggidx, r.m_nstrands, gstate, expression_master_table,
+                    deltas[tidx]);
+            }
+        }
+    };
+
+    if (tasks.size() > 1 && records.size() >= AGG_UPDATE_PARALLEL_MIN_RECORDS) {
+        parallel_for(int(tasks.size()), run_task);
+    } else {
+        for (t_uindex tidx = 0, loop_end = tasks.size(); tidx < loop_end;
+             ++tidx) {
+            run_task(tidx);
+        }
+    }
+
+    for (const auto& d : deltas) {
+        m_has_delta = m_has_delta || d.m_has_delta;
+        for (const auto& delta : d.m_deltas) {
+            m_deltas->insert(delta);
+        }
+    }
+}
+
+static inline t_status
+get_agg_status(const t_column* col, t_uindex idx) {
+    return col->is_status_enabled() ? *col->get_nth_status(idx) : STATUS_VALID;
+}
+
+// Matches `t_tscalar::abs`, which goes through `double` for integers.
+template <typename DATA_T>
+static inline DATA_T
+get_agg_abs(DATA_T v) {
+    return std::is_unsigned<DATA_T>::value ? v : DATA_T(std::abs(double(v)));
+}
+
+static inline double
+get_agg_abs(double v) {
+    return std::abs(v);
+}
+
+static inline float
+get_agg_abs(float v) {
+    return std::abs(v);
+}
+
+template <typename DATA_T>
+void
+t_stree::record_typed_delta(t_agg_update_deltas& deltas, t_uindex nidx,
+    t_uindex colidx, DATA_T old_value, t_status old_status, DATA_T new_value,
+    t_status new_status) const {
+    // Bitwise, like `t_tscalar::operator==`
+    if (old_status == new_status
+        && std::memcmp(&old_value, &new_value, sizeof(DATA_T)) == 0) {
+        return;
+    }
+
+    t_tscalar old_scalar;
+    old_scalar.set(old_value);
+    old_scalar.m_status = old_status;
+
+    t_tscalar new_scalar;
+    new_scalar.set(new_value);
+    new_scalar.m_status = new_status;
+
+    record_delta(deltas, nidx, colidx, old_scalar, new_scalar);
+}
+
+template <typename DATA_T>
+bool
+t_stree::update_agg_column_typed(t_agg_update_info& info,
+    const std::vector<const t_tree_unify_rec*>& records,
+    const t_agg_update_task& task, const t_gstate& gstate,
+    const t_data_table& expression_master_table,
+    t_agg_update_deltas& deltas) {
+    t_uindex colidx = task.m_colidx;
+    const t_aggspec& spec = info.m_aggspecs[colidx];
+    const t_column* src = info.m_src[colidx];
+    t_column* dst = info.m_dst[colidx];
+    bool is_numeric = !std::is_same<DATA_T, bool>::value;
+
+    auto fallback = [&](const t_tree_unify_rec& r) {
+        update_agg_table(r.m_sptidx, colidx, info, r.m_daggidx, r.m_saggidx,
+            r.m_nstrands, gstate, expression_master_table, deltas);
+    };
+
+    switch (spec.agg()) {
+        case AGGTYPE_COUNT: {
+            for (t_uindex ridx = task.m_begin; ridx < task.m_end; ++ridx) {
+                const t_tree_unify_rec& r = *records[ridx];
+                DATA_T old_value = *(dst->get_nth<DATA_T>(r.m_saggidx));
+                t_status old_status = get_agg_status(dst, r.m_saggidx);
+                DATA_T new_value = DATA_T(
+                    r.m_sptidx == 0 ? r.m_nstrands - 1 : r.m_nstrands);
+
+                dst->set_nth<DATA_T>(r.m_saggidx, new_value, STATUS_VALID);
+                record_typed_delta(deltas, r.m_sptidx, colidx, old_value,
+                    old_status, new_value, STATUS_VALID);
+            }
+        } break;
+        case AGGTYPE_PCT_SUM_PARENT:
+        case AGGTYPE_PCT_SUM_GRAND_TOTAL:
+        case AGGTYPE_SUM: {
+            if (!is_numeric || src->get_dtype() != dst->get_dtype()
+                || expression_master_table.get_schema().has_column(
+                    spec.get_dependencies()[0].name())) {
+                return false;
+            }
+
+            for (t_uindex ridx = task.m_begin; ridx < task.m_end; ++ridx) {
+                const t_tree_unify_rec& r = *records[ridx];
+                DATA_T old_value = *(dst->get_nth<DATA_T>(r.m_saggidx));
+
+                // A NaN sum is recalculated from the master table
+                if (old_value != old_value) {
+                    fallback(r);
+                    continue;
+                }
+
+                if (get_agg_status(src, r.m_daggidx) != STATUS_VALID) {
+                    continue;
+                }
+
+                t_status old_status = get_agg_status(dst, r.m_saggidx);
+                DATA_T src_value = *(src->get_nth<DATA_T>(r.m_daggidx));
+                DATA_T new_value = old_status == STATUS_VALID
+                    ? DATA_T(old_value + src_value)
+                    : src_value;
+
+                dst->set_nth<DATA_T>(r.m_saggidx, new_value, STATUS_VALID);
+                record_typed_delta(deltas, r.m_sptidx, colidx, old_value,
+                    old_status, new_value, STATUS_VALID);
+            }
+        } break;
+        case AGGTYPE_HIGH_WATER_MARK:
+        case AGGTYPE_LOW_WATER_MARK: {
+            if (src->get_dtype() != dst->get_dtype()) {
+                return false;
+            }
+
+            bool high = spec.agg() == AGGTYPE_HIGH_WATER_MARK;
+
+            for (t_uindex ridx = task.m_begin; ridx < task.m_end; ++ridx) {
+                const t_tree_unify_rec& r = *records[ridx];
+                DATA_T old_value = *(dst->get_nth<DATA_T>(r.m_saggidx));
+                t_status old_status = get_agg_status(dst, r.m_saggidx);
+                DATA_T new_value = *(src->get_nth<DATA_T>(r.m_daggidx));
+                t_status new_status = get_agg_status(src, r.m_daggidx);
+
+                if (old_status == STATUS_VALID) {
+                    // `t_tscalar` orders invalid values by status
+                    if (new_status != STATUS_VALID) {
+                        fallback(r);
+                        continue;
+                    }
+
+                    new_value = high ? std::max(old_value, new_value)
+                                     : std::min(old_value, new_value);
+                }
+
+                dst->set_nth<DATA_T>(r.m_saggidx, new_value, new_status);
+                record_typed_delta(deltas, r.m_sptidx, colidx, old_value,
+                    old_status, new_value, new_status);
+            }
+        } break;
+        case AGGTYPE_OR:
+        case AGGTYPE_ANY: {
+            std::shared_ptr<const t_column> col
+                = get_column_from_gstate(gstate, expression_master_table,
+                    spec.get_dependencies()[0].name());
+            const t_column* col_ = col.get();
+
+            if (col_->get_dtype() != dst->get_dtype()) {
+                return false;
+            }
+
+            for (t_uindex ridx = task.m_begin; ridx < task.m_end; ++ridx) {
+                const t_tree_unify_rec& r = *records[ridx];
+                auto rows = get_rows(r.m_sptidx);
+                bool found = false;
+                DATA_T new_value = DATA_T();
+
+                for (auto row : rows) {
+                    if (get_agg_status(col_, row) != STATUS_VALID) {
+                        continue;
+                    }
+
+                    new_value = *(col_->get_nth<DATA_T>(row));
+                    if (bool(new_value)) {
+                        found = true;
+                        break;
+                    }
+                }
+
+                if (!found) {
+                    t_tscalar old_scalar = dst->get_scalar(r.m_saggidx);
+                    t_tscalar new_scalar = mknone();
+                    dst->set_scalar(r.m_saggidx, new_scalar);
+                    record_delta(
+                        deltas, r.m_sptidx, colidx, old_scalar, new_scalar);
+                    continue;
+                }
+
+                DATA_T old_value = *(dst->get_nth<DATA_T>(r.m_saggidx));
+                t_status old_status = get_agg_status(dst, r.m_saggidx);
+                dst->set_nth<DATA_T>(r.m_saggidx, new_value, STATUS_VALID);
+                record_typed_delta(deltas, r.m_sptidx, colidx, old_value,
+                    old_status, new_value, STATUS_VALID);
+            }
+        } break;
+        case AGGTYPE_AND: {
+            std::shared_ptr<const t_column> col
+                = get_column_from_gstate(gstate, expression_master_table,
+                    spec.get_dependencies()[0].name());
+            const t_column* col_ = col.get();
+
+            if (dst->get_dtype() != DTYPE_BOOL) {
+                return false;
+            }
+
+            for (t_uindex ridx = task.m_begin; ridx < task.m_end; ++ridx) {
+                const t_tree_unify_rec& r = *records[ridx];
+                auto rows = get_sorted_rows(r.m_sptidx);
+                bool new_value = true;
+
+                for (auto row : rows) {
+                    if (get_agg_status(col_, row) != STATUS_VALID
+                        || !bool(*(col_->get_nth<DATA_T>(row)))) {
+                        new_value = false;
+                        break;
+                    }
+                }
+
+                bool old_value = *(dst->get_nth<bool>(r.m_saggidx));
+                t_status old_status = get_agg_status(dst, r.m_saggidx);
+                dst->set_nth<bool>(r.m_saggidx, new_value, STATUS_VALID);
+                record_typed_delta(deltas, r.m_sptidx, colidx, old_value,
+                    old_status, new_value, STATUS_VALID);
+            }
+        } break;
+        case AGGTYPE_SUM_ABS:
+        case AGGTYPE_ABS_SUM: {
+            std::shared_ptr<const t_column> col
+                = get_column_from_gstate(gstate, expression_master_table,
+                    spec.get_dependencies()[0].name());
+            const t_column* col_ = col.get();
+
+            if (!is_numeric || col_->get_dtype() != dst->get_dtype()) {
+                return false;
+            }
+
+            bool abs_each = spec.agg() == AGGTYPE_SUM_ABS;
+
+            for (t_uindex ridx = task.m_begin; ridx < task.m_end; ++ridx) {
+                const t_tree_unify_rec& r = *records[ridx];
+                auto rows = get_rows(r.m_sptidx);
+
+                // Empty groups produce `none`
+                if (rows.empty()) {
+                    fallback(r);
+                    continue;
+                }
+
+                DATA_T new_value = DATA_T(0);
+
+                for (auto row : rows) {
+                    if (get_agg_status(col_, row) != STATUS_VALID) {
+                        continue;
+                    }
+
+                    DATA_T v = *(col_->get_nth<DATA_T>(row));
+                    new_value
+                        = DATA_T(new_value + (abs_each ? get_agg_abs(v) : v));
+                }
+
+                if (!abs_each) {
+                    new_value = get_agg_abs(new_value);
+                }
+
+                DATA_T old_value = *(dst->get_nth<DATA_T>(r.m_saggidx));
+                t_status old_status = get_agg_status(dst, r.m_saggidx);
+                dst->set_nth<DATA_T>(r.m_saggidx, new_value, STATUS_VALID);
+                record_typed_delta(deltas, r.m_sptidx, colidx, old_value,
+                    old_status, new_value, STATUS_VALID);
+            }
+        } break;
+        default: { return false; }
+    }
+
+    return true;
+}
+
+bool
+t_stree::update_agg_column(t_agg_update_info& info,
+    const std::vector<const t_tree_unify_rec*>& records,
+    const t_agg_update_task& task, const t_gstate& gstate,
+    const t_data_table& expression_master_table,
+    t_agg_update_deltas& deltas) {
+    const t_aggspec& spec = info.m_aggspecs[task.m_colidx];
+    t_dtype dtype = info.m_dst[task.m_colidx]->get_dtype();
+
+    switch (spec.agg()) {
+        case AGGTYPE_COUNT:
+        case AGGTYPE_PCT_SUM_PARENT:
+        case AGGTYPE_PCT_SUM_GRAND_TOTAL:
+        case AGGTYPE_SUM:
+        case AGGTYPE_HIGH_WATER_MARK:
+        case AGGTYPE_LOW_WATER_MARK:
+        case AGGTYPE_OR:
+        case AGGTYPE_ANY:
+        case AGGTYPE_SUM_ABS:
+        case AGGTYPE_ABS_SUM: {
+        } break;
+        case AGGTYPE_AND: {
+            // `and` always writes bool, so it is specialized on its input
+            dtype = get_column_from_gstate(gstate, expression_master_table,
+                spec.get_dependencies()[0].name())
+                        ->get_dtype();
+        } break;
+        default: { return false; }
+    }
+
+    switch (dtype) {
+        case DTYPE_INT64: {
+            return update_agg_column_typed<std::int64_t>(info, records, task,
+                gstate, expression_master_table, deltas);
+        } break;
+        case DTYPE_INT32: {
+            return update_agg_column_typed<std::int32_t>(info, records, task,
+                gstate, expression_master_table, deltas);
+        } break;
+        case DTYPE_UINT64: {
+            return update_agg_column_typed<std::uint64_t>(info, records, task,
+                gstate, expression_master_table, deltas);
+        } break;
+        case DTYPE_UINT32: {
+            return update_agg_column_typed<std::uint32_t>(info, records, task,
+                gstate, expression_master_table, deltas);
+        } break;
+        case DTYPE_FLOAT64: {
+            return update_agg_column_typed<double>(info, records, task, gstate,
+                expression_master_table, deltas);
+        } break;
+        case DTYPE_FLOAT32: {
+            return update_agg_column_typed<float>(info, records, task, gstate,
+                expression_master_table, deltas);
+        } break;
+        case DTYPE_BOOL: {
+            return update_agg_column_typed<bool>(info, records, task, gstate,
+                expression_master_table, deltas);
+        } break;
+        default: { return false; }
     }
 }
 
@@ -897,19 +1405,7 @@ t_stree::genidx() {
 
 std::vector<t_uindex>
 t_stree::get_children(t_uindex idx) const {
-    t_by_pidx_ipair iterators = m_nodes->get<by_pidx>().equal_range(idx);
-
-    t_uindex nchild = std::distance(iterators.first, iterators.second);
-
-    std::vector<t_uindex> temp(nchild);
-
-    t_index count = 0;
-    for (iter_by_pidx iter = iterators.first; iter != iterators.second;
-         ++iter) {
-        temp[count] = iter->m_idx;
-        ++count;
-    }
-    return temp;
+    return m_nodes->get_children(idx);
 }
 
 t_uindex
@@ -919,17 +1415,20 @@ t_stree::size() const {
 
 void
 t_stree::get_child_nodes(t_uindex idx, t_tnodevec& nodes) const {
-    t_index num_children = get_num_children(idx);
-    t_tnodevec temp(num_children);
-    auto iterators = m_nodes->get<by_pidx>().equal_range(idx);
-    std::copy(iterators.first, iterators.second, temp.begin());
+    const std::vector<t_uindex>& children = m_nodes->get_children(idx);
+    t_tnodevec temp;
+    temp.reserve(children.size());
+
+    for (auto cidx : children) {
+        temp.push_back(m_nodes->get(cidx));
+    }
+
     std::swap(nodes, temp);
 }
 
 t_uindex
 t_stree::get_num_children(t_uindex ptidx) const {
-    auto iterators = m_nodes->get<by_pidx>().equal_range(ptidx);
-    return std::distance(iterators.first, iterators.second);
+    return m_nodes->get_num_children(ptidx);
 }
 
 t_uindex
@@ -952,594 +1451,701 @@ t_stree::gen_aggidx() {
 }
 
 void
-t_stree::update_agg_table(t_uindex nidx, t_agg_update_info& info,
-    t_uindex src_ridx, t_uindex dst_ridx, t_index nstrands,
-    const t_gstate& gstate, const t_data_table& expression_master_table) {
+t_stree::update_agg_table(t_uindex nidx, t_uindex colidx,
+    t_agg_update_info& info, t_uindex src_ridx, t_uindex dst_ridx,
+    t_index nstrands, const t_gstate& gstate,
+    const t_data_table& expression_master_table,
+    t_agg_update_deltas& deltas) {
     const t_schema& expression_schema = expression_master_table.get_schema();
-
-    for (t_uindex idx : info.m_dst_topo_sorted) {
-        const t_column* src = info.m_src[idx];
-        t_column* dst = info.m_dst[idx];
-        const t_aggspec& spec = info.m_aggspecs[idx];
-        t_tscalar new_value = mknone();
-        t_tscalar old_value = mknone();
-        auto is_expr
-            = expression_schema.has_column(spec.get_dependencies()[0].name());
-
-        switch (spec.agg()) {
-            case AGGTYPE_PCT_SUM_PARENT:
-            case AGGTYPE_PCT_SUM_GRAND_TOTAL:
-            case AGGTYPE_SUM: {
-                t_tscalar src_scalar = src->get_scalar(src_ridx);
-                t_tscalar dst_scalar = dst->get_scalar(dst_ridx);
-                old_value.set(dst_scalar);
-                new_value.set(dst_scalar.add(src_scalar));
-
-                // is_nan returns false for non-float types
-                if (is_expr || old_value.is_nan()) {
-                    // if we previously had a NaN, add can't make it finite
-                    // again; recalculate entire sum in case it is now finite
-                    auto pkeys = get_pkeys(nidx);
-                    std::vector<double> values;
-                    read_column_from_gstate(gstate, expression_master_table,
-                        spec.get_dependencies()[0].name(), pkeys, values, true);
-                    new_value.set(std::accumulate(
-                        values.begin(), values.end(), double(0)));
-                }
-                dst->set_scalar(dst_ridx, new_value);
-            } break;
-            case AGGTYPE_COUNT: {
-                if (nidx == 0) {
-                    new_value.set(nstrands - 1);
-                } else {
-                    new_value.set(nstrands);
-                }
-
-                dst->set_scalar(dst_ridx, new_value);
-            } break;
-            case AGGTYPE_MEAN: {
-                auto pkeys = get_pkeys(nidx);
+    const t_column* src = info.m_src[colidx];
+    t_column* dst = info.m_dst[colidx];
+    const t_aggspec& spec = info.m_aggspecs[colidx];
+    t_tscalar new_value = mknone();
+    t_tscalar old_value = mknone();
+    auto is_expr
+        = expression_schema.has_column(spec.get_dependencies()[0].name());
+
+    switch (spec.agg()) {
+        case AGGTYPE_PCT_SUM_PARENT:
+        case AGGTYPE_PCT_SUM_GRAND_TOTAL:
+        case AGGTYPE_SUM: {
+            t_tscalar src_scalar = src->get_scalar(src_ridx);
+            t_tscalar dst_scalar = dst->get_scalar(dst_ridx);
+            old_value.set(dst_scalar);
+            new_value.set(dst_scalar.add(src_scalar));
+
+            // is_nan returns false for non-float types
+            if (is_expr || old_value.is_nan()) {
+                // if we previously had a NaN, add can't make it finite
+                // again; recalculate entire sum in case it is now finite
+                auto rows = get_rows(nidx);
                 std::vector<double> values;
-
                 read_column_from_gstate(gstate, expression_master_table,
-                    spec.get_dependencies()[0].name(), pkeys, values, false);
+                    spec.get_dependencies()[0].name(), rows, values, true);
+                new_value.set(std::accumulate(
+                    values.begin(), values.end(), double(0)));
+            }
+            dst->set_scalar(dst_ridx, new_value);
+        } break;
+        case AGGTYPE_COUNT: {
+            if (nidx == 0) {
+                new_value.set(nstrands - 1);
+            } else {
+                new_value.set(nstrands);
+            }
 
-                auto nr
-                    = std::accumulate(values.begin(), values.end(), double(0));
-                double dr = values.size();
+            dst->set_scalar(dst_ridx, new_value);
+        } break;
+        case AGGTYPE_MEAN: {
+            auto rows = get_rows(nidx);
+            std::vector<double> values;
 
-                std::pair<double, double>* dst_pair
-                    = dst->get_nth<std::pair<double, double>>(dst_ridx);
+            read_column_from_gstate(gstate, expression_master_table,
+                spec.get_dependencies()[0].name(), rows, values, false);
 
-                old_value.set(dst_pair->first / dst_pair->second);
+            auto nr
+                = std::accumulate(values.begin(), values.end(), double(0));
+            double dr = values.size();
 
-                dst_pair->first = nr;
-                dst_pair->second = dr;
+            std::pair<double, double>* dst_pair
+                = dst->get_nth<std::pair<double, double>>(dst_ridx);
 
-                dst->set_valid(dst_ridx, true);
+            old_value.set(dst_pair->first / dst_pair->second);
 
-                new_value.set(nr / dr);
-            } break;
-            case AGGTYPE_WEIGHTED_MEAN: {
-                auto pkeys = get_pkeys(nidx);
+            dst_pair->first = nr;
+            dst_pair->second = dr;
 
-                double nr = 0;
-                double dr = 0;
-                std::vector<t_tscalar> values;
-                std::vector<t_tscalar> weights;
+            dst->set_valid(dst_ridx, true);
 
-                read_column_from_gstate(gstate, expression_master_table,
-                    spec.get_dependencies()[0].name(), pkeys, values);
+            new_value.set(nr / dr);
+        } break;
+        case AGGTYPE_WEIGHTED_MEAN: {
+            auto rows = get_rows(nidx);
 
-                read_column_from_gstate(gstate, expression_master_table,
-                    spec.get_dependencies()[1].name(), pkeys, weights);
+            double nr = 0;
+            double dr = 0;
+            std::vector<t_tscalar> values;
+            std::vector<t_tscalar> weights;
 
-                auto weights_it = weights.begin();
-                auto values_it = values.begin();
+            read_column_from_gstate(gstate, expression_master_table,
+                spec.get_dependencies()[0].name(), rows, values);
 
-                for (; weights_it != weights.end() && values_it != values.end();
-                     ++weights_it, ++values_it) {
-                    if (weights_it->is_valid() && values_it->is_valid()
-                        && !weights_it->is_nan() && !values_it->is_nan()) {
-                        nr += weights_it->to_double() * values_it->to_double();
-                        dr += weights_it->to_double();
-                    }
+            read_column_from_gstate(gstate, expression_master_table,
+                spec.get_dependencies()[1].name(), rows, weights);
+
+            auto weights_it = weights.begin();
+            auto values_it = values.begin();
+
+            for (; weights_it != weights.end() && values_it != values.end();
+                 ++weights_it, ++values_it) {
+                if (weights_it->is_valid() && values_it->is_valid()
+                    && !weights_it->is_nan() && !values_it->is_nan()) {
+                    nr += weights_it->to_double() * values_it->to_double();
+                    dr += weights_it->to_double();
                 }
+            }
 
-                std::pair<double, double>* dst_pair
-                    = dst->get_nth<std::pair<double, double>>(dst_ridx);
-                old_value.set(dst_pair->first / dst_pair->second);
+            std::pair<double, double>* dst_pair
+                = dst->get_nth<std::pair<double, double>>(dst_ridx);
+            old_value.set(dst_pair->first / dst_pair->second);
 
-                dst_pair->first = nr;
-                dst_pair->second = dr;
+            dst_pair->first = nr;
+            dst_pair->second = dr;
 
-                bool valid = (dr != 0);
-                dst->set_valid(dst_ridx, valid);
-                new_value.set(nr / dr);
-            } break;
-            case AGGTYPE_UNIQUE: {
-                auto pkeys = get_pkeys(nidx);
-                old_value.set(dst->get_scalar(dst_ridx));
+            bool valid = (dr != 0);
+            dst->set_valid(dst_ridx, valid);
+            new_value.set(nr / dr);
+        } break;
+        case AGGTYPE_UNIQUE: {
+            auto rows = get_sorted_rows(nidx);
+            old_value.set(dst->get_scalar(dst_ridx));
 
-                bool is_unique
-                    = is_unique_from_gstate(gstate, expression_master_table,
-                        spec.get_dependencies()[0].name(), pkeys, new_value);
+            bool is_unique
+                = is_unique_from_gstate(gstate, expression_master_table,
+                    spec.get_dependencies()[0].name(), rows, new_value);
 
-                if (new_value.m_type == DTYPE_STR) {
-                    if (is_unique) {
-                        new_value = m_symtable.get_interned_tscalar(new_value);
-                        dst->set_scalar(dst_ridx, new_value);
-                    } else {
-                        // set the row to invalid but don't set new = old
-                        // because we need to unintern strings over and over
-                        // again if we set new = old.
-                        dst->set_valid(dst_ridx, false);
-                    }
+            if (new_value.m_type == DTYPE_STR) {
+                if (is_unique) {
+                    new_value = intern_tscalar(new_value);
+                    dst->set_scalar(dst_ridx, new_value);
+                } else {
+                    // set the row to invalid but don't set new = old
+                    // because we need to unintern strings over and over
+                    // again if we set new = old.
+                    dst->set_valid(dst_ridx, false);
+                }
+            } else {
+                if (is_unique) {
+                    dst->set_scalar(dst_ridx, new_value);
                 } else {
-                    if (is_unique) {
-                        dst->set_scalar(dst_ridx, new_value);
+                    dst->set_valid(dst_ridx, false);
+                    new_value = old_value;
+                }
+            }
+        } break;
+        case AGGTYPE_OR:
+        case AGGTYPE_ANY: {
+            old_value.set(dst->get_scalar(dst_ridx));
+            auto rows = get_rows(nidx);
+
+            apply_from_gstate(gstate, expression_master_table,
+                spec.get_dependencies()[0].name(), rows, new_value,
+                [](const t_tscalar& row_value, t_tscalar& output) {
+                    if (row_value.as_bool()) {
+                        output.set(row_value);
+                        return true;
+                    }
+                    return false;
+                });
+
+            dst->set_scalar(dst_ridx, new_value);
+        } break;
+        case AGGTYPE_MEDIAN: {
+            old_value.set(dst->get_scalar(dst_ridx));
+            auto rows = get_sorted_rows(nidx);
+
+            new_value.set(reduce_from_gstate<
+                std::function<t_tscalar(std::vector<t_tscalar>&)>>(gstate,
+                expression_master_table, spec.get_dependencies()[0].name(),
+                rows, [](std::vector<t_tscalar>& values) {
+                    if (values.size() == 0) {
+                        return t_tscalar();
+                    } else if (values.size() == 1) {
+                        return values[0];
                     } else {
-                        dst->set_valid(dst_ridx, false);
-                        new_value = old_value;
+                        std::vector<t_tscalar>::iterator middle
+                            = values.begin() + (values.size() / 2);
+
+                        std::nth_element(
+                            values.begin(), middle, values.end());
+
+                        return *middle;
                     }
-                }
-            } break;
-            case AGGTYPE_OR:
-            case AGGTYPE_ANY: {
-                old_value.set(dst->get_scalar(dst_ridx));
-                auto pkeys = get_pkeys(nidx);
-
-                apply_from_gstate(gstate, expression_master_table,
-                    spec.get_dependencies()[0].name(), pkeys, new_value,
-                    [](const t_tscalar& row_value, t_tscalar& output) {
-                        if (row_value.as_bool()) {
-                            output.set(row_value);
-                            return true;
-                        }
-                        return false;
-                    });
+                }));
 
-                dst->set_scalar(dst_ridx, new_value);
-            } break;
-            case AGGTYPE_MEDIAN: {
-                old_value.set(dst->get_scalar(dst_ridx));
-                auto pkeys = get_pkeys(nidx);
-
-                new_value.set(reduce_from_gstate<
-                    std::function<t_tscalar(std::vector<t_tscalar>&)>>(gstate,
-                    expression_master_table, spec.get_dependencies()[0].name(),
-                    pkeys, [](std::vector<t_tscalar>& values) {
-                        if (values.size() == 0) {
-                            return t_tscalar();
-                        } else if (values.size() == 1) {
-                            return values[0];
-                        } else {
-                            std::vector<t_tscalar>::iterator middle
-                                = values.begin() + (values.size() / 2);
-
-                            std::nth_element(
-                                values.begin(), middle, values.end());
-
-                            return *middle;
-                        }
-                    }));
+            dst->set_scalar(dst_ridx, new_value);
+        } break;
+        case AGGTYPE_JOIN: {
+            old_value.set(dst->get_scalar(dst_ridx));
+            auto rows = get_sorted_rows(nidx);
+
+            new_value.set(reduce_from_gstate<
+                std::function<t_tscalar(std::vector<t_tscalar>&)>>(gstate,
+                expression_master_table, spec.get_dependencies()[0].name(),
+                rows, [this](std::vector<t_tscalar>& values) {
+                    std::set<t_tscalar> vset;
+                    for (const auto& v : values) {
+                        vset.insert(v);
+                    }
 
-                dst->set_scalar(dst_ridx, new_value);
-            } break;
-            case AGGTYPE_JOIN: {
-                old_value.set(dst->get_scalar(dst_ridx));
-                auto pkeys = get_pkeys(nidx);
-
-                new_value.set(reduce_from_gstate<
-                    std::function<t_tscalar(std::vector<t_tscalar>&)>>(gstate,
-                    expression_master_table, spec.get_dependencies()[0].name(),
-                    pkeys, [this](std::vector<t_tscalar>& values) {
-                        std::set<t_tscalar> vset;
-                        for (const auto& v : values) {
-                            vset.insert(v);
-                        }
+                    std::stringstream ss;
+                    t_uindex str_size = 0;
+                    for (std::set<t_tscalar>::const_iterator iter
+                         = vset.begin();
+                         iter != vset.end(); ++iter) {
 
-                        std::stringstream ss;
-                        t_uindex str_size = 0;
-                        for (std::set<t_tscalar>::const_iterator iter
-                             = vset.begin();
-                             iter != vset.end(); ++iter) {
-
-                            auto st = iter->to_string();
-                            auto next_len = st.size();
-                            if (next_len + str_size > MAX_JOIN_SIZE) {
-                                break;
-                            }
-
-                            if (iter != vset.begin()) {
-                                str_size += 2;
-                                ss << ", ";
-                            }
-
-                            str_size += next_len;
-                            ss << st;
+                        auto st = iter->to_string();
+                        auto next_len = st.size();
+                        if (next_len + str_size > MAX_JOIN_SIZE) {
+                            break;
                         }
-                        return m_symtable.get_interned_tscalar(
-                            ss.str().c_str());
-                    }));
 
-                dst->set_scalar(dst_ridx, new_value);
-            } break;
-            case AGGTYPE_SCALED_DIV: {
-                const t_column* src_1 = info.m_dst[spec.get_agg_one_idx()];
-                const t_column* src_2 = info.m_dst[spec.get_agg_two_idx()];
+                        if (iter != vset.begin()) {
+                            str_size += 2;
+                            ss << ", ";
+                        }
 
-                t_column* dst = info.m_dst[idx];
-                old_value.set(dst->get_scalar(dst_ridx));
+                        str_size += next_len;
+                        ss << st;
+                    }
+                    return intern_tscalar(
+                        ss.str().c_str());
+                }));
 
-                double agg1 = src_1->get_scalar(dst_ridx).to_double();
-                double agg2 = src_2->get_scalar(dst_ridx).to_double();
+            dst->set_scalar(dst_ridx, new_value);
+        } break;
+        case AGGTYPE_SCALED_DIV: {
+            const t_column* src_1 = info.m_dst[spec.get_agg_one_idx()];
+            const t_column* src_2 = info.m_dst[spec.get_agg_two_idx()];
 
-                double w1 = spec.get_agg_one_weight();
-                double w2 = spec.get_agg_two_weight();
+            t_column* dst = info.m_dst[colidx];
+            old_value.set(dst->get_scalar(dst_ridx));
 
-                double v = (agg1 * w1) / (agg2 * w2);
+            double agg1 = src_1->get_scalar(dst_ridx).to_double();
+            double agg2 = src_2->get_scalar(dst_ridx).to_double();
 
-                new_value.set(v);
-                dst->set_scalar(dst_ridx, new_value);
-            } break;
-            case AGGTYPE_SCALED_ADD: {
+            double w1 = spec.get_agg_one_weight();
+            double w2 = spec.get_agg_two_weight();
 
-                const t_column* src_1 = info.m_dst[spec.get_agg_one_idx()];
-                const t_column* src_2 = info.m_dst[spec.get_agg_two_idx()];
+            double v = (agg1 * w1) / (agg2 * w2);
 
-                t_column* dst = info.m_dst[idx];
-                old_value.set(dst->get_scalar(dst_ridx));
+            new_value.set(v);
+            dst->set_scalar(dst_ridx, new_value);
+        } break;
+        case AGGTYPE_SCALED_ADD: {
 
-                double v = (src_1->get_scalar(dst_ridx).to_double()
-                               * spec.get_agg_one_weight())
-                    + (src_2->get_scalar(dst_ridx).to_double()
-                        * spec.get_agg_two_weight());
+            const t_column* src_1 = info.m_dst[spec.get_agg_one_idx()];
+            const t_column* src_2 = info.m_dst[spec.get_agg_two_idx()];
 
-                new_value.set(v);
-                dst->set_scalar(dst_ridx, new_value);
-            } break;
-            case AGGTYPE_SCALED_MUL: {
-                const t_column* src_1 = info.m_dst[spec.get_agg_one_idx()];
-                const t_column* src_2 = info.m_dst[spec.get_agg_two_idx()];
+            t_column* dst = info.m_dst[colidx];
+            old_value.set(dst->get_scalar(dst_ridx));
 
-                t_column* dst = info.m_dst[idx];
-                old_value.set(dst->get_scalar(dst_ridx));
+            double v = (src_1->get_scalar(dst_ridx).to_double()
+                           * spec.get_agg_one_weight())
+                + (src_2->get_scalar(dst_ridx).to_double()
+                    * spec.get_agg_two_weight());
 
-                double v = (src_1->get_scalar(dst_ridx).to_double()
-                               * spec.get_agg_one_weight())
-                    * (src_2->get_scalar(dst_ridx).to_double()
-                        * spec.get_agg_two_weight());
+            new_value.set(v);
+            dst->set_scalar(dst_ridx, new_value);
+        } break;
+        case AGGTYPE_SCALED_MUL: {
+            const t_column* src_1 = info.m_dst[spec.get_agg_one_idx()];
+            const t_column* src_2 = info.m_dst[spec.get_agg_two_idx()];
 
-                new_value.set(v);
-                dst->set_scalar(dst_ridx, new_value);
-            } break;
-            case AGGTYPE_DOMINANT: {
-                old_value.set(dst->get_scalar(dst_ridx));
-                auto pkeys = get_pkeys(nidx);
+            t_column* dst = info.m_dst[colidx];
+            old_value.set(dst->get_scalar(dst_ridx));
 
-                new_value.set(reduce_from_gstate<
-                    std::function<t_tscalar(std::vector<t_tscalar>&)>>(gstate,
-                    expression_master_table, spec.get_dependencies()[0].name(),
-                    pkeys, [](std::vector<t_tscalar>& values) {
-                        return get_dominant(values);
-                    }));
+            double v = (src_1->get_scalar(dst_ridx).to_double()
+                           * spec.get_agg_one_weight())
+                * (src_2->get_scalar(dst_ridx).to_double()
+                    * spec.get_agg_two_weight());
 
-                dst->set_scalar(dst_ridx, new_value);
-            } break;
-            case AGGTYPE_FIRST: {
-                old_value.set(dst->get_scalar(dst_ridx));
-                auto pair = first_last_helper(
-                    nidx, spec, gstate, expression_master_table);
-                new_value.set(pair.first);
-                dst->set_scalar(dst_ridx, new_value);
-            } break;
-            case AGGTYPE_LAST_BY_INDEX: {
-                old_value.set(dst->get_scalar(dst_ridx));
-                auto pair = first_last_helper(
-                    nidx, spec, gstate, expression_master_table);
-                new_value.set(pair.second);
-                dst->set_scalar(dst_ridx, new_value);
-            } break;
-            case AGGTYPE_LAST_MINUS_FIRST: {
-                old_value.set(dst->get_scalar(dst_ridx));
-                auto pair = (first_last_helper(
-                    nidx, spec, gstate, expression_master_table));
-                new_value.set(pair.second.sub_typesafe(pair.first));
-                dst->set_scalar(dst_ridx, new_value);
-            } break;
-            case AGGTYPE_AND: {
-                old_value.set(dst->get_scalar(dst_ridx));
-                auto pkeys = get_pkeys(nidx);
-
-                new_value.set(reduce_from_gstate<
-                    std::function<t_tscalar(std::vector<t_tscalar>&)>>(gstate,
-                    expression_master_table, spec.get_dependencies()[0].name(),
-                    pkeys, [](std::vector<t_tscalar>& values) {
-                        t_tscalar rval;
-                        rval.set(true);
-
-                        for (const auto& v : values) {
-                            if (!v.as_bool()) {
-                                rval.set(false);
-                                break;
-                            }
+            new_value.set(v);
+            dst->set_scalar(dst_ridx, new_value);
+        } break;
+        case AGGTYPE_DOMINANT: {
+            old_value.set(dst->get_scalar(dst_ridx));
+            auto rows = get_rows(nidx);
+
+            new_value.set(reduce_from_gstate<
+                std::function<t_tscalar(std::vector<t_tscalar>&)>>(gstate,
+                expression_master_table, spec.get_dependencies()[0].name(),
+                rows, [](std::vector<t_tscalar>& values) {
+                    return get_dominant(values);
+                }));
+
+            dst->set_scalar(dst_ridx, new_value);
+        } break;
+        case AGGTYPE_FIRST: {
+            old_value.set(dst->get_scalar(dst_ridx));
+            auto pair = first_last_helper(
+                nidx, spec, gstate, expression_master_table);
+            new_value.set(pair.first);
+            dst->set_scalar(dst_ridx, new_value);
+        } break;
+        case AGGTYPE_LAST_BY_INDEX: {
+            old_value.set(dst->get_scalar(dst_ridx));
+            auto pair = first_last_helper(
+                nidx, spec, gstate, expression_master_table);
+            new_value.set(pair.second);
+            dst->set_scalar(dst_ridx, new_value);
+        } break;
+        case AGGTYPE_LAST_MINUS_FIRST: {
+            old_value.set(dst->get_scalar(dst_ridx));
+            auto pair = (first_last_helper(
+                nidx, spec, gstate, expression_master_table));
+            new_value.set(pair.second.sub_typesafe(pair.first));
+            dst->set_scalar(dst_ridx, new_value);
+        } break;
+        case AGGTYPE_AND: {
+            old_value.set(dst->get_scalar(dst_ridx));
+            auto rows = get_sorted_rows(nidx);
+
+            new_value.set(reduce_from_gstate<
+                std::function<t_tscalar(std::vector<t_tscalar>&)>>(gstate,
+                expression_master_table, spec.get_dependencies()[0].name(),
+                rows, [](std::vector<t_tscalar>& values) {
+                    t_tscalar rval;
+                    rval.set(true);
+
+                    for (const auto& v : values) {
+                        if (!v.as_bool()) {
+                            rval.set(false);
+                            break;
                         }
-                        return rval;
-                    }));
-                dst->set_scalar(dst_ridx, new_value);
-            } break;
-            case AGGTYPE_LAST_VALUE: {
-                t_tscalar dst_scalar = dst->get_scalar(dst_ridx);
-                old_value.set(dst_scalar);
-                t_uindex leaf;
-                if (is_leaf(nidx)) {
-                    leaf = nidx;
-                } else {
-                    auto iters
-                        = m_idxleaf->get<by_idx_lfidx>().equal_range(nidx);
-                    if (iters.first != iters.second) {
-                        leaf = (--iters.second)->m_lfidx;
-                    } else {
-                        dst->set_scalar(dst_ridx, mknone());
-                        break;
                     }
-                }
-
-                auto iters = m_idxpkey->get<by_idx_pkey>().equal_range(leaf);
-                if (iters.first != iters.second) {
-                    t_tscalar pkey = (--iters.second)->m_pkey;
-
-                    dst->set_scalar(dst_ridx,
-                        read_by_pkey_from_gstate(gstate,
-                            expression_master_table,
-                            spec.get_dependencies()[0].name(), pkey));
+                    return rval;
+                }));
+            dst->set_scalar(dst_ridx, new_value);
+        } break;
+        case AGGTYPE_LAST_VALUE: {
+            t_tscalar dst_scalar = dst->get_scalar(dst_ridx);
+            old_value.set(dst_scalar);
+            t_uindex leaf;
+            if (is_leaf(nidx)) {
+                leaf = nidx;
+            } else {
+                auto liter = m_leaves.find(nidx);
+                if (liter != m_leaves.end() && !liter->second.empty()) {
+                    leaf = liter->second.back();
                 } else {
                     dst->set_scalar(dst_ridx, mknone());
+                    break;
                 }
-            } break;
-            case AGGTYPE_HIGH_WATER_MARK: {
-                t_tscalar src_scalar = src->get_scalar(src_ridx);
-                t_tscalar dst_scalar = dst->get_scalar(dst_ridx);
+            }
 
-                old_value.set(dst_scalar);
-                new_value.set(src_scalar);
+            const auto& leaf_rows = get_rows_for_leaf(leaf);
+            if (!leaf_rows.empty()) {
+                std::shared_ptr<const t_column> col
+                    = get_column_from_gstate(gstate, expression_master_table,
+                        spec.get_dependencies()[0].name());
 
-                if (dst_scalar.is_valid()) {
-                    new_value.set(std::max(dst_scalar, src_scalar));
-                }
+                dst->set_scalar(dst_ridx, col->get_scalar(leaf_rows.back()));
+            } else {
+                dst->set_scalar(dst_ridx, mknone());
+            }
+        } break;
+        case AGGTYPE_HIGH_WATER_MARK: {
+            t_tscalar src_scalar = src->get_scalar(src_ridx);
+            t_tscalar dst_scalar = dst->get_scalar(dst_ridx);
 
-                dst->set_scalar(dst_ridx, new_value);
-            } break;
-            case AGGTYPE_LOW_WATER_MARK: {
-                t_tscalar src_scalar = src->get_scalar(src_ridx);
-                t_tscalar dst_scalar = dst->get_scalar(dst_ridx);
+            old_value.set(dst_scalar);
+            new_value.set(src_scalar);
 
-                old_value.set(dst_scalar);
-                new_value.set(src_scalar);
+            if (dst_scalar.is_valid()) {
+                new_value.set(std::max(dst_scalar, src_scalar));
+            }
 
-                if (dst_scalar.is_valid()) {
-                    new_value.set(std::min(dst_scalar, src_scalar));
-                }
-                dst->set_scalar(dst_ridx, new_value);
-            } break;
-            case AGGTYPE_HIGH_MINUS_LOW: {
-                t_tscalar dst_scalar = dst->get_scalar(dst_ridx);
-                old_value.set(dst_scalar);
-                auto pkeys = get_pkeys(nidx);
-                std::vector<t_tscalar> values;
-                read_column_from_gstate(gstate, expression_master_table,
-                    spec.get_dependencies()[0].name(), pkeys, values);
-                auto low_high
-                    = std::minmax_element(values.begin(), values.end());
-                t_tscalar first;
-                first.set(*(low_high.first));
-                t_tscalar second;
-                second.set(*(low_high.second));
-                new_value.set(second.sub_typesafe(first));
-                dst->set_scalar(dst_ridx, new_value);
-            } break;
-            case AGGTYPE_UDF_COMBINER:
-            case AGGTYPE_UDF_REDUCER: {
-                // these will be filled in later
-            } break;
-            case AGGTYPE_SUM_NOT_NULL: {
-                old_value.set(dst->get_scalar(dst_ridx));
-                auto pkeys = get_pkeys(nidx);
-
-                new_value.set(reduce_from_gstate<
-                    std::function<t_tscalar(std::vector<t_tscalar>&)>>(gstate,
-                    expression_master_table, spec.get_dependencies()[0].name(),
-                    pkeys, [](std::vector<t_tscalar>& values) {
-                        if (values.empty()) {
-                            return mknone();
-                        }
+            dst->set_scalar(dst_ridx, new_value);
+        } break;
+        case AGGTYPE_LOW_WATER_MARK: {
+            t_tscalar src_scalar = src->get_scalar(src_ridx);
+            t_tscalar dst_scalar = dst->get_scalar(dst_ridx);
 
-                        t_tscalar rval;
-                        rval.set(std::uint64_t(0));
-                        rval.m_type = values[0].m_type;
+            old_value.set(dst_scalar);
+            new_value.set(src_scalar);
 
-                        for (const auto& v : values) {
-                            if (v.is_nan())
-                                continue;
-                            rval = rval.add(v);
-                        }
+            if (dst_scalar.is_valid()) {
+                new_value.set(std::min(dst_scalar, src_scalar));
+            }
+            dst->set_scalar(dst_ridx, new_value);
+        } break;
+        case AGGTYPE_HIGH_MINUS_LOW: {
+            t_tscalar dst_scalar = dst->get_scalar(dst_ridx);
+            old_value.set(dst_scalar);
+            auto rows = get_sorted_rows(nidx);
+            std::vector<t_tscalar> values;
+            read_column_from_gstate(gstate, expression_master_table,
+                spec.get_dependencies()[0].name(), rows, values);
+            auto low_high
+                = std::minmax_element(values.begin(), values.end());
+            t_tscalar first;
+            first.set(*(low_high.first));
+            t_tscalar second;
+            second.set(*(low_high.second));
+            new_value.set(second.sub_typesafe(first));
+            dst->set_scalar(dst_ridx, new_value);
+        } break;
+        case AGGTYPE_UDF_COMBINER:
+        case AGGTYPE_UDF_REDUCER: {
+            // these will be filled in later
+        } break;
+        case AGGTYPE_SUM_NOT_NULL: {
+            old_value.set(dst->get_scalar(dst_ridx));
+            auto rows = get_rows(nidx);
+
+            new_value.set(reduce_from_gstate<
+                std::function<t_tscalar(std::vector<t_tscalar>&)>>(gstate,
+                expression_master_table, spec.get_dependencies()[0].name(),
+                rows, [](std::vector<t_tscalar>& values) {
+                    if (values.empty()) {
+                        return mknone();
+                    }
 
-                        return rval;
-                    }));
-                dst->set_scalar(dst_ridx, new_value);
-            } break;
-            case AGGTYPE_SUM_ABS: {
-                old_value.set(dst->get_scalar(dst_ridx));
-                auto pkeys = get_pkeys(nidx);
-
-                new_value.set(reduce_from_gstate<
-                    std::function<t_tscalar(std::vector<t_tscalar>&)>>(gstate,
-                    expression_master_table, spec.get_dependencies()[0].name(),
-                    pkeys, [](std::vector<t_tscalar>& values) {
-                        if (values.empty()) {
-                            return mknone();
-                        }
+                    t_tscalar rval;
+                    rval.set(std::uint64_t(0));
+                    rval.m_type = values[0].m_type;
 
-                        t_tscalar rval;
-                        rval.set(std::uint64_t(0));
-                        rval.m_type = values[0].m_type;
-                        for (const auto& v : values) {
-                            rval = rval.add(v.abs());
-                        }
-                        return rval;
-                    }));
+                    for (const auto& v : values) {
+                        if (v.is_nan())
+                            continue;
+                        rval = rval.add(v);
+                    }
 
-                dst->set_scalar(dst_ridx, new_value);
-            } break;
-            case AGGTYPE_ABS_SUM: {
-                old_value.set(dst->get_scalar(dst_ridx));
-                auto pkeys = get_pkeys(nidx);
-                new_value.set(reduce_from_gstate<
-                    std::function<t_tscalar(std::vector<t_tscalar>&)>>(gstate,
-                    expression_master_table, spec.get_dependencies()[0].name(),
-                    pkeys, [](std::vector<t_tscalar>& values) {
-                        if (values.empty()) {
-                            return mknone();
-                        }
-                        t_tscalar rval;
-                        rval.set(std::uint64_t(0));
-                        rval.m_type = values[0].m_type;
-                        for (const auto& v : values) {
-                            rval = rval.add(v);
-                        }
-                        return rval.abs();
-                    }));
-                dst->set_scalar(dst_ridx, new_value);
-            } break;
-            case AGGTYPE_MUL: {
-                old_value.set(dst->get_scalar(dst_ridx));
-                auto pkeys = get_pkeys(nidx);
-                new_value.set(reduce_from_gstate<
-                    std::function<t_tscalar(std::vector<t_tscalar>&)>>(gstate,
-                    expression_master_table, spec.get_dependencies()[0].name(),
-                    pkeys, [](std::vector<t_tscalar>& values) {
-                        if (values.size() == 0) {
-                            return t_tscalar();
-                        } else if (values.size() == 1) {
-                            return values[0];
-                        } else {
-                            t_tscalar v = values[0];
-                            for (t_uindex vidx = 1, vloop_end = values.size();
-                                 vidx < vloop_end; ++vidx) {
-                                v = v.mul(values[vidx]);
-                            }
-                            return v;
-                        }
-                    }));
+                    return rval;
+                }));
+            dst->set_scalar(dst_ridx, new_value);
+        } break;
+        case AGGTYPE_SUM_ABS: {
+            old_value.set(dst->get_scalar(dst_ridx));
+            auto rows = get_rows(nidx);
+
+            new_value.set(reduce_from_gstate<
+                std::function<t_tscalar(std::vector<t_tscalar>&)>>(gstate,
+                expression_master_table, spec.get_dependencies()[0].name(),
+                rows, [](std::vector<t_tscalar>& values) {
+                    if (values.empty()) {
+                        return mknone();
+                    }
 
-                dst->set_scalar(dst_ridx, new_value);
-            } break;
-            case AGGTYPE_DISTINCT_COUNT: {
-                old_value.set(dst->get_scalar(dst_ridx));
-                auto pkeys = get_pkeys(nidx);
-
-                new_value.set(reduce_from_gstate<
-                    std::function<std::uint32_t(std::vector<t_tscalar>&)>>(
-                    gstate, expression_master_table,
-                    spec.get_dependencies()[0].name(), pkeys,
-                    [](std::vector<t_tscalar>& values) {
-                        tsl::hopscotch_set<t_tscalar> vset;
-                        for (const auto& v : values) {
-                            vset.insert(v);
-                        }
-                        std::uint32_t rv = vset.size();
-                        return rv;
-                    }));
+                    t_tscalar rval;
+                    rval.set(std::uint64_t(0));
+                    rval.m_type = values[0].m_type;
+                    for (const auto& v : values) {
+                        rval = rval.add(v.abs());
+                    }
+                    return rval;
+                }));
 
-                dst->set_scalar(dst_ridx, new_value);
-            } break;
-            case AGGTYPE_DISTINCT_LEAF: {
-                auto pkeys = get_pkeys(nidx);
-                old_value.set(dst->get_scalar(dst_ridx));
-                bool skip = false;
-                bool is_unique
-                    = is_unique_from_gstate(gstate, expression_master_table,
-                        spec.get_dependencies()[0].name(), pkeys, new_value);
-
-                if (is_leaf(nidx) && is_unique) {
-                    if (new_value.m_type == DTYPE_STR) {
-                        new_value = m_symtable.get_interned_tscalar(new_value);
+            dst->set_scalar(dst_ridx, new_value);
+        } break;
+        case AGGTYPE_ABS_SUM: {
+            old_value.set(dst->get_scalar(dst_ridx));
+            auto rows = get_rows(nidx);
+            new_value.set(reduce_from_gstate<
+                std::function<t_tscalar(std::vector<t_tscalar>&)>>(gstate,
+                expression_master_table, spec.get_dependencies()[0].name(),
+                rows, [](std::vector<t_tscalar>& values) {
+                    if (values.empty()) {
+                        return mknone();
                     }
-                } else {
-                    if (new_value.m_type == DTYPE_STR) {
-                        new_value = m_symtable.get_interned_tscalar("");
+                    t_tscalar rval;
+                    rval.set(std::uint64_t(0));
+                    rval.m_type = values[0].m_type;
+                    for (const auto& v : values) {
+                        rval = rval.add(v);
+                    }
+                    return rval.abs();
+                }));
+            dst->set_scalar(dst_ridx, new_value);
+        } break;
+        case AGGTYPE_MUL: {
+            old_value.set(dst->get_scalar(dst_ridx));
+            auto rows = get_rows(nidx);
+            new_value.set(reduce_from_gstate<
+                std::function<t_tscalar(std::vector<t_tscalar>&)>>(gstate,
+                expression_master_table, spec.get_dependencies()[0].name(),
+                rows, [](std::vector<t_tscalar>& values) {
+                    if (values.size() == 0) {
+                        return t_tscalar();
+                    } else if (values.size() == 1) {
+                        return values[0];
                     } else {
-                        dst->set_valid(dst_ridx, false);
-                        new_value = old_value;
-                        skip = true;
+                        t_tscalar v = values[0];
+                        for (t_uindex vidx = 1, vloop_end = values.size();
+                             vidx < vloop_end; ++vidx) {
+                            v = v.mul(values[vidx]);
+                        }
+                        return v;
+                    }
+                }));
+
+            dst->set_scalar(dst_ridx, new_value);
+        } break;
+        case AGGTYPE_DISTINCT_COUNT: {
+            old_value.set(dst->get_scalar(dst_ridx));
+            auto rows = get_sorted_rows(nidx);
+
+            new_value.set(reduce_from_gstate<
+                std::function<std::uint32_t(std::vector<t_tscalar>&)>>(
+                gstate, expression_master_table,
+                spec.get_dependencies()[0].name(), rows,
+                [](std::vector<t_tscalar>& values) {
+                    tsl::hopscotch_set<t_tscalar> vset;
+                    for (const auto& v : values) {
+                        vset.insert(v);
                     }
+                    std::uint32_t rv = vset.size();
+                    return rv;
+                }));
+
+            dst->set_scalar(dst_ridx, new_value);
+        } break;
+        case AGGTYPE_DISTINCT_LEAF: {
+            auto rows = get_sorted_rows(nidx);
+            old_value.set(dst->get_scalar(dst_ridx));
+            bool skip = false;
+            bool is_unique
+                = is_unique_from_gstate(gstate, expression_master_table,
+                    spec.get_dependencies()[0].name(), rows, new_value);
+
+            if (is_leaf(nidx) && is_unique) {
+                if (new_value.m_type == DTYPE_STR) {
+                    new_value = intern_tscalar(new_value);
                 }
-                if (!skip)
-                    dst->set_scalar(dst_ridx, new_value);
-            } break;
-            case AGGTYPE_VARIANCE:
-            case AGGTYPE_STANDARD_DEVIATION: {
-                old_value.set(dst->get_scalar(dst_ridx));
+            } else {
+                if (new_value.m_type == DTYPE_STR) {
+                    new_value = intern_tscalar("");
+                } else {
+                    dst->set_valid(dst_ridx, false);
+                    new_value = old_value;
+                    skip = true;
+                }
+            }
+            if (!skip)
+                dst->set_scalar(dst_ridx, new_value);
+        } break;
+        case AGGTYPE_VARIANCE:
+        case AGGTYPE_STANDARD_DEVIATION: {
+            old_value.set(dst->get_scalar(dst_ridx));
 
-                auto pkeys = get_pkeys(nidx);
-                std::vector<double> values;
+            auto rows = get_rows(nidx);
+            std::vector<double> values;
 
-                read_column_from_gstate(gstate, expression_master_table,
-                    spec.get_dependencies()[0].name(), pkeys, values, false);
+            read_column_from_gstate(gstate, expression_master_table,
+                spec.get_dependencies()[0].name(), rows, values, false);
+
+            // Calculate the count, rolling mean, and sum of squares of
+            // differences from the current mean at each iteration.
+            double count = 0, mean = 0, m2 = 0;
+
+            for (double num : values) {
+                count++;
+                double next_mean = mean + (num - mean) / count;
+                m2 += (num - mean) * (num - next_mean);
+                mean = next_mean;
+            }
 
-                // Calculate the count, rolling mean, and sum of squares of
-                // differences from the current mean at each iteration.
-                double count = 0, mean = 0, m2 = 0;
+            // Only calculate stddev for more than 1 element in the group.
+            if (count >= 2) {
+                double value = m2 / count;
 
-                for (double num : values) {
-                    count++;
-                    double next_mean = mean + (num - mean) / count;
-                    m2 += (num - mean) * (num - next_mean);
-                    mean = next_mean;
+                if (spec.agg() == AGGTYPE_STANDARD_DEVIATION) {
+                    value = std::sqrt(value);
                 }
 
-                // Only calculate stddev for more than 1 element in the group.
-                if (count >= 2) {
-                    double value = m2 / count;
+                new_value.set(value);
+                dst->set_scalar(dst_ridx, new_value);
+                dst->set_valid(dst_ridx, true);
+            } else {
+                dst->set_valid(dst_ridx, false);
+            }
 
-                    if (spec.agg() == AGGTYPE_STANDARD_DEVIATION) {
-                        value = std::sqrt(value);
-                    }
+        } break;
+        case AGGTYPE_APPROX_DISTINCT:
+        case AGGTYPE_APPROX_PERCENTILE: {
+            // built bottom-up in `update_sketch_aggs`
+        } break;
+        default: {
+            PSP_COMPLAIN_AND_ABORT("Not implemented");
+        }
+    } // end switch
 
-                    new_value.set(value);
-                    dst->set_scalar(dst_ridx, new_value);
-                    dst->set_valid(dst_ridx, true);
-                } else {
-                    dst->set_valid(dst_ridx, false);
+    record_delta(deltas, nidx, colidx, old_value, new_value);
+}
+
+void
+t_stree::record_delta(t_agg_update_deltas& deltas, t_uindex nidx,
+    t_uindex colidx, const t_tscalar& old_value,
+    const t_tscalar& new_value) const {
+    bool val_neq = old_value != new_value;
+
+    deltas.m_has_delta = deltas.m_has_delta || val_neq;
+    bool deltas_enabled = m_features.at(CTX_FEAT_DELTA);
+    if (deltas_enabled && val_neq) {
+        deltas.m_deltas.push_back(
+            t_tcdelta(nidx, colidx, old_value, new_value));
+    }
+}
+
+t_tscalar
+t_stree::intern_tscalar(const t_tscalar& s) {
+    std::lock_guard<std::mutex> guard(m_symtable_mutex);
+    return m_symtable.get_interned_tscalar(s);
+}
+
+t_tscalar
+t_stree::intern_tscalar(const char* s) {
+    std::lock_guard<std::mutex> guard(m_symtable_mutex);
+    return m_symtable.get_interned_tscalar(s);
+}
+
+void
+t_stree::update_sketch_aggs(t_uindex nidx, t_uindex colidx,
+    t_agg_update_info& info, t_uindex dst_ridx, const t_sketch_inserts& inserts,
+    const t_gstate& gstate, const t_data_table& expression_master_table,
+    t_agg_update_deltas& deltas) {
+    bool fold = inserts.m_fold;
+    bool leaf = is_leaf(nidx);
+    std::vector<t_uindex> leaf_rows;
+    std::vector<t_uindex> child_ridxs;
+
+    if (!fold && leaf) {
+        leaf_rows = get_rows(nidx);
+    } else if (!fold) {
+        for (auto child : m_nodes->get_children(nidx)) {
+            child_ridxs.push_back(m_nodes->get_aggidx(child));
+        }
+    }
+
+    const std::vector<t_uindex>& rows = fold ? inserts.m_rows : leaf_rows;
+    bool read_rows = fold || leaf;
+
+    t_column* dst = info.m_dst[colidx];
+    const t_aggspec& spec = info.m_aggspecs[colidx];
+    const std::string& colname = spec.get_dependencies()[0].name();
+    t_tscalar old_value = mknone();
+    t_tscalar new_value = mknone();
+    old_value.set(dst->get_scalar(dst_ridx));
+
+    switch (spec.agg()) {
+        case AGGTYPE_APPROX_DISTINCT: {
+            auto& sketches = m_hll_sketches.at(colidx);
+            t_hll_sketch& sketch = sketches[dst_ridx];
+
+            if (!fold) {
+                sketch.clear();
+            }
+
+            if (read_rows) {
+                std::vector<t_tscalar> values;
+                read_column_from_gstate(
+                    gstate, expression_master_table, colname, rows, values);
+
+                for (const auto& v : values) {
+                    sketch.add(v);
+                }
+            } else {
+                for (auto child_ridx : child_ridxs) {
+                    sketch.merge(sketches[child_ridx]);
                 }
+            }
 
-            } break;
-            default: {
-                PSP_COMPLAIN_AND_ABORT("Not implemented");
+            new_value.set(
+                static_cast<std::uint32_t>(std::round(sketch.estimate())));
+            dst->set_scalar(dst_ridx, new_value);
+        } break;
+        case AGGTYPE_APPROX_PERCENTILE: {
+            auto& digests = m_tdigests.at(colidx);
+            t_tdigest& digest = digests[dst_ridx];
+
+            if (!fold) {
+                digest.clear();
             }
-        } // end switch
 
-        bool val_neq = old_value != new_value;
+            if (read_rows) {
+                std::vector<double> values;
+                read_column_from_gstate(gstate, expression_master_table,
+                    colname, rows, values, false);
 
-        m_has_delta = m_has_delta || val_neq;
-        bool deltas_enabled = m_features.at(CTX_FEAT_DELTA);
-        if (deltas_enabled && val_neq) {
-            m_deltas->insert(t_tcdelta(nidx, idx, old_value, new_value));
+                for (double v : values) {
+                    digest.add(v);
+                }
+            } else {
+                for (auto child_ridx : child_ridxs) {
+                    digest.merge(digests[child_ridx]);
+                }
+            }
+
+            if (digest.empty()) {
+                dst->set_valid(dst_ridx, false);
+            } else {
+                new_value.set(digest.quantile(spec.get_quantile()));
+                dst->set_scalar(dst_ridx, new_value);
+                dst->set_valid(dst_ridx, true);
+            }
+        } break;
+        default: {
+            PSP_COMPLAIN_AND_ABORT("Not a sketch aggregate");
         }
+    }
 
-    } // end for
+    record_delta(deltas, nidx, colidx, old_value, new_value);
 }
 
 std::vector<t_uindex>
 t_stree::zero_strands() const {
-    auto iterators = m_nodes->get<by_nstrands>().equal_range(0);
-    std::vector<t_uindex> rval;
-
-    for (auto& iter = iterators.first; iter != iterators.second; ++iter) {
-        rval.push_back(iter->m_idx);
-    }
-    return rval;
+    return m_nodes->zero_strands();
 }
 
 std::set<t_uindex>
@@ -1571,14 +2177,26 @@ t_stree::non_zero_ids(const std::set<t_uindex>& ptiset,
     return rval;
 }
 
+std::vector<t_uindex>
+t_stree::updated_ids(const std::vector<t_uindex>& zero_strands) const {
+    std::vector<t_uindex> rval;
+    rval.reserve(m_tree_unification_records.size() + zero_strands.size());
+
+    for (const auto& r : m_tree_unification_records) {
+        rval.push_back(r.m_sptidx);
+    }
+
+    rval.insert(rval.end(), zero_strands.begin(), zero_strands.end());
+    return rval;
+}
+
 t_uindex
 t_stree::get_parent_idx(t_uindex ptidx) const {
-    iter_by_idx iter = m_nodes->get<by_idx>().find(ptidx);
-    if (iter == m_nodes->get<by_idx>().end()) {
+    if (!m_nodes->contains(ptidx)) {
         std::cout << "Failed in tree => " << repr() << std::endl;
         PSP_VERBOSE_ASSERT(false, "Did not find node");
     }
-    return iter->m_pidx;
+    return m_nodes->get_pidx(ptidx);
 }
 
 std::vector<t_uindex>
@@ -1598,18 +2216,15 @@ t_stree::get_ancestry(t_uindex idx) const {
 t_index
 t_stree::get_sibling_idx(
     t_index p_ptidx, t_index p_nchild, t_uindex c_ptidx) const {
-    t_by_pidx_ipair iterators = m_nodes->get<by_pidx>().equal_range(p_ptidx);
-    iter_by_pidx c_iter
-        = m_nodes->project<by_pidx>(m_nodes->get<by_idx>().find(c_ptidx));
-    return std::distance(iterators.first, c_iter);
+    const std::vector<t_uindex>& children = m_nodes->get_children(p_ptidx);
+    return std::distance(children.begin(),
+        std::find(children.begin(), children.end(), c_ptidx));
 }
 
 t_uindex
 t_stree::get_aggidx(t_uindex idx) const {
-    iter_by_idx iter = m_nodes->get<by_idx>().find(idx);
-    PSP_VERBOSE_ASSERT(
-        iter != m_nodes->get<by_idx>().end(), "Failed in get_aggidx");
-    return iter->m_aggidx;
+    PSP_VERBOSE_ASSERT(m_nodes->contains(idx), "Failed in get_aggidx");
+    return m_nodes->get_aggidx(idx);
 }
 
 std::shared_ptr<const t_data_table>
@@ -1624,10 +2239,8 @@ t_stree::_get_aggtable() {
 
 t_stree::t_tnode
 t_stree::get_node(t_uindex idx) const {
-    iter_by_idx iter = m_nodes->get<by_idx>().find(idx);
-    PSP_VERBOSE_ASSERT(
-        iter != m_nodes->get<by_idx>().end(), "Failed in get_node");
-    return *iter;
+    PSP_VERBOSE_ASSERT(m_nodes->contains(idx), "Failed in get_node");
+    return m_nodes->get(idx);
 }
 
 void
@@ -1638,9 +2251,8 @@ t_stree::get_path(t_uindex idx, std::vector<t_tscalar>& rval) const {
         return;
 
     while (1) {
-        iter_by_idx iter = m_nodes->get<by_idx>().find(curidx);
-        rval.push_back(iter->m_value);
-        curidx = iter->m_pidx;
+        rval.push_back(m_nodes->get_value(curidx));
+        curidx = m_nodes->get_pidx(curidx);
         if (curidx == 0) {
             break;
         }
@@ -1650,13 +2262,7 @@ t_stree::get_path(t_uindex idx, std::vector<t_tscalar>& rval) const {
 
 t_uindex
 t_stree::resolve_child(t_uindex root, const t_tscalar& datum) const {
-    auto iter = m_nodes->get<by_pidx_hash>().find(std::make_tuple(root, datum));
-
-    if (iter == m_nodes->get<by_pidx_hash>().end()) {
-        return INVALID_INDEX;
-    }
-
-    return iter->m_idx;
+    return m_nodes->find_child(root, datum);
 }
 
 void
@@ -1670,77 +2276,229 @@ t_stree::clear_aggregates(const std::vector<t_uindex>& indices) {
 
     m_agg_freelist.insert(
         std::end(m_agg_freelist), std::begin(indices), std::end(indices));
+
+    // Release the sketches of freed rows; a reused row rebuilds its sketch
+    // from scratch.
+    for (auto& col : m_hll_sketches) {
+        for (auto aggidx : indices) {
+            if (aggidx < col.second.size()) {
+                col.second[aggidx].clear();
+            }
+        }
+    }
+
+    for (auto& col : m_tdigests) {
+        for (auto aggidx : indices) {
+            if (aggidx < col.second.size()) {
+                col.second[aggidx].clear();
+            }
+        }
+    }
 }
 
 void
 t_stree::drop_zero_strands() {
-    auto iterators = m_nodes->get<by_nstrands>().equal_range(0);
-
-    std::vector<t_uindex> leaves;
+    std::vector<t_uindex> zeros = m_nodes->zero_strands();
 
     auto lst = last_level();
 
     std::vector<t_uindex> node_ids;
+    tsl::hopscotch_set<t_uindex> leaves;
+    tsl::hopscotch_set<t_uindex> ancestors;
 
-    for (auto iter = iterators.first; iter != iterators.second; ++iter) {
-        if (iter->m_depth == lst)
-            leaves.push_back(iter->m_idx);
-        node_ids.push_back(iter->m_aggidx);
+    for (auto nidx : zeros) {
+        node_ids.push_back(m_nodes->get_aggidx(nidx));
+
+        if (m_nodes->get_depth(nidx) == lst) {
+            leaves.insert(nidx);
+
+            for (auto ancidx : get_ancestry(nidx)) {
+                if (ancidx != nidx) {
+                    ancestors.insert(ancidx);
+                }
+            }
+        }
     }
 
     clear_aggregates(node_ids);
 
-    for (auto nidx : leaves) {
-        auto ancestry = get_ancestry(nidx);
+    // Remove the dropped leaves from each ancestor in a single pass, rather
+    // than erasing them one at a time.
+    for (auto ancidx : ancestors) {
+        auto iter = m_leaves.find(ancidx);
+        if (iter == m_leaves.end()) {
+            continue;
+        }
 
-        for (auto ancidx : ancestry) {
-            if (ancidx == nidx)
-                continue;
-            remove_leaf(ancidx, nidx);
+        std::vector<t_uindex>& anc_leaves = m_leaves[ancidx];
+        anc_leaves.erase(std::remove_if(anc_leaves.begin(), anc_leaves.end(),
+                             [&leaves](t_uindex lfidx) {
+                                 return leaves.find(lfidx) != leaves.end();
+                             }),
+            anc_leaves.end());
+    }
+
+    for (auto nidx : zeros) {
+        m_leaves.erase(nidx);
+
+        if (nidx < m_pkeys.size()) {
+            std::vector<t_tscalar>().swap(m_pkeys[nidx]);
+            std::vector<t_uindex>().swap(m_rows[nidx]);
         }
     }
 
-    auto iterators2 = m_nodes->get<by_nstrands>().equal_range(0);
+    m_nodes->erase(zeros);
+}
+
+void
+t_stree::add_pkey(t_uindex idx, t_tscalar pkey, t_uindex row) {
+    if (idx >= m_pkeys.size()) {
+        m_pkeys.resize(idx + 1);
+        m_rows.resize(idx + 1);
+    }
+
+    std::vector<t_tscalar>& pkeys = m_pkeys[idx];
+    std::vector<t_uindex>& rows = m_rows[idx];
+
+    if (pkeys.empty() || pkeys.back() < pkey) {
+        pkeys.push_back(pkey);
+        rows.push_back(row);
+        return;
+    }
 
-    m_nodes->get<by_nstrands>().erase(iterators2.first, iterators2.second);
+    auto iter = std::lower_bound(pkeys.begin(), pkeys.end(), pkey);
+    if (iter == pkeys.end() || *iter != pkey) {
+        rows.insert(rows.begin() + (iter - pkeys.begin()), row);
+        pkeys.insert(iter, pkey);
+    }
 }
 
 void
-t_stree::add_pkey(t_uindex idx, t_tscalar pkey) {
-    t_stpkey s(idx, pkey);
-    m_idxpkey->insert(s);
+t_stree::add_pkeys(std::vector<t_stpkey>& new_pkeys) {
+    if (new_pkeys.empty()) {
+        return;
+    }
+
+    std::sort(new_pkeys.begin(), new_pkeys.end(),
+        [](const t_stpkey& a, const t_stpkey& b) {
+            return a.m_idx < b.m_idx || (a.m_idx == b.m_idx && a.m_pkey < b.m_pkey);
+        });
+
+    std::vector<t_tscalar> merged_pkeys;
+    std::vector<t_uindex> merged_rows;
+
+    for (t_uindex bidx = 0, loop_end = new_pkeys.size(); bidx < loop_end;) {
+        t_uindex idx = new_pkeys[bidx].m_idx;
+        t_uindex eidx = bidx;
+
+        while (eidx < loop_end && new_pkeys[eidx].m_idx == idx) {
+            ++eidx;
+        }
+
+        if (idx >= m_pkeys.size()) {
+            m_pkeys.resize(idx + 1);
+            m_rows.resize(idx + 1);
+        }
+
+        std::vector<t_tscalar>& pkeys = m_pkeys[idx];
+        std::vector<t_uindex>& rows = m_rows[idx];
+
+        // Merge the sorted batch into the leaf, moving each key's row
+        // along with it.
+        merged_pkeys.clear();
+        merged_rows.clear();
+        merged_pkeys.reserve(pkeys.size() + eidx - bidx);
+        merged_rows.reserve(pkeys.size() + eidx - bidx);
+
+        t_uindex oidx = 0;
+        t_uindex pidx = bidx;
+
+        while (oidx < pkeys.size() || pidx < eidx) {
+            bool take_new = oidx == pkeys.size()
+                || (pidx < eidx && new_pkeys[pidx].m_pkey < pkeys[oidx]);
+
+            const t_tscalar& pkey
+                = take_new ? new_pkeys[pidx].m_pkey : pkeys[oidx];
+            t_uindex row = take_new ? new_pkeys[pidx].m_row : rows[oidx];
+
+            if (merged_pkeys.empty() || merged_pkeys.back() != pkey) {
+                merged_pkeys.push_back(pkey);
+                merged_rows.push_back(row);
+            }
+
+            if (take_new) {
+                ++pidx;
+            } else {
+                ++oidx;
+            }
+        }
+
+        std::swap(pkeys, merged_pkeys);
+        std::swap(rows, merged_rows);
+
+        bidx = eidx;
+    }
 }
 
 void
 t_stree::remove_pkey(t_uindex idx, t_tscalar pkey) {
-    auto iter = m_idxpkey->get<by_idx_pkey>().find(std::make_tuple(idx, pkey));
+    if (idx >= m_pkeys.size()) {
+        return;
+    }
+
+    std::vector<t_tscalar>& pkeys = m_pkeys[idx];
+    auto iter = std::lower_bound(pkeys.begin(), pkeys.end(), pkey);
 
-    if (iter == m_idxpkey->get<by_idx_pkey>().end())
+    if (iter == pkeys.end() || *iter != pkey)
         return;
 
-    m_idxpkey->get<by_idx_pkey>().erase(iter);
+    m_rows[idx].erase(m_rows[idx].begin() + (iter - pkeys.begin()));
+    pkeys.erase(iter);
 }
 
 void
 t_stree::add_leaf(t_uindex nidx, t_uindex lfidx) {
-    t_stleaves s(nidx, lfidx);
-    m_idxleaf->insert(s);
+    std::vector<t_uindex>& leaves = m_leaves[nidx];
+
+    // Leaf ids are allocated in increasing order, so this is almost always
+    // an append.
+    if (leaves.empty() || leaves.back() < lfidx) {
+        leaves.push_back(lfidx);
+        return;
+    }
+
+    auto iter = std::lower_bound(leaves.begin(), leaves.end(), lfidx);
+    if (iter == leaves.end() || *iter != lfidx) {
+        leaves.insert(iter, lfidx);
+    }
 }
 
 void
 t_stree::remove_leaf(t_uindex nidx, t_uindex lfidx) {
-    auto iter
-        = m_idxleaf->get<by_idx_lfidx>().find(std::make_tuple(nidx, lfidx));
+    auto liter = m_leaves.find(nidx);
+
+    if (liter == m_leaves.end())
+        return;
 
-    if (iter == m_idxleaf->get<by_idx_lfidx>().end())
+    std::vector<t_uindex>& leaves = m_leaves[nidx];
+    auto iter = std::lower_bound(leaves.begin(), leaves.end(), lfidx);
+
+    if (iter == leaves.end() || *iter != lfidx)
         return;
 
-    m_idxleaf->get<by_idx_lfidx>().erase(iter);
+    leaves.erase(iter);
 }
 
-t_by_idx_pkey_ipair
+const std::vector<t_tscalar>&
 t_stree::get_pkeys_for_leaf(t_uindex idx) const {
-    return m_idxpkey->get<by_idx_pkey>().equal_range(idx);
+    static const std::vector<t_tscalar> EMPTY;
+    return idx < m_pkeys.size() ? m_pkeys[idx] : EMPTY;
+}
+
+const std::vector<t_uindex>&
+t_stree::get_rows_for_leaf(t_uindex idx) const {
+    static const std::vector<t_uindex> EMPTY;
+    return idx < m_rows.size() ? m_rows[idx] : EMPTY;
 }
 
 std::vector<t_tscalar>
@@ -1749,14 +2507,31 @@ t_stree::get_pkeys(t_uindex idx) const {
     std::vector<t_uindex> leaves = get_leaves(idx);
 
     for (auto leaf : leaves) {
-        auto iters = get_pkeys_for_leaf(leaf);
-        for (auto iter = iters.first; iter != iters.second; ++iter) {
-            rval.push_back(iter->m_pkey);
-        }
+        const auto& pkeys = get_pkeys_for_leaf(leaf);
+        rval.insert(rval.end(), pkeys.begin(), pkeys.end());
     }
     return rval;
 }
 
+std::vector<t_uindex>
+t_stree::get_rows(t_uindex idx) const {
+    std::vector<t_uindex> rval;
+    std::vector<t_uindex> leaves = get_leaves(idx);
+
+    for (auto leaf : leaves) {
+        const auto& rows = get_rows_for_leaf(leaf);
+        rval.insert(rval.end(), rows.begin(), rows.end());
+    }
+    return rval;
+}
+
+std::vector<t_uindex>
+t_stree::get_sorted_rows(t_uindex idx) const {
+    std::vector<t_uindex> rval = get_rows(idx);
+    std::sort(rval.begin(), rval.end());
+    return rval;
+}
+
 std::vector<t_uindex>
 t_stree::get_leaves(t_uindex idx) const {
     std::vector<t_uindex> rval;
@@ -1766,17 +2541,16 @@ t_stree::get_leaves(t_uindex idx) const {
         return rval;
     }
 
-    auto iters = m_idxleaf->get<by_idx_lfidx>().equal_range(idx);
-    for (auto iter = iters.first; iter != iters.second; ++iter) {
-        rval.push_back(iter->m_lfidx);
+    auto iter = m_leaves.find(idx);
+    if (iter != m_leaves.end()) {
+        rval = iter->second;
     }
     return rval;
 }
 
 t_depth
 t_stree::get_depth(t_uindex ptidx) const {
-    auto iter = m_nodes->get<by_idx>().find(ptidx);
-    return iter->m_depth;
+    return m_nodes->get_depth(ptidx);
 }
 
 void
@@ -1812,29 +2586,17 @@ t_stree::get_drd_indices(
 
 std::vector<t_uindex>
 t_stree::get_child_idx(t_uindex idx) const {
-    t_index num_children = get_num_children(idx);
-    std::vector<t_uindex> children(num_children);
-    auto iterators = m_nodes->get<by_pidx>().equal_range(idx);
-    t_index count = 0;
-    while (iterators.first != iterators.second) {
-        children[count] = iterators.first->m_idx;
-        ++count;
-        ++iterators.first;
-    }
-    return children;
+    return m_nodes->get_children(idx);
 }
 
 std::vector<std::pair<t_index, t_index>>
 t_stree::get_child_idx_depth(t_uindex idx) const {
-    t_index num_children = get_num_children(idx);
-    std::vector<std::pair<t_index, t_index>> children(num_children);
-    auto iterators = m_nodes->get<by_pidx>().equal_range(idx);
-    t_index count = 0;
-    while (iterators.first != iterators.second) {
+    const std::vector<t_uindex>& cidx = m_nodes->get_children(idx);
+    std::vector<std::pair<t_index, t_index>> children(cidx.size());
+    for (t_uindex count = 0, loop_end = cidx.size(); count < loop_end;
+         ++count) {
         children[count] = std::pair<t_index, t_index>(
-            iterators.first->m_idx, iterators.first->m_depth);
-        ++count;
-        ++iterators.first;
+            cidx[count], m_nodes->get_depth(cidx[count]));
     }
     return children;
 }
@@ -1860,10 +2622,8 @@ t_stree::last_level() const {
 
 bool
 t_stree::is_leaf(t_uindex nidx) const {
-    auto iter = m_nodes->get<by_idx>().find(nidx);
-    PSP_VERBOSE_ASSERT(
-        iter != m_nodes->get<by_idx>().end(), "Did not find node");
-    return iter->m_depth == last_level();
+    PSP_VERBOSE_ASSERT(m_nodes->contains(nidx), "Did not find node");
+    return m_nodes->get_depth(nidx) == last_level();
 }
 
 std::vector<t_uindex>
@@ -1897,12 +2657,11 @@ t_stree::resolve_path(t_uindex root, const std::vector<t_tscalar>& path) const {
         return curidx;
 
     for (t_index i = path.size() - 1; i >= 0; i--) {
-        iter_by_pidx_hash iter = m_nodes->get<by_pidx_hash>().find(
-            std::make_tuple(curidx, path[i]));
-        if (iter == m_nodes->get<by_pidx_hash>().end()) {
+        t_uindex cidx = m_nodes->find_child(curidx, path[i]);
+        if (cidx == t_stnodes::NO_CHILD) {
             return INVALID_INDEX;
         }
-        curidx = iter->m_idx;
+        curidx = cidx;
     }
 
     return curidx;
@@ -1983,15 +2742,8 @@ t_stree::get_aggregate(t_index idx, t_index aggnum) const {
 
 void
 t_stree::get_child_indices(t_index idx, std::vector<t_index>& out_data) const {
-    t_index num_children = get_num_children(idx);
-    std::vector<t_index> temp(num_children);
-    t_by_pidx_ipair iterators = m_nodes->get<by_pidx>().equal_range(idx);
-    t_index count = 0;
-    for (iter_by_pidx iter = iterators.first; iter != iterators.second;
-         ++iter) {
-        temp[count] = iter->m_idx;
-        ++count;
-    }
+    const std::vector<t_uindex>& children = m_nodes->get_children(idx);
+    std::vector<t_index> temp(children.begin(), children.end());
     std::swap(out_data, temp);
 }
 
@@ -2004,6 +2756,8 @@ t_stree::clear_deltas() {
 void
 t_stree::clear() {
     m_nodes->clear();
+    m_hll_sketches.clear();
+    m_tdigests.clear();
     clear_deltas();
 }
 
@@ -2030,19 +2784,19 @@ t_stree::get_deltas() const {
 std::pair<t_tscalar, t_tscalar>
 t_stree::first_last_helper(t_uindex nidx, const t_aggspec& spec,
     const t_gstate& gstate, const t_data_table& expression_master_table) const {
-    auto pkeys = get_pkeys(nidx);
+    auto rows = get_rows(nidx);
 
-    if (pkeys.empty())
+    if (rows.empty())
         return std::make_pair(mknone(), mknone());
 
     std::vector<t_tscalar> values;
     std::vector<t_tscalar> sort_values;
 
     read_column_from_gstate(gstate, expression_master_table,
-        spec.get_dependencies()[0].name(), pkeys, values);
+        spec.get_dependencies()[0].name(), rows, values);
 
     read_column_from_gstate(gstate, expression_master_table,
-        spec.get_dependencies()[1].name(), pkeys, sort_values);
+        spec.get_dependencies()[1].name(), rows, sort_values);
 
     auto minmax_idx = get_minmax_idx(sort_values, spec.get_sort_type());
 
@@ -2087,8 +2841,7 @@ t_stree::first_last_helper(t_uindex nidx, const t_aggspec& spec,
 
 bool
 t_stree::node_exists(t_uindex idx) {
-    iter_by_idx iter = m_nodes->get<by_idx>().find(idx);
-    return iter != m_nodes->get<by_idx>().end();
+    return m_nodes->contains(idx);
 }
 
 t_data_table*
@@ -2096,11 +2849,34 @@ t_stree::get_aggtable() {
     return m_aggregates.get();
 }
 
-std::pair<iter_by_idx, bool>
+bool
 t_stree::insert_node(const t_tnode& node) {
     return m_nodes->insert(node);
 }
 
+void
+t_stree::remove_nodes(const std::vector<t_uindex>& nidxs) {
+    std::vector<t_uindex> aggidxs;
+    aggidxs.reserve(nidxs.size());
+
+    for (auto nidx : nidxs) {
+        if (!m_nodes->contains(nidx)) {
+            continue;
+        }
+
+        aggidxs.push_back(m_nodes->get_aggidx(nidx));
+        m_leaves.erase(nidx);
+
+        if (nidx < m_pkeys.size()) {
+            std::vector<t_tscalar>().swap(m_pkeys[nidx]);
+            std::vector<t_uindex>().swap(m_rows[nidx]);
+        }
+    }
+
+    clear_aggregates(aggidxs);
+    m_nodes->erase(nidxs);
+}
+
 bool
 t_stree::has_deltas() const {
     return m_has_delta;
@@ -2114,9 +2890,8 @@ t_stree::get_sortby_path(t_uindex idx, std::vector<t_tscalar>& rval) const {
         return;
 
     while (1) {
-        iter_by_idx iter = m_nodes->get<by_idx>().find(curidx);
-        rval.push_back(iter->m_sort_value);
-        curidx = iter->m_pidx;
+        rval.push_back(m_nodes->get_sort_value(curidx));
+        curidx = m_nodes->get_pidx(curidx);
         if (curidx == 0) {
             break;
         }
@@ -2129,6 +2904,32 @@ t_stree::set_has_deltas(bool v) {
     m_has_delta = v;
 }
 
+void
+t_stree::set_last_step(t_stree_step step) {
+    m_last_step = std::move(step);
+}
+
+const t_stree_step&
+t_stree::get_last_step() const {
+    return m_last_step;
+}
+
+void
+t_stree::add_context() {
+    ++m_num_contexts;
+}
+
+void
+t_stree::remove_context() {
+    PSP_VERBOSE_ASSERT(m_num_contexts > 0, "Tree has no contexts");
+    --m_num_contexts;
+}
+
+t_uindex
+t_stree::get_num_contexts() const {
+    return m_num_contexts;
+}
+
 t_bfs_iter<t_stree>
 t_stree::bfs() const {
     return t_bfs_iter<t_stree>(this);
@@ -2155,78 +2956,78 @@ t_stree::pprint() const {
     }
 }
 
-void
-t_stree::read_column_from_gstate(const t_gstate& gstate,
-    const t_data_table& expression_master_table, const std::string& colname,
-    const std::vector<t_tscalar>& pkeys,
-    std::vector<t_tscalar>& out_data) const {
+std::shared_ptr<const t_column>
+t_stree::get_column_from_gstate(const t_gstate& gstate,
+    const t_data_table& expression_master_table,
+    const std::string& colname) const {
     const t_schema& expression_schema = expression_master_table.get_schema();
 
     if (expression_schema.has_column(colname)) {
-        gstate.read_column(expression_master_table, colname, pkeys, out_data);
+        return expression_master_table.get_const_column(colname);
     } else {
         std::shared_ptr<t_data_table> gstate_master_table = gstate.get_table();
-        gstate.read_column(*gstate_master_table, colname, pkeys, out_data);
+        return gstate_master_table->get_const_column(colname);
     }
 }
 
 void
 t_stree::read_column_from_gstate(const t_gstate& gstate,
     const t_data_table& expression_master_table, const std::string& colname,
-    const std::vector<t_tscalar>& pkeys, std::vector<double>& out_data,
-    bool include_none) const {
+    const std::vector<t_uindex>& rows,
+    std::vector<t_tscalar>& out_data) const {
     const t_schema& expression_schema = expression_master_table.get_schema();
 
     if (expression_schema.has_column(colname)) {
-        gstate.read_column(
-            expression_master_table, colname, pkeys, out_data, include_none);
+        gstate.read_column(expression_master_table, colname, rows, out_data);
     } else {
         std::shared_ptr<t_data_table> gstate_master_table = gstate.get_table();
-        gstate.read_column(
-            *gstate_master_table, colname, pkeys, out_data, include_none);
+        gstate.read_column(*gstate_master_table, colname, rows, out_data);
     }
 }
 
-t_tscalar
-t_stree::read_by_pkey_from_gstate(const t_gstate& gstate,
+void
+t_stree::read_column_from_gstate(const t_gstate& gstate,
     const t_data_table& expression_master_table, const std::string& colname,
-    t_tscalar& pkey) const {
+    const std::vector<t_uindex>& rows, std::vector<double>& out_data,
+    bool include_none) const {
     const t_schema& expression_schema = expression_master_table.get_schema();
 
     if (expression_schema.has_column(colname)) {
-        return gstate.read_by_pkey(expression_master_table, colname, pkey);
+        gstate.read_column(
+            expression_master_table, colname, rows, out_data, include_none);
     } else {
         std::shared_ptr<t_data_table> gstate_master_table = gstate.get_table();
-        return gstate.read_by_pkey(*gstate_master_table, colname, pkey);
+        gstate.read_column(
+            *gstate_master_table, colname, rows, out_data, include_none);
     }
 }
 
 bool
 t_stree::is_unique_from_gstate(const t_gstate& gstate,
     const t_data_table& expression_master_table, const std::string& colname,
-    const std::vector<t_tscalar>& pkeys, t_tscalar& value) const {
+    const std::vector<t_uindex>& rows, t_tscalar& value) const {
     const t_schema& expression_schema = expression_master_table.get_schema();
 
     if (expression_schema.has_column(colname)) {
-        return gstate.is_unique(expression_master_table, colname, pkeys, value);
+        return gstate.is_unique(expression_master_table, colname, rows, value);
     } else {
         std::shared_ptr<t_data_table> gstate_master_table = gstate.get_table();
-        return gstate.is_unique(*gstate_master_table, colname, pkeys, value);
+        return gstate.is_unique(*gstate_master_table, colname, rows, value);
     }
 }
 
 bool
 t_stree::apply_from_gstate(const t_gstate& gstate,
     const t_data_table& expression_master_table, const std::string& colname,
-    const std::vector<t_tscalar>& pkeys, t_tscalar& value,
+    const std::vector<t_uindex>& rows, t_tscalar& value,
     std::function<bool(const t_tscalar&, t_tscalar&)> fn) const {
     const t_schema& expression_schema = expression_master_table.get_schema();
 
     if (expression_schema.has_column(colname)) {
-        return gstate.apply(expression_master_table, colname, pkeys, value, fn);
+        return gstate.apply(expression_master_table, colname, rows, value, fn);
     } else {
         std::shared_ptr<t_data_table> gstate_master_table = gstate.get_table();
-        return gstate.apply(*gstate_master_table, colname, pkeys, value, fn);
+        return gstate.apply(*gstate_master_table, colname, rows, value, fn);
     }
 }
 
@@ -2234,14 +3035,14 @@ template <typename FN_T>
 typename FN_T::result_type
 t_stree::reduce_from_gstate(const t_gstate& gstate,
     const t_data_table& expression_master_table, const std::string& colname,
-    const std::vector<t_tscalar>& pkeys, FN_T fn) const {
+    const std::vector<t_uindex>& rows, FN_T fn) const {
     const t_schema& expression_schema = expression_master_table.get_schema();
 
     if (expression_schema.has_column(colname)) {
-        return gstate.reduce(expression_master_table, colname, pkeys, fn);
+        return gstate.reduce(expression_master_table, colname, rows, fn);
     } else {
         std::shared_ptr<t_data_table> gstate_master_table = gstate.get_table();
-        return gstate.reduce(*gstate_master_table, colname, pkeys, fn);
+        return gstate.reduce(*gstate_master_table, colname, rows, fn);
     }
 }
 
@@ -36,18 +36,13 @@ t_stnode::set_sort_value(t_tscalar sv) {
     m_sort_value.set(sv);
 }
 
-t_stpkey::t_stpkey(t_uindex idx, t_tscalar pkey)
+t_stpkey::t_stpkey(t_uindex idx, t_tscalar pkey, t_uindex row)
     : m_idx(idx)
-    , m_pkey(pkey) {}
+    , m_pkey(pkey)
+    , m_row(row) {}
 
 t_stpkey::t_stpkey() {}
 
-t_stleaves::t_stleaves(t_uindex idx, t_uindex lfidx)
-    : m_idx(idx)
-    , m_lfidx(lfidx) {}
-
-t_stleaves::t_stleaves() {}
-
 t_cellinfo::t_cellinfo() {}
 
 t_cellinfo::t_cellinfo(t_index idx, t_depth treenum, t_index agg_index,
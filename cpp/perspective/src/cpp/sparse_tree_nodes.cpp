@@ -0,0 +1,319 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2017, the Perspective Authors.
+ *
+ * This file is part of the Perspective library, distributed under the terms of
+ * the Apache License 2.0.  The full license can be found in the LICENSE file.
+ *
+ */
+
+#include <perspective/first.h>
+#include <perspective/sparse_tree_nodes.h>
+#include <algorithm>
+
+namespace perspective {
+
+const t_uindex t_stnodes::SMALL_CHILD_COUNT;
+const t_uindex t_stnodes::NO_CHILD;
+
+t_stchildren::t_stchildren()
+    : m_sorted(true) {}
+
+t_stnodes::t_stnodes()
+    : m_size(0) {}
+
+bool
+t_stnodes::insert(const t_stnode& node) {
+    t_uindex idx = node.m_idx;
+
+    if (contains(idx)
+        || find_child(node.m_pidx, node.m_value) != NO_CHILD) {
+        return false;
+    }
+
+    if (idx >= m_live.size()) {
+        t_uindex new_size = idx + 1;
+        m_pidx.resize(new_size);
+        m_depth.resize(new_size);
+        m_value.resize(new_size);
+        m_sort_value.resize(new_size);
+        m_nstrands.resize(new_size);
+        m_aggidx.resize(new_size);
+        m_live.resize(new_size, false);
+    }
+
+    m_pidx[idx] = node.m_pidx;
+    m_depth[idx] = node.m_depth;
+    m_value[idx].set(node.m_value);
+    m_sort_value[idx].set(node.m_sort_value);
+    m_nstrands[idx] = node.m_nstrands;
+    m_aggidx[idx] = node.m_aggidx;
+    m_live[idx] = true;
+    ++m_size;
+
+    if (node.m_nstrands == 0) {
+        m_zero_strands.insert(idx);
+    }
+
+    t_stchildren& children = m_children[node.m_pidx];
+    std::vector<t_uindex>& cvec = children.m_children;
+
+    // Appending in order - the common case when building from a sorted
+    // dense tree - keeps the range sorted for free.
+    if (children.m_sorted && !cvec.empty()) {
+        t_uindex last = cvec.back();
+        bool in_order = m_sort_value[last] < node.m_sort_value
+            || (!(node.m_sort_value < m_sort_value[last])
+                && m_value[last] < node.m_value);
+
+        if (!in_order) {
+            children.m_sorted = false;
+            m_unsorted.insert(node.m_pidx);
+        }
+    }
+
+    cvec.push_back(idx);
+
+    if (!children.m_index.empty()) {
+        children.m_index[node.m_value] = idx;
+    } else if (cvec.size() > SMALL_CHILD_COUNT) {
+        for (auto cidx : cvec) {
+            children.m_index[m_value[cidx]] = cidx;
+        }
+    }
+
+    return true;
+}
+
+void
+t_stnodes::erase(const std::vector<t_uindex>& nodes) {
+    std::vector<t_uindex> parents;
+    parents.reserve(nodes.size());
+
+    for (auto idx : nodes) {
+        if (!contains(idx)) {
+            continue;
+        }
+
+        m_live[idx] = false;
+        --m_size;
+        m_zero_strands.erase(idx);
+        m_children.erase(idx);
+        m_unsorted.erase(idx);
+        parents.push_back(m_pidx[idx]);
+    }
+
+    std::sort(parents.begin(), parents.end());
+    parents.erase(std::unique(parents.begin(), parents.end()), parents.end());
+
+    for (auto pidx : parents) {
+        if (m_children.find(pidx) == m_children.end()) {
+            continue;
+        }
+
+        t_stchildren& children = m_children[pidx];
+        std::vector<t_uindex>& cvec = children.m_children;
+
+        cvec.erase(std::remove_if(cvec.begin(), cvec.end(),
+                       [this](t_uindex cidx) { return !m_live[cidx]; }),
+            cvec.end());
+
+        if (cvec.empty()) {
+            m_children.erase(pidx);
+            m_unsorted.erase(pidx);
+            continue;
+        }
+
+        children.m_index.clear();
+
+        if (cvec.size() > SMALL_CHILD_COUNT) {
+            for (auto cidx : cvec) {
+                children.m_index[m_value[cidx]] = cidx;
+            }
+        }
+    }
+}
+
+void
+t_stnodes::clear() {
+    m_pidx.clear();
+    m_depth.clear();
+    m_value.clear();
+    m_sort_value.clear();
+    m_nstrands.clear();
+    m_aggidx.clear();
+    m_live.clear();
+    m_size = 0;
+    m_children.clear();
+    m_unsorted.clear();
+    m_zero_strands.clear();
+}
+
+bool
+t_stnodes::contains(t_uindex idx) const {
+    return idx < m_live.size() && m_live[idx];
+}
+
+t_uindex
+t_stnodes::size() const {
+    return m_size;
+}
+
+void
+t_stnodes::check_idx(t_uindex idx) const {
+    PSP_VERBOSE_ASSERT(contains(idx), "Did not find node");
+}
+
+t_stnode
+t_stnodes::get(t_uindex idx) const {
+    check_idx(idx);
+    return t_stnode(idx, m_pidx[idx], m_value[idx], m_depth[idx],
+        m_sort_value[idx], m_nstrands[idx], m_aggidx[idx]);
+}
+
+t_uindex
+t_stnodes::get_pidx(t_uindex idx) const {
+    check_idx(idx);
+    return m_pidx[idx];
+}
+
+t_depth
+t_stnodes::get_depth(t_uindex idx) const {
+    check_idx(idx);
+    return m_depth[idx];
+}
+
+const t_tscalar&
+t_stnodes::get_value(t_uindex idx) const {
+    check_idx(idx);
+    return m_value[idx];
+}
+
+const t_tscalar&
+t_stnodes::get_sort_value(t_uindex idx) const {
+    check_idx(idx);
+    return m_sort_value[idx];
+}
+
+t_uindex
+t_stnodes::get_nstrands(t_uindex idx) const {
+    check_idx(idx);
+    return m_nstrands[idx];
+}
+
+t_uindex
+t_stnodes::get_aggidx(t_uindex idx) const {
+    check_idx(idx);
+    return m_aggidx[idx];
+}
+
+void
+t_stnodes::set_nstrands(t_uindex idx, t_index nstrands) {
+    check_idx(idx);
+    m_nstrands[idx] = nstrands;
+
+    if (nstrands == 0) {
+        m_zero_strands.insert(idx);
+    } else {
+        m_zero_strands.erase(idx);
+    }
+}
+
+void
+t_stnodes::set_sort_value(t_uindex idx, const t_tscalar& sort_value) {
+    check_idx(idx);
+
+    if (m_sort_value[idx] == sort_value) {
+        return;
+    }
+
+    m_sort_value[idx].set(sort_value);
+
+    t_uindex pidx = m_pidx[idx];
+    m_children[pidx].m_sorted = false;
+    m_unsorted.insert(pidx);
+}
+
+const std::vector<t_uindex>&
+t_stnodes::get_children(t_uindex idx) const {
+    static const std::vector<t_uindex> EMPTY;
+
+    auto iter = m_children.find(idx);
+
+    if (iter == m_children.end()) {
+        return EMPTY;
+    }
+
+    // Only ranges touched outside `update_shape_from_static` (which sorts
+    // every range before returning) are sorted here.
+    if (!iter->second.m_sorted) {
+        sort_children(m_children[idx]);
+        m_unsorted.erase(idx);
+    }
+
+    return iter->second.m_children;
+}
+
+t_uindex
+t_stnodes::get_num_children(t_uindex idx) const {
+    auto iter = m_children.find(idx);
+    return iter == m_children.end() ? 0 : iter->second.m_children.size();
+}
+
+t_uindex
+t_stnodes::find_child(t_uindex pidx, const t_tscalar& value) const {
+    auto iter = m_children.find(pidx);
+
+    if (iter == m_children.end()) {
+        return NO_CHILD;
+    }
+
+    const t_stchildren& children = iter->second;
+
+    if (!children.m_index.empty()) {
+        auto citer = children.m_index.find(value);
+        return citer == children.m_index.end() ? NO_CHILD : citer->second;
+    }
+
+    for (auto cidx : children.m_children) {
+        if (m_value[cidx] == value) {
+            return cidx;
+        }
+    }
+
+    return NO_CHILD;
+}
+
+std::vector<t_uindex>
+t_stnodes::zero_strands() const {
+    return std::vector<t_uindex>(m_zero_strands.begin(), m_zero_strands.end());
+}
+
+void
+t_stnodes::sort_children() {
+    for (auto pidx : m_unsorted) {
+        sort_children(m_children[pidx]);
+    }
+
+    m_unsorted.clear();
+}
+
+void
+t_stnodes::sort_children(t_stchildren& children) const {
+    std::sort(children.m_children.begin(), children.m_children.end(),
+        [this](t_uindex a, t_uindex b) {
+            if (m_sort_value[a] < m_sort_value[b]) {
+                return true;
+            }
+
+            if (m_sort_value[b] < m_sort_value[a]) {
+                return false;
+            }
+
+            return m_value[a] < m_value[b];
+        });
+
+    children.m_sorted = true;
+}
+
+} // end namespace perspective
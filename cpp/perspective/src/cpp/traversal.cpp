@@ -12,9 +12,12 @@
 #include <perspective/sparse_tree.h>
 #include <perspective/arg_sort.h>
 #include <perspective/sort_specification.h>
+#include <tsl/hopscotch_set.h>
 
 namespace perspective {
 
+static const t_uindex NO_NODE = INVALID_INDEX;
+
 t_vdnode::t_vdnode()
     : m_expanded(0)
     , m_depth(INVALID_INDEX) {}
@@ -40,21 +43,21 @@ t_traversal::t_traversal(std::shared_ptr<const t_stree> tree)
 
 void
 t_traversal::populate_root_children(const t_stnode_vec& rchildren) {
-    m_nodes = std::make_shared<std::vector<t_tvnode>>(rchildren.size() + 1);
+    std::vector<t_tvnode> nodes(rchildren.size() + 1);
 
     // Initialize root
-    (*m_nodes)[0].m_expanded = true;
-    (*m_nodes)[0].m_depth = 0;
-    (*m_nodes)[0].m_rel_pidx = INVALID_INDEX;
-    (*m_nodes)[0].m_tnid = 0;
-    (*m_nodes)[0].m_ndesc = rchildren.size();
-    (*m_nodes)[0].m_nchild = rchildren.size();
+    nodes[0].m_expanded = true;
+    nodes[0].m_depth = 0;
+    nodes[0].m_rel_pidx = INVALID_INDEX;
+    nodes[0].m_tnid = 0;
+    nodes[0].m_ndesc = rchildren.size();
+    nodes[0].m_nchild = rchildren.size();
 
     t_index count = 1;
 
     for (t_stnode_vec::const_iterator iter = rchildren.begin();
          iter != rchildren.end(); ++iter) {
-        t_tvnode& cnode = (*m_nodes)[count];
+        t_tvnode& cnode = nodes[count];
         cnode.m_expanded = false;
         cnode.m_depth = 1;
         cnode.m_rel_pidx = count;
@@ -63,6 +66,8 @@ t_traversal::populate_root_children(const t_stnode_vec& rchildren) {
         cnode.m_nchild = 0;
         count += 1;
     }
+
+    m_nodes.build(nodes);
 }
 
 void
@@ -74,7 +79,8 @@ t_traversal::populate_root_children(std::shared_ptr<const t_stree> tree) {
 
 t_index
 t_traversal::expand_node(t_index exp_idx) {
-    t_tvnode& exp_tvnode = (*m_nodes)[exp_idx];
+    t_uindex exp_nid = m_nodes.at(exp_idx);
+    t_tvnode& exp_tvnode = m_nodes.get(exp_nid);
 
     if (exp_tvnode.m_expanded) {
         return 0;
@@ -100,17 +106,14 @@ t_traversal::expand_node(t_index exp_idx) {
 
     // Update node being expanded
     exp_tvnode.m_expanded = !tchildren.empty();
-    ;
     exp_tvnode.m_ndesc += n_changed;
     exp_tvnode.m_nchild = n_changed;
 
     // insert children of node into the traversal
-    m_nodes->insert(
-        m_nodes->begin() + exp_idx + 1, children.begin(), children.end());
+    m_nodes.insert(exp_idx + 1, children, exp_nid);
 
     // update ancestors about their new descendents
-    update_ancestors(exp_idx, n_changed);
-    update_sucessors(exp_idx, n_changed);
+    update_ancestors(exp_nid, n_changed);
 
     return n_changed;
 }
@@ -118,7 +121,8 @@ t_traversal::expand_node(t_index exp_idx) {
 t_index
 t_traversal::expand_node(
     const std::vector<t_sortspec>& sortby, t_index exp_idx, t_ctx2* ctx2) {
-    t_tvnode& exp_tvnode = (*m_nodes)[exp_idx];
+    t_uindex exp_nid = m_nodes.at(exp_idx);
+    t_tvnode& exp_tvnode = m_nodes.get(exp_nid);
 
     if (exp_tvnode.m_expanded) {
         return 0;
@@ -142,18 +146,19 @@ t_traversal::expand_node(
             static_cast<size_t>(n_changed));
         t_index num_aggs = sortby.size();
         std::vector<t_tscalar> aggregates(num_aggs);
+        std::vector<t_sorttype> sort_orders = get_sort_orders(sortby);
 
         t_uindex child_idx = 0;
         for (t_stnode_vec::const_iterator iter = tchildren.begin();
              iter != tchildren.end(); ++iter) {
             m_tree->get_aggregates_for_sorting(
                 iter->m_idx, sortby_agg_indices, aggregates, ctx2);
-            (*sortelems)[count] = t_mselem(aggregates, child_idx);
+            (*sortelems)[count].m_order = child_idx;
+            (*sortelems)[count].set_row(aggregates, sort_orders);
             ++count;
             ++child_idx;
         }
 
-        std::vector<t_sorttype> sort_orders = get_sort_orders(sortby);
         t_multisorter sorter(sortelems, sort_orders);
         argsort(sorted_idx, sorter);
     } else {
@@ -180,19 +185,18 @@ t_traversal::expand_node(
     exp_tvnode.m_nchild = n_changed;
 
     // insert children of node into the traversal
-    m_nodes->insert(
-        m_nodes->begin() + exp_idx + 1, children.begin(), children.end());
+    m_nodes.insert(exp_idx + 1, children, exp_nid);
 
     // update ancestors about their new descendents
-    update_ancestors(exp_idx, n_changed);
-    update_sucessors(exp_idx, n_changed);
+    update_ancestors(exp_nid, n_changed);
 
     return n_changed;
 }
 
 t_index
 t_traversal::collapse_node(t_index idx) {
-    t_tvnode& node = (*m_nodes)[idx];
+    t_uindex nid = m_nodes.at(idx);
+    t_tvnode& node = m_nodes.get(nid);
 
     if (!node.m_expanded) {
         return 0;
@@ -204,145 +208,192 @@ t_traversal::collapse_node(t_index idx) {
     t_index bidx = idx + 1;
     t_index eidx = bidx + n_changed;
 
-    // remove entries from traversal
-    m_nodes->erase(m_nodes->begin() + bidx, m_nodes->begin() + eidx);
-
     // Update node being collapsed
     node.m_expanded = false;
     node.m_ndesc -= n_changed;
     node.m_nchild = 0;
 
+    // remove entries from traversal
+    m_nodes.erase(bidx, eidx);
+
     // update ancestors about removal of their
     // descendents
-    update_ancestors(idx, -n_changed);
-    update_sucessors(idx, -n_changed);
+    update_ancestors(nid, -n_changed);
 
     return n_changed;
 }
 
-void
-t_traversal::add_node(const std::vector<t_sortspec>& sortby,
-    const std::vector<t_uindex>& indices, t_index insert_level_idx,
-    t_ctx2* ctx2) {
-    std::vector<t_sortspec> dummy = sortby;
-    std::vector<t_index> tv_indices;
-    t_index collapsed_ancestor = INVALID_INDEX;
+t_index
+t_traversal::set_children(t_index p_ptidx,
+    const std::vector<t_uindex>& c_ptidxs, std::vector<t_uindex>& changed) {
+    t_uindex p_nid = m_nodes.find(p_ptidx);
 
-    get_expanded_span(
-        indices, tv_indices, collapsed_ancestor, insert_level_idx);
+    if (p_nid == NO_NODE
+        || (!m_nodes.get(p_nid).m_expanded && c_ptidxs.empty())) {
+        return 0;
+    }
 
-    if (static_cast<t_index>(tv_indices.size()) == insert_level_idx) {
-        t_index p_tvidx = tv_indices.back();
-        const t_tvnode& p_tvnode = (*m_nodes)[p_tvidx];
-        t_index p_ptidx = p_tvnode.m_tnid;
-        t_index p_nchild = p_tvnode.m_nchild + 1;
-        t_index c_ptidx = indices[insert_level_idx];
-        t_uindex cidx = m_tree->get_sibling_idx(p_ptidx, p_nchild, c_ptidx);
-        cidx = std::min(p_tvnode.m_nchild, cidx);
-        t_index cur_cidx = p_tvidx + 1;
-        for (t_uindex idx = 0; idx < cidx; ++idx) {
-            cur_cidx += (1 + (*m_nodes)[cur_cidx].m_ndesc);
+    m_nodes.get(p_nid).m_expanded = true;
+
+    t_index p_tvidx = m_nodes.rank(p_nid);
+    t_index old_size = size();
+    tsl::hopscotch_set<t_uindex> keep(c_ptidxs.begin(), c_ptidxs.end());
+
+    // Children are removed after collecting them, as removal shifts ranks.
+    std::vector<t_uindex> removed;
+    t_uindex nchild = m_nodes.get(p_nid).m_nchild;
+    t_uindex c_nid = nchild > 0 ? m_nodes.next(p_nid) : NO_NODE;
+    for (t_uindex cidx = 0; cidx < nchild; ++cidx) {
+        const t_tvnode& c_tvnode = m_nodes.get(c_nid);
+        t_uindex next_nid = c_nid;
+        for (t_uindex idx = 0; idx <= c_tvnode.m_ndesc; ++idx) {
+            next_nid = m_nodes.next(next_nid);
         }
 
-        (*m_nodes)[p_tvidx].m_nchild += 1;
+        if (keep.find(c_tvnode.m_tnid) == keep.end()) {
+            removed.push_back(c_nid);
+        }
+
+        c_nid = next_nid;
+    }
+
+    for (auto nid : removed) {
+        t_uindex nrows = m_nodes.get(nid).m_ndesc + 1;
+        for (t_uindex idx = 0, cur = nid; idx < nrows; ++idx) {
+            changed.push_back(m_nodes.get(cur).m_tnid);
+            cur = m_nodes.next(cur);
+        }
+
+        remove_subtree(m_nodes.rank(nid));
+    }
+
+    // Every child before `dest` is in place, so a kept child is always
+    // found at or after it.
+    t_depth depth = m_nodes.get(p_nid).m_depth + 1;
+    t_index dest = p_tvidx + 1;
+    for (auto c_ptidx : c_ptidxs) {
+        t_uindex nid = m_nodes.find(c_ptidx);
+
+        if (nid != NO_NODE) {
+            t_index brank = m_nodes.rank(nid);
+            t_index nrows = m_nodes.get(nid).m_ndesc + 1;
+            m_nodes.move(brank, brank + nrows, dest);
+            dest += nrows;
+            continue;
+        }
 
-        t_depth depth = get_depth(p_tvidx) + 1;
         t_tvnode new_node;
-        fill_travnode(&new_node, false, depth, cur_cidx - p_tvidx, 0, c_ptidx);
-        auto insert_iter = m_nodes->begin() + cur_cidx;
-        m_nodes->insert(insert_iter, new_node);
-        update_ancestors(cur_cidx, 1);
-        update_sucessors(cur_cidx, 1);
+        fill_travnode(&new_node, false, depth, dest - p_tvidx, 0, c_ptidx);
+        m_nodes.insert(dest, std::vector<t_tvnode>(1, new_node), p_nid);
+        m_nodes.get(p_nid).m_nchild += 1;
+        update_ancestors(m_nodes.at(dest), 1);
+        changed.push_back(c_ptidx);
+        dest += 1;
     }
+
+    return t_index(size()) - old_size;
 }
 
-t_index
-t_traversal::update_ancestors(t_index nidx, t_index n_changed) {
-    if (nidx == 0)
-        return 0;
+void
+t_traversal::add_node(const std::vector<t_sortspec>& sortby,
+    const std::vector<t_uindex>& indices, t_index insert_level_idx,
+    t_ctx2* ctx2) {
+    t_index p_tvidx = get_insert_parent(indices, insert_level_idx);
 
-    t_index pidx = nidx - (*m_nodes)[nidx].m_rel_pidx;
-    while (pidx > INVALID_INDEX) {
-        t_tvnode& node = (*m_nodes)[pidx];
-        node.m_ndesc += n_changed;
-        if (pidx == 0) {
-            pidx = INVALID_INDEX;
-        } else {
-            pidx = pidx - node.m_rel_pidx;
-        }
+    if (p_tvidx == INVALID_INDEX) {
+        return;
     }
-    return 0;
+
+    const t_tvnode& p_tvnode = m_nodes.get(m_nodes.at(p_tvidx));
+    t_index p_ptidx = p_tvnode.m_tnid;
+    t_index p_nchild = p_tvnode.m_nchild + 1;
+    t_index c_ptidx = indices[insert_level_idx];
+    t_uindex cidx = m_tree->get_sibling_idx(p_ptidx, p_nchild, c_ptidx);
+    insert_child(p_tvidx, c_ptidx, std::min(p_tvnode.m_nchild, cidx));
 }
 
 t_index
-t_traversal::update_sucessors(t_index nidx, t_index n_changed) {
-    t_tvnode* c_node = &((*m_nodes)[nidx]);
+t_traversal::get_insert_parent(
+    const std::vector<t_uindex>& indices, t_index insert_level_idx) {
+    std::vector<t_index> tv_indices;
+    t_index collapsed_ancestor = INVALID_INDEX;
 
-    while (c_node->m_depth > 0) {
-        t_index pidx = nidx - c_node->m_rel_pidx;
+    get_expanded_span(
+        indices, tv_indices, collapsed_ancestor, insert_level_idx);
 
-        const t_tvnode& p_node = (*m_nodes)[pidx];
+    if (static_cast<t_index>(tv_indices.size()) != insert_level_idx) {
+        return INVALID_INDEX;
+    }
 
-        t_index p_nchild = p_node.m_nchild;
-        t_index coffset = 1;
+    return tv_indices.back();
+}
 
-        for (int i = 0; i < p_nchild; i++) {
-            t_index curr_cidx = pidx + coffset;
-            t_tvnode& child_node = (*m_nodes)[curr_cidx];
-            if (curr_cidx > nidx) {
-                child_node.m_rel_pidx += n_changed;
-            }
-            if (child_node.m_expanded) {
-                coffset = coffset + child_node.m_ndesc + 1;
-            } else {
-                coffset += 1;
-            }
+void
+t_traversal::insert_child(t_index p_tvidx, t_index c_ptidx, t_uindex cidx) {
+    t_uindex p_nid = m_nodes.at(p_tvidx);
+    const t_tvnode& p_tvnode = m_nodes.get(p_nid);
+    t_index cur_cidx = p_tvidx + 1;
+
+    // Without expanded children, the children are contiguous.
+    if (p_tvnode.m_ndesc == p_tvnode.m_nchild) {
+        cur_cidx += cidx;
+    } else {
+        for (t_uindex idx = 0; idx < cidx; ++idx) {
+            cur_cidx += (1 + m_nodes.get(m_nodes.at(cur_cidx)).m_ndesc);
         }
+    }
 
-        nidx = pidx;
-        c_node = &((*m_nodes)[nidx]);
+    m_nodes.get(p_nid).m_nchild += 1;
+
+    t_depth depth = p_tvnode.m_depth + 1;
+    t_tvnode new_node;
+    fill_travnode(&new_node, false, depth, cur_cidx - p_tvidx, 0, c_ptidx);
+    m_nodes.insert(cur_cidx, std::vector<t_tvnode>(1, new_node), p_nid);
+    update_ancestors(m_nodes.at(cur_cidx), 1);
+}
+
+void
+t_traversal::update_ancestors(t_uindex nid, t_index n_changed) {
+    for (t_uindex pnid = m_nodes.get_parent(nid); pnid != NO_NODE;
+         pnid = m_nodes.get_parent(pnid)) {
+        m_nodes.get(pnid).m_ndesc += n_changed;
     }
-    return 0;
 }
 
 t_index
 t_traversal::get_tree_index(t_index idx) const {
-    return (*m_nodes)[idx].m_tnid;
+    return m_nodes.get(m_nodes.at(idx)).m_tnid;
 }
 
 t_uindex
 t_traversal::size() const {
-    return m_nodes->size();
+    return m_nodes.size();
 }
 
 t_depth
 t_traversal::get_depth(t_index idx) const {
-    return (*m_nodes)[idx].m_depth;
+    return m_nodes.get(m_nodes.at(idx)).m_depth;
 }
 
 t_index
 t_traversal::get_traversal_index(t_index idx) {
-    t_index rval = INVALID_INDEX;
-
-    for (t_index i = 0, loop_end = m_nodes->size(); i < loop_end; ++i) {
-        if ((*m_nodes)[i].m_tnid == idx) {
-            rval = i;
-            break;
-        }
-    }
-    return rval;
+    t_uindex nid = m_nodes.find(idx);
+    return nid == NO_NODE ? INVALID_INDEX : t_index(m_nodes.rank(nid));
 }
 
 std::vector<t_vdnode>
 t_traversal::get_view_nodes(t_index bidx, t_index eidx) const {
     std::vector<t_vdnode> vec(eidx - bidx);
+    t_uindex nid = bidx < eidx ? m_nodes.at(bidx) : NO_NODE;
+
     for (t_index i = bidx; i < eidx; i++) {
         t_index idx = i - bidx;
-        const t_tvnode& tv_node = (*m_nodes)[i];
+        const t_tvnode& tv_node = m_nodes.get(nid);
         vec[idx].m_expanded = tv_node.m_expanded;
         vec[idx].m_depth = tv_node.m_depth;
-        t_index tree_idx = get_tree_index(i);
-        vec[idx].m_has_children = m_tree->get_num_children(tree_idx) > 0;
+        vec[idx].m_has_children
+            = m_tree->get_num_children(tv_node.m_tnid) > 0;
+        nid = m_nodes.next(nid);
     }
     return vec;
 }
@@ -351,49 +402,29 @@ void
 t_traversal::get_expanded_span(const std::vector<t_uindex>& in_ptidxes,
     std::vector<t_index>& out_indexes, t_index& out_collpsed_ancestor,
     t_index insert_level_idx) {
-    t_index pidx = 0;
-    t_index coffset = 1;
+    t_uindex pnid = m_nodes.at(0);
 
     out_indexes.push_back(0);
 
+    // Each level is looked up by its tree index, rather than by scanning
+    // the children of the level above.
     for (t_index counter = 1, loop_end = in_ptidxes.size(); counter < loop_end;
          counter++) {
-        bool level_node_found = false;
-        t_index level_idx = INVALID_INDEX;
-        t_index p_nchild = (*m_nodes)[pidx].m_nchild;
+        t_uindex nid = m_nodes.find(in_ptidxes[counter]);
 
-        if (counter >= insert_level_idx) {
-            p_nchild = p_nchild - 1;
+        if (nid == NO_NODE || m_nodes.get_parent(nid) != pnid) {
+            break;
         }
 
-        for (t_index cidx = 0; cidx < p_nchild; ++cidx) {
-            t_tvnode& cnode = (*m_nodes)[pidx + coffset];
-
-            if (static_cast<t_uindex>(cnode.m_tnid) == in_ptidxes[counter]) {
-                level_node_found = true;
-                level_idx = pidx + coffset;
+        t_index level_idx = m_nodes.rank(nid);
 
-                if (cnode.m_expanded) {
-                    pidx = pidx + coffset;
-                    coffset = 1;
-                    p_nchild = (*m_nodes)[pidx].m_nchild;
-                    out_indexes.push_back(pidx);
-                    break;
-                }
-            } else {
-                // TODO: next line
-                coffset = coffset + cnode.m_ndesc + 1;
-            }
-        }
-
-        if (level_node_found && (!((*m_nodes)[level_idx].m_expanded))) {
+        if (!m_nodes.get(nid).m_expanded) {
             out_collpsed_ancestor = level_idx;
             break;
         }
 
-        if (!level_node_found) {
-            break;
-        }
+        out_indexes.push_back(level_idx);
+        pnid = nid;
     }
 }
 
@@ -412,7 +443,8 @@ t_traversal::validate_cells(
 
 t_index
 t_traversal::remove_subtree(t_index idx) {
-    t_tvnode& node = (*m_nodes)[idx];
+    t_uindex nid = m_nodes.at(idx);
+    const t_tvnode& node = m_nodes.get(nid);
 
     // Calculate span of descendents
     t_index n_changed = node.m_ndesc + 1;
@@ -420,25 +452,27 @@ t_traversal::remove_subtree(t_index idx) {
     t_index bidx = idx;
     t_index eidx = bidx + n_changed;
 
-    update_sucessors(idx, -n_changed);
-
     // update ancestors about removal of their
     // descendents
-    update_ancestors(idx, -n_changed);
+    update_ancestors(nid, -n_changed);
 
-    t_index pidx = idx - node.m_rel_pidx;
-    (*m_nodes)[pidx].m_nchild -= 1;
+    t_uindex pnid = m_nodes.get_parent(nid);
+    if (pnid != NO_NODE) {
+        m_nodes.get(pnid).m_nchild -= 1;
+    }
 
     // remove entries from traversal
-    m_nodes->erase(m_nodes->begin() + bidx, m_nodes->begin() + eidx);
+    m_nodes.erase(bidx, eidx);
 
     return n_changed;
 }
 
 void
 t_traversal::pprint() const {
-    for (t_index idx = 0, loop_end = m_nodes->size(); idx < loop_end; ++idx) {
-        const t_tvnode& node = (*m_nodes)[idx];
+    std::vector<t_tvnode> nodes = m_nodes.get_nodes();
+
+    for (t_index idx = 0, loop_end = nodes.size(); idx < loop_end; ++idx) {
+        const t_tvnode& node = nodes[idx];
         const t_stnode tnode = m_tree->get_node(node.m_tnid);
         for (t_uindex didx = 0; didx < node.m_depth; didx++) {
             std::cout << "\t";
@@ -453,29 +487,69 @@ t_traversal::pprint() const {
 
 t_tvnode
 t_traversal::get_node(t_index idx) const {
-    return (*m_nodes)[idx];
+    t_uindex nid = m_nodes.at(idx);
+    t_uindex pnid = m_nodes.get_parent(nid);
+    t_tvnode rval = m_nodes.get(nid);
+    rval.m_rel_pidx
+        = pnid == NO_NODE ? INVALID_INDEX : idx - t_index(m_nodes.rank(pnid));
+    return rval;
 }
 
 void
 t_traversal::get_leaves(std::vector<t_index>& out_data) const {
-    for (t_index curidx = 0, loop_end = m_nodes->size(); curidx < loop_end;
-         ++curidx) {
-        if (!(*m_nodes)[curidx].m_expanded) {
+    t_index nnodes = m_nodes.size();
+    t_uindex nid = nnodes > 0 ? m_nodes.at(0) : NO_NODE;
+
+    for (t_index curidx = 0; curidx < nnodes; ++curidx) {
+        if (!m_nodes.get(nid).m_expanded) {
             out_data.push_back(curidx);
         }
+
+        nid = m_nodes.next(nid);
     }
 }
 
 void
 t_traversal::get_child_indices(
     t_index nidx, std::vector<std::pair<t_index, t_index>>& out_data) const {
-    const t_tvnode& tvnode = (*m_nodes)[nidx];
+    t_uindex nid = m_nodes.at(nidx);
+    const t_tvnode& tvnode = m_nodes.get(nid);
+    t_index nchild = tvnode.m_nchild;
+
+    // Without expanded children, the children are the next `nchild` rows.
+    if (tvnode.m_ndesc == tvnode.m_nchild) {
+        t_uindex cnid = nid;
+
+        for (int i = 0; i < nchild; i++) {
+            cnid = m_nodes.next(cnid);
+            out_data.push_back(std::pair<t_index, t_index>(
+                nidx + 1 + i, m_nodes.get(cnid).m_tnid));
+        }
+
+        return;
+    }
+
+    t_index coffset = 1;
+
+    for (int i = 0; i < nchild; i++) {
+        t_index curr_cidx = nidx + coffset;
+        const t_tvnode& child_node = m_nodes.get(m_nodes.at(curr_cidx));
+        out_data.push_back(
+            std::pair<t_index, t_index>(curr_cidx, child_node.m_tnid));
+        coffset = coffset + child_node.m_ndesc + 1;
+    }
+}
+
+void
+t_traversal::get_child_indices(const std::vector<t_tvnode>& nodes,
+    t_index nidx, std::vector<std::pair<t_index, t_index>>& out_data) {
+    const t_tvnode& tvnode = nodes[nidx];
     t_index nchild = tvnode.m_nchild;
     t_index coffset = 1;
 
     for (int i = 0; i < nchild; i++) {
         t_index curr_cidx = nidx + coffset;
-        const t_tvnode& child_node = (*m_nodes)[curr_cidx];
+        const t_tvnode& child_node = nodes[curr_cidx];
         out_data.push_back(
             std::pair<t_index, t_index>(curr_cidx, child_node.m_tnid));
         coffset = coffset + child_node.m_ndesc + 1;
@@ -484,18 +558,19 @@ t_traversal::get_child_indices(
 
 void
 t_traversal::print_stats() {
-    std::cout << "Traversal size => " << m_nodes->size() << std::endl;
+    std::cout << "Traversal size => " << m_nodes.size() << std::endl;
 }
 
 t_index
 t_traversal::get_num_tree_leaves(t_index idx) const {
-    const t_tvnode& node = (*m_nodes)[idx];
+    t_uindex nid = m_nodes.at(idx);
+    t_index ndesc = m_nodes.get(nid).m_ndesc;
 
     t_index rval = 0;
 
-    for (t_index curidx = idx + 1, loop_end = idx + node.m_ndesc + 1;
-         curidx < loop_end; ++curidx) {
-        if (!(*m_nodes)[curidx].m_expanded) {
+    for (t_index didx = 0; didx < ndesc; ++didx) {
+        nid = m_nodes.next(nid);
+        if (!m_nodes.get(nid).m_expanded) {
             ++rval;
         }
     }
@@ -533,7 +608,7 @@ t_traversal::set_depth(
         for (t_index idx = 0, loop_end = children.size(); idx < loop_end;
              ++idx) {
             const std::pair<t_index, t_index>& child = children[idx];
-            const t_tvnode& tv_node = (*m_nodes)[child.first];
+            const t_tvnode& tv_node = m_nodes.get(m_nodes.at(child.first));
 
             if (tv_node.m_depth < depth) {
                 pending.push_back(child.first);
@@ -561,7 +636,7 @@ t_traversal::get_flattened_tree(t_index idx, t_depth stop_depth) const {
     while (!queue.empty()) {
         t_index hidx = queue.front();
         queue.pop();
-        const t_tvnode& c_node = (*m_nodes)[hidx];
+        const t_tvnode& c_node = m_nodes.get(m_nodes.at(hidx));
         t_depth curdepth = c_node.m_depth;
         t_ftreenode rnode;
         rnode.m_idx = c_node.m_tnid;
@@ -573,7 +648,8 @@ t_traversal::get_flattened_tree(t_index idx, t_depth stop_depth) const {
             t_index curr_cidx = hidx + 1;
             std::vector<t_index> children(nchild);
             for (int cidx = 0; cidx < nchild; cidx++) {
-                const t_tvnode& child_node = (*m_nodes)[curr_cidx];
+                const t_tvnode& child_node
+                    = m_nodes.get(m_nodes.at(curr_cidx));
                 children[cidx] = curr_cidx;
                 if (child_node.m_expanded) {
                     curr_cidx = curr_cidx + child_node.m_ndesc + 1;
@@ -598,14 +674,13 @@ t_traversal::get_flattened_tree(t_index idx, t_depth stop_depth) const {
 
 t_index
 t_traversal::tree_index_lookup(t_index idx, t_index bidx) const {
-    t_index tvidx = INVALID_INDEX;
-    for (t_index i = bidx, loop_end = m_nodes->size(); i < loop_end; ++i) {
-        if ((*m_nodes)[i].m_tnid == idx) {
-            tvidx = i;
-            break;
-        }
+    t_uindex nid = m_nodes.find(idx);
+    if (nid == NO_NODE) {
+        return INVALID_INDEX;
     }
-    return tvidx;
+
+    t_index tvidx = m_nodes.rank(nid);
+    return tvidx >= bidx ? tvidx : INVALID_INDEX;
 }
 
 void
@@ -614,46 +689,41 @@ t_traversal::get_node_ancestors(
     if (nidx == 0)
         return;
 
-    t_index pidx = nidx - (*m_nodes)[nidx].m_rel_pidx;
-    while (pidx > INVALID_INDEX) {
-        ancestors.push_back(pidx);
-        const t_tvnode& node = (*m_nodes)[pidx];
-        if (pidx == 0) {
-            pidx = INVALID_INDEX;
-        } else {
-            pidx = pidx - node.m_rel_pidx;
-        }
+    for (t_uindex pnid = m_nodes.get_parent(m_nodes.at(nidx));
+         pnid != NO_NODE; pnid = m_nodes.get_parent(pnid)) {
+        ancestors.push_back(m_nodes.rank(pnid));
     }
 }
 
 void
 t_traversal::get_expanded(std::vector<t_index>& expanded_tidx) const {
     // Ancestors of expanded nodes
-    std::set<t_index> ancestors;
+    std::set<t_uindex> ancestors;
     std::vector<t_index> expanded;
 
-    if (m_nodes->size() == 0)
+    if (m_nodes.size() == 0)
         return;
 
-    for (t_index i = m_nodes->size() - 1; i > -1; i--) {
-        const t_tvnode& node = (*m_nodes)[i];
-
-        if (node.m_expanded && ancestors.find(i) == ancestors.end()) {
-            expanded.push_back(i);
-            std::vector<t_index> node_ancestors;
-            get_node_ancestors(i, node_ancestors);
-            ancestors.insert(node_ancestors.begin(), node_ancestors.end());
-        }
+    std::vector<t_uindex> nids(m_nodes.size());
+    nids[0] = m_nodes.at(0);
+    for (t_uindex i = 1, loop_end = nids.size(); i < loop_end; ++i) {
+        nids[i] = m_nodes.next(nids[i - 1]);
     }
 
-    std::vector<t_index> rval(expanded.size());
+    for (t_index i = nids.size() - 1; i > -1; i--) {
+        const t_tvnode& node = m_nodes.get(nids[i]);
 
-    for (t_index i = 0, loop_end = rval.size(); i < loop_end; i++) {
-        const t_tvnode& node = (*m_nodes)[expanded[i]];
-        rval[i] = node.m_tnid;
+        if (node.m_expanded && ancestors.find(nids[i]) == ancestors.end()) {
+            expanded.push_back(node.m_tnid);
+
+            for (t_uindex pnid = m_nodes.get_parent(nids[i]); pnid != NO_NODE;
+                 pnid = m_nodes.get_parent(pnid)) {
+                ancestors.insert(pnid);
+            }
+        }
     }
 
-    std::swap(rval, expanded_tidx);
+    std::swap(expanded, expanded_tidx);
 }
 
 void
@@ -680,8 +750,8 @@ t_traversal::get_tree() const {
 
 bool
 t_traversal::get_node_expanded(t_index idx) const {
-    if (idx < 0 || static_cast<t_uindex>(idx) > m_nodes->size())
+    if (idx < 0 || static_cast<t_uindex>(idx) >= m_nodes.size())
         return false;
-    return m_nodes->at(idx).m_expanded;
+    return m_nodes.get(m_nodes.at(idx)).m_expanded;
 }
 } // end namespace perspective
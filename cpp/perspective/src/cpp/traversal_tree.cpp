@@ -0,0 +1,152 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2017, the Perspective Authors.
+ *
+ * This file is part of the Perspective library, distributed under the terms of
+ * the Apache License 2.0.  The full license can be found in the LICENSE file.
+ *
+ */
+
+#include <perspective/first.h>
+#include <perspective/traversal_tree.h>
+
+namespace perspective {
+
+static const t_uindex NO_NODE = static_cast<t_uindex>(INVALID_INDEX);
+
+t_tvtree::t_tvtree() {}
+
+void
+t_tvtree::clear() {
+    m_treap.clear();
+    m_rows.clear();
+    m_vparents.clear();
+    m_tnids.clear();
+}
+
+t_uindex
+t_tvtree::size() const {
+    return m_treap.size();
+}
+
+void
+t_tvtree::build(const std::vector<t_tvnode>& nodes) {
+    clear();
+
+    t_uindex nnodes = nodes.size();
+    std::vector<t_uindex> nidxs(nnodes);
+    m_rows.reserve(nnodes);
+    m_vparents.reserve(nnodes);
+
+    // Node ids are assigned in row order, so a parent's id is its row.
+    for (t_uindex idx = 0; idx < nnodes; ++idx) {
+        const t_tvnode& node = nodes[idx];
+        t_uindex vparent
+            = node.m_rel_pidx == INVALID_INDEX ? NO_NODE
+                                               : idx - node.m_rel_pidx;
+        nidxs[idx] = alloc(node, vparent);
+    }
+
+    m_treap.build(nidxs);
+}
+
+void
+t_tvtree::insert(
+    t_uindex rank, const std::vector<t_tvnode>& nodes, t_uindex vparent) {
+    std::vector<t_uindex> nidxs(nodes.size());
+    for (t_uindex idx = 0, loop_end = nodes.size(); idx < loop_end; ++idx) {
+        nidxs[idx] = alloc(nodes[idx], vparent);
+    }
+
+    m_treap.insert(rank, nidxs);
+}
+
+void
+t_tvtree::erase(t_uindex brank, t_uindex erank) {
+    std::vector<t_uindex> erased;
+    m_treap.erase(brank, erank, erased);
+
+    for (auto nidx : erased) {
+        auto iter = m_tnids.find(m_rows[nidx].m_tnid);
+        if (iter != m_tnids.end() && iter->second == nidx) {
+            m_tnids.erase(iter);
+        }
+    }
+}
+
+void
+t_tvtree::move(t_uindex brank, t_uindex erank, t_uindex rank) {
+    m_treap.move(brank, erank, rank);
+}
+
+t_tvnode&
+t_tvtree::get(t_uindex nidx) {
+    return m_rows[nidx];
+}
+
+const t_tvnode&
+t_tvtree::get(t_uindex nidx) const {
+    return m_rows[nidx];
+}
+
+t_uindex
+t_tvtree::get_parent(t_uindex nidx) const {
+    return m_vparents[nidx];
+}
+
+t_uindex
+t_tvtree::at(t_uindex rank) const {
+    return m_treap.at(rank);
+}
+
+t_uindex
+t_tvtree::rank(t_uindex nidx) const {
+    return m_treap.rank(nidx);
+}
+
+t_uindex
+t_tvtree::next(t_uindex nidx) const {
+    return m_treap.next(nidx);
+}
+
+t_uindex
+t_tvtree::find(t_index tnid) const {
+    auto iter = m_tnids.find(tnid);
+    return iter == m_tnids.end() ? NO_NODE : iter->second;
+}
+
+std::vector<t_tvnode>
+t_tvtree::get_nodes() const {
+    t_uindex nnodes = size();
+    std::vector<t_tvnode> rval(nnodes);
+    std::vector<t_uindex> rows(m_rows.size());
+    t_uindex nidx = nnodes > 0 ? at(0) : NO_NODE;
+
+    for (t_uindex idx = 0; idx < nnodes; ++idx) {
+        rows[nidx] = idx;
+        rval[idx] = m_rows[nidx];
+        rval[idx].m_rel_pidx = m_vparents[nidx] == NO_NODE
+            ? INVALID_INDEX
+            : idx - rows[m_vparents[nidx]];
+        nidx = next(nidx);
+    }
+
+    return rval;
+}
+
+t_uindex
+t_tvtree::alloc(const t_tvnode& node, t_uindex vparent) {
+    t_uindex nidx = m_treap.alloc();
+
+    if (nidx >= m_rows.size()) {
+        m_rows.resize(nidx + 1);
+        m_vparents.resize(nidx + 1);
+    }
+
+    m_rows[nidx] = node;
+    m_vparents[nidx] = vparent;
+    m_tnids[node.m_tnid] = nidx;
+    return nidx;
+}
+
+} // end namespace perspective
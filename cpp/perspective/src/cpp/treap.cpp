@@ -0,0 +1,336 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2017, the Perspective Authors.
+ *
+ * This file is part of the Perspective library, distributed under the terms of
+ * the Apache License 2.0.  The full license can be found in the LICENSE file.
+ *
+ */
+
+#include <perspective/first.h>
+#include <perspective/treap.h>
+
+namespace perspective {
+
+static const t_uindex NO_NODE = static_cast<t_uindex>(INVALID_INDEX);
+
+t_treap::t_treap()
+    : m_root(NO_NODE)
+    , m_seed(0x9E3779B97F4A7C15ULL) {}
+
+void
+t_treap::clear() {
+    m_nodes.clear();
+    m_free.clear();
+    m_root = NO_NODE;
+}
+
+t_uindex
+t_treap::size() const {
+    return subtree_size(m_root);
+}
+
+t_uindex
+t_treap::capacity() const {
+    return m_nodes.size();
+}
+
+t_uindex
+t_treap::alloc() {
+    t_uindex nidx;
+
+    if (m_free.empty()) {
+        nidx = m_nodes.size();
+        m_nodes.emplace_back();
+    } else {
+        nidx = m_free.back();
+        m_free.pop_back();
+    }
+
+    t_treap_node& node = m_nodes[nidx];
+    node.m_left = NO_NODE;
+    node.m_right = NO_NODE;
+    node.m_parent = NO_NODE;
+    node.m_size = 1;
+    node.m_priority = next_priority();
+    return nidx;
+}
+
+void
+t_treap::build(const std::vector<t_uindex>& nidxs) {
+    m_root = link(nidxs);
+}
+
+void
+t_treap::insert(t_uindex rank, const std::vector<t_uindex>& nidxs) {
+    if (nidxs.empty()) {
+        return;
+    }
+
+    t_uindex middle = link(nidxs);
+    t_uindex left;
+    t_uindex right;
+    split(m_root, rank, left, right);
+    m_root = merge(merge(left, middle), right);
+    m_nodes[m_root].m_parent = NO_NODE;
+}
+
+void
+t_treap::erase(
+    t_uindex brank, t_uindex erank, std::vector<t_uindex>& erased) {
+    if (brank >= erank) {
+        return;
+    }
+
+    t_uindex left;
+    t_uindex middle;
+    t_uindex right;
+    split(m_root, erank, middle, right);
+    split(middle, brank, left, middle);
+
+    m_root = merge(left, right);
+    if (m_root != NO_NODE) {
+        m_nodes[m_root].m_parent = NO_NODE;
+    }
+
+    std::vector<t_uindex> stack;
+    if (middle != NO_NODE) {
+        stack.push_back(middle);
+    }
+
+    while (!stack.empty()) {
+        t_uindex nidx = stack.back();
+        stack.pop_back();
+
+        const t_treap_node& node = m_nodes[nidx];
+        if (node.m_left != NO_NODE) {
+            stack.push_back(node.m_left);
+        }
+
+        if (node.m_right != NO_NODE) {
+            stack.push_back(node.m_right);
+        }
+
+        erased.push_back(nidx);
+        m_free.push_back(nidx);
+    }
+}
+
+void
+t_treap::move(t_uindex brank, t_uindex erank, t_uindex rank) {
+    if (brank >= erank || rank == brank) {
+        return;
+    }
+
+    t_uindex left;
+    t_uindex middle;
+    t_uindex right;
+    split(m_root, erank, middle, right);
+    split(middle, brank, left, middle);
+    m_root = merge(left, right);
+
+    split(m_root, rank, left, right);
+    m_root = merge(merge(left, middle), right);
+    m_nodes[m_root].m_parent = NO_NODE;
+}
+
+t_uindex
+t_treap::root() const {
+    return m_root;
+}
+
+t_uindex
+t_treap::left(t_uindex nidx) const {
+    return m_nodes[nidx].m_left;
+}
+
+t_uindex
+t_treap::right(t_uindex nidx) const {
+    return m_nodes[nidx].m_right;
+}
+
+t_uindex
+t_treap::subtree_size(t_uindex nidx) const {
+    return nidx == NO_NODE ? 0 : m_nodes[nidx].m_size;
+}
+
+t_uindex
+t_treap::at(t_uindex rank) const {
+    PSP_VERBOSE_ASSERT(rank < size(), "Row out of bounds");
+    t_uindex cur = m_root;
+
+    while (true) {
+        const t_treap_node& node = m_nodes[cur];
+        t_uindex nleft = subtree_size(node.m_left);
+
+        if (rank < nleft) {
+            cur = node.m_left;
+        } else if (rank == nleft) {
+            return cur;
+        } else {
+            rank -= nleft + 1;
+            cur = node.m_right;
+        }
+    }
+}
+
+t_uindex
+t_treap::rank(t_uindex nidx) const {
+    t_uindex rval = subtree_size(m_nodes[nidx].m_left);
+
+    for (t_uindex cur = nidx; m_nodes[cur].m_parent != NO_NODE;
+         cur = m_nodes[cur].m_parent) {
+        const t_treap_node& parent = m_nodes[m_nodes[cur].m_parent];
+
+        if (parent.m_right == cur) {
+            rval += subtree_size(parent.m_left) + 1;
+        }
+    }
+
+    return rval;
+}
+
+t_uindex
+t_treap::next(t_uindex nidx) const {
+    t_uindex cur = m_nodes[nidx].m_right;
+
+    if (cur != NO_NODE) {
+        while (m_nodes[cur].m_left != NO_NODE) {
+            cur = m_nodes[cur].m_left;
+        }
+
+        return cur;
+    }
+
+    cur = nidx;
+    t_uindex parent = m_nodes[cur].m_parent;
+
+    while (parent != NO_NODE && m_nodes[parent].m_right == cur) {
+        cur = parent;
+        parent = m_nodes[cur].m_parent;
+    }
+
+    return parent;
+}
+
+t_uindex
+t_treap::link(const std::vector<t_uindex>& nidxs) {
+    // Cartesian tree over the nodes in order: node `i` is popped by the
+    // first node `j` to its right with a higher priority, so its subtree
+    // covers the nodes [lo, j) and its size is known on pop.
+    t_uindex nnodes = nidxs.size();
+    std::vector<t_uindex> stack;
+    std::vector<t_uindex> lo(nnodes);
+
+    for (t_uindex idx = 0; idx < nnodes; ++idx) {
+        t_treap_node& node = m_nodes[nidxs[idx]];
+        t_uindex last = NO_NODE;
+
+        while (!stack.empty()
+            && m_nodes[nidxs[stack.back()]].m_priority < node.m_priority) {
+            last = stack.back();
+            stack.pop_back();
+            m_nodes[nidxs[last]].m_size = idx - lo[last];
+        }
+
+        if (last != NO_NODE) {
+            node.m_left = nidxs[last];
+            m_nodes[nidxs[last]].m_parent = nidxs[idx];
+        }
+
+        if (!stack.empty()) {
+            m_nodes[nidxs[stack.back()]].m_right = nidxs[idx];
+            node.m_parent = nidxs[stack.back()];
+        }
+
+        lo[idx] = stack.empty() ? 0 : stack.back() + 1;
+        stack.push_back(idx);
+    }
+
+    for (auto idx : stack) {
+        m_nodes[nidxs[idx]].m_size = nnodes - lo[idx];
+    }
+
+    return stack.empty() ? NO_NODE : nidxs[stack.front()];
+}
+
+t_uindex
+t_treap::merge(t_uindex left, t_uindex right) {
+    if (left == NO_NODE) {
+        return right;
+    }
+
+    if (right == NO_NODE) {
+        return left;
+    }
+
+    if (m_nodes[left].m_priority > m_nodes[right].m_priority) {
+        set_right(left, merge(m_nodes[left].m_right, right));
+        update_size(left);
+        return left;
+    }
+
+    set_left(right, merge(left, m_nodes[right].m_left));
+    update_size(right);
+    return right;
+}
+
+void
+t_treap::split(
+    t_uindex root, t_uindex rank, t_uindex& left, t_uindex& right) {
+    if (root == NO_NODE) {
+        left = NO_NODE;
+        right = NO_NODE;
+        return;
+    }
+
+    t_uindex nleft = subtree_size(m_nodes[root].m_left);
+
+    if (rank <= nleft) {
+        t_uindex inner;
+        split(m_nodes[root].m_left, rank, left, inner);
+        set_left(root, inner);
+        right = root;
+    } else {
+        t_uindex inner;
+        split(m_nodes[root].m_right, rank - nleft - 1, inner, right);
+        set_right(root, inner);
+        left = root;
+    }
+
+    update_size(root);
+    m_nodes[root].m_parent = NO_NODE;
+}
+
+void
+t_treap::set_left(t_uindex nidx, t_uindex child) {
+    m_nodes[nidx].m_left = child;
+    if (child != NO_NODE) {
+        m_nodes[child].m_parent = nidx;
+    }
+}
+
+void
+t_treap::set_right(t_uindex nidx, t_uindex child) {
+    m_nodes[nidx].m_right = child;
+    if (child != NO_NODE) {
+        m_nodes[child].m_parent = nidx;
+    }
+}
+
+void
+t_treap::update_size(t_uindex nidx) {
+    t_treap_node& node = m_nodes[nidx];
+    node.m_size = subtree_size(node.m_left) + subtree_size(node.m_right) + 1;
+}
+
+std::uint64_t
+t_treap::next_priority() {
+    // xorshift64 - deterministic, so the shape of the tree is reproducible.
+    m_seed ^= m_seed << 13;
+    m_seed ^= m_seed >> 7;
+    m_seed ^= m_seed << 17;
+    return m_seed;
+}
+
+} // end namespace perspective
@@ -14,6 +14,7 @@
 #include <perspective/sparse_tree.h>
 #include <perspective/data_table.h>
 #include <perspective/traversal.h>
+#include <perspective/tree_context_common.h>
 #include <perspective/env_vars.h>
 #include <perspective/dense_tree.h>
 #include <perspective/dense_tree_context.h>
@@ -28,7 +29,7 @@ notify_sparse_tree_common(std::shared_ptr<t_data_table> strands,
     const std::vector<t_aggspec>& aggregates,
     const std::vector<std::pair<std::string, std::string>>& tree_sortby,
     const std::vector<t_sortspec>& ctx_sortby, const t_gstate& gstate,
-    const t_data_table& expression_master_table) {
+    const t_data_table& expression_master_table, bool inserts_only) {
     t_filter fltr;
     if (t_env::log_data_nsparse_strands()) {
         std::cout << "nsparse_strands" << std::endl;
@@ -56,25 +57,41 @@ notify_sparse_tree_common(std::shared_ptr<t_data_table> strands,
 
     dctx.init();
 
-    tree->update_shape_from_static(dctx);
+    tree->update_shape_from_static(dctx, gstate);
+
+    t_stree_step step;
+    step.m_zero_strands = tree->zero_strands();
+    step.m_non_zero_ids = tree->non_zero_ids(step.m_zero_strands);
+    step.m_non_zero_leaves = tree->non_zero_leaves(step.m_zero_strands);
+    step.m_updated_ids = tree->updated_ids(step.m_zero_strands);
+
+    tree->drop_zero_strands();
+
+    tree->populate_leaf_index(step.m_non_zero_leaves);
+
+    tree->update_aggs_from_static(
+        dctx, gstate, expression_master_table, inserts_only);
+
+    tree->set_last_step(std::move(step));
+
+    notify_sparse_traversal(tree, traversal, process_traversal, ctx_sortby);
+}
 
-    auto zero_strands = tree->zero_strands();
+void
+notify_sparse_traversal(std::shared_ptr<t_stree> tree,
+    std::shared_ptr<t_traversal> traversal, bool process_traversal,
+    const std::vector<t_sortspec>& ctx_sortby) {
+    const t_stree_step& step = tree->get_last_step();
 
     t_uindex t_osize = process_traversal ? traversal->size() : 0;
     if (process_traversal)
-        traversal->drop_tree_indices(zero_strands);
+        traversal->drop_tree_indices(step.m_zero_strands);
     t_uindex t_nsize = process_traversal ? traversal->size() : 0;
     if (t_osize != t_nsize)
         tree->set_has_deltas(true);
 
-    auto non_zero_ids = tree->non_zero_ids(zero_strands);
-    auto non_zero_leaves = tree->non_zero_leaves(zero_strands);
-
-    tree->drop_zero_strands();
-
-    tree->populate_leaf_index(non_zero_leaves);
-
-    tree->update_aggs_from_static(dctx, gstate, expression_master_table);
+    const auto& non_zero_ids = step.m_non_zero_ids;
+    const auto& non_zero_leaves = step.m_non_zero_leaves;
 
     std::set<t_uindex> visited;
 
@@ -145,11 +162,28 @@ notify_sparse_tree(std::shared_ptr<t_stree> tree,
     auto strand_values = tree->build_strand_table(
         flattened, delta, prev, current, transitions, aggregates, config);
 
+    // An update that only adds rows new to the table leaves every row the
+    // tree already holds as it was.
+    std::shared_ptr<const t_column> op_sptr
+        = flattened.get_const_column("psp_op");
+    std::shared_ptr<const t_column> existed_sptr
+        = existed.get_const_column("psp_existed");
+    bool inserts_only = true;
+
+    for (t_uindex idx = 0, loop_end = flattened.size(); idx < loop_end;
+         ++idx) {
+        if (*(op_sptr->get_nth<std::uint8_t>(idx)) != OP_INSERT
+            || *(existed_sptr->get_nth<bool>(idx))) {
+            inserts_only = false;
+            break;
+        }
+    }
+
     auto strands = strand_values.first;
     auto strand_deltas = strand_values.second;
     notify_sparse_tree_common(strands, strand_deltas, tree, traversal,
         process_traversal, aggregates, tree_sortby, ctx_sortby, gstate,
-        expression_master_table);
+        expression_master_table, inserts_only);
 }
 
 void
@@ -167,7 +201,7 @@ notify_sparse_tree(std::shared_ptr<t_stree> tree,
     auto strand_deltas = strand_values.second;
     notify_sparse_tree_common(strands, strand_deltas, tree, traversal,
         process_traversal, aggregates, tree_sortby, ctx_sortby, gstate,
-        expression_master_table);
+        expression_master_table, false);
 }
 
 std::vector<t_path>
@@ -1326,6 +1326,7 @@ View<CTX_T>::_map_aggregate_types(
         if (agg.name() == name) {
             switch (agg.agg()) {
                 case AGGTYPE_DISTINCT_COUNT:
+                case AGGTYPE_APPROX_DISTINCT:
                 case AGGTYPE_COUNT: {
                     return "integer";
                 } break;
@@ -1335,7 +1336,8 @@ View<CTX_T>::_map_aggregate_types(
                 case AGGTYPE_PCT_SUM_PARENT:
                 case AGGTYPE_PCT_SUM_GRAND_TOTAL:
                 case AGGTYPE_VARIANCE:
-                case AGGTYPE_STANDARD_DEVIATION: {
+                case AGGTYPE_STANDARD_DEVIATION:
+                case AGGTYPE_APPROX_PERCENTILE: {
                     return "float";
                 } break;
                 default: {
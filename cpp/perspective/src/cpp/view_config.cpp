@@ -8,6 +8,7 @@
  */
 
 #include <perspective/view_config.h>
+#include <cstdlib>
 
 namespace perspective {
 
@@ -30,6 +31,7 @@ t_view_config::t_view_config(const std::vector<std::string>& row_pivots,
     , m_expressions(expressions)
     , m_row_pivot_depth(-1)
     , m_column_pivot_depth(-1)
+    , m_top_n(-1)
     , m_filter_op(filter_op)
     , m_column_only(column_only) {}
 
@@ -129,6 +131,12 @@ t_view_config::set_column_pivot_depth(std::int32_t depth) {
     m_column_pivot_depth = depth;
 }
 
+void
+t_view_config::set_top_n(std::int32_t top_n) {
+    PSP_VERBOSE_ASSERT(m_init, "touching uninited object");
+    m_top_n = top_n;
+}
+
 std::vector<std::string>
 t_view_config::get_row_pivots() const {
     PSP_VERBOSE_ASSERT(m_init, "touching uninited object");
@@ -201,6 +209,12 @@ t_view_config::get_column_pivot_depth() const {
     return m_column_pivot_depth;
 }
 
+std::int32_t
+t_view_config::get_top_n() const {
+    PSP_VERBOSE_ASSERT(m_init, "touching uninited object");
+    return m_top_n;
+}
+
 // PRIVATE
 void
 t_view_config::fill_aggspecs(std::shared_ptr<t_schema> schema) {
@@ -253,6 +267,7 @@ t_view_config::fill_aggspecs(std::shared_ptr<t_schema> schema) {
 
             std::vector<t_dep> dependencies{t_dep(column, DEPTYPE_COLUMN)};
             t_aggtype agg_type;
+            double quantile = 0.5;
 
             if (is_column_only) {
                 // Always sort by `ANY` in column only views
@@ -270,12 +285,21 @@ t_view_config::fill_aggspecs(std::shared_ptr<t_schema> schema) {
                 } else {
                     agg_type = str_to_aggtype(col.at(0));
                 }
+
+                if (agg_type == AGGTYPE_APPROX_PERCENTILE) {
+                    quantile = get_aggregate_quantile(col);
+                }
             } else {
                 t_dtype dtype = schema->get_dtype(column);
                 agg_type = _get_default_aggregate(dtype);
             }
 
-            m_aggspecs.push_back(t_aggspec(column, agg_type, dependencies));
+            if (agg_type == AGGTYPE_APPROX_PERCENTILE) {
+                m_aggspecs.push_back(
+                    t_aggspec(column, agg_type, dependencies, quantile));
+            } else {
+                m_aggspecs.push_back(t_aggspec(column, agg_type, dependencies));
+            }
             m_aggregate_names.push_back(column);
         }
     }
@@ -352,6 +376,9 @@ t_view_config::make_aggspec(const std::string& column,
         dependencies.push_back(t_dep("psp_okey", DEPTYPE_COLUMN));
         aggspec = t_aggspec(
             column, column, agg_type, dependencies, SORTTYPE_ASCENDING);
+    } else if (agg_type == AGGTYPE_APPROX_PERCENTILE) {
+        aggspec = t_aggspec(column, agg_type, dependencies,
+            get_aggregate_quantile(aggregate));
     } else {
         aggspec = t_aggspec(column, agg_type, dependencies);
     }
@@ -360,4 +387,38 @@ t_view_config::make_aggspec(const std::string& column,
     m_aggregate_names.push_back(column);
 }
 
+double
+t_view_config::get_aggregate_quantile(
+    const std::vector<std::string>& aggregate) const {
+    std::string param;
+
+    if (aggregate.size() > 1) {
+        param = aggregate.at(1);
+    } else {
+        const std::string& agg_name = aggregate.at(0);
+        auto open = agg_name.find('(');
+        auto close = agg_name.rfind(')');
+
+        if (open == std::string::npos || close == std::string::npos
+            || close < open) {
+            return 0.5;
+        }
+
+        param = agg_name.substr(open + 1, close - open - 1);
+    }
+
+    const char* begin = param.c_str();
+    char* end = nullptr;
+    double quantile = std::strtod(begin, &end);
+
+    if (end == begin || !(quantile >= 0 && quantile <= 1)) {
+        std::stringstream ss;
+        ss << "Invalid quantile for `approx percentile`: '" << param
+           << "', expected a number between 0 and 1." << std::endl;
+        PSP_COMPLAIN_AND_ABORT(ss.str());
+    }
+
+    return quantile;
+}
+
 } // end namespace perspective
\ No newline at end of file
@@ -50,6 +50,10 @@ public:
         t_aggtype agg, t_uindex agg_one_idx, t_uindex agg_two_idx,
         double agg_one_weight, double agg_two_weight);
 
+    // Used by `AGGTYPE_APPROX_PERCENTILE`, where `quantile` is in [0, 1].
+    t_aggspec(const std::string& aggname, t_aggtype agg,
+        const std::vector<t_dep>& dependencies, double quantile);
+
     std::string name() const;
     t_tscalar name_scalar() const;
     std::string disp_name() const;
@@ -64,6 +68,8 @@ public:
     double get_agg_one_weight() const;
     double get_agg_two_weight() const;
 
+    double get_quantile() const;
+
     t_invmode get_inv_mode() const;
 
     std::vector<std::string> get_input_depnames() const;
@@ -77,6 +83,10 @@ public:
 
     bool is_non_delta() const;
 
+    // Whether the aggregate is computed from a mergeable sketch held per
+    // tree node, rather than from the node's rows.
+    bool is_sketch_agg() const;
+
     std::string get_first_depname() const;
 
 private:
@@ -90,6 +100,7 @@ private:
     t_uindex m_agg_two_idx;
     double m_agg_one_weight;
     double m_agg_two_weight;
+    double m_quantile;
     t_invmode m_invmode;
     // t_uindex m_kernel;
 };
@@ -0,0 +1,117 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2017, the Perspective Authors.
+ *
+ * This file is part of the Perspective library, distributed under the terms of
+ * the Apache License 2.0.  The full license can be found in the LICENSE file.
+ *
+ */
+
+#pragma once
+#include <perspective/first.h>
+#include <perspective/base.h>
+#include <perspective/exports.h>
+#include <perspective/column.h>
+#include <tsl/hopscotch_map.h>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace perspective {
+
+/**
+ * @brief The rows of each distinct value of a low-cardinality column.
+ *
+ * Values are keyed by their raw column bits - the interned id for string
+ * columns - so an equality filter is a lookup instead of a scan. Only the
+ * valid rows of a column are indexed, and an index that would need more
+ * than `MAX_KEYS` keys gives up instead of growing.
+ *
+ * A value's rows are kept as a sorted list until it holds more than 1 in
+ * 64 rows, when a bitmap becomes smaller, so at most 128 values own a
+ * bitmap however many keys the column has.
+ */
+class PERSPECTIVE_EXPORT t_bitmap_index {
+public:
+    static const t_uindex MAX_KEYS = 4096;
+
+    t_bitmap_index();
+
+    static bool is_indexable(t_dtype dtype);
+
+    // Type of the column the index was built from.
+    t_dtype get_dtype() const;
+
+    // Raw key of `nbytes` bytes at `data`, zero extended.
+    static std::uint64_t get_key(const void* data, t_uindex nbytes);
+
+    /**
+     * @brief Index the first `nrows` rows of `column`.
+     *
+     * @return false if the column has too many distinct values.
+     */
+    bool build(const t_column* column, t_uindex nrows);
+
+    /**
+     * @brief Re-read `rows` of `column` after they changed, with the column
+     * now holding `nrows` rows. A column whose type was promoted is indexed
+     * again from scratch.
+     *
+     * @return false if the column has too many distinct values.
+     */
+    bool update(const t_column* column, const std::vector<t_uindex>& rows,
+        t_uindex nrows);
+
+    /**
+     * @brief Write the rows holding any of `keys` into `out`, one bit per
+     * row in 64-bit words.
+     *
+     * With `live` set, the indexed rows are compacted to the rows set in
+     * `live`, as `t_column::clone(mask)` does.
+     */
+    void select(const std::vector<std::uint64_t>& keys,
+        const std::vector<std::uint64_t>* live,
+        std::vector<std::uint64_t>& out) const;
+
+private:
+    void clear();
+    void resize(t_uindex nrows);
+    bool set_row(t_uindex ridx, bool valid, std::uint64_t key);
+    void add_row(std::uint16_t slot, t_uindex ridx);
+    void remove_row(std::uint16_t slot, t_uindex ridx);
+    void make_dense(std::uint16_t slot);
+    void make_sparse(std::uint16_t slot);
+
+    static const std::uint16_t NO_SLOT = 0xFFFF;
+
+    t_dtype m_dtype;
+    t_uindex m_nrows;
+
+    // Each distinct value owns a slot, freed once no row holds it.
+    tsl::hopscotch_map<std::uint64_t, std::uint16_t> m_slots;
+    std::vector<std::uint64_t> m_keys;
+    std::vector<t_uindex> m_counts;
+    std::vector<std::uint16_t> m_free_slots;
+
+    // The rows of a slot, in `m_bitmaps` if it is dense and in `m_rows`
+    // otherwise - the other one is empty.
+    std::vector<std::vector<std::uint64_t>> m_bitmaps;
+    std::vector<std::vector<t_uindex>> m_rows;
+
+    // Slot of every row, `NO_SLOT` for rows that are not valid.
+    std::vector<std::uint16_t> m_row_slots;
+};
+
+/**
+ * @brief The bitmap indexes of a table, by column name.
+ *
+ * A table cloned from an indexed table with a mask shares its indexes and
+ * carries the mask as `m_live`.
+ */
+struct PERSPECTIVE_EXPORT t_bitmap_index_set {
+    std::map<std::string, std::shared_ptr<t_bitmap_index>> m_indexes;
+    std::vector<std::uint64_t> m_live;
+    bool m_has_live;
+};
+
+} // end namespace perspective
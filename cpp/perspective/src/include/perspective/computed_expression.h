@@ -17,8 +17,10 @@
 #include <perspective/data_table.h>
 #include <perspective/rlookup.h>
 #include <perspective/computed_function.h>
+#include <perspective/computed_plan.h>
 #include <date/date.h>
 #include <tsl/hopscotch_set.h>
+#include <atomic>
 
 // a header that includes exprtk and overload definitions for `t_tscalar` so
 // it can be used inside exprtk.
@@ -36,6 +38,8 @@ struct PERSPECTIVE_EXPORT t_expression_error {
     t_index m_column;
 };
 
+struct t_computed_program;
+
 /**
  * @brief Contains the metadata for a single expression and the methods which
  * will compute the expression's output.
@@ -50,6 +54,8 @@ public:
         const std::vector<std::pair<std::string, std::string>>& column_ids,
         t_dtype dtype);
 
+    ~t_computed_expression();
+
     void compute(std::shared_ptr<t_data_table> source_table,
         std::shared_ptr<t_data_table> destination_table,
         t_expression_vocab& vocab, t_regex_mapping& regex_mapping) const;
@@ -61,12 +67,51 @@ public:
     get_column_ids() const;
     t_dtype get_dtype() const;
 
+    /**
+     * @brief Whether the expression calls `random()`, `now()` or `today()`,
+     * whose results change each time the expression is computed.
+     */
+    bool is_nondeterministic() const;
+
 private:
+    /**
+     * @brief Compile the expression against a new symbol table and function
+     * store, with input columns of `column_dtypes`.
+     */
+    std::unique_ptr<t_computed_program> compile_program(
+        const std::vector<t_dtype>& column_dtypes, t_expression_vocab& vocab,
+        t_regex_mapping& regex_mapping) const;
+
+    t_tscalar evaluate_row(t_computed_program& program,
+        const std::vector<std::shared_ptr<t_column>>& columns,
+        t_uindex ridx) const;
+
+    /**
+     * @brief Evaluate the rows in [begin, end) with `program`, writing each
+     * result to `output_column`.
+     */
+    void compute_rows(t_computed_program& program,
+        const std::vector<std::shared_ptr<t_column>>& columns,
+        t_column& output_column, t_uindex begin, t_uindex end) const;
+
+    /**
+     * @brief Compute an expression over a single string column once for
+     * each distinct string in `column`, writing each row from the results.
+     */
+    void compute_memoized(t_computed_program& program,
+        std::shared_ptr<t_column> column, t_column& output_column,
+        t_uindex num_rows) const;
+
     std::string m_expression_alias;
     std::string m_expression_string;
     std::string m_parsed_expression_string;
     std::vector<std::pair<std::string, std::string>> m_column_ids;
     t_dtype m_dtype;
+
+    // Compiled by the first `compute` and reused by every later call, which
+    // only binds the source table's columns again. Tables large enough to be
+    // computed in parallel compile one more program for each further thread.
+    mutable std::vector<std::unique_ptr<t_computed_program>> m_programs;
 };
 
 class PERSPECTIVE_EXPORT t_computed_expression_parser {
@@ -125,8 +170,26 @@ public:
         const t_schema& schema, t_expression_error& error,
         t_expression_vocab& vocab, t_regex_mapping& regex_mapping);
 
+    /**
+     * @brief Compile `expression_string` with `PARSER`, counting the
+     * compilation.
+     */
+    static bool compile(const std::string& expression_string,
+        exprtk::expression<t_tscalar>& expression);
+
+    /**
+     * @brief The number of expressions compiled so far. Updates to a table
+     * reuse the programs compiled for its views, so this only moves when
+     * expressions are validated, a view is created, or a table first grows
+     * large enough to compute an expression on more threads.
+     */
+    static t_uindex get_compile_count();
+
     static std::shared_ptr<exprtk::parser<t_tscalar>> PARSER;
 
+    // Views on different tables compile their expressions concurrently.
+    static std::atomic<t_uindex> COMPILE_COUNT;
+
     // Applied to the parser
     static std::size_t PARSER_COMPILE_OPTIONS;
 
@@ -211,4 +274,54 @@ struct PERSPECTIVE_EXPORT t_computed_function_store {
     computed_function::replace_all m_replace_all_fn;
 };
 
+/**
+ * @brief The results of an expression over one string column, by the
+ * column's interned string id and the row's status. A column's vocab only
+ * grows, so the results stay valid across updates and are extended as new
+ * strings are interned.
+ */
+struct PERSPECTIVE_EXPORT t_computed_memo {
+    t_computed_memo();
+
+    std::weak_ptr<t_column> m_column;
+    const t_vocab* m_vocab;
+
+    // `t_expression_vocab::get_generation` when the results were computed,
+    // as string results point into the expression vocab.
+    t_uindex m_generation;
+
+    // Indexed by `string id * NUM_STATUSES + status`.
+    std::vector<t_tscalar> m_results;
+    std::vector<bool> m_computed;
+
+    static const t_uindex NUM_STATUSES = STATUS_CLEAR + 1;
+};
+
+/**
+ * @brief A compiled expression with the symbol table and function store it
+ * was compiled against. The symbol table binds `m_values`, so each row is
+ * evaluated by writing its inputs there - unless the expression could also
+ * be lowered to `m_plan`, which computes whole batches of rows instead, or
+ * only reads a string column, in which case it is evaluated once for each
+ * distinct string and the results kept in `m_memos`.
+ */
+struct PERSPECTIVE_EXPORT t_computed_program {
+    PSP_NON_COPYABLE(t_computed_program);
+
+    t_computed_program(
+        t_expression_vocab& vocab, t_regex_mapping& regex_mapping);
+
+    t_expression_vocab* m_vocab;
+    t_regex_mapping* m_regex_mapping;
+    exprtk::symbol_table<t_tscalar> m_sym_table;
+    t_computed_function_store m_function_store;
+    std::vector<t_tscalar> m_values;
+    exprtk::expression<t_tscalar> m_expression;
+    std::unique_ptr<t_computed_plan> m_plan;
+    bool m_memoize;
+
+    // One for each source column the expression has been computed over.
+    std::vector<t_computed_memo> m_memos;
+};
+
 } // end namespace perspective
\ No newline at end of file
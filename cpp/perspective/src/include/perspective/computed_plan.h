@@ -0,0 +1,109 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2019, the Perspective Authors.
+ *
+ * This file is part of the Perspective library, distributed under the terms of
+ * the Apache License 2.0.  The full license can be found in the LICENSE file.
+ *
+ */
+
+#pragma once
+
+#include <perspective/first.h>
+#include <perspective/base.h>
+#include <perspective/exports.h>
+#include <perspective/raw_types.h>
+#include <perspective/column.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace perspective {
+
+enum t_plan_op {
+    PLAN_OP_COLUMN,
+    PLAN_OP_LITERAL,
+    PLAN_OP_ADD,
+    PLAN_OP_SUB,
+    PLAN_OP_MUL,
+    PLAN_OP_DIV,
+    PLAN_OP_MOD,
+    PLAN_OP_NEG,
+    PLAN_OP_LT,
+    PLAN_OP_LTE,
+    PLAN_OP_GT,
+    PLAN_OP_GTE,
+    PLAN_OP_EQ,
+    PLAN_OP_NE,
+    PLAN_OP_AND,
+    PLAN_OP_OR,
+    PLAN_OP_IF,
+    PLAN_OP_MIN,
+    PLAN_OP_MAX,
+    PLAN_OP_ABS,
+    PLAN_OP_BUCKET,
+    PLAN_OP_TO_FLOAT,
+    PLAN_OP_IS_NULL,
+    PLAN_OP_IS_NOT_NULL
+};
+
+/**
+ * @brief One step of a `t_computed_plan`. Its arguments are earlier steps,
+ * and `m_dtype` is the type of the `t_tscalar` ExprTk would produce for it.
+ */
+struct PERSPECTIVE_EXPORT t_plan_node {
+    t_plan_op m_op;
+    t_dtype m_dtype;
+    std::vector<t_uindex> m_args;
+
+    // The input column of `PLAN_OP_COLUMN`.
+    t_uindex m_cidx;
+
+    // The value of `PLAN_OP_LITERAL`.
+    double m_value;
+};
+
+/**
+ * @brief An expression lowered to typed steps that each run over a batch of
+ * rows at once, instead of ExprTk walking its tree once per row.
+ *
+ * Each step keeps a value and a `t_status` per row, and reproduces what the
+ * `t_tscalar` operators give for the same inputs - including how they order
+ * invalid values - so a plan and ExprTk write the same column. Only
+ * arithmetic, comparisons, `and`/`or`, `if`/ternary, `min`, `max`, `abs`,
+ * numeric `bucket`, `float` and `is_null`/`is_not_null` over numeric and
+ * boolean columns are lowered.
+ */
+class PERSPECTIVE_EXPORT t_computed_plan {
+public:
+    PSP_NON_COPYABLE(t_computed_plan);
+
+    static const t_uindex BATCH_SIZE = 1024;
+
+    /**
+     * @brief Lower a parsed expression string whose output column is of
+     * `dtype`.
+     *
+     * @return nullptr if the expression uses anything the plan does not
+     * cover, and should be computed by ExprTk instead.
+     */
+    static std::unique_ptr<t_computed_plan> build(
+        const std::string& parsed_expression_string,
+        const std::vector<std::pair<std::string, std::string>>& column_ids,
+        const std::vector<t_dtype>& column_dtypes, t_dtype dtype);
+
+    /**
+     * @brief Write the first `num_rows` rows of `output_column` from
+     * `columns`, which are in the order of the plan's `column_ids`.
+     */
+    void compute(const std::vector<std::shared_ptr<t_column>>& columns,
+        t_column& output_column, t_uindex num_rows) const;
+
+private:
+    t_computed_plan();
+
+    std::vector<t_plan_node> m_nodes;
+    t_dtype m_dtype;
+};
+
+} // end namespace perspective
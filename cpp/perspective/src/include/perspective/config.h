@@ -79,6 +79,21 @@ public:
         const std::vector<std::shared_ptr<t_computed_expression>>& expressions,
         bool column_only);
 
+    /**
+     * @brief Construct a new config for a `t_ctx_grouped_pkey` object, whose
+     * rows nest under the row whose `child_pkey_column` value is their
+     * `parent_pkey_column` value.
+     *
+     * @param detail_columns the columns to be displayed in the context
+     * @param child_pkey_column
+     * @param parent_pkey_column
+     * @param sort_column orders siblings in the tree
+     */
+    t_config(const std::vector<std::string>& detail_columns,
+        const std::string& child_pkey_column,
+        const std::string& parent_pkey_column,
+        const std::string& sort_column);
+
     // An empty config, used for the unit context.
     t_config();
 
@@ -175,6 +190,26 @@ public:
     std::string unity_get_column_display_name(t_uindex idx) const;
     t_fmode get_fmode() const;
 
+    /**
+     * @brief A string that is equal for two configs exactly when a
+     * `t_stree` built from one holds the same nodes as a tree built from
+     * the other, i.e. the same row pivots, pivot sorts, filters,
+     * expressions and totals. Aggregates are left out: one-sided contexts
+     * that share a tree read from the union of their aggregates.
+     *
+     * @return std::string
+     */
+    std::string get_tree_signature() const;
+
+    /**
+     * @brief A string that is equal for two aggregates exactly when they
+     * fill the same column of a `t_stree`'s aggregate table.
+     *
+     * @param spec
+     * @return std::string
+     */
+    static std::string get_aggregate_signature(const t_aggspec& spec);
+
     inline const std::string&
     get_grand_agg_str() const {
         return m_grand_agg_str;
@@ -91,18 +91,9 @@ t_uindex num_expressions() const;
 
 std::shared_ptr<t_expression_tables> get_expression_tables() const;
 
-// Given shared pointers to data tables from the gnode, use them to
-// compute the results of expression columns.
-void compute_expressions(std::shared_ptr<t_data_table> flattened_masked,
-    t_expression_vocab& expression_vocab, t_regex_mapping& regex_mapping);
-
-void compute_expressions(std::shared_ptr<t_data_table> master,
-    std::shared_ptr<t_data_table> flattened,
-    std::shared_ptr<t_data_table> delta, std::shared_ptr<t_data_table> prev,
-    std::shared_ptr<t_data_table> current,
-    std::shared_ptr<t_data_table> transitions,
-    std::shared_ptr<t_data_table> existed, t_expression_vocab& expression_vocab,
-    t_regex_mapping& regex_mapping);
+// Take the results of this context's expression columns from the gnode's
+// pass over its tables, computing those no other context shares.
+void compute_expressions(t_expression_cache& cache);
 
 // Unity api
 std::vector<t_tscalar> unity_get_row_data(t_uindex idx) const;
@@ -19,9 +19,24 @@
 #include <perspective/expression_tables.h>
 #include <perspective/expression_vocab.h>
 #include <perspective/regex.h>
+#include <tsl/hopscotch_map.h>
+#include <tsl/hopscotch_set.h>
 
 namespace perspective {
 
+/**
+ * @brief A row of a `t_ctx_grouped_pkey`: its child and parent values, and
+ * its tree node - `NO_NODE` while the row cannot be reached from the root,
+ * e.g. under a parent that is itself waiting or inside a cycle.
+ */
+struct PERSPECTIVE_EXPORT t_gpkey_row {
+    static const t_uindex NO_NODE = static_cast<t_uindex>(INVALID_INDEX);
+
+    t_tscalar m_child;
+    t_tscalar m_parent;
+    t_uindex m_nidx;
+};
+
 class PERSPECTIVE_EXPORT t_ctx_grouped_pkey
     : public t_ctxbase<t_ctx_grouped_pkey> {
 public:
@@ -61,6 +76,16 @@ public:
 private:
     void rebuild();
 
+    /**
+     * @brief Apply inserted/updated and removed primary keys to the tree.
+     *
+     * Only the subtrees of rows whose parent, child value or sort value
+     * changed are detached and placed again, so the cost of a step follows
+     * the rows it touches rather than the size of the table.
+     */
+    void update_rows(const std::vector<t_tscalar>& upserted,
+        const std::vector<t_tscalar>& removed, bool process_traversal);
+
     t_tscalar get_value_from_gstate(
         const std::string& colname, const t_tscalar& pkey) const;
 
@@ -72,6 +97,17 @@ private:
     t_depth m_depth;
     bool m_depth_set;
     std::shared_ptr<t_expression_tables> m_expression_tables;
+
+    // Every row passing the filters by primary key, the row owning each
+    // child value, and the rows naming each value as their parent.
+    tsl::hopscotch_map<t_tscalar, t_gpkey_row> m_rows;
+    tsl::hopscotch_map<t_tscalar, t_tscalar> m_child_pkeys;
+    tsl::hopscotch_map<t_tscalar, tsl::hopscotch_set<t_tscalar>>
+        m_parent_pkeys;
+
+    // Tree nodes whose children were updated in place this step, and so
+    // may be out of order under `m_sortby` until `step_end`.
+    tsl::hopscotch_set<t_uindex> m_sort_parents;
 };
 
 typedef std::shared_ptr<t_ctx_grouped_pkey> t_ctx_grouped_pkey_sptr;
@@ -18,6 +18,9 @@
 #include <perspective/expression_tables.h>
 #include <perspective/expression_vocab.h>
 #include <perspective/regex.h>
+#include <perspective/min_max.h>
+#include <tsl/hopscotch_map.h>
+#include <tsl/hopscotch_set.h>
 
 namespace perspective {
 
@@ -41,6 +44,14 @@ public:
     std::vector<t_tscalar> get_row_path(t_index idx) const;
     void set_depth(t_depth depth);
 
+    /**
+     * @brief Only keep the first `top_n` children of each node in sort
+     * order; -1 keeps every child.
+     *
+     * @param top_n
+     */
+    void set_top_n(t_index top_n);
+
     t_index get_row_idx(const std::vector<t_tscalar>& path) const;
 
     t_depth get_trav_depth(t_index idx) const;
@@ -48,15 +59,149 @@ public:
     std::pair<t_tscalar, t_tscalar> get_min_max(
         const std::string& colname) const;
 
+    std::vector<t_path> get_expansion_state() const;
+    void set_expansion_state(const std::vector<t_path>& paths);
+
+    /**
+     * @brief Whether this context may read from a tree that other contexts
+     * also read from. Trees hold a single set of deltas and alerts, so
+     * contexts that consume either need a tree of their own.
+     *
+     * @return true
+     * @return false
+     */
+    bool can_share_tree() const;
+
+    /**
+     * @brief Whether this context reads from a shared tree but can no
+     * longer share it, and should be reset and refilled from state.
+     *
+     * @return true
+     * @return false
+     */
+    bool needs_own_tree() const;
+
+    /**
+     * @brief Drop this context's tree and read from the tree of `other`,
+     * which must have the same tree signature and hold every aggregate of
+     * this context. Only the traversal is rebuilt; the tree is updated by
+     * whichever context `t_gnode` notifies first.
+     *
+     * @param other
+     */
+    void share_tree(const t_ctx1& other);
+
+    /**
+     * @brief The aggregates of the tree this context reads from: its own,
+     * or the union of the aggregates of the contexts sharing the tree.
+     *
+     * @return const std::vector<t_aggspec>&
+     */
+    const std::vector<t_aggspec>& get_tree_aggregates() const;
+
+    /**
+     * @brief Read this context's aggregates from a tree built for
+     * `aggregates`, which must hold each of them. Takes effect on the next
+     * `reset`.
+     *
+     * @param aggregates
+     */
+    void set_tree_aggregates(const std::vector<t_aggspec>& aggregates);
+
+    /**
+     * @brief The aggregates of a tree for both this context and the
+     * contexts reading a tree built for `aggregates`: `aggregates`, then
+     * each aggregate of this context missing from it.
+     *
+     * @param aggregates
+     * @param out_aggregates
+     * @return false if an aggregate of this context has the name of a
+     * different aggregate in `aggregates`.
+     */
+    bool merge_tree_aggregates(const std::vector<t_aggspec>& aggregates,
+        std::vector<t_aggspec>& out_aggregates) const;
+
+    /**
+     * @brief Update the traversal from the last update of a shared tree,
+     * without touching the tree itself.
+     */
+    void notify_traversal();
+
     using t_ctxbase<t_ctx1>::get_data;
 
 private:
+    /**
+     * @brief Rebuild the traversal and every top-N pool from the tree with
+     * the current sort and expansion, for changes that re-rank every child,
+     * such as a new sort.
+     */
+    void apply_top_n();
+
+    /**
+     * @brief Bring the top-N pools of the parents of the tree nodes updated
+     * by the last step up to date, and show the first `m_top_n` children of
+     * each. Only the changed children are re-ranked.
+     */
+    void update_top_n();
+
+    // Sort row of tree node `nidx` under `m_top_n_sort_orders`.
+    void fill_top_n_elem(t_uindex nidx, t_mselem& elem) const;
+
+    void build_top_n_pool(t_uindex nidx);
+    void update_top_n_pool(t_uindex nidx, const std::vector<t_uindex>& cnidxs);
+
+    // Show the first `m_top_n` children in the pool of `nidx`, appending the
+    // tree nodes shown or hidden to `changed`. Returns the rows added.
+    t_index show_top_n(t_uindex nidx, std::vector<t_uindex>& changed);
+
+    // Expand the rows for `pending` down to `m_depth`, top N at a time.
+    t_index expand_top_n(
+        std::vector<t_uindex> pending, std::vector<t_uindex>& changed);
+
+    // Re-read the min and max of the marked tree nodes on the next call to
+    // `get_min_max`. Nodes are only marked while a column is tracked.
+    void mark_minmax_nodes(const std::vector<t_uindex>& nidxs);
+    void mark_minmax_rows(t_index bidx, t_index eidx);
+
+    // Stop tracking min and max, for changes to the traversal that are too
+    // wide to mark node by node.
+    void reset_minmax();
+
+    void add_minmax_column(const std::string& colname) const;
+
+    t_tscalar get_minmax_value(
+        const t_aggspec& aggspec, const t_column* col, t_uindex nidx) const;
+
+    // Map `m_sortby` onto the aggregates of the tree, into `m_tree_sortby`.
+    void update_tree_sortby();
+
     std::shared_ptr<t_traversal> m_traversal;
     std::shared_ptr<t_stree> m_tree;
+    std::vector<t_aggspec> m_tree_aggregates;
+    // Index into `m_tree_aggregates` of each of this context's aggregates.
+    std::vector<t_index> m_tree_agg_indices;
     std::vector<t_sortspec> m_sortby;
+    // `m_sortby`, by the tree's aggregate indices, for the tree and the
+    // traversal.
+    std::vector<t_sortspec> m_tree_sortby;
     std::shared_ptr<t_expression_tables> m_expression_tables;
     t_depth m_depth;
     bool m_depth_set;
+    t_index m_top_n;
+    // The best `m_top_n * t_ftrav::TOP_N_POOL_FACTOR` children of each
+    // expanded row in sort order, keyed by tree node, so a child can leave
+    // the top N without re-ranking its siblings. Each element's `m_order`
+    // is the child's tree node.
+    tsl::hopscotch_map<t_uindex, std::vector<t_mselem>> m_top_n_pools;
+    // The sort aggregates, then the tree's own order of siblings.
+    std::vector<t_index> m_top_n_agg_indices;
+    std::vector<t_sorttype> m_top_n_sort_orders;
+    // Min and max of the rows shown at each depth, keyed by tree node, for
+    // the columns `get_min_max` has been asked for. Every depth tracks the
+    // same columns.
+    mutable std::vector<t_minmax_index> m_minmax;
+    // Tree nodes updated, shown or hidden since `get_min_max` last ran.
+    mutable tsl::hopscotch_set<t_uindex> m_minmax_marked;
 };
 
 } // end namespace perspective
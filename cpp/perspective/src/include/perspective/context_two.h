@@ -20,6 +20,8 @@
 #include <perspective/expression_tables.h>
 #include <perspective/expression_vocab.h>
 #include <perspective/regex.h>
+#include <perspective/min_max.h>
+#include <tsl/hopscotch_set.h>
 
 namespace perspective {
 
@@ -78,6 +80,23 @@ protected:
     t_uindex calc_translated_colidx(t_uindex n_aggs, t_uindex cidx) const;
 
 private:
+    // Re-read the min and max of the rows of the marked row tree nodes on
+    // the next call to `get_min_max`. Rows are only marked while a column
+    // is tracked.
+    void mark_minmax_nodes(const std::vector<t_uindex>& nidxs);
+    void mark_minmax_rows(t_index bidx, t_index eidx);
+
+    // Stop tracking min and max, for changes to the traversals that are
+    // too wide to mark row by row.
+    void reset_minmax();
+
+    void add_minmax_column(const std::string& colname) const;
+
+    // The min and max of aggregate `scol` over the leaf column cells of
+    // each row in `ridxs`, or none for a row without values.
+    std::vector<std::pair<t_tscalar, t_tscalar>> get_row_min_max(
+        const std::vector<t_index>& ridxs, t_uindex scol) const;
+
     std::shared_ptr<t_traversal> m_rtraversal;
     std::shared_ptr<t_traversal> m_ctraversal;
     std::vector<t_sortspec> m_sortby;
@@ -89,6 +108,13 @@ private:
     t_depth m_column_depth;
     bool m_column_depth_set;
     std::shared_ptr<t_expression_tables> m_expression_tables;
+    // The min and max over the cells of each row shown at each row depth,
+    // keyed by row tree node, for the columns `get_min_max` has been asked
+    // for. Every depth tracks the same columns.
+    mutable std::vector<t_minmax_index> m_row_mins;
+    mutable std::vector<t_minmax_index> m_row_maxes;
+    // Row tree nodes updated, shown or hidden since `get_min_max` last ran.
+    mutable tsl::hopscotch_set<t_uindex> m_minmax_marked;
 };
 
 } // end namespace perspective
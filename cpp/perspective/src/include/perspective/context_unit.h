@@ -16,6 +16,7 @@
 #include <perspective/sym_table.h>
 #include <perspective/traversal.h>
 #include <perspective/flat_traversal.h>
+#include <perspective/min_max.h>
 #include <tsl/hopscotch_set.h>
 
 namespace perspective {
@@ -152,6 +153,10 @@ private:
 
     t_symtable m_symtable;
     bool m_has_delta;
+
+    // Min and max of the columns `get_min_max` has been asked for, brought
+    // up to date from the rows changed since the last call.
+    mutable t_minmax_index m_minmax;
 };
 
 } // end namespace perspective
@@ -19,6 +19,7 @@
 #include <perspective/data_table.h>
 #include <perspective/expression_tables.h>
 #include <perspective/expression_vocab.h>
+#include <perspective/min_max.h>
 #include <perspective/regex.h>
 #include <tsl/hopscotch_set.h>
 
@@ -44,6 +45,14 @@ public:
     void sort_by();
     std::vector<t_sortspec> get_sort_by() const;
 
+    /**
+     * @brief Only keep the first `top_n` rows in sort order; -1 keeps
+     * every row. Must be called after `init`.
+     *
+     * @param top_n
+     */
+    void set_top_n(t_index top_n);
+
     std::pair<t_tscalar, t_tscalar> get_min_max(
         const std::string& colname) const;
 
@@ -92,13 +101,59 @@ protected:
         const std::vector<t_tscalar>& pkeys,
         std::vector<t_tscalar>& out_data) const;
 
+    /**
+     * @brief Like `read_column_from_gstate`, for master table rows already
+     * resolved with `t_gstate::lookup`, writing every `stride`th scalar of
+     * `out_data`.
+     *
+     * @param colname
+     * @param rows
+     * @param out_data
+     * @param stride
+     */
+    void read_column_from_gstate(const std::string& colname,
+        const std::vector<t_uindex>& rows, t_tscalar* out_data,
+        t_uindex stride) const;
+
+    /**
+     * @brief Compute a lazy expression column for whichever of the master
+     * table `rows` have no result yet.
+     *
+     * @param colname
+     * @param rows
+     */
+    void materialize_expression(
+        const std::string& colname, const std::vector<t_uindex>& rows) const;
+
+    /**
+     * @brief Compute the lazy expression column `colname` for every row
+     * from now on, as the traversal needs all of it to sort by it.
+     *
+     * @param colname
+     */
+    void make_expression_eager(const std::string& colname);
+
 private:
     std::shared_ptr<t_ftrav> m_traversal;
     std::shared_ptr<t_zcdeltas> m_deltas;
     tsl::hopscotch_set<t_tscalar> m_delta_pkeys;
     std::shared_ptr<t_expression_tables> m_expression_tables;
+
+    // Expressions that are filtered or sorted on are computed for every row
+    // into `m_expression_tables`, and the others only for the rows read.
+    std::vector<std::shared_ptr<t_computed_expression>> m_eager_expressions;
+    std::shared_ptr<t_lazy_expressions> m_lazy_expressions;
+
+    // Owned by the gnode, and set by each call to `compute_expressions`.
+    t_expression_vocab* m_expression_vocab;
+    t_regex_mapping* m_regex_mapping;
+
     t_symtable m_symtable;
     bool m_has_delta;
+
+    // Min and max of the columns `get_min_max` has been asked for, brought
+    // up to date from the rows changed since the last call.
+    mutable t_minmax_index m_minmax;
 };
 
 } // end namespace perspective
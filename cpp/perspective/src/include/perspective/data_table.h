@@ -37,6 +37,7 @@ struct t_flatten_record {
 };
 
 class t_data_table;
+struct t_bitmap_index_set;
 
 class PERSPECTIVE_EXPORT t_tabular {};
 
@@ -135,6 +136,16 @@ public:
 
     t_mask filter_cpp(
         t_filter_op combiner, const std::vector<t_fterm>& fops) const;
+
+    /**
+     * @brief Attach bitmap indexes that `filter_cpp` reads instead of
+     * scanning the indexed columns. The owner of the indexes keeps them in
+     * sync with the table.
+     *
+     * @param indexes
+     */
+    void set_bitmap_indexes(std::shared_ptr<const t_bitmap_index_set> indexes);
+    std::shared_ptr<const t_bitmap_index_set> get_bitmap_indexes() const;
     t_data_table* clone_(const t_mask& mask) const;
     std::shared_ptr<t_data_table> clone(const t_mask& mask) const;
     std::shared_ptr<t_data_table> clone() const;
@@ -236,6 +247,7 @@ private:
     t_backing_store m_backing_store;
     bool m_init;
     std::vector<std::shared_ptr<t_column>> m_columns;
+    std::shared_ptr<const t_bitmap_index_set> m_bitmap_indexes;
 };
 
 PERSPECTIVE_EXPORT bool operator==(
@@ -12,14 +12,92 @@
 #include <perspective/computed_expression.h>
 #include <perspective/data_table.h>
 #include <perspective/parallel_for.h>
+#include <map>
 
 namespace perspective {
 
+/**
+ * @brief The columns one expression computed during one pass of the gnode,
+ * one per table in `t_expression_tables`. Only `m_master` is set when the
+ * pass has no transitional tables.
+ */
+struct PERSPECTIVE_EXPORT t_expression_columns {
+    std::shared_ptr<t_column> m_master;
+    std::shared_ptr<t_column> m_flattened;
+    std::shared_ptr<t_column> m_prev;
+    std::shared_ptr<t_column> m_current;
+    std::shared_ptr<t_column> m_delta;
+    std::shared_ptr<t_column> m_transitions;
+};
+
+/**
+ * @brief Computes each distinct expression once per pass of the gnode.
+ *
+ * Expressions are keyed by their parsed expression string and input columns,
+ * so every context that defines the same expression - under any alias - is
+ * handed the same columns, and holds them by reference in its own
+ * `t_expression_tables` until the next pass replaces them.
+ */
+class PERSPECTIVE_EXPORT t_expression_cache {
+public:
+    PSP_NON_COPYABLE(t_expression_cache);
+
+    // A pass over the master table alone, when a context is created.
+    t_expression_cache(std::shared_ptr<t_data_table> master,
+        t_expression_vocab& expression_vocab, t_regex_mapping& regex_mapping);
+
+    // A pass over the master table and the tables of an update.
+    t_expression_cache(std::shared_ptr<t_data_table> master,
+        std::shared_ptr<t_data_table> flattened,
+        std::shared_ptr<t_data_table> delta, std::shared_ptr<t_data_table> prev,
+        std::shared_ptr<t_data_table> current,
+        std::shared_ptr<t_data_table> existed,
+        t_expression_vocab& expression_vocab, t_regex_mapping& regex_mapping);
+
+    static std::string get_key(const t_computed_expression& expression);
+
+    /**
+     * @brief Compute the expressions that no context has asked for yet in
+     * this pass.
+     */
+    void compute(
+        const std::vector<std::shared_ptr<t_computed_expression>>& expressions);
+
+    // Columns of an expression passed to `compute`.
+    const t_expression_columns& get_columns(
+        const t_computed_expression& expression) const;
+
+    bool has_transitional_tables() const;
+    t_uindex get_master_size() const;
+    t_uindex get_transitional_size() const;
+    t_expression_vocab& get_expression_vocab() const;
+    t_regex_mapping& get_regex_mapping() const;
+
+private:
+    std::shared_ptr<t_column> compute_column(
+        const t_computed_expression& expression,
+        std::shared_ptr<t_data_table> source) const;
+
+    std::shared_ptr<t_data_table> m_master;
+    std::shared_ptr<t_data_table> m_flattened;
+    std::shared_ptr<t_data_table> m_delta;
+    std::shared_ptr<t_data_table> m_prev;
+    std::shared_ptr<t_data_table> m_current;
+    std::shared_ptr<t_data_table> m_existed;
+    t_expression_vocab& m_expression_vocab;
+    t_regex_mapping& m_regex_mapping;
+    std::map<std::string, t_expression_columns> m_columns;
+};
+
 /**
  * @brief Store expression tables for each context - by separating expression
  * columns from the main tables managed by the context, we ensure that cleaning
  * up a context will also clean up its expression columns and not leak memory
  * after the lifetime of a context.
+ *
+ * The columns themselves may be shared with other contexts through
+ * `t_expression_cache`, so they are only ever replaced and never written to
+ * in place.
  */
 struct t_expression_tables {
 
@@ -29,22 +107,19 @@ struct t_expression_tables {
         const std::vector<std::shared_ptr<t_computed_expression>>& expressions);
 
     /**
-     * @brief Reserve space on each transitional table - reserve is important
-     * because it also reserves space on each underlying column, whereas
-     * `set_capacity` only affects the table, and can lead to a situation where
-     * the table's capacity and the capacity of underlying columns grow out
-     * of sync, which causes memory errors.
-     *
-     * @param size
+     * @brief Point each table at the columns `cache` computed for
+     * `expressions` in this pass.
      */
-    void reserve_transitional_table_size(t_uindex size);
-
-    void set_transitional_table_size(t_uindex size);
+    void compute(
+        const std::vector<std::shared_ptr<t_computed_expression>>& expressions,
+        t_expression_cache& cache);
 
+    // Replace the transitional tables with empty ones.
     void clear_transitional_tables();
 
-    // Calculate the `t_transitions` value for each row.
-    void calculate_transitions(std::shared_ptr<t_data_table> existed);
+    // Calculate the `t_transitions` value for each row of `transitions`.
+    static void calculate_transitions(const t_column& existed,
+        const t_column& prev, const t_column& current, t_column& transitions);
 
     void reset();
 
@@ -58,6 +133,67 @@ struct t_expression_tables {
     std::shared_ptr<t_data_table> m_current;
     std::shared_ptr<t_data_table> m_delta;
     std::shared_ptr<t_data_table> m_transitions;
+
+private:
+    t_schema m_schema;
+    t_schema m_transitions_schema;
+};
+
+/**
+ * @brief An expression column of `t_lazy_expressions`, along with which of
+ * its master table rows hold a result.
+ */
+struct PERSPECTIVE_EXPORT t_lazy_expression_column {
+    std::shared_ptr<t_computed_expression> m_expression;
+    std::shared_ptr<t_data_table> m_table;
+    std::vector<bool> m_computed;
+};
+
+/**
+ * @brief Expression columns of a flat context which nothing sorts or filters
+ * on, so they are only computed for the master table rows that are read
+ * instead of for every row on every update. Each row's result is kept until
+ * an update adds the row or changes one of the expression's input columns.
+ */
+class PERSPECTIVE_EXPORT t_lazy_expressions {
+public:
+    PSP_NON_COPYABLE(t_lazy_expressions);
+
+    t_lazy_expressions(
+        const std::vector<std::shared_ptr<t_computed_expression>>& expressions);
+
+    bool has_column(const std::string& colname) const;
+
+    t_uindex size() const;
+
+    /**
+     * @brief Compute `colname` for the master table `rows`, as returned by
+     * `t_gstate::lookup`, that do not have a result yet.
+     */
+    void materialize(const std::string& colname, const t_data_table& master,
+        const std::vector<t_uindex>& rows, t_expression_vocab& vocab,
+        t_regex_mapping& regex_mapping);
+
+    // The results of `colname`, by master table row.
+    std::shared_ptr<t_data_table> get_table(const std::string& colname) const;
+
+    /**
+     * @brief Drop the results of the master table `rows` - one for each row
+     * of an update's `transitions` table - that were added by the update or
+     * had an input column change.
+     */
+    void invalidate(const std::vector<t_uindex>& rows,
+        const t_data_table& transitions, const t_column& existed);
+
+    void invalidate_all();
+
+    /**
+     * @brief Stop computing `colname` lazily, returning its expression.
+     */
+    std::shared_ptr<t_computed_expression> remove(const std::string& colname);
+
+private:
+    std::map<std::string, t_lazy_expression_column> m_columns;
 };
 
-} // end namespace perspective
\ No newline at end of file
+} // end namespace perspective
@@ -10,6 +10,7 @@
 #include <perspective/first.h>
 #include <perspective/base.h>
 #include <perspective/vocab.h>
+#include <mutex>
 
 namespace perspective {
 class PERSPECTIVE_EXPORT t_expression_vocab {
@@ -22,7 +23,8 @@ public:
      * @brief Given a const char* to a string, intern it into the current
      * vocab page, and return the pointer to the string that has been
      * interned into the vocab. The returned pointer is guaranteed to be
-     * valid for the lifetime of the `t_expression_vocab` instance.
+     * valid for the lifetime of the `t_expression_vocab` instance. Safe to
+     * call from several threads at once.
      *
      * @param str
      * @return const char*
@@ -32,6 +34,14 @@ public:
 
     void clear();
 
+    /**
+     * @brief Returns the number of times the vocab has been cleared, so that
+     * anything holding on to interned strings can tell they are gone.
+     *
+     * @return t_uindex
+     */
+    t_uindex get_generation() const;
+
     /**
      * @brief Returns the empty string owned by the vocab, which will be valid
      * as long as the vocab is alive.
@@ -59,8 +69,13 @@ private:
 
     std::size_t m_current_vocab_size;
 
+    t_uindex m_generation;
+
     // An empty string for validation functions to use.
     std::string m_empty_string;
+
+    // Guards the pages, as expressions are computed on several threads.
+    std::mutex m_mutex;
 };
 
 } // end namespace perspective
\ No newline at end of file
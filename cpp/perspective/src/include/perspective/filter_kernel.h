@@ -0,0 +1,240 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2017, the Perspective Authors.
+ *
+ * This file is part of the Perspective library, distributed under the terms of
+ * the Apache License 2.0.  The full license can be found in the LICENSE file.
+ *
+ */
+
+#pragma once
+#include <perspective/first.h>
+#include <perspective/base.h>
+#include <perspective/bitmap_index.h>
+#include <perspective/exports.h>
+#include <perspective/column.h>
+#include <perspective/filter.h>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace perspective {
+
+// Rows per mask word.
+const t_uindex FILTER_WORD_BITS = 64;
+
+/**
+ * @brief Evaluates one filter term over a column, 64 rows at a time.
+ *
+ * Bit `i` of `word(widx)` is set when row `widx * 64 + i` passes the term;
+ * bits past the last row are always clear, so words from several kernels
+ * can be combined with `&` and `|` directly.
+ */
+class PERSPECTIVE_EXPORT t_filter_kernel {
+public:
+    t_filter_kernel(t_uindex nrows);
+    virtual ~t_filter_kernel();
+
+    virtual std::uint64_t word(t_uindex widx) const = 0;
+
+protected:
+    // Number of rows in word `widx`.
+    t_uindex word_rows(t_uindex widx) const;
+
+    // Mask of the bits of word `widx` that hold rows.
+    std::uint64_t word_mask(t_uindex widx) const;
+
+    t_uindex m_nrows;
+};
+
+/**
+ * @brief Build the kernel for `fterm` on `column`.
+ *
+ * Numeric, boolean, date and time columns compare the raw column values;
+ * string columns compare interned ids, against a per-id lookup table for
+ * orderings. Terms the typed kernels cannot evaluate exactly - mismatched
+ * threshold types, invalid thresholds and substring matches - fall back to
+ * evaluating `t_fterm` on each cell.
+ */
+PERSPECTIVE_EXPORT std::shared_ptr<t_filter_kernel> make_filter_kernel(
+    const t_column* column, const t_fterm& fterm, t_uindex nrows);
+
+/**
+ * @brief Build a kernel for `fterm` that reads `index` instead of `column`,
+ * or return null when the index cannot answer the term. EQ, NE, IN and
+ * NOT_IN are answered; `live` is the mask of an indexed table that `column`
+ * was cloned from, if any.
+ */
+PERSPECTIVE_EXPORT std::shared_ptr<t_filter_kernel> make_index_filter_kernel(
+    const t_column* column, const t_bitmap_index& index,
+    const std::vector<std::uint64_t>* live, const t_fterm& fterm,
+    t_uindex nrows);
+
+// Equality as `t_tscalar::operator==` sees it: floats compare their bits.
+template <typename DATA_T>
+inline bool
+filter_bits_equal(DATA_T a, DATA_T b) {
+    return a == b;
+}
+
+template <>
+inline bool
+filter_bits_equal<double>(double a, double b) {
+    std::uint64_t abits;
+    std::uint64_t bbits;
+    std::memcpy(&abits, &a, sizeof(double));
+    std::memcpy(&bbits, &b, sizeof(double));
+    return abits == bbits;
+}
+
+template <>
+inline bool
+filter_bits_equal<float>(float a, float b) {
+    std::uint32_t abits;
+    std::uint32_t bbits;
+    std::memcpy(&abits, &a, sizeof(float));
+    std::memcpy(&bbits, &b, sizeof(float));
+    return abits == bbits;
+}
+
+template <typename DATA_T>
+struct t_filter_pred_lt {
+    inline bool
+    operator()(DATA_T value) const {
+        return value < m_threshold;
+    }
+
+    DATA_T m_threshold;
+};
+
+template <typename DATA_T>
+struct t_filter_pred_lteq {
+    inline bool
+    operator()(DATA_T value) const {
+        return value < m_threshold || filter_bits_equal(value, m_threshold);
+    }
+
+    DATA_T m_threshold;
+};
+
+template <typename DATA_T>
+struct t_filter_pred_gt {
+    inline bool
+    operator()(DATA_T value) const {
+        return value > m_threshold;
+    }
+
+    DATA_T m_threshold;
+};
+
+template <typename DATA_T>
+struct t_filter_pred_gteq {
+    inline bool
+    operator()(DATA_T value) const {
+        return value > m_threshold || filter_bits_equal(value, m_threshold);
+    }
+
+    DATA_T m_threshold;
+};
+
+template <typename DATA_T>
+struct t_filter_pred_eq {
+    inline bool
+    operator()(DATA_T value) const {
+        return filter_bits_equal(value, m_threshold);
+    }
+
+    DATA_T m_threshold;
+};
+
+template <typename DATA_T>
+struct t_filter_pred_ne {
+    inline bool
+    operator()(DATA_T value) const {
+        return !filter_bits_equal(value, m_threshold);
+    }
+
+    DATA_T m_threshold;
+};
+
+template <typename DATA_T>
+struct t_filter_pred_in {
+    inline bool
+    operator()(DATA_T value) const {
+        bool found = false;
+        for (const DATA_T& member : m_values) {
+            found |= filter_bits_equal(value, member);
+        }
+        return found;
+    }
+
+    std::vector<DATA_T> m_values;
+};
+
+// Looks up interned string ids, or any other dense ids, in a table.
+struct t_filter_pred_table {
+    inline bool
+    operator()(t_uindex value) const {
+        return value < m_table.size() && m_table[value] != 0;
+    }
+
+    std::vector<std::uint8_t> m_table;
+};
+
+/**
+ * @brief Applies `PRED_T` to the raw values of a column.
+ *
+ * Rows whose status is not `STATUS_VALID` take `null_result` instead, and
+ * the whole word is inverted for negated terms.
+ */
+template <typename DATA_T, typename PRED_T>
+class t_filter_value_kernel : public t_filter_kernel {
+public:
+    t_filter_value_kernel(const t_column* column, t_uindex nrows,
+        const PRED_T& pred, bool null_result, bool negated)
+        : t_filter_kernel(nrows)
+        , m_data(column->get_nth<DATA_T>(0))
+        , m_status(
+              column->is_status_enabled() ? column->get_nth_status(0) : nullptr)
+        , m_pred(pred)
+        , m_null_bits(null_result ? ~std::uint64_t(0) : 0)
+        , m_negated(negated) {}
+
+    std::uint64_t
+    word(t_uindex widx) const override {
+        t_uindex bidx = widx * FILTER_WORD_BITS;
+        t_uindex nbits = word_rows(widx);
+        const DATA_T* data = m_data + bidx;
+        std::uint64_t bits = 0;
+
+        for (t_uindex bit = 0; bit < nbits; ++bit) {
+            bits |= std::uint64_t(m_pred(data[bit])) << bit;
+        }
+
+        if (m_status != nullptr) {
+            const t_status* status = m_status + bidx;
+            std::uint64_t valid = 0;
+
+            for (t_uindex bit = 0; bit < nbits; ++bit) {
+                valid |= std::uint64_t(status[bit] == STATUS_VALID) << bit;
+            }
+
+            bits = (bits & valid) | (m_null_bits & ~valid);
+        }
+
+        if (m_negated) {
+            bits = ~bits;
+        }
+
+        return bits & word_mask(widx);
+    }
+
+private:
+    const DATA_T* m_data;
+    const t_status* m_status;
+    PRED_T m_pred;
+    std::uint64_t m_null_bits;
+    bool m_negated;
+};
+
+} // end namespace perspective
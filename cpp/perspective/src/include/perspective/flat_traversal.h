@@ -16,12 +16,14 @@
 #include <functional>
 #include <iostream>
 #include <perspective/multi_sort.h>
+#include <perspective/multi_sort_tree.h>
 #include <perspective/sort_specification.h>
 #include <perspective/gnode_state.h>
 #include <perspective/config.h>
 #include <perspective/exports.h>
 #include <perspective/sym_table.h>
 #include <set>
+#include <limits>
 #include <tsl/hopscotch_map.h>
 
 namespace perspective {
@@ -29,6 +31,10 @@ namespace perspective {
 class PERSPECTIVE_EXPORT t_ftrav {
 
 public:
+    // Top-N views keep up to this many times N rows sorted, so rows can
+    // leave the top N without rescanning every row each time.
+    static const t_index TOP_N_POOL_FACTOR = 2;
+
     t_ftrav();
 
     void init();
@@ -60,6 +66,10 @@ public:
 
     t_index size() const;
 
+    // Only keep the first `top_n` rows in sort order; -1 keeps every row.
+    void set_top_n(t_index top_n);
+    t_index get_top_n() const;
+
     void get_row_indices(const tsl::hopscotch_set<t_tscalar>& pkeys,
         tsl::hopscotch_map<t_tscalar, t_index>& out_map) const;
 
@@ -79,7 +89,8 @@ public:
 
     void step_begin();
 
-    void step_end();
+    void step_end(const t_gstate& gstate,
+        const t_data_table& expression_master_table, const t_config& config);
 
     void add_row(const t_gstate& gstate,
         const t_data_table& expression_master_table, const t_config& config,
@@ -102,21 +113,59 @@ public:
     t_index get_row_idx(t_tscalar pkey) const;
 
 private:
+    // Thread-safe part of `fill_sort_elem`: reads and encodes the sort row
+    // without interning its strings.
+    void fill_sort_row(const t_gstate& gstate,
+        const t_data_table& expression_master_table, const t_config& config,
+        t_tscalar pkey, t_mselem& out_elem) const;
+
+    void intern_sort_row(t_mselem& elem);
+
+    void rebuild(const t_gstate& gstate,
+        const t_data_table& expression_master_table, const t_config& config,
+        const std::vector<t_tscalar>& pkeys);
+
+    t_index get_pool_size() const;
+
+    void insert_elem(const t_mselem& elem);
+
+    void erase_pkey(t_tscalar pkey);
+
+    // Window-first sorting: make `[bidx, eidx)` of `m_lazy_elems` sorted
+    // and in its final position.
+    void sort_window(t_uindex bidx, t_uindex eidx) const;
+    void split_lazy_segment(t_uindex pos) const;
+
+    // Finish a window-first sort and build `m_index` from it.
+    void materialize() const;
+
     t_tscalar get_from_gstate(const t_gstate& gstate,
         const t_data_table& expression_master_table, const std::string& colname,
         t_tscalar pkey) const;
 
-    t_index m_step_deletes;
-    t_index m_step_inserts;
+    // Rows are applied to `m_index` as they arrive, so a step costs
+    // O(k log n) for k changed rows rather than a rebuild of the view.
+    // Both are built lazily after a window-first sort.
+    mutable t_mstree m_index;
+
+    // map primary keys to `m_index` node ids
+    mutable tsl::hopscotch_map<t_tscalar, t_uindex> m_pkeyidx;
 
-    // map primary keys to row indices
-    tsl::hopscotch_map<t_tscalar, t_uindex> m_pkeyidx;
+    // After sorting a large view, rows are only ordered as far as reads
+    // have needed: `m_lazy_segments` maps the start of each segment of
+    // `m_lazy_elems` to whether it is sorted, and every element of a
+    // segment orders after every element of the segments before it.
+    mutable bool m_lazy;
+    mutable std::vector<t_mselem> m_lazy_elems;
+    mutable std::map<t_uindex, bool> m_lazy_segments;
 
-    // map primary keys to sort items
-    tsl::hopscotch_map<t_tscalar, t_mselem> m_new_elems;
+    // For top-N views, `m_index` is a pool of the best rows and
+    // `m_members` holds every row of the view, in or out of the pool.
+    t_index m_top_n;
+    tsl::hopscotch_set<t_tscalar> m_members;
 
     std::vector<t_sortspec> m_sortby;
-    std::shared_ptr<std::vector<t_mselem>> m_index;
+    std::vector<t_sorttype> m_sort_orders;
     t_symtable m_symtable;
 };
 
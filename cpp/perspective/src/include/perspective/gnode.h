@@ -248,6 +248,17 @@ protected:
     template <typename CTX_T>
     void set_ctx_state(void* ptr);
 
+    /**
+     * @brief Index the master table columns that the registered `t_ctx*`
+     * filters on, so that its filter and every later one on them can read
+     * the index instead of scanning the column.
+     *
+     * @tparam CTX_T
+     * @param ptr
+     */
+    template <typename CTX_T>
+    void index_filtered_columns(void* ptr);
+
     bool have_context(const std::string& name) const;
     void notify_contexts(std::shared_ptr<t_data_table> flattened);
 
@@ -321,6 +332,62 @@ protected:
     void _compute_expressions(std::shared_ptr<t_data_table> master,
         std::shared_ptr<t_data_table> flattened);
 
+    /**
+     * @brief Compute the expressions of each registered context, sharing
+     * the columns of identical expressions between contexts.
+     */
+    void _compute_expressions(t_expression_cache& expression_cache);
+
+    /******************************************************************************
+     *
+     * Shared Trees
+     *
+     * One-sided contexts with the same tree signature (see
+     * `t_config::get_tree_signature`) read from one `t_stree`, built for
+     * the union of their aggregates. The first such context in
+     * registration order updates the tree, and the others only update their
+     * own traversal and sort from it.
+     */
+
+    /**
+     * @brief Returns a registered one-sided context, other than `ctx`, whose
+     * tree `ctx` can share, or `nullptr` if there is none. The aggregates a
+     * tree shared by both needs are written to `out_aggregates`.
+     *
+     * @param ctx
+     * @param out_aggregates
+     * @return t_ctx1*
+     */
+    t_ctx1* _find_tree_owner(
+        const t_ctx1* ctx, std::vector<t_aggspec>& out_aggregates) const;
+
+    /**
+     * @brief Move every one-sided context reading from `tree` onto the tree
+     * of `ctx`, keeping their expanded rows.
+     *
+     * @param tree
+     * @param ctx
+     */
+    void _move_tree_contexts(t_stree* tree, t_ctx1& ctx);
+
+    /**
+     * @brief For each context in `ctxhvec`, the index of the context that
+     * updates the tree it reads from: the first one-sided context in
+     * `ctxhvec` with the same tree, or the context itself.
+     *
+     * @param ctxhvec
+     * @return std::vector<t_index>
+     */
+    std::vector<t_index> _get_tree_owners(
+        const std::vector<t_ctx_handle>& ctxhvec) const;
+
+    /**
+     * @brief Move each one-sided context that can no longer share its tree
+     * (because it enabled deltas or alerts) onto a tree of its own, filled
+     * from the current state. Called before the state is updated.
+     */
+    void _unshare_context_trees();
+
 private:
     /**
      * @brief Process the input data table by flattening it, calculating
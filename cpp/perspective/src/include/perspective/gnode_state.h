@@ -11,12 +11,14 @@
 
 #include <perspective/first.h>
 #include <perspective/base.h>
+#include <perspective/bitmap_index.h>
 #include <perspective/data_table.h>
 #include <tsl/hopscotch_map.h>
 #include <tsl/hopscotch_set.h>
 #include <perspective/mask.h>
 #include <perspective/sym_table.h>
 #include <perspective/rlookup.h>
+#include <set>
 
 namespace perspective {
 
@@ -61,6 +63,17 @@ public:
      */
     t_rlookup lookup(t_tscalar pkey) const;
 
+    /**
+     * @brief Look up a batch of primary keys, so that reading many columns
+     * for the same rows probes the mapping once per row.
+     *
+     * @param pkeys
+     * @param out_rows the row index of each key, or `INVALID_INDEX` for keys
+     * that are not in the table.
+     */
+    void lookup(const std::vector<t_tscalar>& pkeys,
+        std::vector<t_uindex>& out_rows) const;
+
     /**
      * @brief If the master table has 0 rows, fill it using `flattened`.
      *
@@ -120,6 +133,33 @@ public:
         const std::vector<t_uindex>& row_indices,
         std::vector<t_tscalar>& out_data) const;
 
+    // Row-index variants of the readers above, for callers that already hold
+    // master table row indices (e.g. `t_stree` leaf membership) and can skip
+    // the primary key lookup. Numeric columns are gathered without going
+    // through `t_tscalar`.
+    void read_column(const t_data_table& table, const std::string& colname,
+        const std::vector<t_uindex>& row_indices, std::vector<double>& out_data,
+        bool include_nones) const;
+
+    // Write `row_indices` of `colname` to `out_data[0]`, `out_data[stride]`
+    // and so on, gathering by the column's type. Rows that are
+    // `INVALID_INDEX` or hold invalid values are written as none.
+    void read_column(const t_data_table& table, const std::string& colname,
+        const std::vector<t_uindex>& row_indices, t_tscalar* out_data,
+        t_uindex stride) const;
+
+    bool apply(const t_data_table& table, const std::string& colname,
+        const std::vector<t_uindex>& row_indices, t_tscalar& value,
+        std::function<bool(const t_tscalar&, t_tscalar&)> fn) const;
+
+    template <typename FN_T>
+    typename FN_T::result_type reduce(const t_data_table& table,
+        const std::string& colname, const std::vector<t_uindex>& row_indices,
+        FN_T fn) const;
+
+    bool is_unique(const t_data_table& table, const std::string& colname,
+        const std::vector<t_uindex>& row_indices, t_tscalar& value) const;
+
     // Also called extensively in contexts during aggregate calculation
 
     bool apply(const t_data_table& table, const std::string& colname,
@@ -193,6 +233,16 @@ public:
      */
     void reset();
 
+    /**
+     * @brief Index `colnames` of the master table for the equality filters
+     * of a new context. Columns that cannot be indexed are skipped, and an
+     * index dropped after outgrowing `t_bitmap_index::MAX_KEYS` is built
+     * again, as the column may have fewer distinct values by now.
+     *
+     * @param colnames
+     */
+    void index_columns(const std::vector<std::string>& colnames);
+
     // Getters
     std::shared_ptr<t_data_table> get_table() const;
     std::shared_ptr<t_data_table> get_pkeyed_table() const;
@@ -232,6 +282,21 @@ protected:
 
     void _mark_deleted(t_uindex idx);
     bool has_pkey(t_tscalar pkey) const;
+
+    /**
+     * @brief Index the columns in `m_indexed_columns` from scratch, and
+     * attach the indexes to the master table.
+     */
+    void build_bitmap_indexes();
+
+    /**
+     * @brief Re-index `rows` of the master table after an update, or every
+     * row if `rows` is null, dropping the indexes of columns that are no
+     * longer low-cardinality.
+     *
+     * @param rows
+     */
+    void update_bitmap_indexes(const std::vector<t_uindex>* rows);
     t_dtype get_pkey_dtype() const;
 
 private:
@@ -251,6 +316,12 @@ private:
     t_symtable m_symtable;
     std::shared_ptr<t_column> m_pkcol;
     std::shared_ptr<t_column> m_opcol;
+
+    // Bitmap indexes of the master table, maintained on every update so
+    // equality filters on new contexts skip the scan. Only the columns some
+    // context has filtered on are indexed.
+    std::shared_ptr<t_bitmap_index_set> m_bitmap_indexes;
+    std::set<std::string> m_indexed_columns;
 };
 
 template <typename FN_T>
@@ -262,4 +333,13 @@ t_gstate::reduce(const t_data_table& table, const std::string& colname,
     return fn(data);
 }
 
+template <typename FN_T>
+typename FN_T::result_type
+t_gstate::reduce(const t_data_table& table, const std::string& colname,
+    const std::vector<t_uindex>& row_indices, FN_T fn) const {
+    std::vector<t_tscalar> data;
+    read_column(table, colname, row_indices, data);
+    return fn(data);
+}
+
 } // end namespace perspective
@@ -13,6 +13,7 @@
 #include <perspective/exports.h>
 #include <boost/dynamic_bitset.hpp>
 #include <boost/shared_ptr.hpp>
+#include <vector>
 #include <perspective/simple_bitmask.h>
 
 namespace perspective {
@@ -28,6 +29,9 @@ public:
 
     t_mask(const t_simple_bitmask& m);
 
+    // From 64-bit words, row `i` at bit `i % 64` of word `i / 64`.
+    t_mask(const std::vector<std::uint64_t>& words, t_uindex size);
+
     ~t_mask();
 
     void clear();
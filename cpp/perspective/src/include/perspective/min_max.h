@@ -0,0 +1,85 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2017, the Perspective Authors.
+ *
+ * This file is part of the Perspective library, distributed under the terms of
+ * the Apache License 2.0.  The full license can be found in the LICENSE file.
+ *
+ */
+
+#pragma once
+#include <perspective/first.h>
+#include <perspective/base.h>
+#include <perspective/exports.h>
+#include <perspective/scalar.h>
+#include <perspective/sym_table.h>
+#include <tsl/hopscotch_map.h>
+#include <tsl/hopscotch_set.h>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace perspective {
+
+/**
+ * @brief The min and max of some columns of a view, kept up to date as rows
+ * change instead of rescanning the view.
+ *
+ * Each tracked column holds the value of every row by primary key and a
+ * counted multiset of those values, so a row that held the min or max can
+ * be removed without a scan. Contexts mark the rows an update touched with
+ * `mark_row`, and write their new values with `set_value` before reading.
+ * Invalid, none and NaN values are not tracked, as a scan skips them too.
+ */
+class PERSPECTIVE_EXPORT t_minmax_index {
+public:
+    t_minmax_index();
+
+    void clear();
+
+    bool empty() const;
+
+    bool has_column(const std::string& colname) const;
+
+    std::vector<std::string> get_columns() const;
+
+    // Start tracking `colname`, with `values[i]` the value of `pkeys[i]`.
+    void add_column(const std::string& colname,
+        const std::vector<t_tscalar>& pkeys,
+        const std::vector<t_tscalar>& values);
+
+    // Rows are only marked while at least one column is tracked.
+    void mark_row(t_tscalar pkey);
+
+    const tsl::hopscotch_set<t_tscalar>& get_marked_rows() const;
+
+    void clear_marked_rows();
+
+    // Set the value of `pkey`, or remove the row for an untracked value
+    // such as `mknone()`.
+    void set_value(
+        const std::string& colname, t_tscalar pkey, t_tscalar value);
+
+    // The smallest and largest value of a tracked column, or none for a
+    // column without values.
+    std::pair<t_tscalar, t_tscalar> get_min_max(
+        const std::string& colname) const;
+
+private:
+    struct t_column_minmax {
+        std::map<t_tscalar, t_uindex> m_counts;
+        tsl::hopscotch_map<t_tscalar, t_tscalar> m_values;
+    };
+
+    void insert_value(t_column_minmax& column, t_tscalar value);
+    void erase_value(t_column_minmax& column, const t_tscalar& value);
+
+    std::map<std::string, t_column_minmax> m_columns;
+    tsl::hopscotch_set<t_tscalar> m_marked;
+
+    // String values point into columns that may reallocate, so they are
+    // interned here.
+    t_symtable m_symtable;
+};
+
+} // end namespace perspective
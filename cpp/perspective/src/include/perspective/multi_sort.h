@@ -13,10 +13,47 @@
 #include <perspective/scalar.h>
 #include <perspective/exports.h>
 #include <perspective/comparators.h>
+#include <memory>
 #include <vector>
 
 namespace perspective {
 
+/**
+ * @brief A normalized sort key for up to `CAPACITY` sort columns.
+ *
+ * Each column is encoded as a tag byte - `(dtype, NaN/status)` - and a
+ * 64-bit word whose unsigned order matches `t_tscalar` order for that
+ * dtype; descending columns store both inverted. Two keys then compare
+ * with plain integer compares, column by column. Strings store their
+ * first 8 bytes big-endian; columns where that prefix is the whole 8
+ * bytes are marked in `m_partial` and ties on them are broken on the
+ * full row.
+ */
+struct PERSPECTIVE_EXPORT t_sortkey {
+    static const t_uindex CAPACITY = 4;
+
+    t_sortkey();
+
+    std::uint64_t m_words[CAPACITY];
+    std::uint8_t m_tags[CAPACITY];
+    std::uint8_t m_size;
+    std::uint8_t m_partial;
+    bool m_keyed;
+};
+
+// Encode `row` into `out_key`. Returns false, leaving `out_key` unkeyed,
+// if `sort_order` has more than `t_sortkey::CAPACITY` columns or any
+// order whose comparison is not lexicographic (abs and none).
+PERSPECTIVE_EXPORT bool encode_sort_key(const std::vector<t_tscalar>& row,
+    const std::vector<t_sorttype>& sort_order, t_sortkey& out_key);
+
+/**
+ * @brief A row of a sort, ordered by its key `m_key`. The sort row the key
+ * was encoded from is only kept, out of line in `m_row`, for the few
+ * elements whose key alone does not order them - a partial string prefix,
+ * or sort orders that cannot be keyed - so most elements are just the key,
+ * the primary key and the order.
+ */
 struct PERSPECTIVE_EXPORT t_mselem {
     t_mselem();
     t_mselem(const std::vector<t_tscalar>& row);
@@ -27,11 +64,15 @@ struct PERSPECTIVE_EXPORT t_mselem {
     t_mselem& operator=(const t_mselem& other);
     t_mselem& operator=(t_mselem&& other);
 
-    std::vector<t_tscalar> m_row;
+    // Encode `row` into `m_key`, keeping a copy of `row` in `m_row` only if
+    // the key alone does not order this element.
+    void set_row(const std::vector<t_tscalar>& row,
+        const std::vector<t_sorttype>& sort_order);
+
+    t_sortkey m_key;
     t_tscalar m_pkey;
     t_uindex m_order;
-    bool m_deleted;
-    bool m_updated;
+    std::unique_ptr<std::vector<t_tscalar>> m_row;
 };
 
 } // end namespace perspective
@@ -40,8 +81,11 @@ namespace std {
 
 inline std::ostream&
 operator<<(std::ostream& os, const perspective::t_mselem& t) {
-    os << "mse<pkey => " << t.m_pkey << " row => " << t.m_row << " deleted => "
-       << t.m_deleted << " order => " << t.m_order << ">";
+    os << "mse<pkey => " << t.m_pkey;
+    if (t.m_row) {
+        os << " row => " << *(t.m_row);
+    }
+    os << " order => " << t.m_order << ">";
     return os;
 }
 
@@ -81,12 +125,12 @@ PERSPECTIVE_EXPORT t_nancmp nan_compare(
     t_sorttype order, const t_tscalar& a, const t_tscalar& b);
 
 inline PERSPECTIVE_EXPORT bool
-cmp_mselem(const t_mselem& a, const t_mselem& b,
+cmp_mselem_row(const t_mselem& a, const t_mselem& b,
     const std::vector<t_sorttype>& sort_order) {
     typedef std::pair<double, t_tscalar> dpair;
 
-    if (a.m_row.size() != b.m_row.size()
-        || a.m_row.size() != sort_order.size()) {
+    if (!a.m_row || !b.m_row || a.m_row->size() != b.m_row->size()
+        || a.m_row->size() != sort_order.size()) {
         std::cout << "ERROR detected in MultiSort." << std::endl;
         return false;
     }
@@ -95,8 +139,8 @@ cmp_mselem(const t_mselem& a, const t_mselem& b,
     t_tscalar second_pkey = b.m_pkey;
 
     for (int idx = 0, loop_end = sort_order.size(); idx < loop_end; ++idx) {
-        const t_tscalar& first = a.m_row[idx];
-        const t_tscalar& second = b.m_row[idx];
+        const t_tscalar& first = (*a.m_row)[idx];
+        const t_tscalar& second = (*b.m_row)[idx];
 
         t_sorttype order = sort_order[idx];
 
@@ -152,6 +196,39 @@ cmp_mselem(const t_mselem& a, const t_mselem& b,
     return first_pkey < second_pkey;
 }
 
+inline PERSPECTIVE_EXPORT bool
+cmp_mselem(const t_mselem& a, const t_mselem& b,
+    const std::vector<t_sorttype>& sort_order) {
+    const t_sortkey& akey = a.m_key;
+    const t_sortkey& bkey = b.m_key;
+
+    if (!akey.m_keyed || !bkey.m_keyed || akey.m_size != bkey.m_size) {
+        return cmp_mselem_row(a, b, sort_order);
+    }
+
+    for (t_uindex idx = 0; idx < akey.m_size; ++idx) {
+        if (akey.m_tags[idx] != bkey.m_tags[idx]) {
+            return akey.m_tags[idx] < bkey.m_tags[idx];
+        }
+
+        if (akey.m_words[idx] != bkey.m_words[idx]) {
+            return akey.m_words[idx] < bkey.m_words[idx];
+        }
+
+        // Equal words on a partial column are 8-byte string prefixes,
+        // which are partial on both sides, so both still have `m_row`.
+        if (akey.m_partial & (1 << idx)) {
+            return cmp_mselem_row(a, b, sort_order);
+        }
+    }
+
+    if (a.m_order != b.m_order) {
+        return a.m_order < b.m_order;
+    }
+
+    return a.m_pkey < b.m_pkey;
+}
+
 inline PERSPECTIVE_EXPORT bool
 cmp_mselem(const t_mselem* a, const t_mselem* b,
     const std::vector<t_sorttype>& sort_order) {
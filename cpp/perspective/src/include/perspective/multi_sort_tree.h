@@ -0,0 +1,73 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2017, the Perspective Authors.
+ *
+ * This file is part of the Perspective library, distributed under the terms of
+ * the Apache License 2.0.  The full license can be found in the LICENSE file.
+ *
+ */
+
+#pragma once
+#include <perspective/first.h>
+#include <perspective/base.h>
+#include <perspective/exports.h>
+#include <perspective/multi_sort.h>
+#include <perspective/treap.h>
+#include <vector>
+
+namespace perspective {
+
+/**
+ * @brief An order-statistic tree of `t_mselem`, ordered by `t_multisorter`.
+ *
+ * A `t_treap` kept in sort order, so inserting, erasing, finding the row at
+ * a rank and finding the rank of a node are all O(log n) expected, without
+ * renumbering the rows after the change.
+ *
+ * Nodes live in one vector and are addressed by node id; an id stays
+ * valid until the node is erased, after which it is recycled.
+ */
+class PERSPECTIVE_EXPORT t_mstree {
+public:
+    t_mstree();
+
+    void set_sort_orders(const std::vector<t_sorttype>& sort_orders);
+
+    void clear();
+
+    t_uindex size() const;
+
+    // Replace the contents with `elems`, which must already be sorted.
+    void build(std::vector<t_mselem>& elems);
+
+    // Returns the id of the new node.
+    t_uindex insert(const t_mselem& elem);
+
+    void erase(t_uindex nidx);
+
+    const t_mselem& get(t_uindex nidx) const;
+
+    // Node id of the row at `rank`.
+    t_uindex at(t_uindex rank) const;
+
+    t_uindex rank(t_uindex nidx) const;
+
+    // Node id of the following row, or INVALID_INDEX past the last row.
+    t_uindex next(t_uindex nidx) const;
+
+    // Rank of the first row not ordered before `elem`.
+    t_uindex lower_bound(const t_mselem& elem) const;
+
+    bool less(const t_mselem& a, const t_mselem& b) const;
+
+private:
+    t_uindex alloc(const t_mselem& elem);
+
+    t_treap m_treap;
+
+    // Indexed by node id.
+    std::vector<t_mselem> m_elems;
+    t_multisorter m_sorter;
+};
+
+} // end namespace perspective
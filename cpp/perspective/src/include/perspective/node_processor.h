@@ -18,28 +18,35 @@
 #include <perspective/node_processor_types.h>
 #include <perspective/partition.h>
 #include <perspective/mask.h>
+#include <perspective/parallel_for.h>
 #include <csignal>
 #include <cmath>
-#include <map>
 
 namespace perspective {
 
 template <int DTYPE_T>
 struct t_pivot_processor {
-    typedef t_chunk_value_span<t_tscalar> t_spans;
+    typedef t_chunk_value_span<typename t_partition_traits<DTYPE_T>::t_value>
+        t_spans;
     typedef std::vector<t_spans> t_spanvec;
-    typedef std::vector<t_spanvec> t_spanvvec;
-    typedef std::map<t_tscalar, t_uindex, t_comparator<t_tscalar, DTYPE_T>>
-        t_map;
 
-    // For now we dont do any inter node
-    // parallelism. this should be trivial
-    // to fix in the future.
+    // Parent nodes are pivoted in tasks of roughly this many leaves; a
+    // level with fewer leaves is pivoted on the calling thread.
+    static const t_uindex PARALLEL_CHUNK_LEAVES = 16384;
+
+    // Pivots the parents in `[nbidx, neidx)` on `data`, appending their
+    // children to `nodes` and the children's values to `values`. Parents
+    // own disjoint ranges of `leaves` and are partitioned in place, so they
+    // are pivoted in parallel; children are appended in parent order
+    // afterwards, which gives the same layout as pivoting one by one.
     t_uindex operator()(const t_column* data, std::vector<t_dense_tnode>* nodes,
         t_column* values, t_column* leaves, t_uindex nbidx, t_uindex neidx,
         const t_mask* mask);
 };
 
+template <int DTYPE_T>
+const t_uindex t_pivot_processor<DTYPE_T>::PARALLEL_CHUNK_LEAVES;
+
 template <int DTYPE_T>
 t_uindex
 t_pivot_processor<DTYPE_T>::operator()(const t_column* data,
@@ -47,87 +54,76 @@ t_pivot_processor<DTYPE_T>::operator()(const t_column* data,
 
     t_column* leaves, t_uindex nbidx, t_uindex neidx, const t_mask* mask) {
 
-    t_lstore lcopy(leaves->data_lstore(), t_lstore_tmp_init_tag());
-
-    // add accessor api and move these to that
-    t_uindex* leaves_ptr = leaves->get_nth<t_uindex>(0);
-    t_uindex* lcopy_ptr = lcopy.get_nth<t_uindex>(0);
-    t_uindex lvl_nidx = neidx;
-    t_uindex offset = 0;
+    // Split the level into runs of parents with about
+    // `PARALLEL_CHUNK_LEAVES` leaves each.
+    std::vector<t_uindex> chunk_ends;
+    t_uindex chunk_leaves = 0;
 
     for (t_uindex nidx = nbidx; nidx < neidx; ++nidx) {
-        t_dense_tnode* pnode = &nodes->at(nidx);
-        t_uindex cbidx = pnode->m_flidx;
-        t_uindex ceidx = pnode->m_flidx + pnode->m_nleaves;
-        t_uindex parent_idx = pnode->m_idx;
-        t_spanvvec spanvec;
-        {
-            t_spanvec spans;
-            partition(data, leaves, cbidx, ceidx, spans);
-            spanvec.push_back(spans);
+        chunk_leaves += (*nodes)[nidx].m_nleaves;
+
+        if (chunk_leaves >= PARALLEL_CHUNK_LEAVES || nidx + 1 == neidx) {
+            chunk_ends.push_back(nidx + 1);
+            chunk_leaves = 0;
         }
+    }
 
-        // map value to number of rows with value
-        t_map globcount((t_comparator<t_tscalar, DTYPE_T>()));
-
-        for (t_index idx = 0, loop_end = spanvec.size(); idx < loop_end;
-             ++idx) {
-            const t_spanvec& sp = spanvec[idx];
-            for (t_uindex spidx = 0, sp_loop_end = sp.size();
-                 spidx < sp_loop_end; ++spidx) {
-                const t_spans& vsp = sp[spidx];
-                auto miter = globcount.find(vsp.m_value);
-                if (miter == globcount.end()) {
-                    globcount[vsp.m_value] = vsp.m_eidx - vsp.m_bidx;
-                } else {
-                    miter->second = miter->second + vsp.m_eidx - vsp.m_bidx;
-                }
-            }
+    // Children of every parent in a chunk, back to back, and the number of
+    // children of each parent.
+    std::vector<t_spanvec> chunk_spans(chunk_ends.size());
+    std::vector<t_uindex> nchildren(neidx - nbidx);
+
+    auto pivot_chunk = [&](int cidx) {
+        t_uindex cbidx = cidx == 0 ? nbidx : chunk_ends[cidx - 1];
+        t_uindex ceidx = chunk_ends[cidx];
+        t_spanvec& spans = chunk_spans[cidx];
+
+        for (t_uindex nidx = cbidx; nidx < ceidx; ++nidx) {
+            const t_dense_tnode& pnode = (*nodes)[nidx];
+            t_uindex nspans = spans.size();
+            partition<DTYPE_T>(data, leaves, pnode.m_flidx,
+                pnode.m_flidx + pnode.m_nleaves, spans);
+            nchildren[nidx - nbidx] = spans.size() - nspans;
         }
+    };
 
-        // map value to leaf offset
-        t_map globcursor((t_comparator<t_tscalar, DTYPE_T>()));
+    if (chunk_ends.size() > 1) {
+        parallel_for(int(chunk_ends.size()), pivot_chunk);
+    } else if (!chunk_ends.empty()) {
+        pivot_chunk(0);
+    }
 
-        for (typename t_map::const_iterator miter = globcount.begin(),
-                                            loop_end = globcount.end();
-             miter != loop_end; ++miter) {
-            globcursor[miter->first] = offset;
-            offset += miter->second;
-        }
+    // Children are appended serially, as they are numbered in parent order.
+    const t_uindex* leaves_ptr = leaves->get_nth<t_uindex>(0);
+    t_uindex lvl_nidx = neidx;
 
-        auto running_cursor = globcursor;
-        for (t_index idx = 0, loop_end = spanvec.size(); idx < loop_end;
-             ++idx) {
-            const t_spanvec& sp = spanvec[idx];
-            for (t_index spidx = 0, sp_loop_end = sp.size();
-                 spidx < sp_loop_end; ++spidx) {
-                const auto& cvs = sp[spidx];
-                t_uindex voff = running_cursor[cvs.m_value];
-                memcpy(lcopy_ptr + voff, leaves_ptr + cvs.m_bidx,
-                    sizeof(t_uindex) * (cvs.m_eidx - cvs.m_bidx));
-
-                running_cursor[cvs.m_value] = voff + cvs.m_eidx - cvs.m_bidx;
+    for (t_uindex cidx = 0, nchunks = chunk_ends.size(); cidx < nchunks;
+         ++cidx) {
+        t_uindex cbidx = cidx == 0 ? nbidx : chunk_ends[cidx - 1];
+        auto span = chunk_spans[cidx].cbegin();
+
+        for (t_uindex nidx = cbidx; nidx < chunk_ends[cidx]; ++nidx) {
+            t_dense_tnode* pnode = &nodes->at(nidx);
+            t_uindex parent_idx = pnode->m_idx;
+            t_uindex nchild = nchildren[nidx - nbidx];
+
+            // Update current node
+            pnode->m_fcidx = lvl_nidx;
+            pnode->m_nchild = nchild;
+
+            for (t_uindex chidx = 0; chidx < nchild; ++chidx, ++span) {
+                nodes->push_back({lvl_nidx, parent_idx, 0, 0, span->m_bidx,
+                    span->m_eidx - span->m_bidx});
+                lvl_nidx += 1;
+
+                // Spans hold raw keys; read the value as a scalar from the
+                // first leaf of the run.
+                values->push_back<t_tscalar>(
+                    data->get_scalar(leaves_ptr[span->m_bidx]));
             }
         }
-
-        // Update current node
-        pnode->m_fcidx = lvl_nidx;
-        pnode->m_nchild = globcount.size();
-
-        for (typename t_map::const_iterator miter = globcursor.begin(),
-                                            loop_end = globcursor.end();
-             miter != loop_end; ++miter) {
-            nodes->push_back({lvl_nidx, parent_idx, 0, 0, miter->second,
-                globcount[miter->first]});
-            lvl_nidx += 1;
-            values->push_back<t_tscalar>(miter->first);
-        }
     }
 
-    t_lstore* llstore = leaves->_get_data_lstore();
-
-    memcpy(leaves_ptr, lcopy_ptr, llstore->size());
-
     return lvl_nidx;
 }
 
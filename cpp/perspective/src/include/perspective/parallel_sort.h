@@ -0,0 +1,117 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2017, the Perspective Authors.
+ *
+ * This file is part of the Perspective library, distributed under the terms of
+ * the Apache License 2.0.  The full license can be found in the LICENSE file.
+ *
+ */
+
+#pragma once
+#include <perspective/first.h>
+#include <perspective/base.h>
+#include <perspective/parallel_for.h>
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+namespace perspective {
+
+// Vectors up to this size are sorted with `std::sort`; larger ones are
+// split into chunks of this size for `parallel_sort`.
+const t_uindex PARALLEL_SORT_CHUNK = 65536;
+
+/**
+ * @brief Find how many of the first `k` elements of the stable merge of
+ * `[a, a + na)` and `[b, b + nb)` come from `a`.
+ */
+template <typename T, typename COMPARE>
+t_uindex
+merge_corank(t_uindex k, const T* a, t_uindex na, const T* b, t_uindex nb,
+    const COMPARE& cmp) {
+    t_uindex lo = k > nb ? k - nb : 0;
+    t_uindex hi = std::min(k, na);
+
+    while (true) {
+        t_uindex i = lo + (hi - lo) / 2;
+        t_uindex j = k - i;
+
+        if (i > 0 && j < nb && cmp(b[j], a[i - 1])) {
+            hi = i - 1;
+        } else if (j > 0 && i < na && !cmp(b[j - 1], a[i])) {
+            lo = i + 1;
+        } else {
+            return i;
+        }
+    }
+}
+
+/**
+ * @brief Sort `data` with a parallel merge sort.
+ *
+ * Chunks of `PARALLEL_SORT_CHUNK` elements are sorted independently, then
+ * merged pairwise; every merge round is split into chunk-sized output
+ * ranges by co-rank so all rounds stay parallel. Chunk boundaries depend
+ * only on `data.size()` and every merge is stable, so the output does not
+ * depend on the number of threads, even for comparators with ties.
+ */
+template <typename T, typename COMPARE>
+void
+parallel_sort(std::vector<T>& data, const COMPARE& cmp) {
+    t_uindex size = data.size();
+
+    if (size <= PARALLEL_SORT_CHUNK) {
+        std::sort(data.begin(), data.end(), cmp);
+        return;
+    }
+
+    t_uindex nchunks = (size + PARALLEL_SORT_CHUNK - 1) / PARALLEL_SORT_CHUNK;
+
+    parallel_for(int(nchunks), [&data, &cmp, size](int cidx) {
+        t_uindex bidx = cidx * PARALLEL_SORT_CHUNK;
+        t_uindex eidx = std::min(bidx + PARALLEL_SORT_CHUNK, size);
+        std::sort(data.begin() + bidx, data.begin() + eidx, cmp);
+    });
+
+    std::vector<T> buffer(size);
+    T* src = data.data();
+    T* dst = buffer.data();
+
+    for (t_uindex width = PARALLEL_SORT_CHUNK; width < size; width *= 2) {
+        parallel_for(int(nchunks), [src, dst, &cmp, size, width](int cidx) {
+            // Output range of this task, and the pair of runs it lies in.
+            t_uindex kbidx = cidx * PARALLEL_SORT_CHUNK;
+            t_uindex keidx = std::min(kbidx + PARALLEL_SORT_CHUNK, size);
+            t_uindex abidx = kbidx - kbidx % (2 * width);
+            t_uindex na = std::min(width, size - abidx);
+            t_uindex nb = std::min(width, size - abidx - na);
+            const T* a = src + abidx;
+            const T* b = a + na;
+
+            t_uindex ibidx
+                = merge_corank(kbidx - abidx, a, na, b, nb, cmp);
+            t_uindex ieidx
+                = merge_corank(keidx - abidx, a, na, b, nb, cmp);
+            t_uindex jbidx = kbidx - abidx - ibidx;
+            t_uindex jeidx = keidx - abidx - ieidx;
+
+            std::merge(std::make_move_iterator(src + abidx + ibidx),
+                std::make_move_iterator(src + abidx + ieidx),
+                std::make_move_iterator(src + abidx + na + jbidx),
+                std::make_move_iterator(src + abidx + na + jeidx),
+                dst + kbidx, cmp);
+        });
+
+        std::swap(src, dst);
+    }
+
+    if (src != data.data()) {
+        parallel_for(int(nchunks), [src, &data, size](int cidx) {
+            t_uindex bidx = cidx * PARALLEL_SORT_CHUNK;
+            t_uindex eidx = std::min(bidx + PARALLEL_SORT_CHUNK, size);
+            std::move(src + bidx, src + eidx, data.begin() + bidx);
+        });
+    }
+}
+
+} // end namespace perspective
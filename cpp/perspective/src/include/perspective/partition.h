@@ -13,121 +13,338 @@
 #include <perspective/raw_types.h>
 #include <perspective/column.h>
 #include <perspective/node_processor_types.h>
+#include <tsl/hopscotch_map.h>
 #include <vector>
 #include <algorithm>
+#include <cstring>
+#include <type_traits>
 
-/*
-TODO improvements
+namespace perspective {
 
-1. Remove allocations in partition using one of the
-following
-approaches
+// Raw storage type of the values `partition<DTYPE_T>` splits leaves on.
+// String columns are split on their vocab indices.
+template <int DTYPE_T>
+struct t_partition_traits;
 
-    a. Direct mapping tid offset into global buffer
-    b. TLS
-    c. ...?
-*/
+#define PSP_PARTITION_TRAITS(DTYPE, TYPE)                                      \
+    template <>                                                                \
+    struct t_partition_traits<DTYPE> {                                         \
+        typedef TYPE t_value;                                                  \
+    };
 
-namespace perspective {
+PSP_PARTITION_TRAITS(DTYPE_INT64, std::int64_t)
+PSP_PARTITION_TRAITS(DTYPE_INT32, std::int32_t)
+PSP_PARTITION_TRAITS(DTYPE_INT16, std::int16_t)
+PSP_PARTITION_TRAITS(DTYPE_INT8, std::int8_t)
+PSP_PARTITION_TRAITS(DTYPE_UINT64, std::uint64_t)
+PSP_PARTITION_TRAITS(DTYPE_UINT32, std::uint32_t)
+PSP_PARTITION_TRAITS(DTYPE_UINT16, std::uint16_t)
+PSP_PARTITION_TRAITS(DTYPE_UINT8, std::uint8_t)
+PSP_PARTITION_TRAITS(DTYPE_FLOAT64, double)
+PSP_PARTITION_TRAITS(DTYPE_FLOAT32, float)
+PSP_PARTITION_TRAITS(DTYPE_BOOL, bool)
+PSP_PARTITION_TRAITS(DTYPE_STR, t_uindex)
 
-template <typename DATA_T>
-struct t_argsort_cmp {
-    t_argsort_cmp(const DATA_T* base)
-        : m_base(base) {}
+#undef PSP_PARTITION_TRAITS
+
+/**
+ * @brief Orders `(status, value)` keys the same way `t_tscalar::operator<`
+ * orders the scalars `t_column::get_scalar` reads for them: by status, then
+ * by value.
+ */
+template <int DTYPE_T>
+struct t_partition_cmp {
+    typedef typename t_partition_traits<DTYPE_T>::t_value t_value;
+
+    t_partition_cmp(const t_column* data) {}
 
     inline bool
-    operator()(t_uindex a, t_uindex b) {
-        return (*(m_base + a)) < (*(m_base + b));
+    operator()(t_status s1, t_value v1, t_status s2, t_value v2) const {
+        return s1 != s2 ? s1 < s2 : v1 < v2;
     }
+};
+
+template <>
+struct t_partition_cmp<DTYPE_STR> {
+    t_partition_cmp(const t_column* data)
+        : m_data(data) {}
+
+    inline bool
+    operator()(t_status s1, t_uindex v1, t_status s2, t_uindex v2) const {
+        if (s1 != s2) {
+            return s1 < s2;
+        }
 
-    const DATA_T* m_base;
+        return v1 != v2
+            && std::strcmp(m_data->unintern_c(v1), m_data->unintern_c(v2)) < 0;
+    }
+
+    const t_column* m_data;
+};
+
+/**
+ * @brief Buffers reused by every `partition` call on a thread, so that
+ * pivoting a level with many small parents does not allocate per parent.
+ */
+template <typename DATA_T>
+struct t_partition_scratch {
+    // Key of each leaf being partitioned.
+    std::vector<DATA_T> m_values;
+    std::vector<t_status> m_status;
+
+    // Run (slot) of each leaf, the first leaf of each slot, and the slots
+    // in key order.
+    std::vector<t_uindex> m_slots;
+    std::vector<t_uindex> m_slot_first;
+    std::vector<t_uindex> m_slot_order;
+    std::vector<t_uindex> m_slot_offset;
+
+    // Key to slot lookups for counting sorts.
+    std::vector<t_uindex> m_table;
+    tsl::hopscotch_map<t_uindex, t_uindex> m_slot_map;
+
+    // Argsort order, and leaves in their partitioned order.
+    std::vector<t_uindex> m_order;
+    std::vector<t_uindex> m_leaves;
 };
 
+template <typename DATA_T>
+inline t_partition_scratch<DATA_T>&
+get_partition_scratch() {
+    static thread_local t_partition_scratch<DATA_T> scratch;
+    return scratch;
+}
+
+// Keys are counting-sorted through a table when their range (per status)
+// is below this many times the number of leaves.
+const t_uindex PARTITION_DENSE_TABLE_RATIO = 2;
+
+/**
+ * @brief Second half of a counting sort: given the slot of each leaf and
+ * the slots in key order, append one span per slot to `out_spans` and
+ * scatter the leaves into their slot's run, keeping their relative order.
+ */
 template <typename DATA_T>
 inline void
-argsort(const DATA_T* b, std::vector<t_uindex>& output) {
-    // Output should be the same size is erange-brange
-    for (t_index i = 0, loop_end = output.size(); i != loop_end; ++i) {
-        output[i] = i;
+scatter_partition_slots(t_uindex* PSP_RESTRICT leaves, t_uindex bidx,
+    t_uindex nelems, t_partition_scratch<DATA_T>& scratch,
+    std::vector<t_chunk_value_span<DATA_T>>& out_spans) {
+    const std::vector<t_uindex>& slots = scratch.m_slots;
+    std::vector<t_uindex>& offsets = scratch.m_slot_offset;
+
+    offsets.assign(scratch.m_slot_first.size(), 0);
+    for (t_uindex idx = 0; idx < nelems; ++idx) {
+        ++offsets[slots[idx]];
     }
-    t_argsort_cmp<DATA_T> cmp(const_cast<DATA_T*>(b));
-    std::sort(output.begin(), output.end(), cmp);
+
+    t_uindex offset = 0;
+    for (auto sidx : scratch.m_slot_order) {
+        t_uindex count = offsets[sidx];
+        out_spans.push_back(t_chunk_value_span<DATA_T>());
+        fill_chunk_value_span<DATA_T>(out_spans.back(),
+            scratch.m_values[scratch.m_slot_first[sidx]], bidx + offset,
+            bidx + offset + count);
+        offsets[sidx] = offset;
+        offset += count;
+    }
+
+    std::vector<t_uindex>& sorted = scratch.m_leaves;
+    sorted.resize(nelems);
+    for (t_uindex idx = 0; idx < nelems; ++idx) {
+        sorted[offsets[slots[idx]]++] = leaves[idx];
+    }
+
+    std::memcpy(leaves, sorted.data(), sizeof(t_uindex) * nelems);
 }
 
+/**
+ * @brief Sorts the leaves in `[bidx, eidx)` by the value of `data_` at each
+ * leaf, and appends one span per run of equal values to `out_spans`, in
+ * value order.
+ *
+ * Integer keys with a small range are counting-sorted through a table in
+ * key order. String keys are counting-sorted by vocab index, through a
+ * table or a hash map, and only the distinct strings are compared. Other
+ * keys are argsorted. All buffers come from per-thread scratch.
+ */
+template <int DTYPE_T>
 inline void
 partition(const t_column* PSP_RESTRICT data_, t_column* PSP_RESTRICT leaves_,
     t_uindex bidx, t_uindex eidx,
-    std::vector<t_chunk_value_span<t_tscalar>>& out_spans) {
-    t_uindex* leaves = leaves_->get_nth<t_uindex>(0);
-    typedef t_chunk_value_span<t_tscalar> t_cvs;
+    std::vector<t_chunk_value_span<
+        typename t_partition_traits<DTYPE_T>::t_value>>& out_spans) {
+    typedef typename t_partition_traits<DTYPE_T>::t_value t_value;
+    typedef t_chunk_value_span<t_value> t_cvs;
+
     t_uindex nelems = eidx - bidx;
-    switch (nelems) {
-        case 0:
-            break;
-        case 1: {
-            out_spans.push_back(t_cvs());
-            t_cvs& c = out_spans[0];
-            fill_chunk_value_span<t_tscalar>(
-                c, data_->get_scalar(leaves[bidx]), bidx, eidx);
-        } break;
-        default: {
-            std::vector<t_tscalar> buf(nelems);
-            for (t_uindex idx = 0; idx < nelems; ++idx) {
-                buf[idx] = data_->get_scalar(leaves[bidx + idx]);
-            }
 
-            std::vector<t_uindex> order(nelems);
+    if (nelems == 0) {
+        return;
+    }
+
+    t_uindex* leaves = leaves_->get_nth<t_uindex>(0) + bidx;
+    const t_value* data = data_->get_nth<t_value>(0);
+
+    if (nelems == 1) {
+        out_spans.push_back(t_cvs());
+        fill_chunk_value_span<t_value>(
+            out_spans.back(), data[leaves[0]], bidx, eidx);
+        return;
+    }
 
-            t_tscalar* buf_addr = &buf[0];
-            argsort(buf_addr, order);
-            std::vector<t_uindex> temp_leaves(nelems);
-            for (t_uindex j = 0; j < nelems; ++j) {
-                temp_leaves[j] = leaves[bidx + order[j]];
+    t_partition_scratch<t_value>& scratch = get_partition_scratch<t_value>();
+    std::vector<t_value>& values = scratch.m_values;
+    std::vector<t_status>& status = scratch.m_status;
+    const t_status* data_status
+        = data_->is_status_enabled() ? data_->get_nth_status(0) : nullptr;
+
+    values.resize(nelems);
+    status.resize(nelems);
+
+    for (t_uindex idx = 0; idx < nelems; ++idx) {
+        t_uindex row = leaves[idx];
+        values[idx] = data[row];
+        status[idx] = data_status ? data_status[row] : STATUS_VALID;
+    }
+
+    t_partition_cmp<DTYPE_T> cmp(data_);
+    const t_uindex empty = t_uindex(INVALID_INDEX);
+    std::vector<t_uindex>& slots = scratch.m_slots;
+    std::vector<t_uindex>& slot_first = scratch.m_slot_first;
+    std::vector<t_uindex>& slot_order = scratch.m_slot_order;
+    std::vector<t_uindex>& table = scratch.m_table;
+
+    if (DTYPE_T == DTYPE_STR) {
+        t_uindex vocab_size = data_->get_vlenidx();
+        bool dense = vocab_size <= PARTITION_DENSE_TABLE_RATIO * nelems;
+
+        // Slots are numbered in first-seen order, then sorted by string.
+        slots.resize(nelems);
+        slot_first.clear();
+
+        if (dense) {
+            table.assign(3 * vocab_size, empty);
+        } else {
+            scratch.m_slot_map.clear();
+        }
+
+        for (t_uindex idx = 0; idx < nelems; ++idx) {
+            t_uindex key = status[idx] * vocab_size + t_uindex(values[idx]);
+            t_uindex slot = slot_first.size();
+
+            if (dense) {
+                if (table[key] == empty) {
+                    table[key] = slot;
+                    slot_first.push_back(idx);
+                } else {
+                    slot = table[key];
+                }
+            } else {
+                auto inserted
+                    = scratch.m_slot_map.insert(std::make_pair(key, slot));
+                if (inserted.second) {
+                    slot_first.push_back(idx);
+                } else {
+                    slot = inserted.first->second;
+                }
             }
 
-            std::vector<t_tscalar> sdata(nelems);
-            std::vector<t_uindex> edges;
-            auto old_value = buf[order[0]];
+            slots[idx] = slot;
+        }
+
+        slot_order.resize(slot_first.size());
+        for (t_uindex sidx = 0, loop_end = slot_order.size(); sidx < loop_end;
+             ++sidx) {
+            slot_order[sidx] = sidx;
+        }
+
+        std::sort(slot_order.begin(), slot_order.end(),
+            [&](t_uindex a, t_uindex b) {
+                t_uindex fa = slot_first[a];
+                t_uindex fb = slot_first[b];
+                return cmp(status[fa], values[fa], status[fb], values[fb]);
+            });
+
+        scatter_partition_slots(leaves, bidx, nelems, scratch, out_spans);
+        return;
+    }
+
+    if (std::is_integral<t_value>::value) {
+        auto minmax = std::minmax_element(values.begin(), values.end());
+        t_value base = *minmax.first;
 
-            sdata[0] = old_value;
-            for (t_uindex i = 0; i < nelems; ++i) {
-                auto new_value = buf[order[i]];
-                if (old_value != new_value) {
-                    sdata[i] = new_value;
-                    edges.push_back(i);
+        // Unsigned difference, so that a full-width range cannot overflow.
+        std::uint64_t range_m1
+            = std::uint64_t(*minmax.second) - std::uint64_t(base);
+
+        if (range_m1 < PARTITION_DENSE_TABLE_RATIO * nelems) {
+            t_uindex range = t_uindex(range_m1) + 1;
+            table.assign(3 * range, empty);
+
+            slots.resize(nelems);
+            for (t_uindex idx = 0; idx < nelems; ++idx) {
+                slots[idx]
+                    = status[idx] * range + t_uindex(values[idx] - base);
+                table[slots[idx]] = 0;
+            }
+
+            // Walking the table in index order visits keys in
+            // `(status, value)` order, so slots numbered in that walk are
+            // already sorted.
+            t_uindex nslots = 0;
+            for (auto& slot : table) {
+                if (slot != empty) {
+                    slot = nslots++;
                 }
-                old_value = new_value;
             }
 
-            if (edges.empty()) {
-                out_spans.push_back(t_cvs());
-                t_cvs& c = out_spans.back();
-                fill_chunk_value_span<t_tscalar>(c, sdata[0], bidx, eidx);
-            } else {
-                t_tscalar value;
-                std::vector<t_uindex> boundaries;
-                boundaries.push_back(0);
-                boundaries.insert(boundaries.end(), edges.begin(), edges.end());
-                boundaries.push_back(order.size());
-
-                for (t_uindex i = 0, loop_end = boundaries.size() - 1;
-                     i < loop_end; ++i) {
-                    t_uindex begin = boundaries[i];
-                    t_uindex end = boundaries[i + 1];
-                    value = sdata[begin];
-                    t_uindex num_new_bytes = sizeof(t_uindex) * (end - begin);
-                    memcpy(leaves + begin + bidx, &temp_leaves[begin],
-                        num_new_bytes);
-                    out_spans.push_back(t_cvs());
-                    t_cvs& cvs = out_spans.back();
-                    fill_chunk_value_span<t_tscalar>(
-                        cvs, value, bidx + begin, bidx + end);
+            slot_first.assign(nslots, empty);
+            for (t_uindex idx = 0; idx < nelems; ++idx) {
+                slots[idx] = table[slots[idx]];
+                if (slot_first[slots[idx]] == empty) {
+                    slot_first[slots[idx]] = idx;
                 }
             }
+
+            slot_order.resize(nslots);
+            for (t_uindex sidx = 0; sidx < nslots; ++sidx) {
+                slot_order[sidx] = sidx;
+            }
+
+            scatter_partition_slots(leaves, bidx, nelems, scratch, out_spans);
+            return;
         }
+    }
+
+    // Argsort, then split into runs of keys equivalent under `cmp`.
+    std::vector<t_uindex>& order = scratch.m_order;
+    order.resize(nelems);
+    for (t_uindex idx = 0; idx < nelems; ++idx) {
+        order[idx] = idx;
+    }
+
+    auto less = [&](t_uindex a, t_uindex b) {
+        return cmp(status[a], values[a], status[b], values[b]);
+    };
+
+    std::sort(order.begin(), order.end(), less);
 
-        break;
+    std::vector<t_uindex>& sorted = scratch.m_leaves;
+    sorted.resize(nelems);
+
+    t_uindex run_begin = 0;
+    for (t_uindex idx = 0; idx < nelems; ++idx) {
+        sorted[idx] = leaves[order[idx]];
+
+        if (idx + 1 == nelems || less(order[idx], order[idx + 1])) {
+            out_spans.push_back(t_cvs());
+            fill_chunk_value_span<t_value>(out_spans.back(),
+                values[order[run_begin]], bidx + run_begin, bidx + idx + 1);
+            run_begin = idx + 1;
+        }
     }
+
+    std::memcpy(leaves, sorted.data(), sizeof(t_uindex) * nelems);
 }
 
 } // end namespace perspective
@@ -14,6 +14,7 @@
 #include <perspective/exports.h>
 #include <tsl/hopscotch_map.h>
 #include <re2/re2.h>
+#include <mutex>
 
 namespace perspective {
 
@@ -25,7 +26,8 @@ struct PERSPECTIVE_EXPORT t_regex_mapping {
     /**
      * @brief Given a regex pattern string, store it in the map if it does not
      * exist already, and return a raw pointer to the stored RE2 object which
-     * will be valid as long as the mapping is alive.
+     * will be valid as long as the mapping is alive. Safe to call from
+     * several threads at once.
      *
      * @param pattern
      * @return RE2&
@@ -37,6 +39,8 @@ struct PERSPECTIVE_EXPORT t_regex_mapping {
     // Store pointers to RE2 objects as the default copy assignment operator
     // for RE2 is disabled.
     tsl::hopscotch_map<std::string, std::shared_ptr<RE2>> m_regex_map;
+
+    std::mutex m_mutex;
 };
 
 } // end namespace perspective
@@ -0,0 +1,97 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2017, the Perspective Authors.
+ *
+ * This file is part of the Perspective library, distributed under the terms of
+ * the Apache License 2.0.  The full license can be found in the LICENSE file.
+ *
+ */
+
+#pragma once
+#include <perspective/first.h>
+#include <perspective/base.h>
+#include <perspective/exports.h>
+#include <perspective/scalar.h>
+#include <cstdint>
+#include <vector>
+
+namespace perspective {
+
+/**
+ * @brief A HyperLogLog sketch used by the `approx distinct` aggregate.
+ *
+ * The sketch has 2^HLL_PRECISION one-byte registers (4KB), which gives a
+ * relative standard error of 1.04 / sqrt(4096) ~= 1.6% on the estimated
+ * distinct count. Small cardinalities fall back to linear counting and are
+ * close to exact.
+ *
+ * Until more than HLL_SPARSE_MAX registers are set, only the set registers
+ * are kept, as a sorted list of `index << 8 | rank`, so the many small
+ * aggregate rows of a deep tree do not pay for the dense registers.
+ *
+ * Two sketches merge by taking the register-wise maximum, so a parent
+ * node's sketch is the merge of its children's sketches.
+ */
+class PERSPECTIVE_EXPORT t_hll_sketch {
+public:
+    static const std::uint32_t HLL_PRECISION = 12;
+    static const std::uint32_t HLL_NUM_REGISTERS = 1 << HLL_PRECISION;
+    static const std::uint32_t HLL_SPARSE_MAX = HLL_NUM_REGISTERS / 8;
+
+    t_hll_sketch();
+
+    void add(const t_tscalar& value);
+    void add_hash(std::uint64_t hash);
+    void merge(const t_hll_sketch& other);
+    void clear();
+
+    bool empty() const;
+    double estimate() const;
+
+private:
+    void set_register(std::uint32_t ridx, std::uint8_t rank);
+    void make_dense();
+
+    std::vector<std::uint32_t> m_sparse;
+    std::vector<std::uint8_t> m_registers;
+};
+
+/**
+ * @brief A merging t-digest used by the `approx percentile` aggregate.
+ *
+ * Centroids are bounded by the k1 scale function with a compression of
+ * TDIGEST_COMPRESSION, so the digest holds at most ~160 centroids. The rank
+ * error of a quantile estimate is below ~1% around the median and shrinks
+ * proportionally to q * (1 - q) towards the tails; the minimum and maximum
+ * are exact. Digests are mergeable, so a parent node's digest is the merge
+ * of its children's digests.
+ */
+class PERSPECTIVE_EXPORT t_tdigest {
+public:
+    static const t_uindex TDIGEST_COMPRESSION = 100;
+
+    struct t_centroid {
+        double m_mean;
+        double m_weight;
+    };
+
+    t_tdigest();
+
+    void add(double value);
+    void merge(const t_tdigest& other);
+    void clear();
+
+    bool empty() const;
+    double quantile(double q);
+
+private:
+    void compress();
+
+    std::vector<t_centroid> m_centroids;
+    std::vector<t_centroid> m_unmerged;
+    double m_total_weight;
+    double m_min;
+    double m_max;
+};
+
+} // end namespace perspective
@@ -14,13 +14,9 @@ SUPPRESS_WARNINGS_VC(4503)
 #include <perspective/first.h>
 #include <perspective/base.h>
 #include <perspective/exports.h>
-#include <boost/multi_index_container.hpp>
-#include <boost/multi_index/member.hpp>
-#include <boost/multi_index/hashed_index.hpp>
-#include <boost/multi_index/ordered_index.hpp>
-#include <boost/multi_index/composite_key.hpp>
 #include <perspective/sort_specification.h>
 #include <perspective/sparse_tree_node.h>
+#include <perspective/sparse_tree_nodes.h>
 #include <perspective/pivot.h>
 #include <perspective/aggspec.h>
 #include <perspective/step_delta.h>
@@ -28,11 +24,13 @@ SUPPRESS_WARNINGS_VC(4503)
 #include <perspective/sym_table.h>
 #include <perspective/data_table.h>
 #include <perspective/dense_tree.h>
+#include <perspective/sketch.h>
 #include <vector>
 #include <algorithm>
 #include <deque>
 #include <sstream>
 #include <queue>
+#include <mutex>
 
 namespace perspective {
 
@@ -41,26 +39,9 @@ class t_dtree_ctx;
 class t_config;
 class t_ctx2;
 
-using boost::multi_index_container;
-using namespace boost::multi_index;
-
 typedef std::pair<t_depth, t_index> t_dptipair;
 typedef std::vector<t_dptipair> t_dptipairvec;
 
-struct by_idx {};
-
-struct by_depth {};
-
-struct by_pidx {};
-
-struct by_pidx_hash {};
-
-struct by_nstrands {};
-
-struct by_idx_pkey {};
-
-struct by_idx_lfidx {};
-
 PERSPECTIVE_EXPORT t_tscalar get_dominant(std::vector<t_tscalar>& values);
 
 struct t_build_strand_table_metadata {
@@ -72,50 +53,6 @@ struct t_build_strand_table_metadata {
     t_uindex m_pivsize;
 };
 
-typedef multi_index_container<t_stnode,
-    indexed_by<ordered_unique<tag<by_idx>,
-                   BOOST_MULTI_INDEX_MEMBER(t_stnode, t_uindex, m_idx)>,
-        hashed_non_unique<tag<by_depth>,
-            BOOST_MULTI_INDEX_MEMBER(t_stnode, std::uint8_t, m_depth)>,
-        hashed_non_unique<tag<by_nstrands>,
-            BOOST_MULTI_INDEX_MEMBER(t_stnode, t_uindex, m_nstrands)>,
-        ordered_unique<tag<by_pidx>,
-            composite_key<t_stnode,
-                BOOST_MULTI_INDEX_MEMBER(t_stnode, t_uindex, m_pidx),
-                BOOST_MULTI_INDEX_MEMBER(t_stnode, t_tscalar, m_sort_value),
-                BOOST_MULTI_INDEX_MEMBER(t_stnode, t_tscalar, m_value)>>,
-        ordered_unique<tag<by_pidx_hash>,
-            composite_key<t_stnode,
-                BOOST_MULTI_INDEX_MEMBER(t_stnode, t_uindex, m_pidx),
-                BOOST_MULTI_INDEX_MEMBER(t_stnode, t_tscalar, m_value)>>>>
-    t_treenodes;
-
-typedef multi_index_container<t_stpkey,
-    indexed_by<ordered_unique<tag<by_idx_pkey>,
-        composite_key<t_stpkey,
-            BOOST_MULTI_INDEX_MEMBER(t_stpkey, t_uindex, m_idx),
-            BOOST_MULTI_INDEX_MEMBER(t_stpkey, t_tscalar, m_pkey)>>>>
-    t_idxpkey;
-
-typedef multi_index_container<t_stleaves,
-    indexed_by<ordered_unique<tag<by_idx_lfidx>,
-        composite_key<t_stleaves,
-            BOOST_MULTI_INDEX_MEMBER(t_stleaves, t_uindex, m_idx),
-            BOOST_MULTI_INDEX_MEMBER(t_stleaves, t_uindex, m_lfidx)>>>>
-    t_idxleaf;
-
-typedef t_treenodes::index<by_idx>::type index_by_idx;
-typedef t_treenodes::index<by_pidx>::type index_by_pidx;
-
-typedef t_treenodes::index<by_idx>::type::iterator iter_by_idx;
-typedef t_treenodes::index<by_pidx>::type::iterator iter_by_pidx;
-typedef t_treenodes::index<by_pidx_hash>::type::iterator iter_by_pidx_hash;
-typedef std::pair<iter_by_pidx, iter_by_pidx> t_by_pidx_ipair;
-
-typedef t_idxpkey::index<by_idx_pkey>::type::iterator iter_by_idx_pkey;
-
-typedef std::pair<iter_by_idx_pkey, iter_by_idx_pkey> t_by_idx_pkey_ipair;
-
 struct PERSPECTIVE_EXPORT t_agg_update_info {
     std::vector<const t_column*> m_src;
     std::vector<t_column*> m_dst;
@@ -136,6 +73,42 @@ struct t_tree_unify_rec {
 
 typedef std::vector<t_tree_unify_rec> t_tree_unify_rec_vec;
 
+// One unit of work of `update_aggs_from_static`: aggregate column
+// `m_colidx` for the records in `[m_begin, m_end)`.
+struct t_agg_update_task {
+    t_uindex m_colidx;
+    t_uindex m_begin;
+    t_uindex m_end;
+};
+
+// The master table rows an update added to a node, which its sketches take
+// in when `m_fold` is set instead of being built again.
+struct t_sketch_inserts {
+    t_sketch_inserts();
+
+    bool m_fold;
+    std::vector<t_uindex> m_rows;
+};
+
+// Deltas produced by a single task, merged into the tree once every task
+// has finished.
+struct t_agg_update_deltas {
+    t_agg_update_deltas();
+
+    bool m_has_delta;
+    std::vector<t_tcdelta> m_deltas;
+};
+
+// The nodes dropped and kept by the most recent shape update of a tree.
+// Every traversal over the tree replays this to stay in step with it.
+struct t_stree_step {
+    std::vector<t_uindex> m_zero_strands;
+    std::set<t_uindex> m_non_zero_ids;
+    std::set<t_uindex> m_non_zero_leaves;
+    // Every node whose aggregates were recomputed or which was dropped.
+    std::vector<t_uindex> m_updated_ids;
+};
+
 class PERSPECTIVE_EXPORT t_stree {
 public:
     typedef const t_stree* t_cptr;
@@ -146,6 +119,11 @@ public:
 
     typedef std::map<const char*, const char*, t_cmp_charptr> t_sidxmap;
 
+    // Records per task when an aggregate column is split across threads,
+    // and the smallest update worth dispatching to the thread pool.
+    static const t_uindex AGG_UPDATE_CHUNK_SIZE = 1024;
+    static const t_uindex AGG_UPDATE_PARALLEL_MIN_RECORDS = 256;
+
     t_stree(const std::vector<t_pivot>& pivots,
         const std::vector<t_aggspec>& aggspecs, const t_schema& schema,
         const t_config& cfg);
@@ -187,10 +165,15 @@ public:
     build_strand_table(const t_data_table& flattened,
         const std::vector<t_aggspec>& aggspecs, const t_config& config) const;
 
-    void update_shape_from_static(const t_dtree_ctx& ctx);
+    // `gstate` must already hold this update's rows; new primary keys are
+    // resolved to their master table rows here.
+    void update_shape_from_static(
+        const t_dtree_ctx& ctx, const t_gstate& gstate);
 
+    // With `inserts_only`, the update only added rows that are new to the
+    // table, so the sketches of existing nodes take in just those rows.
     void update_aggs_from_static(const t_dtree_ctx& ctx, const t_gstate& gstate,
-        const t_data_table& expression_master_table);
+        const t_data_table& expression_master_table, bool inserts_only);
 
     t_uindex size() const;
 
@@ -207,6 +190,9 @@ public:
     std::set<t_uindex> non_zero_ids(const std::set<t_uindex>& ptiset,
         const std::vector<t_uindex>& zero_strands) const;
 
+    std::vector<t_uindex> updated_ids(
+        const std::vector<t_uindex>& zero_strands) const;
+
     t_uindex get_parent_idx(t_uindex idx) const;
     std::vector<t_uindex> get_ancestry(t_uindex idx) const;
 
@@ -227,17 +213,28 @@ public:
 
     void drop_zero_strands();
 
-    void add_pkey(t_uindex idx, t_tscalar pkey);
+    void add_pkey(t_uindex idx, t_tscalar pkey, t_uindex row);
     void remove_pkey(t_uindex idx, t_tscalar pkey);
     void add_leaf(t_uindex nidx, t_uindex lfidx);
     void remove_leaf(t_uindex nidx, t_uindex lfidx);
 
-    t_by_idx_pkey_ipair get_pkeys_for_leaf(t_uindex idx) const;
+    const std::vector<t_tscalar>& get_pkeys_for_leaf(t_uindex idx) const;
+    const std::vector<t_uindex>& get_rows_for_leaf(t_uindex idx) const;
     t_depth get_depth(t_uindex ptidx) const;
     void get_drd_indices(
         t_uindex ridx, t_depth rel_depth, std::vector<t_uindex>& leaves) const;
     std::vector<t_uindex> get_leaves(t_uindex idx) const;
     std::vector<t_tscalar> get_pkeys(t_uindex idx) const;
+
+    // Master table rows of the primary keys under `idx`, in the same order
+    // as `get_pkeys`.
+    std::vector<t_uindex> get_rows(t_uindex idx) const;
+
+    // `get_rows` in ascending row order, for reductions that do not depend
+    // on the order of their inputs; gathers in row order touch the master
+    // table's columns sequentially.
+    std::vector<t_uindex> get_sorted_rows(t_uindex idx) const;
+
     std::vector<t_uindex> get_child_idx(t_uindex idx) const;
     std::vector<std::pair<t_index, t_index>> get_child_idx_depth(
         t_uindex idx) const;
@@ -282,10 +279,27 @@ public:
 
     void clear_aggregates(const std::vector<t_uindex>& indices);
 
-    std::pair<iter_by_idx, bool> insert_node(const t_tnode& node);
+    bool insert_node(const t_tnode& node);
+
+    // Erase `nidxs` along with their primary keys and aggregate rows. The
+    // caller passes whole subtrees.
+    void remove_nodes(const std::vector<t_uindex>& nidxs);
+
+    // Fresh node ids, and aggregate rows reusing those of removed nodes.
+    t_uindex genidx();
+    t_uindex gen_aggidx();
     bool has_deltas() const;
     void set_has_deltas(bool v);
 
+    void set_last_step(t_stree_step step);
+    const t_stree_step& get_last_step() const;
+
+    // Number of one-sided contexts reading from this tree; more than one
+    // when `t_gnode` shares it between contexts with the same signature.
+    void add_context();
+    void remove_context();
+    t_uindex get_num_contexts() const;
+
     std::vector<t_uindex> get_descendents(t_uindex nidx) const;
 
     t_uindex get_num_leaves(t_uindex depth) const;
@@ -300,14 +314,70 @@ protected:
     t_uindex get_num_aggcols() const;
 
     bool pivots_changed(t_value_transition t) const;
-    t_uindex genidx();
-    t_uindex gen_aggidx();
     std::vector<t_uindex> get_children(t_uindex idx) const;
 
-    void update_agg_table(t_uindex nidx, t_agg_update_info& info,
-        t_uindex src_ridx, t_uindex dst_ridx, t_index nstrands,
+    // Update aggregate column `colidx` of node `nidx`. Safe to call
+    // concurrently for different columns, or for different nodes of a
+    // non-string column; changes are collected in `deltas`.
+    void update_agg_table(t_uindex nidx, t_uindex colidx,
+        t_agg_update_info& info, t_uindex src_ridx, t_uindex dst_ridx,
+        t_index nstrands, const t_gstate& gstate,
+        const t_data_table& expression_master_table,
+        t_agg_update_deltas& deltas);
+
+    // Update the sketch-backed aggregate (`approx distinct`, `approx
+    // percentile`) in column `colidx` for node `nidx`. Unless `inserts`
+    // folds new rows into the existing sketch, leaves are rebuilt from their
+    // rows and every other node by merging its children's sketches, so
+    // callers must finish children before their parents.
+    void update_sketch_aggs(t_uindex nidx, t_uindex colidx,
+        t_agg_update_info& info, t_uindex dst_ridx,
+        const t_sketch_inserts& inserts, const t_gstate& gstate,
+        const t_data_table& expression_master_table,
+        t_agg_update_deltas& deltas);
+
+    // Update aggregate column `task.m_colidx` for the records in `task`
+    // with a kernel specialized on the column's dtype. Returns false, having
+    // done nothing, if the aggregate or dtype has no kernel; records a
+    // kernel cannot handle exactly are passed to `update_agg_table`.
+    bool update_agg_column(t_agg_update_info& info,
+        const std::vector<const t_tree_unify_rec*>& records,
+        const t_agg_update_task& task, const t_gstate& gstate,
+        const t_data_table& expression_master_table,
+        t_agg_update_deltas& deltas);
+
+    template <typename DATA_T>
+    bool update_agg_column_typed(t_agg_update_info& info,
+        const std::vector<const t_tree_unify_rec*>& records,
+        const t_agg_update_task& task, const t_gstate& gstate,
+        const t_data_table& expression_master_table,
+        t_agg_update_deltas& deltas);
+
+    template <typename DATA_T>
+    void record_typed_delta(t_agg_update_deltas& deltas, t_uindex nidx,
+        t_uindex colidx, DATA_T old_value, t_status old_status,
+        DATA_T new_value, t_status new_status) const;
+
+    void make_agg_update_tasks(const t_agg_update_info& info,
+        const std::vector<t_uindex>& cols, t_uindex begin, t_uindex end,
+        std::vector<t_agg_update_task>& tasks) const;
+
+    // Sketch aggregates are updated when `sketch_inserts`, which holds an
+    // entry for each of `records`, is set.
+    void run_agg_update_tasks(t_agg_update_info& info,
+        const std::vector<const t_tree_unify_rec*>& records,
+        const std::vector<t_agg_update_task>& tasks,
+        const std::vector<t_sketch_inserts>* sketch_inserts,
         const t_gstate& gstate, const t_data_table& expression_master_table);
 
+    void record_delta(t_agg_update_deltas& deltas, t_uindex nidx,
+        t_uindex colidx, const t_tscalar& old_value,
+        const t_tscalar& new_value) const;
+
+    // `m_symtable` is shared by aggregate update tasks.
+    t_tscalar intern_tscalar(const t_tscalar& s);
+    t_tscalar intern_tscalar(const char* s);
+
     bool is_leaf(t_uindex nidx) const;
 
     t_build_strand_table_metadata build_strand_table_metadata(
@@ -315,48 +385,61 @@ protected:
         const t_config& config) const;
 
     void populate_pkey_idx(const t_dtree_ctx& ctx, const t_dtree& dtree,
-        t_uindex dptidx, t_uindex sptidx, t_uindex ndepth,
-        t_idxpkey& new_idx_pkey);
+        const t_gstate& gstate, t_uindex dptidx, t_uindex sptidx,
+        t_uindex ndepth, std::vector<t_stpkey>& new_pkeys);
 
-    // Methods that use `t_gstate`'s mapping of primary keys to row indices
-    // to extract values from a data table. Because these methods can either
+    // Merge a batch of new (leaf, pkey) pairs into the per-leaf pkey
+    // vectors, sorting each leaf once rather than once per key.
+    void add_pkeys(std::vector<t_stpkey>& new_pkeys);
+
+    // Methods that extract values at master table row indices (see
+    // `get_rows`) from a data table. Because these methods can either
     // extract from the expressions table or the master table of the gnode,
     // these methods abstract away the "is_expression" check.
 
+    std::shared_ptr<const t_column> get_column_from_gstate(
+        const t_gstate& gstate, const t_data_table& expression_master_table,
+        const std::string& colname) const;
+
     void read_column_from_gstate(const t_gstate& gstate,
         const t_data_table& expression_master_table, const std::string& colname,
-        const std::vector<t_tscalar>& pkeys,
+        const std::vector<t_uindex>& rows,
         std::vector<t_tscalar>& out_data) const;
 
     void read_column_from_gstate(const t_gstate& gstate,
         const t_data_table& expression_master_table, const std::string& colname,
-        const std::vector<t_tscalar>& pkeys, std::vector<double>& out_data,
+        const std::vector<t_uindex>& rows, std::vector<double>& out_data,
         bool include_none) const;
 
-    t_tscalar read_by_pkey_from_gstate(const t_gstate& gstate,
-        const t_data_table& expression_master_table, const std::string& colname,
-        t_tscalar& pkey) const;
-
     bool is_unique_from_gstate(const t_gstate& gstate,
         const t_data_table& expression_master_table, const std::string& colname,
-        const std::vector<t_tscalar>& pkeys, t_tscalar& value) const;
+        const std::vector<t_uindex>& rows, t_tscalar& value) const;
 
     bool apply_from_gstate(const t_gstate& gstate,
         const t_data_table& expression_master_table, const std::string& colname,
-        const std::vector<t_tscalar>& pkeys, t_tscalar& value,
+        const std::vector<t_uindex>& rows, t_tscalar& value,
         std::function<bool(const t_tscalar&, t_tscalar&)> fn) const;
 
     template <typename FN_T>
     typename FN_T::result_type reduce_from_gstate(const t_gstate& gstate,
         const t_data_table& expression_master_table, const std::string& colname,
-        const std::vector<t_tscalar>& pkeys, FN_T fn) const;
+        const std::vector<t_uindex>& rows, FN_T fn) const;
 
 private:
     std::vector<t_pivot> m_pivots;
     bool m_init;
-    std::shared_ptr<t_treenodes> m_nodes;
-    std::shared_ptr<t_idxpkey> m_idxpkey;
-    std::shared_ptr<t_idxleaf> m_idxleaf;
+    std::shared_ptr<t_stnodes> m_nodes;
+
+    // Sorted primary keys of each leaf, indexed by node id, and the master
+    // table row of each of those keys. A primary key keeps its row from
+    // insertion into `t_gstate` until it is erased, and the tree adds and
+    // removes keys in the same update that `t_gstate` assigns and frees
+    // their rows, so rows are resolved once when a key joins a leaf.
+    std::vector<std::vector<t_tscalar>> m_pkeys;
+    std::vector<std::vector<t_uindex>> m_rows;
+
+    // Sorted leaf ids under each non-leaf node.
+    tsl::hopscotch_map<t_uindex, std::vector<t_uindex>> m_leaves;
     t_uindex m_curidx;
     std::shared_ptr<t_data_table> m_aggregates;
     std::vector<t_aggspec> m_aggspecs;
@@ -371,8 +454,16 @@ private:
     t_tree_unify_rec_vec m_tree_unification_records;
     std::vector<bool> m_features;
     t_symtable m_symtable;
+    std::mutex m_symtable_mutex;
     bool m_has_delta;
     std::string m_grand_agg_str;
+    t_stree_step m_last_step;
+    t_uindex m_num_contexts;
+
+    // Per-node sketches for sketch-backed aggregates, keyed by aggregate
+    // column index and indexed by the node's aggregate row.
+    std::map<t_uindex, std::vector<t_hll_sketch>> m_hll_sketches;
+    std::map<t_uindex, std::vector<t_tdigest>> m_tdigests;
 };
 
 } // end namespace perspective
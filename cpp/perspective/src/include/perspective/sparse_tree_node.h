@@ -35,19 +35,12 @@ struct PERSPECTIVE_EXPORT t_stnode {
 typedef std::vector<t_stnode> t_stnode_vec;
 
 struct PERSPECTIVE_EXPORT t_stpkey {
-    t_stpkey(t_uindex idx, t_tscalar pkey);
+    t_stpkey(t_uindex idx, t_tscalar pkey, t_uindex row);
     t_stpkey();
 
     t_uindex m_idx;
     t_tscalar m_pkey;
-};
-
-struct PERSPECTIVE_EXPORT t_stleaves {
-    t_stleaves(t_uindex idx, t_uindex lfidx);
-    t_stleaves();
-
-    t_uindex m_idx;
-    t_uindex m_lfidx;
+    t_uindex m_row;
 };
 
 // Used in t_ctx2 for mapping back into
@@ -0,0 +1,116 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2017, the Perspective Authors.
+ *
+ * This file is part of the Perspective library, distributed under the terms of
+ * the Apache License 2.0.  The full license can be found in the LICENSE file.
+ *
+ */
+
+#pragma once
+#include <perspective/first.h>
+#include <perspective/base.h>
+#include <perspective/exports.h>
+#include <perspective/scalar.h>
+#include <perspective/sparse_tree_node.h>
+#include <tsl/hopscotch_map.h>
+#include <tsl/hopscotch_set.h>
+#include <vector>
+
+namespace perspective {
+
+/**
+ * @brief The children of a single `t_stree` node.
+ *
+ * Child ids are kept in one contiguous vector ordered by
+ * `(sort_value, value)`, which is the order contexts traverse them in.
+ * Parents with more than `SMALL_CHILD_COUNT` children also get a hash index
+ * from value to child id so that `resolve_child` stays O(1) for wide
+ * pivots; smaller parents are scanned linearly.
+ */
+struct PERSPECTIVE_EXPORT t_stchildren {
+    t_stchildren();
+
+    std::vector<t_uindex> m_children;
+    tsl::hopscotch_map<t_tscalar, t_uindex> m_index;
+    bool m_sorted;
+};
+
+/**
+ * @brief Node storage for `t_stree`.
+ *
+ * Node fields live in parallel arrays indexed by node id, so reading one
+ * field across many nodes touches contiguous memory and a node costs
+ * ~70 bytes instead of a multi-index entry with five tree/hash links.
+ * Node ids are never reused, so erased ids leave holes marked dead in
+ * `m_live`.
+ *
+ * Inserts and sort value changes only append to / mark the parent's child
+ * range; ranges are re-sorted once in `sort_children`, or lazily on the
+ * next read of that range.
+ */
+class PERSPECTIVE_EXPORT t_stnodes {
+public:
+    static const t_uindex SMALL_CHILD_COUNT = 16;
+    static const t_uindex NO_CHILD = static_cast<t_uindex>(INVALID_INDEX);
+
+    t_stnodes();
+
+    // Returns false (and does nothing) if `node.m_idx` is already in use or
+    // its parent already has a child with the same value.
+    bool insert(const t_stnode& node);
+
+    // Erases a batch of nodes. Nodes whose parents are also erased are
+    // handled in the same pass.
+    void erase(const std::vector<t_uindex>& nodes);
+
+    void clear();
+
+    bool contains(t_uindex idx) const;
+    t_uindex size() const;
+
+    t_stnode get(t_uindex idx) const;
+
+    t_uindex get_pidx(t_uindex idx) const;
+    t_depth get_depth(t_uindex idx) const;
+    const t_tscalar& get_value(t_uindex idx) const;
+    const t_tscalar& get_sort_value(t_uindex idx) const;
+    t_uindex get_nstrands(t_uindex idx) const;
+    t_uindex get_aggidx(t_uindex idx) const;
+
+    void set_nstrands(t_uindex idx, t_index nstrands);
+    void set_sort_value(t_uindex idx, const t_tscalar& sort_value);
+
+    // Children of `idx` ordered by `(sort_value, value)`.
+    const std::vector<t_uindex>& get_children(t_uindex idx) const;
+    t_uindex get_num_children(t_uindex idx) const;
+
+    // The child of `pidx` with value `value`, or `NO_CHILD`.
+    t_uindex find_child(t_uindex pidx, const t_tscalar& value) const;
+
+    std::vector<t_uindex> zero_strands() const;
+
+    // Re-sort every child range invalidated since the last call.
+    void sort_children();
+
+private:
+    void sort_children(t_stchildren& children) const;
+    void check_idx(t_uindex idx) const;
+
+    std::vector<t_uindex> m_pidx;
+    std::vector<std::uint8_t> m_depth;
+    std::vector<t_tscalar> m_value;
+    std::vector<t_tscalar> m_sort_value;
+    std::vector<t_uindex> m_nstrands;
+    std::vector<t_uindex> m_aggidx;
+    std::vector<bool> m_live;
+    t_uindex m_size;
+
+    // Keyed by parent id; leaves have no entry. Child ranges are sorted
+    // lazily from const readers, hence `mutable`.
+    mutable tsl::hopscotch_map<t_uindex, t_stchildren> m_children;
+    mutable tsl::hopscotch_set<t_uindex> m_unsorted;
+    tsl::hopscotch_set<t_uindex> m_zero_strands;
+};
+
+} // end namespace perspective
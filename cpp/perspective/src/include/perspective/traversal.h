@@ -15,6 +15,7 @@
 #include <perspective/exports.h>
 #include <perspective/multi_sort.h>
 #include <perspective/traversal_nodes.h>
+#include <perspective/traversal_tree.h>
 #include <perspective/sort_specification.h>
 #include <perspective/sparse_tree_node.h>
 #include <perspective/sparse_tree.h>
@@ -41,13 +42,23 @@ public:
 
     t_index collapse_node(t_index idx);
 
+    // Make the children of the row for tree node `p_ptidx` exactly
+    // `c_ptidxs`, in that order, expanding the row if needed. Rows kept keep
+    // their expansion; the tree node ids of rows inserted or removed are
+    // appended to `changed`. Returns the net number of rows added.
+    t_index set_children(t_index p_ptidx, const std::vector<t_uindex>& c_ptidxs,
+        std::vector<t_uindex>& changed);
+
     void add_node(const std::vector<t_sortspec>& sortby,
         const std::vector<t_uindex>& indices, t_index insert_level_idx,
         t_ctx2* ctx2 = nullptr);
 
-    t_index update_ancestors(t_index nidx, t_index n_changed);
-
-    t_index update_sucessors(t_index nidx, t_index n_changed);
+    // Like `add_node`, but the new row goes in at its position under
+    // `sortby` among its siblings rather than at its position in the tree.
+    template <typename SRC_T>
+    void add_sorted_node(const std::vector<t_sortspec>& sortby,
+        const std::vector<t_uindex>& indices, t_index insert_level_idx,
+        const SRC_T& src, t_ctx2* ctx2 = nullptr);
 
     t_index get_tree_index(t_index idx) const;
 
@@ -78,6 +89,14 @@ public:
     void sort_by(const t_config& config, const std::vector<t_sortspec>& sortby,
         const SRC_T& src, t_ctx2* ctx2 = nullptr);
 
+    // Re-sort the children of each expanded row whose tree index is in
+    // `ptidxs`, moving each child with its expanded descendants. Rows
+    // outside those children keep their positions.
+    template <typename SRC_T>
+    void sort_children(const std::vector<t_sortspec>& sortby,
+        const SRC_T& src, const std::vector<t_uindex>& ptidxs,
+        t_ctx2* ctx2 = nullptr);
+
     void get_child_indices(
         t_index nidx, std::vector<std::pair<t_index, t_index>>& out_data) const;
 
@@ -113,8 +132,35 @@ public:
     void populate_root_children(std::shared_ptr<const t_stree> tree);
 
 private:
+    // Add `n_changed` to the descendant count of every ancestor of the node
+    // with id `nid`.
+    void update_ancestors(t_uindex nid, t_index n_changed);
+
+    // Row of the parent a new node at `insert_level_idx` goes under, or
+    // INVALID_INDEX if that parent is not expanded.
+    t_index get_insert_parent(
+        const std::vector<t_uindex>& indices, t_index insert_level_idx);
+
+    // Insert tree node `c_ptidx` as child number `cidx` of the row at
+    // `p_tvidx`.
+    void insert_child(t_index p_tvidx, t_index c_ptidx, t_uindex cidx);
+
+    template <typename SRC_T>
+    void fill_sort_elem(const SRC_T& src, t_index ptidx,
+        const std::vector<t_index>& agg_indices,
+        const std::vector<t_sorttype>& sort_orders, t_uindex order,
+        std::vector<t_tscalar>& aggregates, t_mselem& elem,
+        t_ctx2* ctx2) const;
+
+    static void get_child_indices(const std::vector<t_tvnode>& nodes,
+        t_index nidx, std::vector<std::pair<t_index, t_index>>& out_data);
+
     std::shared_ptr<const t_stree> m_tree;
-    std::shared_ptr<std::vector<t_tvnode>> m_nodes;
+
+    // Rows are kept in a balanced tree rather than a vector, so expanding,
+    // collapsing, adding and removing rows anywhere in a large traversal
+    // does not shift every row after them.
+    t_tvtree m_nodes;
 };
 
 /**
@@ -130,13 +176,14 @@ template <typename SRC_T>
 void
 t_traversal::sort_by(const t_config& config,
     const std::vector<t_sortspec>& sortby, const SRC_T& src, t_ctx2* ctx2) {
-    std::vector<t_tvnode> new_nodes(m_nodes->size());
+    std::vector<t_tvnode> nodes = m_nodes.get_nodes();
+    std::vector<t_tvnode> new_nodes(nodes.size());
 
     // Pair is -> (old tvidx, new tvidx)
     std::vector<std::pair<t_index, t_index>> queue;
 
     // Add root to queue
-    new_nodes[0] = (*m_nodes)[0];
+    new_nodes[0] = nodes[0];
     queue.emplace_back(std::pair<t_index, t_index>(0, 0));
 
     std::vector<t_index> sortby_agg_indices(sortby.size());
@@ -159,10 +206,10 @@ t_traversal::sort_by(const t_config& config,
         // Heads idx in new traversal
         t_index h_ntvidx = head_info.second;
 
-        const t_tvnode& head = (*m_nodes)[h_ctvidx];
+        const t_tvnode& head = nodes[h_ctvidx];
 
         std::vector<std::pair<t_index, t_index>> h_children;
-        get_child_indices(h_ctvidx, h_children);
+        get_child_indices(nodes, h_ctvidx, h_children);
 
         if (!h_children.empty()) {
             // Get sorted indices
@@ -173,6 +220,7 @@ t_traversal::sort_by(const t_config& config,
                 = std::make_shared<std::vector<t_mselem>>(size_t(n_changed));
             auto num_aggs = sortby.size();
             std::vector<t_tscalar> aggregates(num_aggs);
+            std::vector<t_sorttype> sort_orders = get_sort_orders(sortby);
 
             for (t_uindex i = 0, loop_end = n_changed; i < loop_end; i++) {
                 children_ptidx[i] = h_children[i].second;
@@ -180,11 +228,10 @@ t_traversal::sort_by(const t_config& config,
                 src.get_aggregates_for_sorting(
                     children_ptidx[i], sortby_agg_indices, aggregates, ctx2);
 
-                (*sortelems)[i]
-                    = t_mselem(aggregates, static_cast<t_uindex>(i));
+                (*sortelems)[i].m_order = static_cast<t_uindex>(i);
+                (*sortelems)[i].set_row(aggregates, sort_orders);
             }
 
-            std::vector<t_sorttype> sort_orders = get_sort_orders(sortby);
             t_multisorter sorter(sortelems, sort_orders);
             argsort(sorted_idx, sorter);
 
@@ -202,7 +249,7 @@ t_traversal::sort_by(const t_config& config,
                 for (t_index idx = bidx; idx < eidx; idx++) {
                     t_index cidx = sorted_idx[idx - bidx];
                     t_index c_otvidx = h_children[cidx].first;
-                    new_nodes[idx] = (*m_nodes)[c_otvidx];
+                    new_nodes[idx] = nodes[c_otvidx];
                     new_nodes[idx].m_rel_pidx = idx - bidx + 1;
                 }
             } else {
@@ -214,7 +261,7 @@ t_traversal::sort_by(const t_config& config,
                     t_index cidx = sorted_idx[idx];
                     t_index c_otvidx = h_children[cidx].first;
 
-                    const t_tvnode& child = (*m_nodes)[c_otvidx];
+                    const t_tvnode& child = nodes[c_otvidx];
 
                     // Enqueue child if it is expanded
                     if (child.m_expanded) {
@@ -222,7 +269,7 @@ t_traversal::sort_by(const t_config& config,
                             std::pair<t_index, t_index>(c_otvidx, c_ntvidx));
                     }
 
-                    new_nodes[c_ntvidx] = (*m_nodes)[c_otvidx];
+                    new_nodes[c_ntvidx] = nodes[c_otvidx];
                     new_nodes[c_ntvidx].m_rel_pidx = c_ntvidx - h_ntvidx;
                     c_ntvidx = c_ntvidx + child.m_ndesc + 1;
                 }
@@ -230,7 +277,149 @@ t_traversal::sort_by(const t_config& config,
         }
     }
 
-    std::swap(*m_nodes, new_nodes);
+    m_nodes.build(new_nodes);
+}
+
+template <typename SRC_T>
+void
+t_traversal::add_sorted_node(const std::vector<t_sortspec>& sortby,
+    const std::vector<t_uindex>& indices, t_index insert_level_idx,
+    const SRC_T& src, t_ctx2* ctx2) {
+    if (sortby.empty()) {
+        add_node(sortby, indices, insert_level_idx, ctx2);
+        return;
+    }
+
+    t_index p_tvidx = get_insert_parent(indices, insert_level_idx);
+
+    if (p_tvidx == INVALID_INDEX) {
+        return;
+    }
+
+    const t_tvnode& p_tvnode = m_nodes.get(m_nodes.at(p_tvidx));
+    t_uindex nchild = p_tvnode.m_nchild;
+    t_index c_ptidx = indices[insert_level_idx];
+
+    std::vector<t_index> agg_indices(sortby.size());
+    for (t_uindex idx = 0, loop_end = sortby.size(); idx < loop_end; ++idx) {
+        agg_indices[idx] = sortby[idx].m_agg_index;
+    }
+
+    std::vector<t_sorttype> sort_orders = get_sort_orders(sortby);
+    t_multisorter sorter(sort_orders);
+    std::vector<t_tscalar> aggregates(sortby.size());
+
+    // The new row orders after every sibling it ties with.
+    t_mselem elem;
+    t_mselem sibling;
+    fill_sort_elem(src, c_ptidx, agg_indices, sort_orders, nchild, aggregates,
+        elem, ctx2);
+
+    t_uindex cidx = 0;
+
+    if (p_tvnode.m_ndesc == nchild) {
+        // Contiguous children - binary search on their rows.
+        t_uindex hi = nchild;
+
+        while (cidx < hi) {
+            t_uindex mid = cidx + (hi - cidx) / 2;
+            t_index s_ptidx = m_nodes.get(m_nodes.at(p_tvidx + 1 + mid)).m_tnid;
+            fill_sort_elem(src, s_ptidx, agg_indices, sort_orders, mid,
+                aggregates, sibling, ctx2);
+
+            if (sorter(elem, sibling)) {
+                hi = mid;
+            } else {
+                cidx = mid + 1;
+            }
+        }
+    } else {
+        t_uindex rank = p_tvidx + 1;
+
+        for (; cidx < nchild; ++cidx) {
+            const t_tvnode& node = m_nodes.get(m_nodes.at(rank));
+            fill_sort_elem(src, node.m_tnid, agg_indices, sort_orders, cidx,
+                aggregates, sibling, ctx2);
+
+            if (sorter(elem, sibling)) {
+                break;
+            }
+
+            rank += node.m_ndesc + 1;
+        }
+    }
+
+    insert_child(p_tvidx, c_ptidx, cidx);
+}
+
+template <typename SRC_T>
+void
+t_traversal::sort_children(const std::vector<t_sortspec>& sortby,
+    const SRC_T& src, const std::vector<t_uindex>& ptidxs, t_ctx2* ctx2) {
+    if (sortby.empty()) {
+        return;
+    }
+
+    std::vector<t_index> agg_indices(sortby.size());
+    for (t_uindex idx = 0, loop_end = sortby.size(); idx < loop_end; ++idx) {
+        agg_indices[idx] = sortby[idx].m_agg_index;
+    }
+
+    std::vector<t_sorttype> sort_orders = get_sort_orders(sortby);
+    std::vector<t_tscalar> aggregates(sortby.size());
+
+    for (auto ptidx : ptidxs) {
+        t_uindex p_nid = m_nodes.find(ptidx);
+
+        if (p_nid == static_cast<t_uindex>(INVALID_INDEX)
+            || !m_nodes.get(p_nid).m_expanded) {
+            continue;
+        }
+
+        const t_tvnode& p_tvnode = m_nodes.get(p_nid);
+        t_uindex p_tvidx = m_nodes.rank(p_nid);
+        t_uindex nchild = p_tvnode.m_nchild;
+
+        // Node ids of the children in their current order.
+        std::vector<t_uindex> c_nids(nchild);
+        auto sortelems
+            = std::make_shared<std::vector<t_mselem>>(size_t(nchild));
+
+        t_uindex rank = p_tvidx + 1;
+        for (t_uindex cidx = 0; cidx < nchild; ++cidx) {
+            c_nids[cidx] = m_nodes.at(rank);
+            const t_tvnode& node = m_nodes.get(c_nids[cidx]);
+            fill_sort_elem(src, node.m_tnid, agg_indices, sort_orders, cidx,
+                aggregates, (*sortelems)[cidx], ctx2);
+            rank += node.m_ndesc + 1;
+        }
+
+        std::vector<t_index> sorted_idx(nchild);
+        t_multisorter sorter(sortelems, sort_orders);
+        argsort(sorted_idx, sorter);
+
+        // Move each child's block into place behind the ones already
+        // placed; a child already in place is not touched.
+        t_uindex dest = p_tvidx + 1;
+        for (auto cidx : sorted_idx) {
+            t_uindex c_nid = c_nids[cidx];
+            t_uindex brank = m_nodes.rank(c_nid);
+            t_uindex nrows = m_nodes.get(c_nid).m_ndesc + 1;
+            m_nodes.move(brank, brank + nrows, dest);
+            dest += nrows;
+        }
+    }
+}
+
+template <typename SRC_T>
+void
+t_traversal::fill_sort_elem(const SRC_T& src, t_index ptidx,
+    const std::vector<t_index>& agg_indices,
+    const std::vector<t_sorttype>& sort_orders, t_uindex order,
+    std::vector<t_tscalar>& aggregates, t_mselem& elem, t_ctx2* ctx2) const {
+    src.get_aggregates_for_sorting(ptidx, agg_indices, aggregates, ctx2);
+    elem.m_order = order;
+    elem.set_row(aggregates, sort_orders);
 }
 
 } // end namespace perspective
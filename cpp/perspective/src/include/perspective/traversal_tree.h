@@ -0,0 +1,91 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2017, the Perspective Authors.
+ *
+ * This file is part of the Perspective library, distributed under the terms of
+ * the Apache License 2.0.  The full license can be found in the LICENSE file.
+ *
+ */
+
+#pragma once
+#include <perspective/first.h>
+#include <perspective/base.h>
+#include <perspective/exports.h>
+#include <perspective/traversal_nodes.h>
+#include <perspective/treap.h>
+#include <tsl/hopscotch_map.h>
+#include <vector>
+
+namespace perspective {
+
+/**
+ * @brief The rows of a `t_traversal`, in an implicit treap.
+ *
+ * Rows are ordered by position only (see `t_treap`), so inserting or
+ * erasing a run of k rows, finding the row at a position and finding the
+ * position of a row are O(log n + k) expected, without shifting the rows
+ * after the change.
+ *
+ * Rows are addressed by node id, which stays valid until the row is erased.
+ * A row's traversal parent is kept as a node id rather than as
+ * `m_rel_pidx`, which would change with every insert before it - the
+ * `m_rel_pidx` of stored rows is not maintained.
+ */
+class PERSPECTIVE_EXPORT t_tvtree {
+public:
+    t_tvtree();
+
+    void clear();
+
+    t_uindex size() const;
+
+    // Replace the contents with `nodes` in traversal order, taking the
+    // parent of each row from its `m_rel_pidx`.
+    void build(const std::vector<t_tvnode>& nodes);
+
+    // Insert `nodes` before the row at `rank`, as children of `vparent`.
+    void insert(
+        t_uindex rank, const std::vector<t_tvnode>& nodes, t_uindex vparent);
+
+    // Erase the rows in [brank, erank).
+    void erase(t_uindex brank, t_uindex erank);
+
+    // Move the rows in [brank, erank) to start at `rank`, counted once they
+    // are taken out. Rows keep their node ids and traversal parents.
+    void move(t_uindex brank, t_uindex erank, t_uindex rank);
+
+    // `m_tnid` must not be changed through `get`.
+    t_tvnode& get(t_uindex nidx);
+    const t_tvnode& get(t_uindex nidx) const;
+
+    // Node id of the traversal parent, or INVALID_INDEX for the root.
+    t_uindex get_parent(t_uindex nidx) const;
+
+    // Node id of the row at `rank`.
+    t_uindex at(t_uindex rank) const;
+
+    t_uindex rank(t_uindex nidx) const;
+
+    // Node id of the following row, or INVALID_INDEX past the last row.
+    t_uindex next(t_uindex nidx) const;
+
+    // Node id of the row for sparse tree node `tnid`, or INVALID_INDEX.
+    t_uindex find(t_index tnid) const;
+
+    // Every row in order, with `m_rel_pidx` filled in.
+    std::vector<t_tvnode> get_nodes() const;
+
+private:
+    t_uindex alloc(const t_tvnode& node, t_uindex vparent);
+
+    t_treap m_treap;
+
+    // Indexed by node id.
+    std::vector<t_tvnode> m_rows;
+    std::vector<t_uindex> m_vparents;
+
+    // Sparse tree node id to node id.
+    tsl::hopscotch_map<t_index, t_uindex> m_tnids;
+};
+
+} // end namespace perspective
@@ -0,0 +1,92 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2017, the Perspective Authors.
+ *
+ * This file is part of the Perspective library, distributed under the terms of
+ * the Apache License 2.0.  The full license can be found in the LICENSE file.
+ *
+ */
+
+#pragma once
+#include <perspective/first.h>
+#include <perspective/base.h>
+#include <perspective/exports.h>
+#include <vector>
+
+namespace perspective {
+
+struct PERSPECTIVE_EXPORT t_treap_node {
+    t_uindex m_left;
+    t_uindex m_right;
+    t_uindex m_parent;
+    t_uindex m_size;
+    std::uint64_t m_priority;
+};
+
+/**
+ * @brief The shape of an implicit treap, without its payload.
+ *
+ * Nodes are ordered by position only, and every node carries its subtree
+ * size, so inserting or erasing a run of k nodes, finding the node at a
+ * rank and finding the rank of a node are O(log n + k) expected.
+ *
+ * Nodes are addressed by node id, which stays valid until the node is
+ * erased, after which it is recycled by `alloc`. Owners keep their payload
+ * in a vector indexed by node id, sized to `capacity()`.
+ */
+class PERSPECTIVE_EXPORT t_treap {
+public:
+    t_treap();
+
+    void clear();
+
+    t_uindex size() const;
+
+    // One past the largest node id handed out since the last `clear`.
+    t_uindex capacity() const;
+
+    // Id of a new node, not yet in the treap.
+    t_uindex alloc();
+
+    // Replace the contents with the allocated nodes `nidxs`, in order.
+    void build(const std::vector<t_uindex>& nidxs);
+
+    // Insert the allocated nodes `nidxs` before the node at `rank`.
+    void insert(t_uindex rank, const std::vector<t_uindex>& nidxs);
+
+    // Erase the nodes in [brank, erank), appending their ids to `erased`.
+    void erase(t_uindex brank, t_uindex erank, std::vector<t_uindex>& erased);
+
+    // Move the nodes in [brank, erank) so that the first of them lands at
+    // `rank`, counted once they are taken out. Node ids are kept.
+    void move(t_uindex brank, t_uindex erank, t_uindex rank);
+
+    t_uindex root() const;
+    t_uindex left(t_uindex nidx) const;
+    t_uindex right(t_uindex nidx) const;
+    t_uindex subtree_size(t_uindex nidx) const;
+
+    // Node id at `rank`.
+    t_uindex at(t_uindex rank) const;
+
+    t_uindex rank(t_uindex nidx) const;
+
+    // Node id of the following node, or INVALID_INDEX past the last node.
+    t_uindex next(t_uindex nidx) const;
+
+private:
+    t_uindex link(const std::vector<t_uindex>& nidxs);
+    t_uindex merge(t_uindex left, t_uindex right);
+    void split(t_uindex root, t_uindex rank, t_uindex& left, t_uindex& right);
+    void set_left(t_uindex nidx, t_uindex child);
+    void set_right(t_uindex nidx, t_uindex child);
+    void update_size(t_uindex nidx);
+    std::uint64_t next_priority();
+
+    std::vector<t_treap_node> m_nodes;
+    std::vector<t_uindex> m_free;
+    t_uindex m_root;
+    std::uint64_t m_seed;
+};
+
+} // end namespace perspective
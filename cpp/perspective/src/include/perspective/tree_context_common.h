@@ -23,7 +23,22 @@ PERSPECTIVE_EXPORT void notify_sparse_tree_common(
     const std::vector<t_aggspec>& aggregates,
     const std::vector<std::pair<std::string, std::string>>& tree_sortby,
     const std::vector<t_sortspec>& ctx_sortby, const t_gstate& gstate,
-    const t_data_table& expression_master_table);
+    const t_data_table& expression_master_table, bool inserts_only);
+
+/**
+ * @brief Bring `traversal` in step with the last shape update of `tree`,
+ * dropping emptied nodes and adding new ones. Called by
+ * `notify_sparse_tree_common` after it updates the tree, and on its own for
+ * contexts that read from a tree another context updates.
+ *
+ * @param tree
+ * @param traversal
+ * @param process_traversal
+ * @param ctx_sortby
+ */
+PERSPECTIVE_EXPORT void notify_sparse_traversal(std::shared_ptr<t_stree> tree,
+    std::shared_ptr<t_traversal> traversal, bool process_traversal,
+    const std::vector<t_sortspec>& ctx_sortby);
 
 PERSPECTIVE_EXPORT void notify_sparse_tree(std::shared_ptr<t_stree> tree,
     std::shared_ptr<t_traversal> traversal, bool process_traversal,
@@ -84,6 +84,14 @@ public:
     void set_row_pivot_depth(std::int32_t depth);
     void set_column_pivot_depth(std::int32_t depth);
 
+    /**
+     * @brief Limit sorted output to the first `top_n` rows - of the whole
+     * view for flat views, and of each parent's children for pivots.
+     *
+     * @param top_n
+     */
+    void set_top_n(std::int32_t top_n);
+
     std::vector<std::string> get_row_pivots() const;
 
     std::vector<std::string> get_column_pivots() const;
@@ -106,6 +114,7 @@ public:
 
     std::int32_t get_row_pivot_depth() const;
     std::int32_t get_column_pivot_depth() const;
+    std::int32_t get_top_n() const;
 
 private:
     bool m_init;
@@ -161,6 +170,18 @@ private:
     void make_aggspec(const std::string& column,
         const std::vector<std::string>& aggregate, t_dtype dtype);
 
+    /**
+     * @brief Parse the quantile for an `approx percentile` aggregate, which
+     * is provided either as a second element (`["approx percentile",
+     * "0.95"]`) or inline (`"approx percentile(0.95)"`), defaulting to the
+     * median.
+     *
+     * @param aggregate
+     * @return double
+     */
+    double get_aggregate_quantile(
+        const std::vector<std::string>& aggregate) const;
+
     // containers for primitive data that does not need transformation into
     // abstractions
     std::vector<std::string> m_row_pivots;
@@ -201,6 +222,12 @@ private:
     std::int32_t m_row_pivot_depth;
     std::int32_t m_column_pivot_depth;
 
+    /**
+     * @brief If specified, the number of rows (or children per parent)
+     * the engine should keep in sort order; -1 keeps every row.
+     */
+    std::int32_t m_top_n;
+
     /**
      * @brief the `t_filter_op` used to return data in the case of multiple
      * filters being applied.
@@ -24,6 +24,8 @@ declare module "@finos/perspective" {
         | "abs sum"
         | "and"
         | "any"
+        | "approx distinct"
+        | "approx percentile"
         | "avg"
         | "count"
         | "distinct count"
@@ -43,7 +45,8 @@ declare module "@finos/perspective" {
         | "sum not null"
         | "unique"
         | "var"
-        | ["weighted mean", ColumnName];
+        | ["weighted mean", ColumnName]
+        | ["approx percentile", string];
 
     export type FilterOp =
         | "<"
@@ -43,10 +43,13 @@ export const CONFIG_VALID_KEYS = [
     "group_by_depth",
     "split_by_depth",
     "filter_op",
+    "top_n",
 ];
 
 const NUMBER_AGGREGATES = [
     "any",
+    "approx distinct",
+    "approx percentile",
     "avg",
     "abs sum",
     "count",
@@ -74,6 +77,7 @@ const NUMBER_AGGREGATES = [
 
 const STRING_AGGREGATES = [
     "any",
+    "approx distinct",
     "count",
     "distinct count",
     "distinct leaf",
@@ -87,6 +91,7 @@ const STRING_AGGREGATES = [
 
 const BOOLEAN_AGGREGATES = [
     "any",
+    "approx distinct",
     "count",
     "distinct count",
     "distinct leaf",
@@ -1223,6 +1223,7 @@ export default function (Module) {
         this.filter_op = config.filter_op || "and";
         this.group_by_depth = config.group_by_depth;
         this.split_by_depth = config.split_by_depth;
+        this.top_n = config.top_n;
     }
 
     /**
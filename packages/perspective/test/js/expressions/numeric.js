@@ -1096,6 +1096,110 @@ module.exports = (perspective) => {
                 await table.delete();
             });
 
+            it("Arithmetic over nulls and zero divisors", async function () {
+                const table = await perspective.table({
+                    a: [1.5, null, 3.5, -4.5],
+                    b: [0, 2, null, 4],
+                });
+
+                const view = await table.view({
+                    expressions: [
+                        '"a" / "b"',
+                        '"a" % "b"',
+                        'min("a", "b", 1)',
+                        'bucket("a", 2)',
+                        'abs("a") + "b"',
+                        'abs("a") > 2 ? "a" : 0 - "a"',
+                        'is_null("a" / "b")',
+                    ],
+                });
+
+                const result = await view.to_columns();
+                expect(result['"a" / "b"']).toEqual([null, null, null, -1.125]);
+                expect(result['"a" % "b"']).toEqual([null, null, null, -0.5]);
+                expect(result['min("a", "b", 1)']).toEqual([
+                    0,
+                    null,
+                    null,
+                    -4.5,
+                ]);
+                expect(result['bucket("a", 2)']).toEqual([0, null, 2, -6]);
+                expect(result['abs("a") + "b"']).toEqual([1.5, null, null, 8.5]);
+                expect(result['abs("a") > 2 ? "a" : 0 - "a"']).toEqual([
+                    -1.5,
+                    null,
+                    3.5,
+                    -4.5,
+                ]);
+                expect(result['is_null("a" / "b")']).toEqual([
+                    true,
+                    true,
+                    true,
+                    false,
+                ]);
+                await view.delete();
+                await table.delete();
+            });
+
+            it("Sub-expressions shared by several expressions", async function () {
+                const table = await perspective.table({
+                    a: [1, 2, null, 4],
+                    b: [10, 20, 30, null],
+                });
+
+                const view = await table.view({
+                    expressions: [
+                        '"a" + "b"',
+                        '("a" + "b") * 2',
+                        '("a" + "b") - "a" * "a"',
+                        '"a" * "a" > 3 ? "a" + "b" : "a"',
+                    ],
+                });
+
+                let result = await view.to_columns();
+                expect(result['"a" + "b"']).toEqual([11, 22, null, null]);
+                expect(result['("a" + "b") * 2']).toEqual([22, 44, null, null]);
+                expect(result['("a" + "b") - "a" * "a"']).toEqual([
+                    10,
+                    18,
+                    null,
+                    null,
+                ]);
+                expect(result['"a" * "a" > 3 ? "a" + "b" : "a"']).toEqual([
+                    1,
+                    22,
+                    null,
+                    null,
+                ]);
+
+                table.update({a: [5], b: [1]});
+                result = await view.to_columns();
+                expect(result['"a" + "b"']).toEqual([11, 22, null, null, 6]);
+                expect(result['("a" + "b") * 2']).toEqual([
+                    22,
+                    44,
+                    null,
+                    null,
+                    12,
+                ]);
+                expect(result['("a" + "b") - "a" * "a"']).toEqual([
+                    10,
+                    18,
+                    null,
+                    null,
+                    -19,
+                ]);
+                expect(result['"a" * "a" > 3 ? "a" + "b" : "a"']).toEqual([
+                    1,
+                    22,
+                    null,
+                    null,
+                    6,
+                ]);
+                await view.delete();
+                await table.delete();
+            });
+
             it("percent_of", async function () {
                 const table = await perspective.table({
                     a: "integer",
@@ -284,6 +284,25 @@ module.exports = (perspective) => {
             table.delete();
         });
 
+        it("Uppercase with repeated values across updates", async function () {
+            const table = await perspective.table({
+                a: ["abc", "def", "abc", null, "def", "abc"],
+            });
+            const view = await table.view({
+                expressions: ['upper("a")', `match("a", 'b')`],
+            });
+            table.update({a: ["ghi", "abc", null, "ghi", "def"]});
+            let result = await view.to_columns();
+            expect(result['upper("a")']).toEqual(
+                result.a.map((x) => (x ? x.toUpperCase() : null))
+            );
+            expect(result[`match("a", 'b')`]).toEqual(
+                result.a.map((x) => (x ? x.includes("b") : null))
+            );
+            view.delete();
+            table.delete();
+        });
+
         it.skip("Uppercase, non-utf8", async function () {
             const table = await perspective.table({
                 a: ["𝕙ḗľᶅở щṏᵲɭⅾ", "𝓊⋁ẅ⤫𝛾𝓏", null],
@@ -1123,6 +1123,90 @@ module.exports = (perspective) => {
             view.delete();
             table.delete();
         });
+
+        it("recompute rows read before an update, remove and re-add", async function () {
+            const table = await perspective.table(data, {index: "x"});
+
+            const view = await table.view({
+                expressions: ['"y" * 10'],
+            });
+
+            let result = await view.to_columns({start_row: 1, end_row: 3});
+            expect(result).toEqual({
+                x: [2, 3],
+                y: [4, 6],
+                '"y" * 10': [40, 60],
+            });
+
+            table.update({x: [2], y: [5]});
+            table.remove([3]);
+            table.update({x: [5], y: [null]});
+
+            result = await view.to_columns();
+            expect(result).toEqual({
+                x: [1, 2, 4, 5],
+                y: [2, 5, 8, null],
+                '"y" * 10': [20, 50, 80, null],
+            });
+
+            view.delete();
+            table.delete();
+        });
+
+        it("recompute `now()` on rows that are updated", async function () {
+            const table = await perspective.table(data, {index: "x"});
+
+            const view = await table.view({
+                expressions: ["now()"],
+            });
+
+            const before = await view.to_columns();
+            await new Promise((resolve) => setTimeout(resolve, 50));
+            table.update({x: [2], y: [5]});
+
+            const after = await view.to_columns();
+            expect(after.y).toEqual([2, 5, 6, 8]);
+            expect(after["now()"][1]).toBeGreaterThan(before["now()"][1]);
+
+            view.delete();
+            table.delete();
+        });
+
+        it("share an expression between views under different aliases", async function () {
+            const table = await perspective.table(data, {index: "x"});
+
+            // Filtering on the expression computes it on every update.
+            const view = await table.view({
+                expressions: ['//a\n"y" * 2'],
+                filter: [["a", ">", 0]],
+            });
+
+            const view2 = await table.view({
+                expressions: ['//b\n"y" * 2'],
+                filter: [["b", ">", 0]],
+            });
+
+            table.update({x: [2, 5], y: [10, 12]});
+            table.remove([3]);
+
+            const result = await view.to_columns();
+            expect(result).toEqual({
+                x: [1, 2, 4, 5],
+                y: [2, 10, 8, 12],
+                a: [4, 20, 16, 24],
+            });
+
+            const result2 = await view2.to_columns();
+            expect(result2).toEqual({
+                x: [1, 2, 4, 5],
+                y: [2, 10, 8, 12],
+                b: [4, 20, 16, 24],
+            });
+
+            view2.delete();
+            view.delete();
+            table.delete();
+        });
     });
 
     describe("Computed updates with group by", function () {
@@ -402,6 +402,37 @@ module.exports = (perspective) => {
                 view.delete();
                 table.delete();
             });
+
+            it("y in ['a', 'b', 'd'] on a view created after updates and removes", async function () {
+                var table = await perspective.table(
+                    {x: "integer", y: "string"},
+                    {index: "x"}
+                );
+                table.update([
+                    {x: 1, y: "a"},
+                    {x: 2, y: "b"},
+                    {x: 3, y: "c"},
+                    {x: 4, y: "d"},
+                ]);
+                table.update([{x: 2, y: "d"}]);
+                table.remove([1]);
+                var view = await table.view({
+                    filter: [["y", "in", ["a", "b", "d"]]],
+                });
+                let json = await view.to_json();
+                expect(json).toEqual([
+                    {x: 2, y: "d"},
+                    {x: 4, y: "d"},
+                ]);
+                var view2 = await table.view({
+                    filter: [["y", "not in", ["a", "b", "d"]]],
+                });
+                json = await view2.to_json();
+                expect(json).toEqual([{x: 3, y: "c"}]);
+                view2.delete();
+                view.delete();
+                table.delete();
+            });
         });
 
         describe("not in", function () {
@@ -460,6 +491,21 @@ module.exports = (perspective) => {
                 view.delete();
                 table.delete();
             });
+
+            it("y == 'a' OR x > 3", async function () {
+                var table = await perspective.table(data);
+                var view = await table.view({
+                    filter_op: "or",
+                    filter: [
+                        ["y", "==", "a"],
+                        ["x", ">", 3],
+                    ],
+                });
+                let json = await view.to_json();
+                expect(json).toEqual([rdata[0], rdata[3]]);
+                view.delete();
+                table.delete();
+            });
         });
 
         describe("is null", function () {
@@ -81,6 +81,32 @@ describe("get_min_max", function () {
             view.delete();
             table.delete();
         });
+
+        it("after appending rows", async function () {
+            var table = await perspective.table(data);
+            var view = await table.view({});
+            expect(await view.get_min_max("w")).toEqual([-9.5, 8.5]);
+            table.update({w: [10.5, -12.5], x: [5, 0]});
+            expect(await view.get_min_max("w")).toEqual([-12.5, 10.5]);
+            expect(await view.get_min_max("x")).toEqual([0, 5]);
+            view.delete();
+            table.delete();
+        });
+
+        it("after updates and removes on an indexed table", async function () {
+            var table = await perspective.table(
+                {id: [1, 2, 3, 4], w: [1.5, -2.5, 3.5, 8.5]},
+                {index: "id"}
+            );
+            var view = await table.view({columns: ["w"]});
+            expect(await view.get_min_max("w")).toEqual([-2.5, 8.5]);
+            table.update({id: [4], w: [0.5]});
+            expect(await view.get_min_max("w")).toEqual([-2.5, 3.5]);
+            table.remove([2]);
+            expect(await view.get_min_max("w")).toEqual([0.5, 3.5]);
+            view.delete();
+            table.delete();
+        });
     });
 
     describe("1 sided", function () {
@@ -116,6 +142,46 @@ describe("get_min_max", function () {
             view.delete();
             table.delete();
         });
+
+        it("after updates and removes on an indexed table", async function () {
+            var table = await perspective.table(
+                {
+                    id: [1, 2, 3, 4],
+                    g: ["a", "a", "b", "b"],
+                    w: [1.5, -2.5, 3.5, 8.5],
+                },
+                {index: "id"}
+            );
+            var view = await table.view({group_by: ["g"], columns: ["w"]});
+            expect(await view.get_min_max("w")).toEqual([-1, 12]);
+            table.update({id: [4], w: [0.5]});
+            expect(await view.get_min_max("w")).toEqual([-1, 4]);
+            table.remove([1, 2]);
+            expect(await view.get_min_max("w")).toEqual([4, 4]);
+            view.delete();
+            table.delete();
+        });
+
+        it("after collapsing and expanding rows", async function () {
+            var table = await perspective.table({
+                g: ["a", "a", "b", "b"],
+                h: ["x", "y", "x", "y"],
+                w: [1.5, -2.5, 3.5, 8.5],
+            });
+            var view = await table.view({
+                group_by: ["g", "h"],
+                columns: ["w"],
+            });
+            expect(await view.get_min_max("w")).toEqual([-2.5, 8.5]);
+            await view.collapse(4);
+            expect(await view.get_min_max("w")).toEqual([-2.5, 1.5]);
+            await view.collapse(1);
+            expect(await view.get_min_max("w")).toEqual([-1, 12]);
+            await view.expand(2);
+            expect(await view.get_min_max("w")).toEqual([3.5, 8.5]);
+            view.delete();
+            table.delete();
+        });
     });
 
     describe("2 sided", function () {
@@ -154,6 +220,32 @@ describe("get_min_max", function () {
             view.delete();
             table.delete();
         });
+
+        it("after updates and removes on an indexed table", async function () {
+            var table = await perspective.table(
+                {
+                    id: [1, 2, 3, 4],
+                    g: ["a", "a", "b", "b"],
+                    s: ["p", "q", "p", "q"],
+                    w: [1.5, -2.5, 3.5, 8.5],
+                },
+                {index: "id"}
+            );
+            var view = await table.view({
+                group_by: ["g"],
+                split_by: ["s"],
+                columns: ["w"],
+            });
+            expect(await view.get_min_max("w")).toEqual([-2.5, 8.5]);
+            table.update({id: [4], w: [0.5]});
+            expect(await view.get_min_max("w")).toEqual([-2.5, 3.5]);
+            table.remove([2]);
+            expect(await view.get_min_max("w")).toEqual([0.5, 3.5]);
+            table.update({id: [5], g: ["a"], s: ["r"], w: [-7.5]});
+            expect(await view.get_min_max("w")).toEqual([-7.5, 3.5]);
+            view.delete();
+            table.delete();
+        });
     });
 
     describe("column only", function () {
@@ -50,5 +50,126 @@ module.exports = (perspective, mode) => {
             }
             table.delete();
         });
+
+        it("Expressions are not recompiled on update", async function () {
+            if (perspective.sync_module) {
+                perspective = perspective.sync_module();
+            }
+            const table = await perspective.table({x: [1, 2], y: ["a", "b"]});
+            const view = await table.view({
+                expressions: ['"x" + 1', 'upper("y")'],
+            });
+            await view.to_columns();
+            const count = perspective.__module__.get_expression_compile_count();
+
+            for (let i = 0; i < 5; i++) {
+                table.update({x: [i], y: ["c"]});
+            }
+
+            const result = await view.to_columns();
+            expect(result['"x" + 1']).toEqual([2, 3, 1, 2, 3, 4, 5]);
+            expect(
+                perspective.__module__.get_expression_compile_count()
+            ).toEqual(count);
+            view.delete();
+            table.delete();
+        });
+
+        it("Grouped pkey rows stay sorted under add, update and remove", async function () {
+            if (perspective.sync_module) {
+                perspective = perspective.sync_module();
+            }
+            const module = perspective.__module__;
+            const table = await perspective.table(
+                {
+                    id: [1, 2, 3, 4, 5],
+                    parent: [null, null, 1, 1, null],
+                    s: [0, 0, 0, 0, 0],
+                    x: [10, 30, 5, 7, 20],
+                },
+                {index: "id"}
+            );
+
+            const flush = () => {
+                const pool = table._Table.get_pool();
+                pool._process();
+                pool.delete();
+            };
+
+            // Siblings sorted by "x", descending.
+            const ctx = module.make_grouped_pkey_context(
+                table._Table,
+                "grouped",
+                ["x"],
+                "id",
+                "parent",
+                "s",
+                [0, true]
+            );
+
+            expect(module.get_grouped_pkey_rows(ctx)).toEqual([
+                [1, 2],
+                [1, 5],
+                [1, 1],
+                [2, 4],
+                [2, 3],
+            ]);
+
+            table.update({
+                id: [6, 7],
+                parent: [1, null],
+                s: [0, 0],
+                x: [6, 25],
+            });
+            flush();
+            expect(module.get_grouped_pkey_rows(ctx)).toEqual([
+                [1, 2],
+                [1, 7],
+                [1, 5],
+                [1, 1],
+                [2, 4],
+                [2, 6],
+                [2, 3],
+            ]);
+
+            table.update({id: [5], x: [40]});
+            flush();
+            expect(module.get_grouped_pkey_rows(ctx)).toEqual([
+                [1, 5],
+                [1, 2],
+                [1, 7],
+                [1, 1],
+                [2, 4],
+                [2, 6],
+                [2, 3],
+            ]);
+
+            table.remove([2]);
+            flush();
+            expect(module.get_grouped_pkey_rows(ctx)).toEqual([
+                [1, 5],
+                [1, 7],
+                [1, 1],
+                [2, 4],
+                [2, 6],
+                [2, 3],
+            ]);
+
+            // Moves "4" from under "1" to the root.
+            table.update({id: [4], parent: [null]});
+            flush();
+            expect(module.get_grouped_pkey_rows(ctx)).toEqual([
+                [1, 5],
+                [1, 7],
+                [1, 1],
+                [2, 6],
+                [2, 3],
+                [1, 4],
+            ]);
+
+            module.delete_grouped_pkey_context(table._Table, "grouped");
+            ctx.delete();
+            table.delete();
+        });
     });
 };
@@ -1702,6 +1702,72 @@ module.exports = (perspective) => {
             await view.delete();
             await table.delete();
         });
+
+        it("approx distinct", async function () {
+            const table = await perspective.table({
+                x: ["a", "b", "c", "a", "b", "d"],
+                y: [1, 1, 1, 2, 2, 2],
+            });
+            const view = await table.view({
+                group_by: ["y"],
+                columns: ["x"],
+                aggregates: {x: "approx distinct"},
+            });
+
+            // Small cardinalities are counted exactly.
+            const result = await view.to_columns();
+            expect(result.x).toEqual([4, 3, 3]);
+
+            await view.delete();
+            await table.delete();
+        });
+
+        it("approx distinct after appends and updates", async function () {
+            const table = await perspective.table(
+                {
+                    id: [1, 2, 3, 4],
+                    x: ["a", "b", "a", "c"],
+                    y: [1, 1, 2, 2],
+                },
+                {index: "id"}
+            );
+            const view = await table.view({
+                group_by: ["y"],
+                columns: ["x"],
+                aggregates: {x: "approx distinct"},
+            });
+
+            table.update({id: [5, 6], x: ["d", "a"], y: [1, 3]});
+            let result = await view.to_columns();
+            expect(result.x).toEqual([4, 3, 2, 1]);
+
+            table.update({id: [2, 5], x: ["a", "a"]});
+            result = await view.to_columns();
+            expect(result.x).toEqual([2, 1, 2, 1]);
+
+            await view.delete();
+            await table.delete();
+        });
+
+        it("approx percentile", async function () {
+            const table = await perspective.table({
+                x: [1, 2, 3, 4, 5, 6, 7, 8, 9],
+                y: ["a", "a", "a", "a", "a", "b", "b", "b", "b"],
+            });
+            const view = await table.view({
+                group_by: ["y"],
+                columns: ["x"],
+                aggregates: {x: ["approx percentile", "0.5"]},
+            });
+
+            const result = await view.to_columns();
+            expect(result.x[0]).toBeCloseTo(5, 6);
+            expect(result.x[1]).toBeCloseTo(3, 6);
+            expect(result.x[2]).toBeCloseTo(7.5, 6);
+
+            await view.delete();
+            await table.delete();
+        });
     });
 
     describe("Aggregates with nulls", function () {
@@ -2048,6 +2114,141 @@ module.exports = (perspective) => {
             table.delete();
         });
 
+        it("['y'] on views with the same group by and different columns", async function () {
+            const table = await perspective.table(data, {index: "x"});
+            const view = await table.view({
+                group_by: ["y"],
+                columns: ["x"],
+            });
+            const view2 = await table.view({
+                group_by: ["y"],
+                columns: ["z", "x"],
+                sort: [["x", "desc"]],
+            });
+
+            table.update([{x: 5, y: "a", z: false}]);
+
+            expect(await view.to_json()).toEqual([
+                {__ROW_PATH__: [], x: 15},
+                {__ROW_PATH__: ["a"], x: 6},
+                {__ROW_PATH__: ["b"], x: 2},
+                {__ROW_PATH__: ["c"], x: 3},
+                {__ROW_PATH__: ["d"], x: 4},
+            ]);
+            expect(await view2.to_json()).toEqual([
+                {__ROW_PATH__: [], z: 5, x: 15},
+                {__ROW_PATH__: ["a"], z: 2, x: 6},
+                {__ROW_PATH__: ["d"], z: 1, x: 4},
+                {__ROW_PATH__: ["c"], z: 1, x: 3},
+                {__ROW_PATH__: ["b"], z: 1, x: 2},
+            ]);
+
+            // Reads from the tree built for `view` and `view2`.
+            const view3 = await table.view({
+                group_by: ["y"],
+                columns: ["z"],
+            });
+
+            expect(await view3.to_json()).toEqual([
+                {__ROW_PATH__: [], z: 5},
+                {__ROW_PATH__: ["a"], z: 2},
+                {__ROW_PATH__: ["b"], z: 1},
+                {__ROW_PATH__: ["c"], z: 1},
+                {__ROW_PATH__: ["d"], z: 1},
+            ]);
+
+            view.delete();
+            table.remove([1]);
+            expect(await view2.to_json()).toEqual([
+                {__ROW_PATH__: [], z: 4, x: 14},
+                {__ROW_PATH__: ["a"], z: 1, x: 5},
+                {__ROW_PATH__: ["d"], z: 1, x: 4},
+                {__ROW_PATH__: ["c"], z: 1, x: 3},
+                {__ROW_PATH__: ["b"], z: 1, x: 2},
+            ]);
+            expect(await view3.to_json()).toEqual([
+                {__ROW_PATH__: [], z: 4},
+                {__ROW_PATH__: ["a"], z: 1},
+                {__ROW_PATH__: ["b"], z: 1},
+                {__ROW_PATH__: ["c"], z: 1},
+                {__ROW_PATH__: ["d"], z: 1},
+            ]);
+
+            view3.delete();
+            view2.delete();
+            table.delete();
+        });
+
+        it("['y'] on views with the same group by and different sorts", async function () {
+            const table = await perspective.table(data, {index: "x"});
+            const view = await table.view({
+                group_by: ["y"],
+                columns: ["x"],
+            });
+            const view2 = await table.view({
+                group_by: ["y"],
+                columns: ["x"],
+                sort: [["x", "desc"]],
+            });
+
+            table.update([
+                {x: 5, y: "a", z: true},
+                {x: 2, y: "a"},
+            ]);
+
+            expect(await view.to_json()).toEqual([
+                {__ROW_PATH__: [], x: 15},
+                {__ROW_PATH__: ["a"], x: 8},
+                {__ROW_PATH__: ["c"], x: 3},
+                {__ROW_PATH__: ["d"], x: 4},
+            ]);
+            expect(await view2.to_json()).toEqual([
+                {__ROW_PATH__: [], x: 15},
+                {__ROW_PATH__: ["a"], x: 8},
+                {__ROW_PATH__: ["d"], x: 4},
+                {__ROW_PATH__: ["c"], x: 3},
+            ]);
+
+            view.delete();
+            table.remove([1]);
+            expect(await view2.to_json()).toEqual([
+                {__ROW_PATH__: [], x: 14},
+                {__ROW_PATH__: ["a"], x: 7},
+                {__ROW_PATH__: ["d"], x: 4},
+                {__ROW_PATH__: ["c"], x: 3},
+            ]);
+
+            view2.delete();
+            table.delete();
+        });
+
+        it("['y'] with row deltas on one of two views with the same group by", async function (done) {
+            const table = await perspective.table(data, {index: "x"});
+            const view = await table.view({group_by: ["y"], columns: ["x"]});
+            const view2 = await table.view({group_by: ["y"], columns: ["x"]});
+            const answer = [
+                {__ROW_PATH__: [], x: 10},
+                {__ROW_PATH__: ["b"], x: 3},
+                {__ROW_PATH__: ["c"], x: 3},
+                {__ROW_PATH__: ["d"], x: 4},
+            ];
+
+            view2.on_update(
+                async function (updated) {
+                    expect(updated.delta.byteLength).toBeGreaterThan(0);
+                    expect(await view.to_json()).toEqual(answer);
+                    expect(await view2.to_json()).toEqual(answer);
+                    view2.delete();
+                    view.delete();
+                    table.delete();
+                    done();
+                },
+                {mode: "row"}
+            );
+
+            table.update([{x: 1, y: "b"}]);
+        });
+
         describe("pivoting on column containing null values", function () {
             it("shows one pivot for the nulls on initial load", async function () {
                 const dataWithNulls = [
@@ -144,6 +144,212 @@ module.exports = (perspective) => {
             });
         });
 
+        describe("With updates", () => {
+            it("moves, adds and removes rows in place", async function () {
+                var table = await perspective.table(data2, {index: "y"});
+                var view = await table.view({
+                    columns: ["y", "x"],
+                    sort: [["x", "asc"]],
+                });
+
+                expect(await view.to_columns()).toEqual({
+                    y: ["a", "h", "b", "g", "c", "f", "d", "e"],
+                    x: [1, 1, 2, 2, 3, 3, 4, 4],
+                });
+
+                table.update({y: ["a", "i"], x: [5, 0]});
+                table.remove(["g"]);
+
+                expect(await view.to_columns()).toEqual({
+                    y: ["i", "h", "b", "c", "f", "d", "e", "a"],
+                    x: [0, 1, 2, 3, 3, 4, 4, 5],
+                });
+
+                expect(await view.to_columns({start_row: 2, end_row: 4})).toEqual({
+                    y: ["b", "c"],
+                    x: [2, 3],
+                });
+
+                view.delete();
+                table.delete();
+            });
+
+            it("keeps a sorted tree in order under add, update and remove", async function () {
+                var table = await perspective.table(
+                    {
+                        k: ["a1", "a2", "b1", "b2", "c1"],
+                        g: ["a", "a", "b", "b", "c"],
+                        v: [1, 2, 3, 4, 5],
+                    },
+                    {index: "k"}
+                );
+
+                var view = await table.view({
+                    group_by: ["g", "k"],
+                    columns: ["v"],
+                    sort: [["v", "desc"]],
+                });
+
+                expect(await view.to_columns()).toEqual({
+                    __ROW_PATH__: [
+                        [],
+                        ["b"],
+                        ["b", "b2"],
+                        ["b", "b1"],
+                        ["c"],
+                        ["c", "c1"],
+                        ["a"],
+                        ["a", "a2"],
+                        ["a", "a1"],
+                    ],
+                    v: [15, 7, 4, 3, 5, 5, 3, 2, 1],
+                });
+
+                table.update({k: ["a3"], g: ["a"], v: [10]});
+                expect(await view.to_columns()).toEqual({
+                    __ROW_PATH__: [
+                        [],
+                        ["a"],
+                        ["a", "a3"],
+                        ["a", "a2"],
+                        ["a", "a1"],
+                        ["b"],
+                        ["b", "b2"],
+                        ["b", "b1"],
+                        ["c"],
+                        ["c", "c1"],
+                    ],
+                    v: [25, 13, 10, 2, 1, 7, 4, 3, 5, 5],
+                });
+
+                table.update({k: ["b1"], v: [20]});
+                expect(await view.to_columns()).toEqual({
+                    __ROW_PATH__: [
+                        [],
+                        ["b"],
+                        ["b", "b1"],
+                        ["b", "b2"],
+                        ["a"],
+                        ["a", "a3"],
+                        ["a", "a2"],
+                        ["a", "a1"],
+                        ["c"],
+                        ["c", "c1"],
+                    ],
+                    v: [42, 24, 20, 4, 13, 10, 2, 1, 5, 5],
+                });
+
+                table.remove(["a3"]);
+                expect(await view.to_columns()).toEqual({
+                    __ROW_PATH__: [
+                        [],
+                        ["b"],
+                        ["b", "b1"],
+                        ["b", "b2"],
+                        ["c"],
+                        ["c", "c1"],
+                        ["a"],
+                        ["a", "a2"],
+                        ["a", "a1"],
+                    ],
+                    v: [32, 24, 20, 4, 5, 5, 3, 2, 1],
+                });
+
+                view.delete();
+                table.delete();
+            });
+        });
+
+        describe("Top N", () => {
+            it("keeps the first N rows of a flat view", async function () {
+                var table = await perspective.table(data2, {index: "y"});
+                var view = await table.view({
+                    columns: ["y", "x"],
+                    sort: [["x", "desc"]],
+                    top_n: 3,
+                });
+
+                expect(await view.num_rows()).toEqual(3);
+                expect(await view.to_columns()).toEqual({
+                    y: ["d", "e", "c"],
+                    x: [4, 4, 3],
+                });
+
+                table.update({y: ["a"], x: [10]});
+                expect(await view.to_columns()).toEqual({
+                    y: ["a", "d", "e"],
+                    x: [10, 4, 4],
+                });
+
+                // Empties the sorted pool, which is refilled from the rows
+                // that were outside of it.
+                table.remove(["a", "d", "e", "c", "f"]);
+                expect(await view.to_columns()).toEqual({
+                    y: ["b", "g", "h"],
+                    x: [2, 2, 1],
+                });
+
+                view.delete();
+                table.delete();
+            });
+
+            it("keeps the first N children of each group", async function () {
+                var table = await perspective.table(data);
+                var view = await table.view({
+                    group_by: ["y"],
+                    columns: ["w"],
+                    sort: [["w", "desc"]],
+                    top_n: 2,
+                });
+
+                expect(await view.to_columns()).toEqual({
+                    __ROW_PATH__: [[], ["d"], ["c"]],
+                    w: [40, 13, 11],
+                });
+
+                table.update({w: [100], x: [1], y: ["a"], z: [true]});
+                expect(await view.to_columns()).toEqual({
+                    __ROW_PATH__: [[], ["a"], ["d"]],
+                    w: [140, 107, 13],
+                });
+
+                view.delete();
+                table.delete();
+            });
+
+            it("refills the children of a group after removes", async function () {
+                var table = await perspective.table(data2, {index: "y"});
+                var view = await table.view({
+                    group_by: ["y"],
+                    columns: ["x"],
+                    sort: [["x", "desc"]],
+                    top_n: 2,
+                });
+
+                expect(await view.to_columns()).toEqual({
+                    __ROW_PATH__: [[], ["d"], ["e"]],
+                    x: [20, 4, 4],
+                });
+
+                table.update({y: ["g"], x: [10]});
+                expect(await view.to_columns()).toEqual({
+                    __ROW_PATH__: [[], ["g"], ["d"]],
+                    x: [28, 10, 4],
+                });
+
+                // Empties the pool of the root's children, which is refilled
+                // from the children that were outside of it.
+                table.remove(["c", "d", "e", "f", "g"]);
+                expect(await view.to_columns()).toEqual({
+                    __ROW_PATH__: [[], ["b"], ["a"]],
+                    x: [4, 2, 1],
+                });
+
+                view.delete();
+                table.delete();
+            });
+        });
+
         describe("With aggregates", function () {
             describe("aggregates, in a sorted column with nulls", function () {
                 it("sum", async function () {
@@ -19,6 +19,8 @@ class Aggregate(Enum):
 
     AND = "and"
     ANY = "any"
+    APPROX_DISTINCT = "approx distinct"
+    APPROX_PERCENTILE = "approx percentile"
     AVG = "avg"
     COUNT = "count"
     DISTINCT_COUNT = "distinct count"
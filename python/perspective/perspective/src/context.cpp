@@ -53,6 +53,11 @@ namespace binding {
         auto cfg = t_config(columns, fterm, filter_op, expressions);
         auto ctx0 = std::make_shared<t_ctx0>(*(schema.get()), cfg);
         ctx0->init();
+
+        if (view_config->get_top_n() > -1) {
+            ctx0->set_top_n(view_config->get_top_n());
+        }
+
         ctx0->sort_by(sortspec);
 
         auto pool = table->get_pool();
@@ -82,6 +87,10 @@ namespace binding {
         ctx1->init();
         ctx1->sort_by(sortspec);
 
+        if (view_config->get_top_n() > -1) {
+            ctx1->set_top_n(view_config->get_top_n());
+        }
+
         auto pool = table->get_pool();
         auto gnode = table->get_gnode();
         pool->register_context(gnode->get_id(), name, ONE_SIDED_CONTEXT,
@@ -260,6 +260,10 @@ namespace binding {
                 config.attr("split_by_depth").cast<std::int32_t>());
         }
 
+        if (!config.attr("top_n").is_none()) {
+            view_config->set_top_n(config.attr("top_n").cast<std::int32_t>());
+        }
+
         return view_config;
     }
 
@@ -33,6 +33,9 @@ class ViewConfig(object):
                 value to filter by.
             expressions (:obj:`list` of :obj:`str`):  A list of string
                 expressions which will be calculated by the view.
+            top_n (:obj:`int`): If set, only the first ``top_n`` rows in sort
+                order are kept - of the whole view for flat views, and of
+                each parent's children for views with group by.
         """
         self._config = config
         self._group_by = self._config.get("group_by", [])
@@ -45,6 +48,7 @@ class ViewConfig(object):
         self._filter_op = self._config.get("filter_op", "and")
         self.group_by_depth = self._config.get("group_by_depth", None)
         self.split_by_depth = self._config.get("split_by_depth", None)
+        self.top_n = self._config.get("top_n", None)
 
     def get_group_by(self):
         """The columns used as
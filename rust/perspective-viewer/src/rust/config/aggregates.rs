@@ -65,6 +65,12 @@ pub enum SingleAggregate {
     #[serde(rename = "distinct count")]
     DistinctCount,
 
+    #[serde(rename = "approx distinct")]
+    ApproxDistinct,
+
+    #[serde(rename = "approx percentile")]
+    ApproxPercentile,
+
     #[serde(rename = "avg")]
     Avg,
 
@@ -109,6 +115,8 @@ impl Display for SingleAggregate {
             SingleAggregate::Last => "last",
             SingleAggregate::Count => "count",
             SingleAggregate::DistinctCount => "distinct count",
+            SingleAggregate::ApproxDistinct => "approx distinct",
+            SingleAggregate::ApproxPercentile => "approx percentile",
             SingleAggregate::Avg => "avg",
             SingleAggregate::Mean => "mean",
             SingleAggregate::Join => "join",
@@ -143,6 +151,8 @@ impl FromStr for SingleAggregate {
             "last" => Ok(SingleAggregate::Last),
             "count" => Ok(SingleAggregate::Count),
             "distinct count" => Ok(SingleAggregate::DistinctCount),
+            "approx distinct" => Ok(SingleAggregate::ApproxDistinct),
+            "approx percentile" => Ok(SingleAggregate::ApproxPercentile),
             "avg" => Ok(SingleAggregate::Avg),
             "mean" => Ok(SingleAggregate::Mean),
             "join" => Ok(SingleAggregate::Join),
@@ -197,6 +207,7 @@ impl FromStr for Aggregate {
 
 const STRING_AGGREGATES: &[SingleAggregate] = &[
     SingleAggregate::Any,
+    SingleAggregate::ApproxDistinct,
     SingleAggregate::Count,
     SingleAggregate::DistinctCount,
     SingleAggregate::Dominant,
@@ -211,6 +222,8 @@ const STRING_AGGREGATES: &[SingleAggregate] = &[
 const NUMBER_AGGREGATES: &[SingleAggregate] = &[
     SingleAggregate::AbsSum,
     SingleAggregate::Any,
+    SingleAggregate::ApproxDistinct,
+    SingleAggregate::ApproxPercentile,
     SingleAggregate::Avg,
     SingleAggregate::Count,
     SingleAggregate::DistinctCount,